@@ -0,0 +1,30 @@
+#!/bin/bash
+if [ "$#" -lt 2 ]; then
+  echo ""
+  echo "*** ERROR: invalid number of arguments ($#)"
+  echo ""
+  echo "Usage: $0 <elf_filename> <nm_exec_name>"
+  exit 1
+fi
+
+nm_exec_name=$2
+elf_filename=$1
+
+# Prints the size in bytes of the given symbol, or nothing if absent.
+symbol_size() {
+  local hex=$($nm_exec_name -S $elf_filename | awk -v sym="$1" '$4 == sym { print $2 }')
+  [ -n "$hex" ] && echo $((16#$hex))
+}
+
+working_size=$(symbol_size g_workingLoggerConfig)
+overlay_size=$(symbol_size g_savedOverlay)
+
+if [ -z "$working_size" ] || [ -z "$overlay_size" ]; then
+  echo "*** WARNING: LoggerConfig symbols not found in $elf_filename"
+  exit 0
+fi
+
+# The working copy used to hold the overlay too, plus a page of padding.
+# The overlay only takes RAM while it has unflashed changes.
+old_size=$((working_size + overlay_size + 256))
+echo "LoggerConfig RAM: $working_size bytes, +$overlay_size while CAN/OBD2 changes are unflashed (was $old_size, saved $((old_size - working_size)))"
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+# Converts a raw CAN capture (an rc_N.can file, see
+# include/CAN/can_capture.h) to the candump log format, one frame per
+# line:
+#
+#   (seconds.micros) canN ID#DATA
+#
+# Timestamps are the logger's uptime unless an offset is given.  A record
+# cut short at the end of the file (power lost while capturing) is
+# dropped.
+
+import optparse
+import struct
+import sys
+
+class RcpCanCaptureDecoder(object):
+    MAGIC = b'RCAN'
+    VERSION = 1
+    HEADER_LEN = 8
+
+    DLC_MASK = 0x0F
+    FLAG_BUS = 0x10
+    FLAG_EXTENDED = 0x20
+    FLAG_TIMESTAMP = 0x40
+
+    def __init__(self):
+        self.have_header = False
+        self.ms = 0
+        self.buff = bytearray()
+
+    def _record_len(self, flags):
+        return (1 + (4 if flags & self.FLAG_TIMESTAMP else 0) +
+                (4 if flags & self.FLAG_EXTENDED else 2) +
+                (flags & self.DLC_MASK))
+
+    def _check_header(self):
+        header = bytes(self.buff[:self.HEADER_LEN])
+        if header[:4] != self.MAGIC:
+            raise ValueError('Not a CAN capture file')
+        if header[4] != self.VERSION:
+            raise ValueError('Unsupported capture version {}'.format(header[4]))
+
+        del self.buff[:self.HEADER_LEN]
+        self.have_header = True
+
+    def feed(self, data):
+        """
+        Adds data to the decoder.  Returns a list of the
+        (ms, bus, id, extended, data) frames that were completed by it.
+        """
+        self.buff.extend(data)
+        frames = []
+
+        if not self.have_header:
+            if len(self.buff) < self.HEADER_LEN:
+                return frames
+            self._check_header()
+
+        offset = 0
+        while offset < len(self.buff):
+            flags = self.buff[offset]
+            end = offset + self._record_len(flags)
+            if end > len(self.buff):
+                break
+
+            pos = offset + 1
+            if flags & self.FLAG_TIMESTAMP:
+                self.ms, = struct.unpack_from('<I', self.buff, pos)
+                pos += 4
+
+            extended = bool(flags & self.FLAG_EXTENDED)
+            if extended:
+                can_id, = struct.unpack_from('<I', self.buff, pos)
+                pos += 4
+            else:
+                can_id, = struct.unpack_from('<H', self.buff, pos)
+                pos += 2
+
+            bus = 1 if flags & self.FLAG_BUS else 0
+            frames.append((self.ms, bus, can_id, extended,
+                           bytes(self.buff[pos:end])))
+            offset = end
+
+        del self.buff[:offset]
+        return frames
+
+
+def format_candump(ms, bus, can_id, extended, data, offset_ms=0,
+                   interface='can'):
+    ms += offset_ms
+    can_id = '{:08X}'.format(can_id) if extended else '{:03X}'.format(can_id)
+    return '({}.{:06d}) {}{} {}#{}'.format(ms // 1000, (ms % 1000) * 1000,
+                                          interface, bus, can_id,
+                                          data.hex().upper())
+
+
+def main():
+    parser = optparse.OptionParser()
+    parser.add_option('-f', '--filename',
+                      dest="capture_file",
+                      help="Path of the CAN capture to convert. " +
+                      "Reads stdin if not given")
+    parser.add_option('-o', '--offset',
+                      dest="offset", type="float", default=0.0,
+                      help="Seconds to add to each timestamp, e.g. the " +
+                      "epoch time the logger was powered up at")
+    parser.add_option('-i', '--interface',
+                      dest="interface", default='can',
+                      help="Interface name prefix.  Defaults to can, " +
+                      "giving can0 and can1")
+
+    options, remainder = parser.parse_args()
+
+    if options.capture_file:
+        fil = open(options.capture_file, 'rb')
+    else:
+        fil = sys.stdin.buffer
+
+    offset_ms = int(round(options.offset * 1000))
+    decoder = RcpCanCaptureDecoder()
+    with fil:
+        for chunk in iter(lambda: fil.read(4096), b''):
+            for frame in decoder.feed(chunk):
+                print(format_candump(*frame, offset_ms=offset_ms,
+                                     interface=options.interface))
+
+if __name__ == '__main__':
+    main()
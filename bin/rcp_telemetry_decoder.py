@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+#
+# Decodes a captured telemetry stream that may hold both JSON messages
+# and binary sample frames (see include/logger/sample_binary.h).  Each
+# sample is printed as a line of CSV: tick followed by one column per
+# channel, empty where the channel was not populated.
+
+import json
+import optparse
+import struct
+import sys
+
+class RcpTelemetryDecoder(object):
+    SOF = 0x02
+    HEADER_LEN = 4
+    FRAME_SAMPLE = 1
+    FRAME_LAYOUT = 2
+
+    # Binary value type -> (struct format, size)
+    VALUE_TYPES = {
+        0: ('<i', 4),
+        1: ('<q', 8),
+        2: ('<f', 4),
+        3: ('<d', 8),
+    }
+
+    def __init__(self):
+        self.types = None
+        self.names = None
+        self.buff = bytearray()
+
+    def _decode_layout(self, payload):
+        count, = struct.unpack_from('<H', payload, 0)
+        self.types = list(payload[2:2 + count])
+
+    def _decode_sample(self, payload):
+        if self.types is None:
+            return None
+
+        tick, bitmap_count = struct.unpack_from('<IB', payload, 0)
+        offset = 5
+        bitmaps = struct.unpack_from('<{}I'.format(bitmap_count),
+                                     payload, offset)
+        offset += 4 * bitmap_count
+
+        values = []
+        for i, value_type in enumerate(self.types):
+            if not bitmaps[i // 32] & (1 << (i % 32)):
+                values.append(None)
+                continue
+
+            fmt, size = self.VALUE_TYPES[value_type]
+            values.append(struct.unpack_from(fmt, payload, offset)[0])
+            offset += size
+
+        return tick, values
+
+    def _decode_json(self, line):
+        try:
+            msg = json.loads(line.decode('utf-8'))
+        except ValueError:
+            return None
+
+        meta = msg.get('s', {}).get('meta')
+        if meta:
+            self.names = [m['nm'] for m in meta]
+
+        return None
+
+    def feed(self, data):
+        """
+        Adds data to the decoder.  Returns a list of the (tick, values)
+        samples that were completed by it.
+        """
+        self.buff.extend(data)
+        samples = []
+
+        while self.buff:
+            if self.buff[0] != self.SOF:
+                eol = self.buff.find(b'\n')
+                if eol < 0:
+                    break
+
+                self._decode_json(bytes(self.buff[:eol + 1]))
+                del self.buff[:eol + 1]
+                continue
+
+            if len(self.buff) < self.HEADER_LEN:
+                break
+
+            frame_type, length = struct.unpack_from('<BH', self.buff, 1)
+            end = self.HEADER_LEN + length
+            if len(self.buff) < end:
+                break
+
+            payload = bytes(self.buff[self.HEADER_LEN:end])
+            del self.buff[:end]
+
+            if frame_type == self.FRAME_LAYOUT:
+                self._decode_layout(payload)
+            elif frame_type == self.FRAME_SAMPLE:
+                sample = self._decode_sample(payload)
+                if sample:
+                    samples.append(sample)
+
+        return samples
+
+
+def main():
+    parser = optparse.OptionParser()
+    parser.add_option('-f', '--filename',
+                      dest="capture_file",
+                      help="Path of captured stream to decode. " +
+                      "Reads stdin if not given")
+
+    options, remainder = parser.parse_args()
+
+    if options.capture_file:
+        fil = open(options.capture_file, 'rb')
+    else:
+        fil = sys.stdin.buffer
+
+    decoder = RcpTelemetryDecoder()
+    header_printed = False
+    with fil:
+        for chunk in iter(lambda: fil.read(4096), b''):
+            for tick, values in decoder.feed(chunk):
+                if not header_printed and decoder.names:
+                    print(','.join(['tick'] + decoder.names))
+                    header_printed = True
+
+                print(','.join([str(tick)] +
+                               ['' if v is None else str(v) for v in values]))
+
+if __name__ == '__main__':
+    main()
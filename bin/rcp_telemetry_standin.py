@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# A stand-in for the telemetry server, for testing store-and-forward.
+# Accepts connections from a logger, reads its JSON sample records and
+# keeps track of their sequence numbers ("q").  Backfilled records
+# ("bf":1) arrive on the next connection, after the live ones that
+# followed them, so sequence numbers are tracked across connections and
+# gaps are reported each time one closes.  Kill the link mid-session
+# (pull the antenna, drive through a tunnel) and check that no gaps are
+# left when the logger has caught up.
+
+import json
+import optparse
+import socket
+
+class SequenceTracker(object):
+    def __init__(self):
+        self.seen = set()
+        self.duplicates = 0
+        self.live = 0
+        self.backfilled = 0
+
+    def add(self, sample):
+        seq = sample.get('q')
+        if seq is None:
+            return
+
+        if seq in self.seen:
+            self.duplicates += 1
+            return
+
+        self.seen.add(seq)
+        if sample.get('bf'):
+            self.backfilled += 1
+        else:
+            self.live += 1
+
+    def gaps(self):
+        """
+        Returns the list of (first, last) ranges of sequence numbers
+        that never arrived.
+        """
+        gaps = []
+        expected = None
+        for seq in sorted(self.seen):
+            if expected is not None and seq > expected:
+                gaps.append((expected, seq - 1))
+            expected = seq + 1
+
+        return gaps
+
+    def report(self):
+        print('live {} backfilled {} duplicates {}'.format(
+            self.live, self.backfilled, self.duplicates))
+        for first, last in self.gaps():
+            print('missing {}-{}'.format(first, last))
+
+
+def serve_connection(conn, tracker, verbose):
+    buff = b''
+
+    with conn:
+        for chunk in iter(lambda: conn.recv(4096), b''):
+            buff += chunk
+            while b'\n' in buff:
+                line, buff = buff.split(b'\n', 1)
+                try:
+                    msg = json.loads(line.decode('utf-8'))
+                except ValueError:
+                    continue
+
+                if not isinstance(msg, dict):
+                    continue
+
+                if verbose and ('s' in msg or 'sb' in msg):
+                    print(line.decode('utf-8').strip())
+
+                if msg.get('s'):
+                    tracker.add(msg['s'])
+
+                # A batch numbers its samples from the first one
+                batch = msg.get('sb')
+                if batch and batch.get('q') is not None:
+                    for i in range(len(batch.get('d', []))):
+                        tracker.add({'q': batch['q'] + i})
+
+    tracker.report()
+
+
+def main():
+    parser = optparse.OptionParser()
+    parser.add_option('-p', '--port',
+                      dest="port", type="int", default=8080,
+                      help="Port to listen on")
+    parser.add_option('-v', '--verbose',
+                      dest="verbose", action="store_true", default=False,
+                      help="Print every sample record")
+
+    options, remainder = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(('', options.port))
+    sock.listen(1)
+
+    tracker = SequenceTracker()
+    while True:
+        conn, addr = sock.accept()
+        print('connection from {}:{}'.format(*addr))
+        serve_connection(conn, tracker, options.verbose)
+
+if __name__ == '__main__':
+    main()
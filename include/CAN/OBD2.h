@@ -30,6 +30,16 @@ CPP_GUARD_BEGIN
 #define OBD2_PID_DEFAULT_TIMEOUT_MS 500
 #define OBD2_PID_REQUEST_TIMEOUT_MS 10
 
+/* IDs the ECU answers PID requests on */
+#define OBD2_11BIT_PID_RESPONSE 0x7E8
+#define OBD2_29BIT_PID_RESPONSE 0x18DAF110
+
+/* The bus OBD2 requests go out on */
+#define OBD2_CAN_BUS 0
+
+/* Most mode 01 PIDs packed into one request, per SAE J1979 */
+#define OBD2_MAX_PIDS_PER_REQUEST 6
+
 /**
  * Call to flag that the OBD2 state is stale
  */
@@ -45,7 +55,7 @@ bool OBD2_is_state_stale(void);
  * Initialize the current values based on the provided OBD2 config
  * @param obd2_config the obd2 configuration used for initialization
  */
-bool OBD2_init_current_values(OBD2Config *obd2_config);
+bool OBD2_init_current_values(const OBD2Config *obd2_config);
 
 /**
  * Get the current OBD2 channel value for the index
@@ -62,18 +72,48 @@ float OBD2_get_current_channel_value(int index);
 void OBD2_set_current_channel_value(int index, float value);
 
 /**
- * Schedule the next OBD2 query, if there is one to schedule.
+ * @return the number of OBD2 channels being queried
+ */
+size_t OBD2_get_channel_count(void);
+
+/**
+ * Get the rate the channel actually received values at, over the last
+ * second or so.
+ * @param index the channel index
+ * @return the achieved rate in Hz
+ */
+float OBD2_get_channel_rate(int index);
+
+/**
+ * @return the smoothed round trip time of OBD2 queries, in ms
+ */
+uint32_t OBD2_get_query_latency(void);
+
+/**
+ * @return true if the ECU has answered an OBD2 query
+ */
+bool OBD2_is_active(void);
+
+/**
+ * @return how long in ms until the next OBD2 query is due, or the
+ * outstanding one times out.  Use this to bound waits for CAN messages.
+ */
+size_t OBD2_next_query_delay_ms(void);
+
+/**
+ * Schedule the next OBD2 query, if one is due.  Each PID is queried at
+ * its configured sample rate, as far as the ECU can keep up.
  * @param obd2_config the current OBDII configuration
  * @param enabled_obd2_pids_count the number of OBDII PIDs to process
  */
-void sequence_next_obd2_query(OBD2Config * obd2_config, uint16_t enabled_obd2_pids_count);
+void sequence_next_obd2_query(const OBD2Config *obd2_config, uint16_t enabled_obd2_pids_count);
 
 /**
  * Update the current OBD2 channel values with the CAN message
  * @param msg the CAN message containing the PID response
  * @param cfg the OBD2 configuration containing the channel mapping
  */
-void update_obd2_channels(CAN_msg *msg, OBD2Config *cfg);
+void update_obd2_channels(CAN_msg *msg, const OBD2Config *cfg);
 
 /**
  * Get the current value matching the specified OBD2 PID.
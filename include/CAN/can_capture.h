@@ -0,0 +1,127 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _CAN_CAPTURE_H_
+#define _CAN_CAPTURE_H_
+
+#include "CAN.h"
+#include "capabilities.h"
+#include "cpp_guard.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/*
+ * Capture file layout.  All fields are little endian.
+ *
+ * The file starts with an 8 byte header: the magic "RCAN", a version
+ * byte and 3 reserved bytes.  It is followed by one record per frame:
+ *
+ *   flags     1 byte: DLC in bits 0-3, bus in bit 4, extended ID in
+ *             bit 5, timestamp follows in bit 6.
+ *   timestamp 4 bytes, ms of uptime.  Only present when it changed since
+ *             the previous record, and always on the first record of a
+ *             buffer.
+ *   id        2 bytes for a standard ID, 4 for an extended one.
+ *   data      DLC bytes.
+ */
+#define CAN_CAPTURE_MAGIC		"RCAN"
+#define CAN_CAPTURE_VERSION		1
+#define CAN_CAPTURE_HEADER_LEN		8
+
+#define CAN_CAPTURE_DLC_MASK		0x0F
+#define CAN_CAPTURE_FLAG_BUS		0x10
+#define CAN_CAPTURE_FLAG_EXTENDED	0x20
+#define CAN_CAPTURE_FLAG_TIMESTAMP	0x40
+
+/* flags + timestamp + extended id + data */
+#define CAN_CAPTURE_RECORD_MAX		(1 + 4 + 4 + CAN_MSG_SIZE)
+
+/* A partially filled buffer is handed to the writer after this long */
+#define CAN_CAPTURE_FLUSH_MS		1000
+
+struct can_capture_stats {
+        uint32_t frames;
+        uint32_t dropped;
+        uint32_t bytes;
+};
+
+/**
+ * Fills buf with the capture file header.
+ * @return The length of the header.
+ */
+size_t can_capture_header(uint8_t *buf);
+
+/**
+ * Asks the CAN task to start capturing frames.  Allocates the capture
+ * buffers on first use.  The capture is running once the CAN task next
+ * calls can_capture_poll.
+ * @return false if capture is not supported or there is no memory.
+ */
+bool can_capture_start(void);
+
+/**
+ * Asks the CAN task to stop capturing frames.  The CAN task hands over
+ * the buffer it was filling the next time it calls can_capture_poll.
+ */
+void can_capture_stop(void);
+
+/**
+ * @return true while the CAN task is capturing frames.
+ */
+bool can_capture_is_running(void);
+
+/**
+ * Records a frame received at the given ms of uptime.  Drops it if the
+ * writer has fallen behind and there is no free buffer.  CAN task only.
+ */
+void can_capture_frame(const CAN_msg *msg, const uint32_t ms);
+
+/**
+ * Acts on start and stop requests and hands over a partially filled
+ * buffer once it gets old.  CAN task only; call it every loop.
+ */
+void can_capture_poll(const uint32_t ms);
+
+/**
+ * @return The oldest filled buffer, or NULL if there is none.  Its length
+ * goes in len.  The buffer stays valid until can_capture_release.
+ * Writer only.
+ */
+const uint8_t* can_capture_peek(size_t *len);
+
+/**
+ * Gives the buffer returned by can_capture_peek back to the CAN task.
+ */
+void can_capture_release(void);
+
+/**
+ * Fills in the counts for the current, or last, capture session.
+ */
+void can_capture_get_stats(struct can_capture_stats *stats);
+
+CPP_GUARD_END
+
+#endif /* _CAN_CAPTURE_H_ */
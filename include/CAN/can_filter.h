@@ -0,0 +1,99 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _CAN_FILTER_H_
+#define _CAN_FILTER_H_
+
+#include "capabilities.h"
+#include "cpp_guard.h"
+#include "loggerConfig.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+#define CAN_FILTER_STD_ID_MASK	0x7FF
+#define CAN_FILTER_EXT_ID_MASK	0x1FFFFFFF
+
+/* Up to two filters per mapping, plus three for the OBD2 response IDs */
+#define CAN_FILTER_MAX	(2 * CAN_MAPPINGS + 3)
+
+/**
+ * One ID/mask acceptance filter.  A frame passes if its ID, masked,
+ * equals the filter ID.  Standard and extended IDs never share a filter.
+ */
+struct can_filter {
+        uint32_t id;
+        uint32_t mask;
+        bool extended;
+};
+
+/**
+ * The acceptance filters for one CAN bus.  If accept_all is set the
+ * filters are meaningless; something needs every frame on the bus.
+ */
+struct can_filter_set {
+        struct can_filter filters[CAN_FILTER_MAX];
+        size_t count;
+        bool accept_all;
+};
+
+/**
+ * Empties the filter set.  An empty set accepts nothing.
+ */
+void can_filter_init(struct can_filter_set *fs);
+
+/**
+ * Adds the filters that pass the frames a CAN mapping with this ID and
+ * mask would match.  A mask of 0 means an exact match.  Mappings don't
+ * look at IDE, so IDs that fit in 11 bits get a standard and an extended
+ * filter.  Filters already covered by others in the set are left out.
+ */
+void can_filter_add(struct can_filter_set *fs, uint32_t id, uint32_t mask);
+
+/**
+ * Builds the filters that pass every frame the CAN mappings and OBD2
+ * channels on the given bus can use.
+ */
+void can_filter_build(struct can_filter_set *fs, const uint8_t bus,
+                      const CANChannelConfig *can_cfg,
+                      const OBD2Config *obd2_cfg);
+
+/**
+ * Merges filters until there are no more than max_banks.  Each merge
+ * picks the pair that lets the fewest extra IDs through.  Falls back to
+ * accept_all if standard and extended IDs can't fit.
+ * @return the number of hardware filter banks needed.
+ */
+size_t can_filter_reduce(struct can_filter_set *fs, const size_t max_banks);
+
+/**
+ * @return true if a frame with the given ID passes the filter set.
+ */
+bool can_filter_accepts(const struct can_filter_set *fs, const uint32_t id,
+                        const bool extended);
+
+CPP_GUARD_END
+
+#endif /* _CAN_FILTER_H_ */
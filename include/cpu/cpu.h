@@ -32,6 +32,14 @@ int cpu_init(void);
 void cpu_reset(int bootloader);
 const char * cpu_get_serialnumber(void);
 
+/**
+ * @return A free running count of CPU cycles.  Wraps, so only use it to
+ * time things that take a lot less than a minute.
+ */
+uint32_t cpu_get_cycle_count(void);
+
+uint32_t cpu_get_cycles_per_usec(void);
+
 CPP_GUARD_END
 
 #endif /* CPU_H_ */
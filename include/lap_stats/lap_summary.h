@@ -0,0 +1,103 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _LAP_SUMMARY_H_
+#define _LAP_SUMMARY_H_
+
+#include "channel_config.h"
+#include "cpp_guard.h"
+#include "dateTime.h"
+#include "serial.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+struct sample;
+
+/**
+ * The running statistics of one channel over a lap.
+ */
+struct lap_summary_channel {
+        const ChannelConfig *cfg;
+        float min;
+        float max;
+        double sum;
+        uint32_t count;
+};
+
+/**
+ * Accumulates the min, max and average of every channel as samples are
+ * taken, and keeps the result of the last completed lap.  The lap
+ * boundaries come from lap_stats, which runs in the GPS task; they are
+ * applied on the next sample so only the logger task touches the
+ * running statistics.
+ */
+void lap_summary_init(void);
+
+/**
+ * Drops the running statistics and the last lap.
+ */
+void lap_summary_reset(void);
+
+/**
+ * Notes that a lap started.  Whatever was accumulated before it, like
+ * an out lap, is dropped.
+ */
+void lap_summary_start_lap(void);
+
+/**
+ * Notes that a lap finished.  The running statistics become the
+ * summary of this lap.
+ */
+void lap_summary_end_lap(const int lap, const tiny_millis_t lap_time);
+
+/**
+ * Adds the populated channels of a sample to the running statistics.
+ * Only the logger task may call this.
+ */
+void lap_summary_add_sample(const struct sample *s);
+
+/**
+ * @return The number of laps summarized so far.  Changes every time a
+ * new summary is available; 0 means there is none yet.
+ */
+uint32_t lap_summary_count(void);
+
+/**
+ * Copies the statistics of a channel of the last completed lap.
+ * @return false if there is no such channel.
+ */
+bool lap_summary_get_channel(const size_t idx,
+                             struct lap_summary_channel *chan);
+
+/**
+ * Writes the last completed lap as
+ * "lapSum":{"lap":<lap>,"ms":<lap time>,"chans":{<name>:[<min>,<max>,<avg>],...}}
+ */
+void lap_summary_get_json(struct Serial *serial, const bool more);
+
+CPP_GUARD_END
+
+#endif /* _LAP_SUMMARY_H_ */
@@ -26,6 +26,7 @@
 #include "serial.h"
 #include "jsmn.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include "channel_config.h"
 #include "auto_control.h"
 
@@ -38,6 +39,8 @@ struct auto_logger_config {
         char channel[DEFAULT_LABEL_LENGTH];
         struct auto_control_trigger start;
         struct auto_control_trigger stop;
+        /* Seconds of samples to keep ahead of an auto start.  0 = off */
+        uint8_t pre_trigger;
 };
 
 void auto_logger_reset_config(struct auto_logger_config* cfg);
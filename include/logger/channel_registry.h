@@ -0,0 +1,144 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHANNEL_REGISTRY_H_
+#define _CHANNEL_REGISTRY_H_
+
+#include "capabilities.h"
+#include "cpp_guard.h"
+#include "sampleRecord.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+#define CHANNEL_REGISTRY_INVALID_INDEX	-1
+
+/*
+ * Upper bound on the channels that are not covered by a configurable
+ * limit (time, analog, IMU, GPS, lap stats, etc).  Generous on purpose.
+ */
+#define CHANNEL_REGISTRY_FIXED_CHANNELS	64
+
+/*
+ * Slot count of the sample channel hash table.  Kept at twice the
+ * maximum possible channel count so probe chains stay short.
+ */
+#define CHANNEL_REGISTRY_SLOTS	(2 * (MAX_VIRTUAL_CHANNELS +	\
+                                      CAN_MAPPINGS +		\
+                                      OBD2_CHANNELS +		\
+                                      CHANNEL_REGISTRY_FIXED_CHANNELS))
+
+/**
+ * Returns the name of the entry at index idx within the ctx collection.
+ */
+typedef const char* channel_name_fn(const void *ctx, const size_t idx);
+
+/**
+ * A small open addressing hash table that maps a channel name to its
+ * index within some collection of channels.  The table does not store
+ * the names themselves; it asks the name_of callback for them when it
+ * needs to resolve a collision.  This keeps each slot at 2 bytes.
+ */
+struct channel_name_index {
+        int16_t *slots;
+        size_t slot_count;
+        channel_name_fn *name_of;
+};
+
+/**
+ * Binds a name index to its backing storage and empties it.
+ */
+void channel_name_index_init(struct channel_name_index *ni, int16_t *slots,
+                             const size_t slot_count,
+                             channel_name_fn *name_of);
+
+/**
+ * Empties the name index.
+ */
+void channel_name_index_reset(struct channel_name_index *ni);
+
+/**
+ * Adds a name to the index.  If the name is already present the
+ * existing entry is kept, matching the first-match semantics of a
+ * linear search.
+ * @return true if the name is present in the index after this call.
+ */
+bool channel_name_index_add(struct channel_name_index *ni, const void *ctx,
+                            const char *name, const size_t idx);
+
+/**
+ * @return The index associated with name, or
+ * CHANNEL_REGISTRY_INVALID_INDEX if it is not present.
+ */
+int channel_name_index_find(const struct channel_name_index *ni,
+                            const void *ctx, const char *name);
+
+/**
+ * A cached reference to a channel by name.  Holders keep one of these
+ * around and pass it to channel_registry_resolve on each use so that the
+ * name lookup only happens when the channel layout changes.
+ */
+struct channel_ref {
+        int index;
+        unsigned int version;
+};
+
+/**
+ * Rebuilds the global channel registry from the layout of the given
+ * sample.  All sample buffers share the same layout, so any one of them
+ * may be used.  Invoke this whenever the sample buffers are
+ * re-initialized.
+ */
+void channel_registry_build(const struct sample *s);
+
+/**
+ * @return The version of the channel registry.  Changes every time the
+ * registry is rebuilt.  0 means it has never been built.
+ */
+unsigned int channel_registry_version(void);
+
+/**
+ * Looks up the index of a channel within the sample by name.  Falls
+ * back to a linear search if the registry does not describe the sample.
+ * @return The channel index or CHANNEL_REGISTRY_INVALID_INDEX.
+ */
+int channel_registry_find(const struct sample *s, const char *name);
+
+/**
+ * Resolves a cached channel reference.  Only performs a lookup when the
+ * registry has been rebuilt since the reference was last resolved.
+ * @return The channel index or CHANNEL_REGISTRY_INVALID_INDEX.
+ */
+int channel_registry_resolve(struct channel_ref *ref,
+                             const struct sample *s, const char *name);
+
+/**
+ * Forces the next channel_registry_resolve call on this reference to
+ * perform a lookup.  Use this when the name being referenced changes.
+ */
+void channel_ref_invalidate(struct channel_ref *ref);
+
+CPP_GUARD_END
+
+#endif /* _CHANNEL_REGISTRY_H_ */
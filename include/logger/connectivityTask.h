@@ -28,8 +28,12 @@
 #include "queue.h"
 #include "sampleRecord.h"
 #include "serial.h"
+#include "stream_profile.h"
 #include "task.h"
 #include "dateTime.h"
+#include "telemetry_backlog.h"
+#include "telemetry_batch.h"
+#include "telemetry_rate.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -45,12 +49,28 @@ typedef struct _ConnParams {
         size_t periodicMeta;
         uint32_t connection_timeout;
         xQueueHandle sampleQueue;
+        struct telemetry_rate *telemetry_rate;
+        struct stream_profile *stream_profile;
+        struct telemetry_backlog *backlog;
+        struct telemetry_batch *batch;
         int max_sample_rate;
         enum led activity_led;
 } ConnParams;
 
 void queueTelemetryRecord(const LoggerMessage *msg);
 
+/**
+ * @return The rate control of the stream on the given connectivity
+ * channel, or NULL if that channel has no stream running.
+ */
+const struct telemetry_rate* connectivity_get_telemetry_rate(const size_t channel);
+
+/**
+ * @return The backlog of the stream on the given connectivity channel,
+ * or NULL if that stream does not keep one.
+ */
+struct telemetry_backlog* connectivity_get_backlog(const size_t channel);
+
 void startConnectivityTask(int16_t priority);
 
 void connectivityTask(void *params);
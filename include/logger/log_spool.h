@@ -0,0 +1,128 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_SPOOL_H_
+#define _LOG_SPOOL_H_
+
+#include "cpp_guard.h"
+#include "sampleRecord.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/* Share of the free heap the spool takes when it is allocated */
+#define LOG_SPOOL_HEAP_PCT	25
+
+/* Not worth having a spool smaller than this */
+#define LOG_SPOOL_MIN_SIZE	1024
+
+/**
+ * Statistics of the spool and the card writes it rides out.  Reset at
+ * the start of every logging session.
+ */
+struct log_spool_stats {
+        /* Bytes of RAM the spool holds records in.  0 if disabled */
+        size_t size;
+        size_t high_water;
+        size_t high_water_records;
+        uint32_t spooled;
+        uint32_t dropped;
+        /* Longest a single write or sync to the card took */
+        uint32_t worst_stall_ms;
+};
+
+/**
+ * Must be called once before any tasks that log start.
+ */
+void log_spool_init(void);
+
+/**
+ * Allocates the spool if it is not yet, sized at LOG_SPOOL_HEAP_PCT of
+ * the free heap but no more than max_size.  Called by the logger task
+ * when logging starts, so the spool only costs RAM once someone logs.
+ * @return The size of the spool.  0 if there is not enough RAM for it.
+ */
+size_t log_spool_alloc(const size_t max_size);
+
+/**
+ * Frees the spool if it has no records left, so the RAM is there for
+ * others between sessions.  The next log_spool_alloc sizes it again.
+ * Only the file writer task may call this, once it has drained the
+ * spool after logging stops.
+ */
+void log_spool_release(void);
+
+/**
+ * Resets the statistics for a new logging session.
+ */
+void log_spool_reset_stats(void);
+
+/**
+ * Adds a sample to the spool as a compact binary record.  Called by the
+ * logger task when the file writer queue is full, or while the spool
+ * still has records so the samples reach the file in order.
+ * @return false if the spool is disabled or full.
+ */
+bool log_spool_add(const struct sample *s);
+
+/**
+ * Adds a sample to the pre-trigger ring.  While not logging the spool
+ * keeps the samples of the last window_ticks, evicting the oldest
+ * records as it goes, so a log that starts late still has the lead up
+ * to its trigger.  Pre-trigger records are not pending until
+ * log_spool_end_preroll is called.
+ * @return false if the spool is disabled, the sample does not fit or
+ * records from the last session have yet to be written.
+ */
+bool log_spool_preroll(const struct sample *s, const uint32_t window_ticks);
+
+/**
+ * Hands the pre-trigger records to the file writer.  Call it once the
+ * log start message is queued so the writer opens the file first.
+ */
+void log_spool_end_preroll(void);
+
+/**
+ * @return The number of records waiting for the file writer.
+ */
+size_t log_spool_pending(void);
+
+/**
+ * Takes the oldest record off the spool.  Only the file writer task may
+ * call this.
+ * @return The record as a sample with the current channel layout, valid
+ * until the next call, or NULL if there are no records.
+ */
+struct sample* log_spool_take(void);
+
+/**
+ * Notes how long a write or sync to the card took.
+ */
+void log_spool_note_stall(const uint32_t ms);
+
+void log_spool_get_stats(struct log_spool_stats *stats);
+
+CPP_GUARD_END
+
+#endif /* _LOG_SPOOL_H_ */
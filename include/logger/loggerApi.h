@@ -29,6 +29,9 @@
 #include "sampleRecord.h"
 #include "serial.h"
 
+#include <stdbool.h>
+#include <stdint.h>
+
 CPP_GUARD_BEGIN
 
 #define API_METHOD(_NAME, _FUNC) {(_NAME), (_FUNC)},
@@ -43,10 +46,12 @@ CPP_GUARD_BEGIN
 	API_METHOD("getCapabilities", api_getCapabilities)		\
 	API_METHOD("getConnCfg", api_getConnectivityConfig)		\
 	API_METHOD("getLapCfg", api_getLapConfig)			\
+	API_METHOD("getLapSum", api_get_lap_summary)			\
 	API_METHOD("getLogfile", api_getLogfile)			\
 	API_METHOD("getMeta", api_getMeta)				\
 	API_METHOD("getObd2Cfg", api_getObd2Config)			\
 	API_METHOD("getStatus", api_getStatus)				\
+	API_METHOD("getTaskStats", api_get_task_stats)			\
 	API_METHOD("getTrackCfg", api_getTrackConfig)			\
 	API_METHOD("getTrackDb", api_getTrackDb)			\
 	API_METHOD("getVer", api_getVersion)				\
@@ -63,6 +68,7 @@ CPP_GUARD_BEGIN
 	API_METHOD("setTelemetry", api_set_telemetry)			\
 	API_METHOD("setTrackCfg", api_setTrackConfig)			\
 	API_METHOD("setWifiCfg", api_set_wifi_cfg)			\
+	API_METHOD("rstTaskStats", api_reset_task_stats)		\
 	API_METHOD("sysReset", api_systemReset)				\
 
 #if GPS_HARDWARE_SUPPORT
@@ -78,8 +84,12 @@ CPP_GUARD_BEGIN
 #define AUTOLOGGING_METHODS                                     \
     API_METHOD("getSdLogCtrlCfg", api_get_auto_logger_cfg)     \
     API_METHOD("setSdLogCtrlCfg", api_set_auto_logger_cfg)
+#define LOG_FILES_METHODS                                       \
+    API_METHOD("getLogData", api_get_log_data)                  \
+    API_METHOD("getLogList", api_get_log_list)
 #else
 #define AUTOLOGGING_METHODS
+#define LOG_FILES_METHODS
 #endif
 
 #if CAMERA_CONTROL  > 0
@@ -142,6 +152,7 @@ CPP_GUARD_BEGIN
 
 #define API_METHODS                             \
         AUTOLOGGING_METHODS                     \
+        LOG_FILES_METHODS                       \
         CAMERA_CONTROL_METHODS                  \
         BASE_API_METHODS                        \
         GPS_API_METHODS                         \
@@ -157,6 +168,8 @@ CPP_GUARD_BEGIN
 int api_flashConfig(struct Serial *serial, const jsmntok_t *json);
 int api_getVersion(struct Serial *serial, const jsmntok_t *json);
 int api_getCapabilities(struct Serial *serial, const jsmntok_t *json);
+int api_get_task_stats(struct Serial *serial, const jsmntok_t *json);
+int api_reset_task_stats(struct Serial *serial, const jsmntok_t *json);
 int api_getStatus(struct Serial *serial, const jsmntok_t *json);
 int api_systemReset(struct Serial *serial, const jsmntok_t *json);
 int api_factoryReset(struct Serial *serial, const jsmntok_t *json);
@@ -170,6 +183,7 @@ int api_getGpsConfig(struct Serial *serial, const jsmntok_t *json);
 int api_setGpsConfig(struct Serial *serial, const jsmntok_t *json);
 int api_setLapConfig(struct Serial *serial, const jsmntok_t *json);
 int api_getLapConfig(struct Serial *serial, const jsmntok_t *json);
+int api_get_lap_summary(struct Serial *serial, const jsmntok_t *json);
 int api_getTrackConfig(struct Serial *serial, const jsmntok_t *json);
 int api_setTrackConfig(struct Serial *serial, const jsmntok_t *json);
 int api_setLogfileLevel(struct Serial *serial, const jsmntok_t *json);
@@ -203,9 +217,65 @@ int api_runScript(struct Serial *serial, const jsmntok_t *json);
 //messages
 void api_sendLogStart(struct Serial *serial);
 void api_sendLogEnd(struct Serial *serial);
+/**
+ * Sends the summary of the last completed lap.
+ */
+void api_send_lap_summary(struct Serial *serial);
+/**
+ * Sends a streamed sample record, terminated and in the format the
+ * client on the serial port asked for.
+ * @param mask The channels the client receives, or NULL for all of them.
+ * The metadata only describes these channels.
+ */
 void api_send_sample_record(struct Serial *serial,
                             const struct sample *sample,
-                            const unsigned int tick, const int sendMeta);
+                            const unsigned int tick, const int sendMeta,
+                            const struct channel_mask *mask);
+
+/**
+ * Same as #api_send_sample_record, but JSON records also carry the
+ * sequence number of the sample in the stream as "q".
+ */
+void api_send_sequenced_sample_record(struct Serial *serial,
+                                      const struct sample *sample,
+                                      const unsigned int tick,
+                                      const uint32_t seq, const int sendMeta,
+                                      const struct channel_mask *mask);
+
+/**
+ * Sends a sample that was kept while the link was down as a JSON sample
+ * record with its sequence number and "bf":1.  Always JSON, whatever
+ * format the client asked for.
+ * @param layout A sample with the channel layout the body was rendered
+ * with.
+ * @param body The binary sample body (see sample_binary.h).
+ * @return false if the body did not fit the layout.
+ */
+bool api_send_backfill_record(struct Serial *serial,
+                              const struct sample *layout,
+                              const struct channel_mask *mask,
+                              const unsigned int tick, const uint32_t seq,
+                              const uint8_t *body, const size_t len);
+
+/**
+ * Sends several consecutive samples as one JSON batch record:
+ * {"sb":{"t":<tick>,"q":<seq>,"meta":[...],"d":[[...],[...]]}}.  Each
+ * inner array is the "d" array of a sample record.  "t" and "q" belong
+ * to the first sample and go up by one for each that follows.
+ * @param layout A sample with the channel layout the bodies were
+ * rendered with.
+ * @param seq The sequence number of the first sample, or NULL if the
+ * stream does not number them.
+ * @param bodies Binary sample bodies (see sample_binary.h), each one
+ * after its u16 little endian length.
+ * @return false if a body did not fit the layout.
+ */
+bool api_send_sample_batch(struct Serial *serial,
+                           const struct sample *layout,
+                           const struct channel_mask *mask,
+                           const unsigned int tick, const uint32_t *seq,
+                           const int sendMeta, const uint8_t *bodies,
+                           const size_t len);
 
 /* Wifi methods */
 int api_get_wifi_cfg(struct Serial *s, const jsmntok_t *json);
@@ -220,6 +290,8 @@ int api_set_active_track(struct Serial *serial, const jsmntok_t *json);
 #if SDCARD_SUPPORT
 int api_get_auto_logger_cfg(struct Serial *serial, const jsmntok_t *json);
 int api_set_auto_logger_cfg(struct Serial *serial, const jsmntok_t *json);
+int api_get_log_list(struct Serial *serial, const jsmntok_t *json);
+int api_get_log_data(struct Serial *serial, const jsmntok_t *json);
 #endif
 
 #if CAMERA_CONTROL
@@ -29,6 +29,7 @@
 #include "cpp_guard.h"
 #include "geopoint.h"
 #include "serial_device.h"
+#include "stream_profile.h"
 #include "timer_config.h"
 #include "tracks.h"
 #include "versionInfo.h"
@@ -39,9 +40,6 @@
 
 CPP_GUARD_BEGIN
 
-/* Internal FLASH Page Size: 256 bytes */
-#define FLASH_PAGE_SIZE	((unsigned int) 256)
-
 /**
  * Standard sample rates based on OS timer ticks.  Note that every
  * sample rate must be evenly divisible by all sample rates below
@@ -285,6 +283,16 @@ typedef struct _CANConfig {
 #if CAN_SW_TERMINATION == true
     bool termination[CONFIG_CAN_CHANNELS];
 #endif
+    /*
+     * Only let the frames the CAN mappings and OBD2 channels use through.
+     * Off by default since Lua scripts may want the rest.
+     */
+    unsigned char auto_filter;
+    /**
+     * Record every raw frame to a .can file next to the log while
+     * logging.  Opens up the acceptance filters.
+     */
+    unsigned char capture;
 } CANConfig;
 
 /* define max offsets and length for CAN mappings */
@@ -468,6 +476,9 @@ typedef struct _BluetoothConfig {
         unsigned char btEnabled;
         char new_name [BT_DEVICE_NAME_LENGTH];
         char new_pin [BT_PASSCODE_LENGTH];
+#if BLUETOOTH_SUPPORT
+        struct stream_profile_config profile;
+#endif
 } BluetoothConfig;
 
 #define CELL_APN_HOST_LENGTH 30
@@ -488,6 +499,9 @@ typedef struct _CellularConfig {
         char apnPass [CELL_APN_PASS_LENGTH + 1];
         char dns1[DNS_ADDR_LEN];
         char dns2[DNS_ADDR_LEN];
+#if CELLULAR_SUPPORT
+        struct stream_profile_config profile;
+#endif
 } CellularConfig;
 
 
@@ -562,11 +576,6 @@ typedef struct _LoggerConfig {
     //CAN Configuration
     CANConfig CanConfig;
 
-    CANChannelConfig can_channel_cfg;
-
-    //OBD2 Config
-    OBD2Config OBD2Configs;
-
     //GPS Configuration
     GPSConfig GPSConfigs;
 
@@ -587,16 +596,80 @@ typedef struct _LoggerConfig {
 #if CAMERA_CONTROL
     struct camera_control_config camera_control_cfg;
 #endif
-    //Padding data to accommodate flash routine
-    char padding_data[FLASH_PAGE_SIZE];
 } LoggerConfig;
 
+/*
+ * The CAN channel mappings and OBD2 PIDs.  They are too big to keep a
+ * copy of in RAM, so they have a flash sector of their own and are read
+ * in place until they are changed.  Go through get_can_channel_config
+ * and get_obd2_config.
+ */
+typedef struct _LoggerConfigOverlay {
+    /* The size of this overlay struct */
+    size_t config_size;
+
+    /* stores the version of the firmware that wrote it */
+    VersionInfo RcpVersionInfo;
+
+    CANChannelConfig can_channel_cfg;
+
+    //OBD2 Config
+    OBD2Config OBD2Configs;
+} LoggerConfigOverlay;
+
+/*
+ * Tasks that hold on to CAN or OBD2 config pointers.  They tell the
+ * config which copy they are using, so that flashing never erases the
+ * image under them.
+ */
+enum logger_config_reader {
+        LOGGER_CONFIG_READER_LOGGER,
+        LOGGER_CONFIG_READER_CAN,
+        LOGGER_CONFIG_READERS,
+};
 
 void initialize_logger_config();
 
 const LoggerConfig * getSavedLoggerConfig();
+
+const LoggerConfigOverlay * getSavedLoggerConfigOverlay();
+
 LoggerConfig * getWorkingLoggerConfig();
 
+/**
+ * @return The working CAN mapping config, read only.  Comes straight
+ * from flash unless it has been changed since it was last flashed.
+ */
+const CANChannelConfig* get_can_channel_config(void);
+
+/**
+ * @return The working CAN mapping config, for changing.  Copies the
+ * overlay to RAM first if need be.  NULL if there is no memory for it.
+ */
+CANChannelConfig* get_can_channel_config_rw(void);
+
+/**
+ * @return The working OBD2 config, read only.
+ */
+const OBD2Config* get_obd2_config(void);
+
+/**
+ * @return The working OBD2 config, for changing.  NULL if there is no
+ * memory for the copy.
+ */
+OBD2Config* get_obd2_config_rw(void);
+
+/**
+ * Called by a reader before it fetches its CAN and OBD2 config pointers
+ * again.  Any pointers it got before must not be used after this.
+ */
+void logger_config_overlay_sync(enum logger_config_reader reader);
+
+/**
+ * @return The bytes of RAM the overlay takes up right now.
+ */
+size_t logger_config_overlay_size(void);
+
 int getConnectivitySampleRateLimit();
 int encodeSampleRate(int sampleRate);
 int decodeSampleRate(int sampleRateCode);
@@ -633,7 +706,12 @@ bool should_sample(const int sample_rate, const int max_rate);
 int getHigherSampleRate(const int a, const int b);
 
 int flashLoggerConfig(void);
-void reset_logger_config(void);
+
+/**
+ * Resets the working config to defaults.
+ * @return false if there was no memory to reset the CAN and OBD2 config.
+ */
+bool reset_logger_config(void);
 int flash_default_logger_config(void);
 
 void logger_config_reset_gps_config(GPSConfig *cfg);
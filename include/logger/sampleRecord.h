@@ -64,7 +64,7 @@ typedef struct _ChannelSample {
         float valueFloat;
         double valueDouble;
     };
-    ChannelConfig *cfg;
+    const ChannelConfig *cfg;
     union {
         int (*get_int_sample)(int);
         long long (*get_longlong_sample)(int);
@@ -110,6 +110,17 @@ size_t init_sample_buffer(struct sample *s, const size_t count);
 void free_sample_buffer(struct sample *s);
 
 
+/**
+ * Gets a sample value by its channel index within the specified sample.
+ * Use channel_registry_find or channel_registry_resolve to get the index.
+ * @param s the sample to fetch a value from
+ * @param index the index of the channel within the sample
+ * @param value pointer to the value to set if sample is found
+ * @return true if the sample was found and set
+ */
+bool get_sample_value_by_index(const struct sample *s, const int index,
+                               double *value);
+
 /**
  * Gets a sample value by name for the specified sample.
  * @param s the sample to fetch a value from
@@ -0,0 +1,86 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SAMPLE_ARENA_H_
+#define _SAMPLE_ARENA_H_
+
+#include "capabilities.h"
+#include "cpp_guard.h"
+#include "sampleRecord.h"
+
+#include <stddef.h>
+
+CPP_GUARD_BEGIN
+
+/* Most sample buffers the logger ring can be laid out with */
+#define SAMPLE_ARENA_MAX_DEPTH	LOGGER_MESSAGE_BUFFER_SIZE
+
+/**
+ * Must be called once before any tasks that use sample buffers start.
+ */
+void sample_arena_init(void);
+
+/**
+ * Lays out the logger's ring of sample buffers in the sample arena.  All
+ * the channel samples live in a single allocation that holds depth
+ * buffers plus one scratch buffer.  The arena is only reallocated when
+ * it is too small for the new layout; it never shrinks.  If a larger
+ * arena can not be had, fewer buffers are laid out.
+ * @param channel_count The channels in each sample buffer.
+ * @param depth The sample buffers wanted, up to SAMPLE_ARENA_MAX_DEPTH.
+ * @return The number of sample buffers laid out.  0 if none could be.
+ */
+size_t sample_arena_layout(const size_t channel_count, size_t depth);
+
+/**
+ * @return The number of sample buffers in the ring.
+ */
+size_t sample_arena_depth(void);
+
+/**
+ * @return The size of the arena in bytes.
+ */
+size_t sample_arena_size(void);
+
+/**
+ * @return The sample buffer at index in the ring, or NULL if index is
+ * past its depth.
+ */
+struct sample* sample_arena_get(const size_t index);
+
+/**
+ * Acquires the scratch sample buffer for one off samples, like the ones
+ * the API builds, laid out for the current config.  Only one task can
+ * hold it at a time.
+ * @param channel_count The channels the buffer needs.
+ * @return The scratch buffer, or NULL if the arena has no room for it.
+ * Must be released with #sample_arena_release_scratch.
+ */
+struct sample* sample_arena_acquire_scratch(const size_t channel_count);
+
+/**
+ * Releases the scratch buffer from #sample_arena_acquire_scratch.
+ */
+void sample_arena_release_scratch(struct sample *s);
+
+CPP_GUARD_END
+
+#endif /* _SAMPLE_ARENA_H_ */
@@ -0,0 +1,195 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SAMPLE_BINARY_H_
+#define _SAMPLE_BINARY_H_
+
+#include "cpp_guard.h"
+#include "sampleRecord.h"
+#include "serial.h"
+#include "stream_profile.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/*
+ * Compact binary framing for streamed samples.  Clients opt in per
+ * connection with {"setTelemetry":{"fmt":1}}.  Everything else on the
+ * connection (API responses, samples carrying metadata) stays JSON, so
+ * a reader tells the two apart by the first byte: '{' starts a JSON
+ * message that ends with "\r\n" and SAMPLE_BINARY_SOF starts a frame.
+ *
+ * Every frame is:
+ *   u8  SAMPLE_BINARY_SOF
+ *   u8  frame type
+ *   u16 payload length
+ *   payload
+ *
+ * SAMPLE_BINARY_LAYOUT payload, sent before the first sample and
+ * whenever the channel layout changes:
+ *   u16 channel count
+ *   u8  value type of each channel
+ *
+ * SAMPLE_BINARY_SAMPLE payload:
+ *   u32 tick
+ *   u8  bitmap count
+ *   u32 bitmaps of populated channels (same as the JSON record)
+ *   raw values of the populated channels, sized by their value type
+ *
+ * All multi-byte fields are little endian.
+ */
+#define SAMPLE_BINARY_SOF		0x02
+#define SAMPLE_BINARY_HEADER_LEN	4
+
+/*
+ * How many connections can ask for the binary format.  Oldest entry gets
+ * replaced when full.
+ */
+#define SAMPLE_BINARY_MAX_CLIENTS	8
+
+enum sample_binary_frame_type {
+        SAMPLE_BINARY_SAMPLE = 1,
+        SAMPLE_BINARY_LAYOUT = 2,
+};
+
+enum sample_binary_value_type {
+        SAMPLE_BINARY_INT32 = 0,
+        SAMPLE_BINARY_INT64 = 1,
+        SAMPLE_BINARY_FLOAT32 = 2,
+        SAMPLE_BINARY_FLOAT64 = 3,
+};
+
+enum telemetry_format {
+        TELEMETRY_FORMAT_JSON = 0,
+        TELEMETRY_FORMAT_BINARY = 1,
+};
+
+/**
+ * Must be called once before any tasks that stream samples start.
+ */
+void sample_binary_init(void);
+
+/**
+ * @return The binary value type used for the channel sample.
+ */
+enum sample_binary_value_type sample_binary_value_type(const ChannelSample *cs);
+
+/**
+ * @return The size in bytes of a value of the given type.
+ */
+size_t sample_binary_value_size(const enum sample_binary_value_type type);
+
+/**
+ * Writes the channel sample as a raw little endian value.
+ * @return The number of bytes written.
+ */
+size_t sample_binary_put_value(uint8_t *buf, const ChannelSample *cs);
+
+/**
+ * Reads a raw little endian value written by #sample_binary_put_value
+ * back into the channel sample.  The value type comes from the sample
+ * data type of cs.
+ * @return The number of bytes read.
+ */
+size_t sample_binary_get_value(ChannelSample *cs, const uint8_t *buf);
+
+/**
+ * Writes a SAMPLE_BINARY_SAMPLE frame.  The body is everything in the
+ * payload after the tick, as rendered by the sample frame.
+ */
+void sample_binary_write_sample(struct Serial *serial, const uint32_t tick,
+                                const uint8_t *body, const size_t body_len);
+
+/**
+ * Writes the body of a binary sample as the contents of the "d" array
+ * of a JSON sample record, exactly as the sample frame would have.
+ * @param layout A sample with the channel layout the body was rendered
+ * with.
+ * @param mask The channels the body was rendered with, or NULL for all.
+ * @return false if the body does not fit the layout.  Part of it may
+ * have been written.
+ */
+bool sample_binary_write_json_values(struct Serial *serial,
+                                     const struct sample *layout,
+                                     const struct channel_mask *mask,
+                                     const uint8_t *body, const size_t len);
+
+/**
+ * Reads the values of a binary sample body rendered with every channel
+ * back into a sample with the same layout, marking the channels that
+ * are not in the body as unpopulated.
+ * @return false if the body does not fit the layout.  Part of it may
+ * have been read.
+ */
+bool sample_binary_read_values(struct sample *s, const uint8_t *body,
+                               const size_t len);
+
+/**
+ * Renders the binary sample body cur as a delta against the body prev
+ * of an earlier sample with the same layout and mask: only the values
+ * that are populated in cur and differ from prev are kept.  The
+ * bitmaps of the delta mark the values it holds.
+ * @param out Where the delta goes.  Needs room for cur_len bytes.
+ * @param prev The earlier body, or NULL to keep every value of cur.
+ * @return The length of the delta, or 0 if a body does not fit the
+ * layout.
+ */
+size_t sample_binary_delta(uint8_t *out, const struct sample *layout,
+                           const struct channel_mask *mask,
+                           const uint8_t *prev, const size_t prev_len,
+                           const uint8_t *cur, const size_t cur_len);
+
+/**
+ * Writes a SAMPLE_BINARY_LAYOUT frame describing the channels of the
+ * sample in the mask, but only if the client on the serial port does
+ * not have the current one.
+ * @param mask The channels the client receives, or NULL for all of them.
+ */
+void sample_binary_write_layout(struct Serial *serial,
+                                const struct sample *s,
+                                const struct channel_mask *mask);
+
+/**
+ * Sets the telemetry format the client on the serial port wants.
+ * @return false if the format is not one we know.
+ */
+bool sample_binary_set_client_format(const struct Serial *serial,
+                                     const int format);
+
+/**
+ * @return true if the client on the serial port asked for the binary
+ * format.
+ */
+bool sample_binary_client_enabled(const struct Serial *serial);
+
+/**
+ * Puts the client back on the JSON format.  Call this when the
+ * connection is re-established.
+ */
+void sample_binary_reset_client(const struct Serial *serial);
+
+CPP_GUARD_END
+
+#endif /* _SAMPLE_BINARY_H_ */
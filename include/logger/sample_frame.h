@@ -0,0 +1,113 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _SAMPLE_FRAME_H_
+#define _SAMPLE_FRAME_H_
+
+#include "cpp_guard.h"
+#include "capabilities.h"
+#include "sampleRecord.h"
+#include "stream_profile.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/*
+ * How many rendered samples we keep around for sharing.  Two per
+ * connectivity channel lets each stream profile keep sending the
+ * previous sample while the next one is rendered for everyone else.
+ */
+#define SAMPLE_FRAME_SLOTS	(2 * CONNECTIVITY_CHANNELS)
+
+/* Longest a single rendered value can be, including the NULL terminator */
+#define SAMPLE_FRAME_VALUE_MAX_LEN	30
+
+/**
+ * The values of one sample rendered as the body of the "d" array of a
+ * sample record: the populated channel values followed by the channel
+ * bitmasks.  The same values are also rendered as the body of a binary
+ * sample frame (see sample_binary.h).  Frames are reference counted so
+ * that every stream sending the same sample with the same channels
+ * shares a single rendering of it.
+ */
+struct sample_frame {
+        size_t refs;
+        bool shared;
+        const struct sample *sample;
+        size_t ticks;
+        unsigned int version;
+        bool masked;
+        struct channel_mask mask;
+        size_t capacity;
+        size_t length;
+        char *data;
+        size_t bin_length;
+        uint8_t *bin;
+};
+
+/**
+ * Must be called once before any tasks that stream samples start.
+ */
+void sample_frame_init(void);
+
+/**
+ * Acquires the rendered frame for the sample.  If another stream has
+ * already rendered this sample with the same channels, and it has not
+ * changed since, that frame is shared.  Otherwise the sample is
+ * rendered now.
+ * @param mask The channels to render, or NULL for all of them.  The
+ * bitmaps of the frame only cover these channels.
+ * @return The frame, or NULL if we are out of memory.  Must be released
+ * with #sample_frame_release.
+ */
+struct sample_frame* sample_frame_acquire(const struct sample *s,
+                                          const struct channel_mask *mask);
+
+/**
+ * Renders the sample into a private frame that is never shared.  Use
+ * this for samples that do not come from the logger sample buffers.
+ * @param mask The channels to render, or NULL for all of them.
+ * @return The frame, or NULL if we are out of memory.  Must be released
+ * with #sample_frame_release.
+ */
+struct sample_frame* sample_frame_create(const struct sample *s,
+                                         const struct channel_mask *mask);
+
+/**
+ * Releases a frame from #sample_frame_acquire or #sample_frame_create.
+ */
+void sample_frame_release(struct sample_frame *f);
+
+/**
+ * Renders the value of the channel sample the same way it appears in a
+ * frame.
+ * @param buf Must have room for SAMPLE_FRAME_VALUE_MAX_LEN bytes.
+ * @return The length of the rendered value.
+ */
+size_t sample_frame_render_value(char *buf, const ChannelSample *cs);
+
+CPP_GUARD_END
+
+#endif /* _SAMPLE_FRAME_H_ */
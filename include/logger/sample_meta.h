@@ -0,0 +1,115 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SAMPLE_META_H_
+#define _SAMPLE_META_H_
+
+#include "cpp_guard.h"
+#include "capabilities.h"
+#include "sampleRecord.h"
+#include "serial.h"
+#include "stream_profile.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/*
+ * How many connections can tell us which meta hash they already have.
+ * Oldest entry gets replaced when full.
+ */
+#define SAMPLE_META_MAX_CLIENTS	8
+
+/*
+ * How many renderings we cache: the full channel list plus one subset
+ * per connectivity channel.
+ */
+#define SAMPLE_META_SLOTS	(CONNECTIVITY_CHANNELS + 1)
+
+/**
+ * The channel metadata ("meta" array) for the current channel layout,
+ * or a subset of it, rendered once into JSON.  Blobs are reference
+ * counted so that a stream can keep sending one while the config
+ * changes underneath it.
+ */
+struct sample_meta {
+        size_t refs;
+        unsigned int version;
+        bool masked;
+        struct channel_mask mask;
+        uint32_t hash;
+        size_t length;
+        char json[];
+};
+
+/**
+ * Must be called once before any tasks that stream samples start.
+ */
+void sample_meta_init(void);
+
+/**
+ * Acquires the rendered metadata for the current channel layout.  The
+ * cached copy is returned if it is still valid.  Otherwise it gets
+ * rendered from the channel layout of s.
+ * @param s A sample with the current channel layout.  May be NULL, in
+ * which case only a valid cached copy will be returned.
+ * @param mask The channels to describe, or NULL for all of them.
+ * @return The metadata, or NULL if it is not cached and s is NULL or we
+ * are out of memory.  Must be released with #sample_meta_release.
+ */
+struct sample_meta* sample_meta_acquire(const struct sample *s,
+                                        const struct channel_mask *mask);
+
+/**
+ * Releases metadata acquired by #sample_meta_acquire.
+ */
+void sample_meta_release(struct sample_meta *sm);
+
+/**
+ * Writes the rendered metadata, including its hash, to the serial port.
+ */
+void sample_meta_write(struct Serial *serial, const struct sample_meta *sm,
+                       const int more);
+
+/**
+ * Records that the client on the other end of the serial port already
+ * has the metadata with the given hash.
+ */
+void sample_meta_set_client_hash(const struct Serial *serial,
+                                 const uint32_t hash);
+
+/**
+ * @return true if the client on the serial port has told us that it has
+ * the metadata with the given hash.
+ */
+bool sample_meta_client_has(const struct Serial *serial, const uint32_t hash);
+
+/**
+ * Forgets what the client on the serial port has.  Call this when the
+ * connection is re-established.
+ */
+void sample_meta_reset_client(const struct Serial *serial);
+
+CPP_GUARD_END
+
+#endif /* _SAMPLE_META_H_ */
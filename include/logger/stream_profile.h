@@ -0,0 +1,149 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _STREAM_PROFILE_H_
+#define _STREAM_PROFILE_H_
+
+#include "channel_config.h"
+#include "cpp_guard.h"
+#include "jsmn.h"
+#include "serial.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/* Most channels a telemetry destination can be limited to */
+#define STREAM_PROFILE_MAX_CHANNELS	40
+
+/*
+ * Words in a channel mask.  Covers as many channels as the bitmaps of
+ * a sample record can describe.
+ */
+#define CHANNEL_MASK_WORDS	10
+
+/* Most samples a destination can have batched into one message */
+#define STREAM_PROFILE_MAX_BATCH	25
+
+/* Whether a destination receives a summary of each completed lap */
+enum stream_lap_summary {
+        STREAM_LAP_SUMMARY_OFF = 0,
+        /* Along with the samples */
+        STREAM_LAP_SUMMARY_ADD,
+        /* Instead of the samples, for links that can't keep up */
+        STREAM_LAP_SUMMARY_ONLY,
+};
+
+/**
+ * Which channels a telemetry destination receives and how fast.  An
+ * empty channel list means every enabled channel, and SAMPLE_DISABLED
+ * means the fastest rate the link supports.  Channels are sent in the
+ * order they appear in the sample, not the order they are listed in.
+ *
+ * Samples can be batched into one message of up to batch_samples
+ * samples, or as many as arrive within batch_ms, whichever fills first.
+ * Both 0 means every sample is sent on its own.
+ *
+ * lap_summary is one of enum stream_lap_summary.
+ */
+struct stream_profile_config {
+        unsigned short sample_rate;
+        unsigned char channel_count;
+        char channels[STREAM_PROFILE_MAX_CHANNELS][DEFAULT_LABEL_LENGTH];
+        unsigned char batch_samples;
+        unsigned short batch_ms;
+        unsigned char lap_summary;
+};
+
+/**
+ * One bit per channel of a sample, by index.  A NULL mask means every
+ * channel.
+ */
+struct channel_mask {
+        uint32_t bits[CHANNEL_MASK_WORDS];
+};
+
+struct sample;
+
+/**
+ * A stream profile bound to the current channel layout.  The mask is
+ * only rebuilt when the channel registry changes.
+ */
+struct stream_profile {
+        const struct stream_profile_config *cfg;
+        unsigned int version;
+        struct channel_mask mask;
+};
+
+void stream_profile_reset_config(struct stream_profile_config *cfg);
+
+void stream_profile_get_config(const struct stream_profile_config *cfg,
+                               struct Serial *serial, const bool more);
+
+/**
+ * Sets the profile from a
+ * {"sr":<hz>,"chans":[<name>,...],"batch":<samples>,"batchMs":<ms>,
+ *  "laps":<lap summary>}
+ * object.  Fields that are missing are left alone.
+ * @return false if the object is malformed, lists too many channels,
+ * batches too many samples or asks for an unknown lap summary mode.
+ */
+bool stream_profile_set_config(struct stream_profile_config *cfg,
+                               const jsmntok_t *json);
+
+/**
+ * @return The rate the destination should stream at given the fastest
+ * rate its link supports.  Never faster than link_max.
+ */
+int stream_profile_sample_rate(const struct stream_profile_config *cfg,
+                               const int link_max);
+
+/**
+ * Binds a stream profile to its config.  A NULL cfg selects the default
+ * profile, for links that have no profile of their own.
+ */
+void stream_profile_init(struct stream_profile *sp,
+                         const struct stream_profile_config *cfg);
+
+/**
+ * @return The channels of s that the destination receives, or NULL if
+ * it receives all of them.
+ */
+const struct channel_mask* stream_profile_mask(struct stream_profile *sp,
+                                               const struct sample *s);
+
+/**
+ * @return true if the channel at idx is in the mask.
+ */
+bool channel_mask_has(const struct channel_mask *mask, const size_t idx);
+
+/**
+ * @return true if both masks select the same channels.
+ */
+bool channel_mask_equal(const struct channel_mask *a,
+                        const struct channel_mask *b);
+
+CPP_GUARD_END
+
+#endif /* _STREAM_PROFILE_H_ */
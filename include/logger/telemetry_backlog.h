@@ -0,0 +1,139 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TELEMETRY_BACKLOG_H_
+#define _TELEMETRY_BACKLOG_H_
+
+#include "FreeRTOS.h"
+#include "cpp_guard.h"
+#include "ring_buffer.h"
+#include "sampleRecord.h"
+#include "semphr.h"
+#include "serial.h"
+#include "stream_profile.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/* Only backfill while the TX buffer of the link is less full than this */
+#define TELEMETRY_BACKLOG_DRAIN_TX_PCT	25
+
+/**
+ * Keeps the samples a stream could not send while its link was down so
+ * they can be backfilled once it is back.  Samples are captured by the
+ * logger task as compact binary records (see sample_binary.h) rendered
+ * with the channels of the stream profile, at the stream's rate.  The
+ * oldest records are dropped when the backlog is full.
+ *
+ * Every sample of the stream, live or backfilled, gets the next number
+ * of one sequence so the server can put them together and ignore ones it
+ * already has.  A backlog only holds records of one channel layout; it
+ * is emptied when the layout changes.
+ */
+struct telemetry_backlog {
+        xSemaphoreHandle mutex;
+        struct ring_buff *rb;
+        struct stream_profile profile;
+        int rate;
+        volatile bool capturing;
+        unsigned int version;
+        uint32_t next_seq;
+        size_t records;
+
+        uint32_t captured;
+        uint32_t dropped;
+        uint32_t backfilled;
+
+        /* Only used by the task that drains the backlog */
+        uint8_t *scratch;
+        size_t scratch_cap;
+};
+
+/**
+ * Sets up a backlog.
+ * @param size Bytes of RAM to hold records in.
+ * @param cfg The stream profile of the stream.
+ * @param rate The sample rate the stream is sent at.
+ * @return false if we are out of memory.
+ */
+bool telemetry_backlog_init(struct telemetry_backlog *bl, const size_t size,
+                            const struct stream_profile_config *cfg,
+                            const int rate);
+
+/**
+ * @return true if the backlog was set up.  Safe to call on one that was
+ * never initialized, as long as it was zeroed.
+ */
+bool telemetry_backlog_enabled(const struct telemetry_backlog *bl);
+
+/**
+ * Starts or stops capturing samples.  Capture while the link is down.
+ */
+void telemetry_backlog_set_capturing(struct telemetry_backlog *bl,
+                                     const bool capturing);
+
+bool telemetry_backlog_capturing(const struct telemetry_backlog *bl);
+
+/**
+ * Adds the sample to the backlog if we are capturing and it is due at
+ * the stream's rate.  Called by the logger task.
+ * @return true if the sample was added.
+ */
+bool telemetry_backlog_capture(struct telemetry_backlog *bl,
+                               const struct sample *s);
+
+/**
+ * @return The sequence number for the next live sample.
+ */
+uint32_t telemetry_backlog_next_seq(struct telemetry_backlog *bl);
+
+/**
+ * @return The number of records waiting to be backfilled.
+ */
+size_t telemetry_backlog_pending(struct telemetry_backlog *bl);
+
+/**
+ * @return true if there is something to backfill and the link has room
+ * for it.
+ */
+bool telemetry_backlog_should_drain(struct telemetry_backlog *bl,
+                                    const size_t tx_pending,
+                                    const size_t tx_capacity);
+
+/**
+ * Sends the oldest record as a backfilled sample record.
+ * @param layout A sample with the current channel layout.
+ * @param mask The channels of the stream, or NULL for all of them.
+ * @param tick The record count of the connection, like a live sample.
+ * @return true if a record was sent.
+ */
+bool telemetry_backlog_send(struct telemetry_backlog *bl,
+                            struct Serial *serial,
+                            const struct sample *layout,
+                            const struct channel_mask *mask,
+                            const unsigned int tick);
+
+CPP_GUARD_END
+
+#endif /* _TELEMETRY_BACKLOG_H_ */
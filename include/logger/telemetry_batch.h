@@ -0,0 +1,122 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _TELEMETRY_BATCH_H_
+#define _TELEMETRY_BATCH_H_
+
+#include "cpp_guard.h"
+#include "dateTime.h"
+#include "sampleRecord.h"
+#include "serial.h"
+#include "stream_profile.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/* Bytes of sample bodies a stream can hold for one batch */
+#define TELEMETRY_BATCH_BUFFER_SIZE	2048
+
+/**
+ * Collects the samples of a stream so they go out as one message (see
+ * api_send_sample_batch).  Slow links like cellular pay for every write
+ * in modem framing, TCP/IP headers and airtime; one larger write costs
+ * far less than many small ones.
+ *
+ * Samples are kept as binary bodies (see sample_binary.h).  The first
+ * sample of a batch keeps all of its values and every one after it
+ * only those that changed since the sample before it.  A reader carries
+ * values forward from one sample to the next, just like it does for
+ * channels that are not populated in a sample record.
+ */
+struct telemetry_batch {
+        const struct stream_profile_config *cfg;
+        uint8_t *buff;
+        size_t used;
+        size_t count;
+
+        /* Where the batch starts */
+        tiny_millis_t started;
+        unsigned int tick;
+        uint32_t seq;
+        bool sequenced;
+        bool send_meta;
+
+        /* What the bodies were rendered with */
+        const struct sample *layout;
+        const struct channel_mask *mask;
+        unsigned int version;
+
+        /* Full body of the last sample added, to take deltas against */
+        uint8_t *prev;
+        size_t prev_len;
+        size_t prev_cap;
+};
+
+/**
+ * Sets up a batch for a stream.  Only allocates memory if the profile
+ * asks for batching.
+ * @return false if we are out of memory.
+ */
+bool telemetry_batch_init(struct telemetry_batch *tb,
+                          const struct stream_profile_config *cfg);
+
+/**
+ * @return true if samples of the stream should go through the batch.
+ */
+bool telemetry_batch_enabled(const struct telemetry_batch *tb);
+
+/**
+ * Drops any samples in the batch.  Call this when the connection is
+ * re-established.
+ */
+void telemetry_batch_reset(struct telemetry_batch *tb);
+
+/**
+ * Adds a sample to the batch.  Sends the batch first if the sample
+ * does not belong in it, and after if that filled it.
+ * @param seq The sequence number of the sample, or NULL.
+ * @param send_meta If the channel metadata should go with the sample.
+ */
+void telemetry_batch_add(struct telemetry_batch *tb, struct Serial *serial,
+                         const struct sample *s,
+                         const struct channel_mask *mask,
+                         const unsigned int tick, const uint32_t *seq,
+                         const bool send_meta, const tiny_millis_t now);
+
+/**
+ * @return true if the batch has waited as long as it should.
+ */
+bool telemetry_batch_due(const struct telemetry_batch *tb,
+                         const tiny_millis_t now);
+
+/**
+ * Sends whatever is in the batch.  Drops it instead if the channel
+ * layout changed since it was started.
+ */
+void telemetry_batch_flush(struct telemetry_batch *tb, struct Serial *serial);
+
+CPP_GUARD_END
+
+#endif /* _TELEMETRY_BATCH_H_ */
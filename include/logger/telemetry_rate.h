@@ -0,0 +1,119 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _TELEMETRY_RATE_H_
+#define _TELEMETRY_RATE_H_
+
+#include "cpp_guard.h"
+#include "dateTime.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/* How long to wait after a change before stepping down again */
+#define TELEMETRY_RATE_STEP_DOWN_HOLDOFF_MS	1000
+
+/* How long the link must be clear before we try a faster rate */
+#define TELEMETRY_RATE_STEP_UP_MS		5000
+
+/*
+ * The link is considered backed up once its TX buffer is this
+ * percentage full after a sample was written.
+ */
+#define TELEMETRY_RATE_TX_FULL_PCT		50
+
+/**
+ * Adapts the streaming rate of a connection to what its link can drain.
+ * The rate steps down as soon as the link shows it can't keep up: the
+ * sample queue overflowed, the TX buffer stays backed up or writing a
+ * sample takes more than half a sample period.  The rate steps back up
+ * toward the configured maximum once the link has been clear for a
+ * while.
+ */
+struct telemetry_rate {
+        const char *name;
+        int max_rate;
+        int rate;
+        size_t level;
+        size_t max_level;
+
+        uint32_t sent;
+        /* Written by the logger task, so only ever incremented */
+        volatile uint32_t dropped;
+        uint32_t dropped_seen;
+        uint32_t latency_ms;
+        uint32_t latency_max_ms;
+
+        tiny_millis_t changed_at;
+        tiny_millis_t clear_since;
+};
+
+/**
+ * Sets up the rate control of a stream.
+ * @param name The name of the stream, as reported in the status.
+ * @param max_rate The fastest sample rate the stream may use.
+ */
+void telemetry_rate_init(struct telemetry_rate *tr, const char *name,
+                         const int max_rate);
+
+/**
+ * Goes back to the maximum rate and clears the latency stats.  The
+ * sent and dropped counts keep running.  Call this when the connection
+ * is re-established.
+ */
+void telemetry_rate_reset(struct telemetry_rate *tr, const tiny_millis_t now);
+
+/**
+ * @return true if the sample at the given logger tick should be sent at
+ * the current rate.
+ */
+bool telemetry_rate_should_send(const struct telemetry_rate *tr,
+                                const size_t ticks);
+
+/**
+ * Records a sample that was dropped before it could be sent.  Safe to
+ * call from the task that feeds the stream.
+ */
+void telemetry_rate_dropped(struct telemetry_rate *tr);
+
+/**
+ * Records a sample that was sent and adapts the rate.
+ * @param tx_pending Bytes still waiting in the TX buffer of the link.
+ * @param tx_capacity Size of the TX buffer of the link.
+ * @param write_ms How long writing the sample took.
+ * @param now The current uptime.
+ */
+void telemetry_rate_sent(struct telemetry_rate *tr, const size_t tx_pending,
+                         const size_t tx_capacity, const uint32_t write_ms,
+                         const tiny_millis_t now);
+
+/**
+ * @return The current rate in Hz.
+ */
+int telemetry_rate_hz(const struct telemetry_rate *tr);
+
+CPP_GUARD_END
+
+#endif /* _TELEMETRY_RATE_H_ */
@@ -92,6 +92,13 @@ enum log_level {
 #define WARNING_LEVEL	(get_log_level() >= WARNING)
 #define TRACE_LEVEL 	(get_log_level() >= TRACE)
 
+/*
+ * The *_int_msg, *_float_msg and *_bool_msg variants do not format
+ * anything at the call site.  They record the msg pointer and the raw
+ * value and formatting happens when the log is drained.  Because of
+ * this msg MUST have static lifetime (a string literal in practice).
+ */
+
 size_t read_log_to_serial(struct Serial *s, int escape);
 int writek(const char *msg);
 int writek_int(int value);
@@ -0,0 +1,77 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOG_FILES_H_
+#define _LOG_FILES_H_
+
+#include "cpp_guard.h"
+#include "serial.h"
+
+#include <stddef.h>
+
+CPP_GUARD_BEGIN
+
+/* An 8.3 file name and its NUL */
+#define LOG_FILES_NAME_LEN	13
+
+/* Most log files listed by one getLogList response */
+#define LOG_FILES_LIST_MAX	32
+
+/*
+ * Most bytes of a log file sent by one getLogData response, and the
+ * default.  Big enough that the round trip between chunks is small next
+ * to the time on the wire, small enough that a
+ * logging session waiting on the card is not held up for long.
+ */
+#define LOG_FILES_CHUNK_SIZE	65536
+
+/**
+ * Streams a page of the log files on the SD card as
+ * {"logList":{"files":[{"nm":...,"sz":...},...],"next":N}}.  Pass next
+ * back as start to get the following page.  next is -1 once the listing
+ * is complete.
+ * @param start Directory position to resume from.  0 for the first page.
+ * @param count Most files to list.  0 or anything larger than
+ * LOG_FILES_LIST_MAX means LOG_FILES_LIST_MAX.
+ * @return An API status code.
+ */
+int log_files_list(struct Serial *serial, const size_t start,
+                   const size_t count);
+
+/**
+ * Streams up to len bytes of a log file from offset as
+ * {"logData":{"nm":...,"off":N,"sz":N,"data":"...","len":N}}, where sz is
+ * the size of the file and len the bytes actually sent.  The data string
+ * carries the raw bytes: JSON escapes for control characters, quotes and
+ * backslashes, and \u00XX for every byte outside of printable ASCII, so
+ * each character of the decoded string is one byte of the file.  A
+ * response may carry fewer bytes than asked for, for example if logging
+ * starts mid-transfer; resume from off + len.
+ * @param len Most bytes to send.  0 or anything larger than
+ * LOG_FILES_CHUNK_SIZE means LOG_FILES_CHUNK_SIZE.
+ * @return An API status code.
+ */
+int log_files_read(struct Serial *serial, const char *name,
+                   const size_t offset, const size_t len);
+
+CPP_GUARD_END
+
+#endif /* _LOG_FILES_H_ */
@@ -35,6 +35,14 @@ int UnmountFS();
 bool sdcard_present();
 int OpenNextLogFile(FIL *f);
 
+/**
+ * FatFs is not re-entrant here.  Any task that mounts the card holds
+ * this lock until it unmounts it again.
+ * @return true if the lock was taken.
+ */
+bool sdcard_lock(const size_t timeout_ms);
+void sdcard_unlock(void);
+
 CPP_GUARD_END
 
 #endif /*SDCARD_H_*/
@@ -110,6 +110,13 @@ int serial_read_c(struct Serial *s, char* c);
 
 int serial_read_byte(struct Serial *serial, uint8_t *b, const size_t delay);
 
+int serial_read_buff_wait(struct Serial *s, char *buff, const size_t len,
+                          const size_t delay);
+
+int serial_read_until_wait(struct Serial *s, char *buff, const size_t len,
+                           const char *delims, const size_t delims_len,
+                           const size_t delay);
+
 int serial_read_line(struct Serial *s, char *l, const size_t len);
 
 int serial_read_line_wait(struct Serial *s, char *l, const size_t len,
@@ -126,10 +133,28 @@ int serial_write_s_wait(struct Serial *s, const char *l, const size_t delay);
 
 int serial_write_s(struct Serial *s, const char *l);
 
-xQueueHandle serial_get_rx_queue(struct Serial *s);
+size_t serial_rx_put(struct Serial *s, const void *data, const size_t len,
+                     const size_t delay);
+
+size_t serial_rx_put_isr(struct Serial *s, const void *data, const size_t len,
+                         portBASE_TYPE *task_woken);
+
+bool serial_rx_peek_c(struct Serial *s, char *c);
+
+size_t serial_rx_available(struct Serial *s);
 
 xQueueHandle serial_get_tx_queue(struct Serial *s);
 
+/**
+ * @return The number of bytes waiting to be transmitted.
+ */
+size_t serial_tx_pending(struct Serial *s);
+
+/**
+ * @return The number of bytes the transmit buffer can hold.
+ */
+size_t serial_tx_capacity(const struct Serial *s);
+
 enum serial_ioctl_status {
 	SERIAL_IOCTL_STATUS_OK = 0,
 	SERIAL_IOCTL_STATUS_ERR = -1,
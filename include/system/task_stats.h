@@ -0,0 +1,124 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _TASK_STATS_H_
+#define _TASK_STATS_H_
+
+#include "cpp_guard.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/*
+ * Upper bounds, in microseconds, of the histogram buckets.  The last
+ * bucket takes everything longer.
+ */
+#define TASK_STATS_BUCKET_LIMITS_US	\
+        {100, 250, 500, 1000, 2500, 5000, 10000}
+#define TASK_STATS_BUCKETS	8
+
+/* The loops we keep stats on */
+enum task_stats_id {
+        TASK_STATS_LOGGER = 0,
+        TASK_STATS_FILE_WRITER,
+        TASK_STATS_CAN,
+        TASK_STATS_LUA,
+        TASK_STATS_COUNT,
+};
+
+struct task_stats_histogram {
+        uint32_t counts[TASK_STATS_BUCKETS];
+};
+
+/**
+ * Timing of one iteration of a task loop, measured with the CPU cycle
+ * counter.  Run time is from the start of an iteration to its end, so
+ * it includes any time the task was preempted.  Lateness is how long
+ * after it was due an iteration started.  Each task updates only its
+ * own stats, so there is no locking.
+ */
+struct task_stats {
+        uint32_t runs;
+        uint32_t missed;
+        uint64_t busy_us;
+        uint32_t run_max_us;
+        uint32_t late_max_us;
+        uint32_t budget_us;
+        size_t queue_max;
+        struct task_stats_histogram run;
+        struct task_stats_histogram late;
+
+        /* The iteration in progress */
+        uint32_t started;
+        uint32_t due;
+        volatile bool is_due;
+};
+
+/**
+ * Clears the stats of every task.  Budgets are kept.
+ */
+void task_stats_reset(void);
+
+/**
+ * Sets how long an iteration of the task may run before it counts as a
+ * missed deadline.  0 means it has no deadline.
+ */
+void task_stats_set_budget(const enum task_stats_id id,
+                           const uint32_t budget_us);
+
+/**
+ * Marks the task as due to run now.  The next task_stats_begin call
+ * records how late it was.  Safe to call from an ISR.
+ */
+void task_stats_due(const enum task_stats_id id);
+
+/**
+ * Records how late an iteration started, for tasks that know that
+ * themselves.
+ */
+void task_stats_late(const enum task_stats_id id, const uint32_t late_us);
+
+void task_stats_begin(const enum task_stats_id id);
+
+void task_stats_end(const enum task_stats_id id);
+
+/**
+ * Records the number of messages waiting in the queue the task feeds
+ * from, keeping the highest.
+ */
+void task_stats_queue(const enum task_stats_id id, const size_t depth);
+
+const struct task_stats* task_stats_get(const enum task_stats_id id);
+
+const char* task_stats_name(const enum task_stats_id id);
+
+/**
+ * @return Milliseconds since the stats were last reset.
+ */
+uint32_t task_stats_duration_ms(void);
+
+CPP_GUARD_END
+
+#endif /* _TASK_STATS_H_ */
@@ -0,0 +1,52 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include "cpp_guard.h"
+#include <stddef.h>
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+#define HASH_FNV1A_INIT	2166136261u
+
+/**
+ * Continues a 32 bit FNV-1a hash over a block of memory.  Use
+ * HASH_FNV1A_INIT as the starting value.
+ */
+uint32_t hash_fnv1a_update(uint32_t hash, const void *data, const size_t len);
+
+/**
+ * 32 bit FNV-1a hash of a block of memory.  Not cryptographic; meant
+ * for hash tables and change detection.
+ */
+uint32_t hash_fnv1a(const void *data, const size_t len);
+
+/**
+ * 32 bit FNV-1a hash of a NULL terminated string.
+ */
+uint32_t hash_fnv1a_str(const char *str);
+
+CPP_GUARD_END
+
+#endif /* _HASH_H_ */
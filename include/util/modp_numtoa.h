@@ -26,6 +26,7 @@
 
 #include "cpp_guard.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 CPP_GUARD_BEGIN
@@ -70,6 +71,13 @@ void modp_ultoa10(uint64_t value, char* buf);
  */
 void modp_ftoa(float value, char* buf, int precision);
 
+/**
+ * Same output as modp_ftoa, but digits are written in place, most
+ * significant first, so no reversal or zero trimming pass is needed.
+ * @return The length of the string written, excluding the NUL.
+ */
+size_t modp_ftoa_fixed(float value, char* buf, int precision);
+
 void modp_dtoa(double value, char* buf, int precision);
 
 /** \brief convert an integer to string with selectable base
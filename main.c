@@ -37,7 +37,9 @@
 #include "fileWriter.h"
 #include "gpioTasks.h"
 #include "gpsTask.h"
+#include "lap_summary.h"
 #include "led.h"
+#include "log_spool.h"
 #include "loggerHardware.h"
 #include "loggerTaskEx.h"
 #include "luaScript.h"
@@ -45,6 +47,10 @@
 #include "messaging.h"
 #include "panic.h"
 #include "printk.h"
+#include "sample_arena.h"
+#include "sample_binary.h"
+#include "sample_frame.h"
+#include "sample_meta.h"
 #include "task.h"
 #include "usb_comm.h"
 #include "wifi.h"
@@ -77,6 +83,12 @@ void setupTask(void *param)
 
         InitLoggerHardware();
         initMessaging();
+        lap_summary_init();
+        log_spool_init();
+        sample_arena_init();
+        sample_meta_init();
+        sample_frame_init();
+        sample_binary_init();
 
         startGPSTask(RCP_INPUT_PRIORITY);
 
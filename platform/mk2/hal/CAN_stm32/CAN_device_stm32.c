@@ -268,8 +268,8 @@ int CAN_device_set_filter(const uint8_t const channel, const uint8_t id, const u
         const size_t shift = extended ? 3 : 21;
         CAN_filter_init_structure.CAN_FilterIdHigh = (filter << shift) >> 16;
         CAN_filter_init_structure.CAN_FilterMaskIdHigh = (mask << shift) >> 16;
-        CAN_filter_init_structure.CAN_FilterIdLow = (uint16_t) filter;
-        CAN_filter_init_structure.CAN_FilterMaskIdLow = (uint16_t) mask;
+        CAN_filter_init_structure.CAN_FilterIdLow = (uint16_t) (filter << shift);
+        CAN_filter_init_structure.CAN_FilterMaskIdLow = (uint16_t) (mask << shift);
 
         CAN_FilterInit(&CAN_filter_init_structure);
 
@@ -497,8 +497,7 @@ static void usart_generic_irq_handler(volatile struct usart_info *ui)
                  * to avoid any casting issues from uint16_t
                  */
                 cChar = (uint8_t) USART_ReceiveData(usart);
-                xQueueHandle rx_queue = serial_get_rx_queue(ui->serial);
-                if (!xQueueSendFromISR(rx_queue, &cChar, &xTaskWoken))
+                if (!serial_rx_put_isr(ui->serial, &cChar, 1, &xTaskWoken))
                         ui->char_dropped = true;
         } else if (ore_set) {
                 /*
@@ -551,16 +550,23 @@ static bool dma_rx_isr(volatile struct usart_info *ui)
         volatile uint8_t* const buff = ui->dma_rx.buff;
         volatile uint8_t* const edge = buff + ui->dma_rx.buff_size;
         volatile uint8_t* const head = dma_counter ? edge - dma_counter : buff;
-        xQueueHandle queue = serial_get_rx_queue(ui->serial);
         portBASE_TYPE task_awoke = pdFALSE;
 
-        while (tail != head) {
-                uint8_t val = *tail;
-                if (!xQueueSendFromISR(queue, &val, &task_awoke))
+        /* Hand the new data over in at most two spans since it may wrap */
+        if (head < tail) {
+                const size_t len = edge - tail;
+                if (serial_rx_put_isr(ui->serial, (const void*) tail, len,
+                                      &task_awoke) < len)
                         ui->char_dropped = true;
 
-                if (++tail >= edge)
-                        tail = buff;
+                tail = buff;
+        }
+
+        if (tail != head) {
+                const size_t len = head - tail;
+                if (serial_rx_put_isr(ui->serial, (const void*) tail, len,
+                                      &task_awoke) < len)
+                        ui->char_dropped = true;
         }
 
         ui->dma_rx.ptr = head;
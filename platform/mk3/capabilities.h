@@ -31,6 +31,33 @@
 #define MAX_SECTORS	20
 #define MAX_VIRTUAL_CHANNELS	100
 #define LOGGER_MESSAGE_BUFFER_SIZE	10
+/*
+ * Bytes of RAM the cellular stream keeps samples in while its link is
+ * down, to backfill once it is back.
+ */
+#define TELEMETRY_BACKLOG_SIZE	16384
+/*
+ * Most bytes of RAM the logger spools samples in while the SD card is
+ * too slow to keep up.  Takes less if the heap is short when logging
+ * starts.
+ */
+#define LOG_SPOOL_MAX_SIZE	32768
+/*
+ * Bytes of SD card space to reserve ahead of the log file while writing,
+ * so cluster allocation happens a chunk at a time instead of in the
+ * middle of a session.  The reserve is trimmed off when the file is
+ * closed; a file not closed cleanly (power cut) keeps it as junk at the
+ * end.  0 disables.
+ */
+#define LOG_PREALLOC_SIZE	0
+/*
+ * Bytes of RAM that raw CAN frames queue up in on their way to the SD
+ * card while capturing, split into CAN_CAPTURE_BUFFERS buffers.  Only
+ * allocated once a capture starts.  A frame takes 11 bytes or so, and
+ * a busy 1 Mbit bus carries about 8000 a second.  0 disables.
+ */
+#define CAN_CAPTURE_SIZE	32768
+#define CAN_CAPTURE_BUFFERS	8
 /*
  * What is the maximum number of samples available per predictive time
  * buffer.  More samples == better resolution. Each slot is 12 bytes.
@@ -80,6 +107,7 @@
 #define CAN_CHANNELS			2
 #define CAN_SW_TERMINATION      true
 #define CAN_MAPPINGS            100
+#define CAN_FILTER_BANKS        13
 #define OBD2_CHANNELS           20
 
 //Wireless connections
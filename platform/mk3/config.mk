@@ -81,6 +81,8 @@ $(RCP_SRC)/CAN/CAN_task.c \
 $(RCP_SRC)/CAN/CAN_aux_queue.c \
 $(RCP_SRC)/CAN/can_mapping.c \
 $(RCP_SRC)/CAN/can_channels.c \
+$(RCP_SRC)/CAN/can_capture.c \
+$(RCP_SRC)/CAN/can_filter.c \
 $(RCP_SRC)/GPIO/GPIO.c \
 $(RCP_SRC)/GPIO/gpioTasks.c \
 $(RCP_SRC)/LED/led.c \
@@ -110,13 +112,16 @@ $(RCP_SRC)/gsm/gsm.c \
 $(RCP_SRC)/imu/imu.c \
 $(RCP_SRC)/jsmn/jsmn.c \
 $(RCP_SRC)/lap_stats/lap_stats.c \
+$(RCP_SRC)/lap_stats/lap_summary.c \
 $(RCP_SRC)/launch_control.c \
 $(RCP_SRC)/logger/auto_control.c \
 $(RCP_SRC)/logger/auto_logger.c \
 $(RCP_SRC)/logger/camera_control.c \
 $(RCP_SRC)/logger/channel_config.c \
+$(RCP_SRC)/logger/channel_registry.c \
 $(RCP_SRC)/logger/connectivityTask.c \
 $(RCP_SRC)/logger/fileWriter.c \
+$(RCP_SRC)/logger/log_spool.c \
 $(RCP_SRC)/logger/logger.c \
 $(RCP_SRC)/logger/loggerApi.c \
 $(RCP_SRC)/logger/loggerCommands.c \
@@ -126,6 +131,14 @@ $(RCP_SRC)/logger/loggerHardware.c \
 $(RCP_SRC)/logger/loggerSampleData.c \
 $(RCP_SRC)/logger/loggerTaskEx.c \
 $(RCP_SRC)/logger/sampleRecord.c \
+$(RCP_SRC)/logger/sample_arena.c \
+$(RCP_SRC)/logger/sample_binary.c \
+$(RCP_SRC)/logger/sample_frame.c \
+$(RCP_SRC)/logger/sample_meta.c \
+$(RCP_SRC)/logger/stream_profile.c \
+$(RCP_SRC)/logger/telemetry_backlog.c \
+$(RCP_SRC)/logger/telemetry_batch.c \
+$(RCP_SRC)/logger/telemetry_rate.c \
 $(RCP_SRC)/logger/versionInfo.c \
 $(RCP_SRC)/logging/printk.c \
 $(RCP_SRC)/lua/luaBaseBinding.c \
@@ -138,11 +151,13 @@ $(RCP_SRC)/messaging/messaging.c \
 $(RCP_SRC)/modem/at.c \
 $(RCP_SRC)/modem/at_basic.c \
 $(RCP_SRC)/predictive_timer/predictive_timer_2.c \
+$(RCP_SRC)/sdcard/log_files.c \
 $(RCP_SRC)/sdcard/sdcard.c \
 $(RCP_SRC)/serial/rx_buff.c \
 $(RCP_SRC)/serial/serial.c \
 $(RCP_SRC)/serial/serial_buffer.c \
 $(RCP_SRC)/system/flags.c \
+$(RCP_SRC)/system/task_stats.c \
 $(RCP_SRC)/tasks/wifi.c \
 $(RCP_SRC)/timer/timer.c \
 $(RCP_SRC)/timer/timer_config.c \
@@ -154,6 +169,7 @@ $(RCP_SRC)/usb_comm/usb_comm.c \
 $(RCP_SRC)/util/FreeRTOS-openocd.c \
 $(RCP_SRC)/util/byteswap.c \
 $(RCP_SRC)/util/convert.c \
+$(RCP_SRC)/util/hash.c \
 $(RCP_SRC)/util/linear_interpolate.c \
 $(RCP_SRC)/util/modp_numtoa.c \
 $(RCP_SRC)/util/panic.c \
@@ -44,6 +44,10 @@
 #define CAN_CHANNELS	            1
 #define CAN_SW_TERMINATION          false
 #define CAN_MAPPINGS                10
+#define CAN_FILTER_BANKS            13
+/* No SD card to capture raw CAN frames to */
+#define CAN_CAPTURE_SIZE            0
+#define CAN_CAPTURE_BUFFERS         1
 #define OBD2_CHANNELS               10
 
 //Wireless connections
@@ -216,8 +216,8 @@ int CAN_device_set_filter(const uint8_t channel, const uint8_t id, const uint8_t
 	const size_t shift = extended ? 3 : 21;
 	CAN_FilterInitStructure.CAN_FilterIdHigh = (filter << shift) >> 16;
 	CAN_FilterInitStructure.CAN_FilterMaskIdHigh = (mask << shift) >> 16;
-	CAN_FilterInitStructure.CAN_FilterIdLow = (uint16_t) filter;
-	CAN_FilterInitStructure.CAN_FilterMaskIdLow = (uint16_t) mask;
+	CAN_FilterInitStructure.CAN_FilterIdLow = (uint16_t) (filter << shift);
+	CAN_FilterInitStructure.CAN_FilterMaskIdLow = (uint16_t) (mask << shift);
 
 	CAN_FilterInit(&CAN_FilterInitStructure);
 
@@ -24,6 +24,7 @@
 #include <app_info.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stm32f30x.h>
 #include <stm32f30x_misc.h>
 #include <stm32f30x_rcc.h>
 
@@ -40,6 +41,14 @@ static char to_hex(uint8_t val)
         return val >= 10 ? val - 10  + 'A' : val + '0';
 }
 
+/* Free running count of CPU cycles, for timing things shorter than a tick */
+static void init_cycle_counter()
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
 static void init_cpu_id()
 {
         const uint8_t* ids = (const uint8_t *) CPU_ID_REGISTER_START;
@@ -55,6 +64,7 @@ int cpu_device_init(void)
 	NVIC_SetVectorTable(NVIC_VectTab_FLASH, (uint32_t)&_flash_start);
 	NVIC_PriorityGroupConfig(NVIC_PriorityGroup_4);
 	init_cpu_id();
+	init_cycle_counter();
 	return 1;
 }
 
@@ -94,3 +104,13 @@ void cpu_device_spin(uint32_t ms)
 	while(ms-- > 0)
 		for (volatile size_t i = 0; i < iterations; ++i);
 }
+
+uint32_t cpu_device_get_cycle_count(void)
+{
+	return DWT->CYCCNT;
+}
+
+uint32_t cpu_device_get_cycles_per_usec(void)
+{
+	return SystemCoreClock / 1000000;
+}
@@ -146,14 +146,12 @@ void EP1_IN_Callback (void)
 void EP3_OUT_Callback(void)
 {
         portBASE_TYPE hpta = false;
-        xQueueHandle queue = serial_get_rx_queue(usb_state.serial);
         uint8_t *buff = usb_state.USB_Rx_Buffer;
 
 	/* Get the received data buffer and clear the counter */
 	const size_t len = USB_SIL_Read(EP3_OUT, buff);
 
-        for (size_t i = 0; i < len; ++i)
-                xQueueSendFromISR(queue, buff + i, &hpta);
+        serial_rx_put_isr(usb_state.serial, buff, len, &hpta);
 
 	/*
          * STIEG HACK
@@ -26,6 +26,7 @@
 #include "stddef.h"
 #include "CAN.h"
 #include "OBD2.h"
+#include "can_capture.h"
 #include "printk.h"
 #include "FreeRTOS.h"
 #include "task.h"
@@ -35,6 +36,9 @@
 #include "capabilities.h"
 #include "can_mapping.h"
 #include "can_channels.h"
+#include "can_filter.h"
+#include "task_stats.h"
+#include "macros.h"
 
 #include "CAN_aux_queue.h"
 
@@ -44,16 +48,51 @@
 #define CAN_TASK_FEATURED_DISABLED_MS   2000
 #define CAN_RX_DELAY                    300
 
+/* Too big for the task stack */
+static struct can_filter_set filter_set;
+
+/**
+ * Sets the hardware acceptance filters so only the frames the CAN
+ * mappings and OBD2 channels use reach this task.
+ */
+static void apply_acceptance_filters(const CANChannelConfig *ccc,
+                                     const OBD2Config *oc)
+{
+        for (uint8_t bus = 0; bus < CAN_CHANNELS; bus++) {
+                can_filter_build(&filter_set, bus, ccc, oc);
+                const size_t banks = can_filter_reduce(&filter_set, CAN_FILTER_BANKS);
+
+                size_t id = 0;
+                if (filter_set.accept_all) {
+                        CAN_set_filter(bus, id++, 1, 0, 0, true);
+                } else {
+                        for (; id < filter_set.count; id++) {
+                                const struct can_filter *f = &filter_set.filters[id];
+                                CAN_set_filter(bus, id, f->extended, f->id, f->mask, true);
+                        }
+                }
+
+                for (; id < CAN_FILTER_BANKS; id++)
+                        CAN_set_filter(bus, id, 0, 0, 0, false);
+
+                pr_info(_LOG_PFX "CAN");
+                pr_info_int(bus);
+                pr_info_int_msg(" acceptance filter banks: ", banks);
+        }
+}
+
 static void CAN_task(void *parameters)
 {
         LoggerConfig *lc = getWorkingLoggerConfig();
-        CANChannelConfig *ccc = &lc->can_channel_cfg;
-        OBD2Config *oc = &lc->OBD2Configs;
 
 #if CAN_AUX_QUEUE_SUPPORT == 1
         CAN_aux_queue_init();
 #endif
         while(1) {
+                /* A config change may have moved these to or from RAM */
+                logger_config_overlay_sync(LOGGER_CONFIG_READER_CAN);
+                const CANChannelConfig *ccc = get_can_channel_config();
+                const OBD2Config *oc = get_obd2_config();
                 uint16_t enabled_mapping_count = 0;
                 uint16_t enabled_obd2_pids_count = 0;
                 bool success;
@@ -70,11 +109,23 @@ static void CAN_task(void *parameters)
                 if (!success)
                         pr_error_int_msg("Failed to create buffer for OBD2 channels; size ", new_enabled_obd2_pids_count);
 
+                /* A capture wants every frame on the bus */
+                if (lc->CanConfig.auto_filter && !lc->CanConfig.capture)
+                        apply_acceptance_filters(ccc, oc);
+
                 while(! (CAN_is_state_stale() || OBD2_is_state_stale())) {
                         CAN_msg msg;
-                        int result = CAN_rx_msg(&msg, CAN_RX_DELAY );
+                        /* wake up in time for the next OBD2 query */
+                        size_t rx_delay = CAN_RX_DELAY;
+                        if (oc->enabled && enabled_obd2_pids_count)
+                                rx_delay = MIN(rx_delay, OBD2_next_query_delay_ms());
+
+                        int result = CAN_rx_msg(&msg, rx_delay);
+                        const uint32_t now_ms = ticksToMs(getCurrentTicks());
 
                         if (result) {
+                                task_stats_begin(TASK_STATS_CAN);
+                                can_capture_frame(&msg, now_ms);
                                 if (ccc->enabled)
                                         update_can_channels(&msg, ccc, enabled_mapping_count);
 
@@ -83,11 +134,15 @@ static void CAN_task(void *parameters)
 #if CAN_AUX_QUEUE_SUPPORT == 1
                                 CAN_aux_queue_put_msg(&msg, 0);
 #endif
+                                task_stats_end(TASK_STATS_CAN);
                         }
                         if (oc->enabled)
                                 sequence_next_obd2_query(oc, enabled_obd2_pids_count);
 
+                        can_capture_poll(now_ms);
                 }
+                /* Done with ccc and oc; don't hold up a flash while we wait */
+                logger_config_overlay_sync(LOGGER_CONFIG_READER_CAN);
                 delayMs(CAN_TASK_FEATURED_DISABLED_MS);
         }
 }
@@ -0,0 +1,231 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "can_capture.h"
+#include "macros.h"
+#include "mem_mang.h"
+#include "printk.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[can_capture] "
+
+#define CAN_CAPTURE_BUFFER_SIZE	(CAN_CAPTURE_SIZE / CAN_CAPTURE_BUFFERS)
+
+/*
+ * The CAN task fills the buffers in turn and the file writer empties
+ * them.  Each side only ever advances its own counter, so the two need
+ * no lock.  The CAN task owns buffer produced % CAN_CAPTURE_BUFFERS as
+ * long as fewer than CAN_CAPTURE_BUFFERS are waiting on the writer.
+ */
+static struct {
+        uint8_t *buffers;
+        volatile size_t lengths[CAN_CAPTURE_BUFFERS];
+        volatile uint32_t produced;
+        volatile uint32_t consumed;
+        volatile bool requested;
+        volatile bool running;
+
+        /* CAN task only */
+        size_t fill;
+        uint32_t fill_ms;
+        uint32_t last_ms;
+
+        volatile uint32_t frames;
+        volatile uint32_t dropped;
+        volatile uint32_t bytes;
+} capture;
+
+static void put_u16(uint8_t *p, const uint16_t v)
+{
+        p[0] = (uint8_t) v;
+        p[1] = (uint8_t) (v >> 8);
+}
+
+static void put_u32(uint8_t *p, const uint32_t v)
+{
+        put_u16(p, (uint16_t) v);
+        put_u16(p + 2, (uint16_t) (v >> 16));
+}
+
+static size_t encode_frame(uint8_t *buf, const CAN_msg *msg,
+                           const uint32_t ms, const bool stamp)
+{
+        const uint8_t len = MIN(msg->dataLength, CAN_MSG_SIZE);
+        uint8_t *p = buf;
+
+        *p++ = len |
+                (msg->can_bus ? CAN_CAPTURE_FLAG_BUS : 0) |
+                (msg->isExtendedAddress ? CAN_CAPTURE_FLAG_EXTENDED : 0) |
+                (stamp ? CAN_CAPTURE_FLAG_TIMESTAMP : 0);
+
+        if (stamp) {
+                put_u32(p, ms);
+                p += 4;
+        }
+
+        if (msg->isExtendedAddress) {
+                put_u32(p, msg->addressValue);
+                p += 4;
+        } else {
+                put_u16(p, (uint16_t) msg->addressValue);
+                p += 2;
+        }
+
+        memcpy(p, msg->data, len);
+        return p + len - buf;
+}
+
+static uint8_t* fill_buffer(void)
+{
+        return capture.buffers +
+                (capture.produced % CAN_CAPTURE_BUFFERS) *
+                CAN_CAPTURE_BUFFER_SIZE;
+}
+
+static bool fill_buffer_free(void)
+{
+        return capture.produced - capture.consumed < CAN_CAPTURE_BUFFERS;
+}
+
+static void hand_over(void)
+{
+        if (!capture.fill)
+                return;
+
+        capture.lengths[capture.produced % CAN_CAPTURE_BUFFERS] = capture.fill;
+        capture.bytes += capture.fill;
+        capture.fill = 0;
+        /* Publish last; the writer may take the buffer from here on */
+        capture.produced++;
+}
+
+size_t can_capture_header(uint8_t *buf)
+{
+        memset(buf, 0, CAN_CAPTURE_HEADER_LEN);
+        memcpy(buf, CAN_CAPTURE_MAGIC, 4);
+        buf[4] = CAN_CAPTURE_VERSION;
+        return CAN_CAPTURE_HEADER_LEN;
+}
+
+bool can_capture_start(void)
+{
+        if (!CAN_CAPTURE_BUFFER_SIZE)
+                return false;
+
+        if (!capture.buffers) {
+                capture.buffers = portMalloc(CAN_CAPTURE_SIZE);
+                if (!capture.buffers) {
+                        pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ",
+                                         CAN_CAPTURE_SIZE);
+                        return false;
+                }
+        }
+
+        /* The CAN task leaves these alone until it sees the request */
+        if (!capture.running) {
+                capture.frames = 0;
+                capture.dropped = 0;
+                capture.bytes = 0;
+        }
+
+        capture.requested = true;
+        return true;
+}
+
+void can_capture_stop(void)
+{
+        capture.requested = false;
+}
+
+bool can_capture_is_running(void)
+{
+        return capture.running;
+}
+
+void can_capture_frame(const CAN_msg *msg, const uint32_t ms)
+{
+        if (!capture.running)
+                return;
+
+        if (capture.fill + CAN_CAPTURE_RECORD_MAX > CAN_CAPTURE_BUFFER_SIZE)
+                hand_over();
+
+        if (!fill_buffer_free()) {
+                capture.dropped++;
+                return;
+        }
+
+        /* Each buffer stands on its own, so start it with the time */
+        const bool stamp = !capture.fill || ms != capture.last_ms;
+        if (!capture.fill)
+                capture.fill_ms = ms;
+
+        capture.fill += encode_frame(fill_buffer() + capture.fill, msg, ms,
+                                     stamp);
+        capture.last_ms = ms;
+        capture.frames++;
+}
+
+void can_capture_poll(const uint32_t ms)
+{
+        if (capture.requested && !capture.running) {
+                capture.fill = 0;
+                capture.running = true;
+                pr_info(LOG_PFX "Started\r\n");
+                return;
+        }
+
+        if (!capture.requested && capture.running) {
+                hand_over();
+                capture.running = false;
+                pr_info_int_msg(LOG_PFX "Stopped.  Dropped frames: ",
+                                capture.dropped);
+                return;
+        }
+
+        if (capture.fill && ms - capture.fill_ms >= CAN_CAPTURE_FLUSH_MS)
+                hand_over();
+}
+
+const uint8_t* can_capture_peek(size_t *len)
+{
+        if (capture.consumed == capture.produced)
+                return NULL;
+
+        const size_t idx = capture.consumed % CAN_CAPTURE_BUFFERS;
+        *len = capture.lengths[idx];
+        return capture.buffers + idx * CAN_CAPTURE_BUFFER_SIZE;
+}
+
+void can_capture_release(void)
+{
+        if (capture.consumed != capture.produced)
+                capture.consumed++;
+}
+
+void can_capture_get_stats(struct can_capture_stats *stats)
+{
+        stats->frames = capture.frames;
+        stats->dropped = capture.dropped;
+        stats->bytes = capture.bytes;
+}
@@ -76,10 +76,10 @@ void CAN_set_current_channel_value(int index, float value)
         can_state.CAN_current_values[index] = value;
 }
 
-void update_can_channels(CAN_msg *msg, CANChannelConfig *cfg, uint16_t enabled_mapping_count)
+void update_can_channels(CAN_msg *msg, const CANChannelConfig *cfg, uint16_t enabled_mapping_count)
 {
         for (size_t i = 0; i < enabled_mapping_count; i++) {
-                CANMapping *mapping = &cfg->can_channels[i].mapping;
+                const CANMapping *mapping = &cfg->can_channels[i].mapping;
 
                 /* only process the mapping for the bus we're handling messages for */
                 if (msg->can_bus != mapping->can_channel)
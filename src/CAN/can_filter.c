@@ -0,0 +1,199 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "OBD2.h"
+#include "can_filter.h"
+
+#include <string.h>
+
+static unsigned int open_bits(const struct can_filter *f)
+{
+        const uint32_t width = f->extended ?
+                CAN_FILTER_EXT_ID_MASK : CAN_FILTER_STD_ID_MASK;
+        uint32_t open = width & ~f->mask;
+        unsigned int count = 0;
+
+        for (; open; open &= open - 1)
+                ++count;
+
+        return count;
+}
+
+/**
+ * @return true if every frame that passes b also passes a.
+ */
+static bool filter_covers(const struct can_filter *a,
+                          const struct can_filter *b)
+{
+        return a->extended == b->extended &&
+                (a->mask & b->mask) == a->mask &&
+                (b->id & a->mask) == a->id;
+}
+
+static void remove_filter(struct can_filter_set *fs, const size_t idx)
+{
+        fs->filters[idx] = fs->filters[--fs->count];
+}
+
+/**
+ * Drops the filters that the one at idx makes redundant.
+ */
+static void remove_covered(struct can_filter_set *fs, const size_t idx)
+{
+        const struct can_filter keep = fs->filters[idx];
+        size_t count = 0;
+
+        for (size_t i = 0; i < fs->count; ++i) {
+                if (i == idx || !filter_covers(&keep, fs->filters + i))
+                        fs->filters[count++] = fs->filters[i];
+        }
+
+        fs->count = count;
+}
+
+static void add_filter(struct can_filter_set *fs, const uint32_t id,
+                       const uint32_t mask, const bool extended)
+{
+        const struct can_filter f = {
+                .id = id & mask,
+                .mask = mask,
+                .extended = extended,
+        };
+
+        for (size_t i = 0; i < fs->count; ++i) {
+                if (filter_covers(fs->filters + i, &f))
+                        return;
+        }
+
+        if (fs->count >= CAN_FILTER_MAX) {
+                fs->accept_all = true;
+                return;
+        }
+
+        fs->filters[fs->count++] = f;
+        remove_covered(fs, fs->count - 1);
+}
+
+void can_filter_init(struct can_filter_set *fs)
+{
+        fs->count = 0;
+        fs->accept_all = false;
+}
+
+void can_filter_add(struct can_filter_set *fs, uint32_t id, uint32_t mask)
+{
+        const uint32_t match = mask ? mask : CAN_FILTER_EXT_ID_MASK;
+
+        if (id <= CAN_FILTER_STD_ID_MASK)
+                add_filter(fs, id, match & CAN_FILTER_STD_ID_MASK, false);
+
+        /* Mappings ignore IDE, so an extended frame can match any ID */
+        if (id <= CAN_FILTER_EXT_ID_MASK)
+                add_filter(fs, id, match & CAN_FILTER_EXT_ID_MASK, true);
+}
+
+void can_filter_build(struct can_filter_set *fs, const uint8_t bus,
+                      const CANChannelConfig *can_cfg,
+                      const OBD2Config *obd2_cfg)
+{
+        can_filter_init(fs);
+
+        for (size_t i = 0; can_cfg->enabled && i < can_cfg->enabled_mappings; ++i) {
+                const CANMapping *mapping = &can_cfg->can_channels[i].mapping;
+                if (mapping->can_channel != bus)
+                        continue;
+
+                /* An ID of 0 matches every frame */
+                if (0 == mapping->can_id) {
+                        fs->accept_all = true;
+                        return;
+                }
+
+                can_filter_add(fs, mapping->can_id, mapping->can_mask);
+        }
+
+        if (obd2_cfg->enabled && obd2_cfg->enabledPids && OBD2_CAN_BUS == bus) {
+                can_filter_add(fs, OBD2_11BIT_PID_RESPONSE, 0);
+                can_filter_add(fs, OBD2_29BIT_PID_RESPONSE, 0);
+        }
+}
+
+size_t can_filter_reduce(struct can_filter_set *fs, const size_t max_banks)
+{
+        while (!fs->accept_all && fs->count > max_banks) {
+                struct can_filter best = {0};
+                unsigned int best_open = 0;
+                size_t best_a = 0;
+                size_t best_b = 0;
+                bool found = false;
+
+                for (size_t a = 0; a < fs->count; ++a) {
+                        for (size_t b = a + 1; b < fs->count; ++b) {
+                                const struct can_filter *fa = fs->filters + a;
+                                const struct can_filter *fb = fs->filters + b;
+                                if (fa->extended != fb->extended)
+                                        continue;
+
+                                /* Only the bits both agree on still count */
+                                struct can_filter merged = *fa;
+                                merged.mask = fa->mask & fb->mask & ~(fa->id ^ fb->id);
+                                merged.id = fa->id & merged.mask;
+
+                                const unsigned int open = open_bits(&merged);
+                                if (!found || open < best_open) {
+                                        found = true;
+                                        best = merged;
+                                        best_open = open;
+                                        best_a = a;
+                                        best_b = b;
+                                }
+                        }
+                }
+
+                /* Only one standard and one extended filter left */
+                if (!found) {
+                        fs->accept_all = true;
+                        break;
+                }
+
+                fs->filters[best_a] = best;
+                remove_filter(fs, best_b);
+                remove_covered(fs, best_a);
+        }
+
+        return fs->accept_all ? 1 : fs->count;
+}
+
+bool can_filter_accepts(const struct can_filter_set *fs, const uint32_t id,
+                        const bool extended)
+{
+        if (fs->accept_all)
+                return true;
+
+        for (size_t i = 0; i < fs->count; ++i) {
+                const struct can_filter *f = fs->filters + i;
+                if (f->extended == extended && (id & f->mask) == f->id)
+                        return true;
+        }
+
+        return false;
+}
@@ -32,8 +32,6 @@
 #include "can_mapping.h"
 
 #define _LOG_PFX                        "[OBD2] "
-#define OBD2_11BIT_PID_RESPONSE         0x7E8
-#define OBD2_29BIT_PID_RESPONSE         0x18DAF110
 
 #define OBD2_11BIT_PID_REQUEST          0x7DF
 #define OBD2_29BIT_PID_REQUEST          0x18DB33F1
@@ -47,6 +45,30 @@
 #define OBD2_MODE_ENHANCED_DATA         0x22
 #define OBD2_TIMEOUT_DISABLE_THRESHOLD  10
 
+/* how often the achieved PID rates are worked out */
+#define OBD2_RATE_WINDOW_MS             1000
+
+/* how far the PID schedule may fall behind when the ECU can't keep up */
+#define OBD2_SCHEDULE_MAX_LAG_MS        500
+
+/* physical addresses of the first ECU, for flow control */
+#define OBD2_11BIT_ECU_REQUEST          0x7E0
+#define OBD2_29BIT_ECU_REQUEST          0x18DA10F1
+
+/* ISO 15765-2 frame types, in the high nibble of the first byte */
+#define ISO_TP_SINGLE_FRAME             0x0
+#define ISO_TP_FIRST_FRAME              0x1
+#define ISO_TP_CONSECUTIVE_FRAME        0x2
+#define ISO_TP_FLOW_CONTROL             0x30
+#define ISO_TP_PAD                      0x55
+
+/* the longest mode 01 value we can hand to a CAN mapping as a single frame */
+#define OBD2_PACKED_PID_MAX_LENGTH      4
+
+/* response mode byte, then a PID and its value for each PID requested */
+#define OBD2_PACKED_RESPONSE_MAX        (1 + OBD2_MAX_PIDS_PER_REQUEST * \
+                                         (1 + OBD2_PACKED_PID_MAX_LENGTH))
+
 enum obd2_channel_status {
         OBD2_CHANNEL_STATUS_NO_DATA = 0,
         OBD2_CHANNEL_STATUS_DATA_RECEIVED,
@@ -59,9 +81,24 @@ struct OBD2ChannelState {
         float current_value;
 
         /**
-         * holds the state for the priority sequencer
+         * tick by which the channel should next be queried
+         */
+        size_t next_due;
+
+        /**
+         * ticks between queries, from the channel's sample rate
+         */
+        size_t period;
+
+        /**
+         * values received since the rate window started
          */
-        uint16_t sequencer_count;
+        uint16_t update_count;
+
+        /**
+         * updates per second achieved over the last rate window
+         */
+        float achieved_rate;
 
         /* PID associated with OBD2 channel */
         uint16_t pid;
@@ -69,6 +106,17 @@ struct OBD2ChannelState {
         /* number of timeouts seen on this channel */
         uint8_t timeout_count;
 
+        /**
+         * left out of a packed answer; asked for on its own next, before
+         * anything is held against it
+         */
+        bool is_solo_pending;
+
+        /**
+         * only answered on its own, so never packed again
+         */
+        bool is_solo_only;
+
         /* indicates status of channel */
         enum obd2_channel_status channel_status;
 };
@@ -84,11 +132,8 @@ struct OBD2State {
         /* the index of the current OBD2 PID we're querying */
         uint16_t current_obd2_pid_index;
 
-        /**
-         * the max sample rate across all of the channels;
-         * will set the time base for the fastest PID querying
-         */
-        uint16_t max_sample_rate;
+        /* when the current rate window started */
+        size_t rate_window_start;
 
         /**
          * number of OBD2 channels
@@ -101,7 +146,7 @@ struct OBD2State {
         uint16_t squelched_count;
 
         /**
-         * latency in ms for OBDII queries
+         * smoothed round trip time in ms for OBDII queries
          */
         uint32_t query_latency;
 
@@ -119,10 +164,51 @@ struct OBD2State {
          * indicates if we're using 29 bit PID requests
          */
         bool is_29bit_obd2;
+
+        /**
+         * channels asked for by the outstanding request.  More than one
+         * means their mode 01 PIDs were packed into the same request
+         */
+        uint16_t request_indexes[OBD2_MAX_PIDS_PER_REQUEST];
+        uint8_t request_count;
+
+        /**
+         * flag to indicate if we pack mode 01 PIDs into one request.
+         * Cleared if the ECU doesn't answer a packed request
+         */
+        bool is_packing_enabled;
+
+        /**
+         * flag to indicate the ECU answered more than one PID of a
+         * packed request
+         */
+        bool is_packing_confirmed;
+
+        /**
+         * reassembly of a packed response that spans several frames
+         */
+        uint8_t response[OBD2_PACKED_RESPONSE_MAX];
+        uint8_t response_length;
+        uint8_t response_expected;
+        uint8_t response_sequence;
 };
 
 static struct OBD2State obd2_state = {0};
 
+/**
+ * Data bytes of the standard mode 01 PIDs (SAE J1979), by PID.  0 means
+ * the PID is unknown, or too long to pack, so it is queried on its own.
+ */
+static const uint8_t mode1_pid_lengths[] = {
+        4, 4, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 2, 1, 1, 1, /* 0x00 */
+        2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, /* 0x10 */
+        4, 2, 2, 2, 4, 4, 4, 4, 4, 4, 4, 4, 1, 1, 1, 1, /* 0x20 */
+        1, 2, 2, 1, 4, 4, 4, 4, 4, 4, 4, 4, 2, 2, 2, 2, /* 0x30 */
+        4, 4, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 4, /* 0x40 */
+        4, 1, 1, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 1, /* 0x50 */
+        4, 1, 1, 2,                                     /* 0x60 */
+};
+
 
 void OBD2_state_stale(void)
 {
@@ -175,10 +261,62 @@ static int OBD2_request_PID(uint32_t pid, uint8_t mode, bool is_29_bit, size_t t
         msg.data[7] = 0x55;
         msg.dataLength = 8;
         msg.isExtendedAddress = is_29_bit;
-        return CAN_tx_msg(0, &msg, timeout);
+        return CAN_tx_msg(OBD2_CAN_BUS, &msg, timeout);
+}
+
+/**
+ * Sends a mode 01 request for several PIDs at once.  ECUs answer with
+ * the values of all of them in one response.
+ * @param pids the OBD2 PIDs to request, up to OBD2_MAX_PIDS_PER_REQUEST
+ * @param count the number of PIDs
+ * @param timeout the timeout in ms for sending the OBD2 request
+ */
+static int OBD2_request_PIDs(const uint8_t *pids, const size_t count,
+                             bool is_29_bit, size_t timeout)
+{
+        CAN_msg msg;
+        msg.addressValue = is_29_bit ? OBD2_29BIT_PID_REQUEST : OBD2_11BIT_PID_REQUEST;
+        memset(msg.data, ISO_TP_PAD, sizeof(msg.data));
+        msg.data[0] = 1 + count;
+        msg.data[1] = OBD2_MODE_SHOW_CURRENT_DATA;
+        memcpy(msg.data + 2, pids, count);
+        msg.dataLength = 8;
+        msg.isExtendedAddress = is_29_bit;
+        return CAN_tx_msg(OBD2_CAN_BUS, &msg, timeout);
+}
+
+/**
+ * Tells the ECU to send the rest of a response that spans several
+ * frames, all at once.
+ */
+static int OBD2_send_flow_control(bool is_29_bit, size_t timeout)
+{
+        CAN_msg msg;
+        msg.addressValue = is_29_bit ? OBD2_29BIT_ECU_REQUEST : OBD2_11BIT_ECU_REQUEST;
+        memset(msg.data, ISO_TP_PAD, sizeof(msg.data));
+        msg.data[0] = ISO_TP_FLOW_CONTROL;
+        msg.data[1] = 0; /* no block size limit */
+        msg.data[2] = 0; /* no separation time */
+        msg.dataLength = 8;
+        msg.isExtendedAddress = is_29_bit;
+        return CAN_tx_msg(OBD2_CAN_BUS, &msg, timeout);
+}
+
+/**
+ * @return the data bytes of the PID's value if the channel may be
+ * packed into a request with others, 0 otherwise.
+ */
+static uint8_t packed_pid_length(const PidConfig *pid_cfg)
+{
+        if (pid_cfg->passive ||
+            pid_cfg->mode != OBD2_MODE_SHOW_CURRENT_DATA ||
+            pid_cfg->pid >= sizeof(mode1_pid_lengths))
+                return 0;
+
+        return mode1_pid_lengths[pid_cfg->pid];
 }
 
-bool OBD2_init_current_values(OBD2Config *obd2_config)
+bool OBD2_init_current_values(const OBD2Config *obd2_config)
 {
         pr_info(_LOG_PFX "Init current values\r\n");
         uint16_t obd2_channel_count = obd2_config->enabledPids;
@@ -194,18 +332,16 @@ bool OBD2_init_current_values(OBD2Config *obd2_config)
         obd2_state.query_latency = 0;
         obd2_state.is_active = false;
         obd2_state.is_29bit_obd2 = false;
-        /* determine the fastest sample rate, which will set our PID querying timebase */
-        size_t max_sample_rate = 0;
-        for (size_t i = 0; i < obd2_channel_count; i++) {
-                max_sample_rate = MAX(max_sample_rate,
-                                      decodeSampleRate(obd2_config->pids[i].mapping.channel_cfg.sampleRate));
-        }
-        obd2_state.max_sample_rate = max_sample_rate;
-        pr_debug_int_msg(_LOG_PFX " Max OBD2 sample rate: ", obd2_state.max_sample_rate);
+        obd2_state.request_count = 0;
+        obd2_state.is_packing_enabled = true;
+        obd2_state.is_packing_confirmed = false;
+        obd2_state.response_expected = 0;
+        obd2_state.rate_window_start = getCurrentTicks();
 
         if (obd2_channel_count == 0) {
         		/* if no OBD2 channels are enabled, don't malloc */
 				obd2_state.current_channel_states = NULL;
+				obd2_state.channel_count = 0;
     obd2_state.is_stale = false;
 				return true;
         }
@@ -220,12 +356,20 @@ bool OBD2_init_current_values(OBD2Config *obd2_config)
 				return false;
 		}
 
-		/* set our current PIDs */
+		/* set our current PIDs, all due right away */
 		for (size_t i = 0; i < obd2_channel_count; i++) {
 		        struct OBD2ChannelState *state = &obd2_state.current_channel_states[i];
+		        const size_t sample_rate =
+		                decodeSampleRate(obd2_config->pids[i].mapping.channel_cfg.sampleRate);
 				state->pid = obd2_config->pids[i].pid;
 				state->channel_status = OBD2_CHANNEL_STATUS_NO_DATA;
 				state->timeout_count = 0;
+				state->is_solo_pending = false;
+				state->is_solo_only = false;
+				state->next_due = obd2_state.rate_window_start;
+				state->period = MAX(1, msToTicks(1000 / MAX(1, sample_rate)));
+				state->update_count = 0;
+				state->achieved_rate = 0;
 				state->current_value = 0.0;
 		}
 
@@ -248,136 +392,506 @@ void OBD2_set_current_channel_value(int index, float value)
         obd2_state.current_channel_states[index].current_value = value;
 }
 
-void sequence_next_obd2_query(OBD2Config * obd2_config, uint16_t enabled_obd2_pids_count)
+size_t OBD2_get_channel_count(void)
 {
-        /* no PIDs, no query... */
-		if (enabled_obd2_pids_count == 0)
-				return;
+        return obd2_state.current_channel_states == NULL ?
+                0 : obd2_state.channel_count;
+}
 
-        bool is_obd2_timeout = obd2_state.last_obd2_query_timestamp > 0 &&
-        		isTimeoutMs(obd2_state.last_obd2_query_timestamp, OBD2_PID_DEFAULT_TIMEOUT_MS);
-
-        size_t current_pid_index = obd2_state.current_obd2_pid_index;
-
-        if (is_obd2_timeout) {
-        		/* check for timeout and squelch current PID if needed */
-                struct OBD2ChannelState *state = &obd2_state.current_channel_states[current_pid_index];
-                pr_debug_int_msg(_LOG_PFX "Timeout requesting PID ", state->pid);
-
-                /* only start counting timeouts if we've ever received data */
-                if (obd2_state.is_active) {
-                        state->timeout_count++;
-                        if (state->timeout_count >= OBD2_TIMEOUT_DISABLE_THRESHOLD) {
-                                state->channel_status = OBD2_CHANNEL_STATUS_SQUELCHED;
-                                pr_info_int_msg(_LOG_PFX "Excessive timeouts, squelching PID ", state->pid);
-                                obd2_state.squelched_count++;
-                                /**
-                                 * if all channels end up being squelched, then we should just reset OBD2 config
-                                 * This accounts for cases where there's a complete disconnect and a reset is needed
-                                 */
-                                if (obd2_state.squelched_count == obd2_state.channel_count) {
-                                        pr_info(_LOG_PFX "all channels timed out, resetting OBD2 state\r\n");
-                                        obd2_state.is_stale = true;
-                                }
-                        }
+float OBD2_get_channel_rate(int index)
+{
+        if (obd2_state.current_channel_states == NULL)
+                return 0;
+        return obd2_state.current_channel_states[index].achieved_rate;
+}
+
+uint32_t OBD2_get_query_latency(void)
+{
+        return obd2_state.query_latency;
+}
+
+bool OBD2_is_active(void)
+{
+        return obd2_state.is_active;
+}
+
+/**
+ * Stores a value the ECU sent for a channel.
+ */
+static void channel_updated(const int index, const float value)
+{
+        struct OBD2ChannelState *state = &obd2_state.current_channel_states[index];
+
+        OBD2_set_current_channel_value(index, value);
+        state->channel_status = OBD2_CHANNEL_STATUS_DATA_RECEIVED;
+        state->timeout_count = 0;
+        state->update_count++;
+}
+
+/**
+ * Works out the rate each channel actually got values at, once per
+ * rate window.
+ */
+static void update_achieved_rates(void)
+{
+        const size_t now = getCurrentTicks();
+        const size_t elapsed = now - obd2_state.rate_window_start;
+        if (elapsed < msToTicks(OBD2_RATE_WINDOW_MS))
+                return;
+
+        const float seconds = ticksToMs(elapsed) / 1000.0f;
+        for (size_t i = 0; i < obd2_state.channel_count; i++) {
+                struct OBD2ChannelState *state = &obd2_state.current_channel_states[i];
+                state->achieved_rate = state->update_count / seconds;
+                state->update_count = 0;
+        }
+        obd2_state.rate_window_start = now;
+}
+
+/**
+ * Queries are sent one round trip ahead of the deadline so the answer
+ * lands on time.
+ * @return the ticks the channel is late by, or a negative number if it
+ * is not due yet.
+ */
+static int32_t channel_lateness(const struct OBD2ChannelState *state,
+                                const size_t now)
+{
+        const size_t lead = msToTicks(obd2_state.query_latency);
+        return (int32_t) (now + lead - state->next_due);
+}
+
+/**
+ * Moves a channel's deadline on by one period as it gets queried.
+ */
+static void channel_scheduled(struct OBD2ChannelState *state)
+{
+        state->next_due += state->period;
+}
+
+/**
+ * Moves every deadline on, keeping their order, so the schedule never
+ * lags more than OBD2_SCHEDULE_MAX_LAG_MS.  Otherwise the PIDs would
+ * burst to catch up once the ECU does.
+ */
+static void limit_schedule_lag(const int32_t lateness)
+{
+        const int32_t excess = lateness - msToTicks(OBD2_SCHEDULE_MAX_LAG_MS);
+        if (excess <= 0)
+                return;
+
+        for (size_t i = 0; i < obd2_state.channel_count; i++)
+                obd2_state.current_channel_states[i].next_due += excess;
+}
+
+static bool is_requested(const size_t index)
+{
+        for (size_t i = 0; i < obd2_state.request_count; i++) {
+                if (obd2_state.request_indexes[i] == index)
+                        return true;
+        }
+        return false;
+}
+
+/**
+ * @return true if the channel can share a mode 01 request with others.
+ */
+static bool is_packable(const OBD2Config *obd2_config, const size_t index)
+{
+        const struct OBD2ChannelState *state = &obd2_state.current_channel_states[index];
+
+        return packed_pid_length(&obd2_config->pids[index]) &&
+                !state->is_solo_pending && !state->is_solo_only;
+}
+
+/**
+ * @return the due channel with the earliest deadline that passes the
+ * filter, or -1 if there is none.
+ */
+static int most_due_channel(const OBD2Config *obd2_config,
+                            const uint16_t enabled_obd2_pids_count,
+                            const bool packable_only, const size_t now)
+{
+        int32_t highest_lateness = 0;
+        int most_due_pid_index = -1;
+
+        for (size_t i = 0; i < enabled_obd2_pids_count; i++) {
+                struct OBD2ChannelState *state = &obd2_state.current_channel_states[i];
+                if (state->channel_status == OBD2_CHANNEL_STATUS_SQUELCHED)
+                        /* if channel is squelched then skip */
+                        continue;
+
+                if (packable_only && !is_packable(obd2_config, i))
+                        continue;
+
+                if (is_requested(i))
+                        continue;
+
+                const int32_t lateness = channel_lateness(state, now);
+                if (lateness < 0)
+                        continue;
+
+                if (most_due_pid_index < 0 || lateness > highest_lateness) {
+                        highest_lateness = lateness;
+                        most_due_pid_index = i;
                 }
-                /*if we have timed out and we're not active, then we should try auto-detecting 29 or 11 bit OBDII */
-                else {
-                        obd2_state.is_29bit_obd2 = !obd2_state.is_29bit_obd2;
-                        pr_info_int_msg(_LOG_PFX "Trying OBDII bit mode ", obd2_state.is_29bit_obd2 ? 29 : 11);
+        }
+
+        return most_due_pid_index;
+}
+
+/**
+ * Counts a timeout against a channel, squelching it if it times out too
+ * often.
+ */
+static void channel_timed_out(struct OBD2ChannelState *state)
+{
+        state->timeout_count++;
+        if (state->timeout_count < OBD2_TIMEOUT_DISABLE_THRESHOLD ||
+            state->channel_status == OBD2_CHANNEL_STATUS_SQUELCHED)
+                return;
+
+        state->channel_status = OBD2_CHANNEL_STATUS_SQUELCHED;
+        pr_info_int_msg(_LOG_PFX "Excessive timeouts, squelching PID ", state->pid);
+        obd2_state.squelched_count++;
+        /**
+         * if all channels end up being squelched, then we should just reset OBD2 config
+         * This accounts for cases where there's a complete disconnect and a reset is needed
+         */
+        if (obd2_state.squelched_count == obd2_state.channel_count) {
+                pr_info(_LOG_PFX "all channels timed out, resetting OBD2 state\r\n");
+                obd2_state.is_stale = true;
+        }
+}
+
+static void request_timed_out(void)
+{
+        /**
+         * Not every ECU supports packed requests.  If it never answered
+         * one, go back to one PID at a time rather than blame the PIDs.
+         */
+        if (obd2_state.request_count > 1 && !obd2_state.is_packing_confirmed) {
+                pr_info(_LOG_PFX "No answer to packed PID request, "
+                        "querying one PID at a time\r\n");
+                obd2_state.is_packing_enabled = false;
+                return;
+        }
+
+        /* only start counting timeouts if we've ever received data */
+        if (obd2_state.is_active) {
+                for (size_t i = 0; i < obd2_state.request_count; i++) {
+                        struct OBD2ChannelState *state =
+                                &obd2_state.current_channel_states[obd2_state.request_indexes[i]];
+                        pr_debug_int_msg(_LOG_PFX "Timeout requesting PID ", state->pid);
+                        state->is_solo_pending = false;
+                        channel_timed_out(state);
                 }
         }
+        /*if we have timed out and we're not active, then we should try auto-detecting 29 or 11 bit OBDII */
+        else {
+                obd2_state.is_29bit_obd2 = !obd2_state.is_29bit_obd2;
+                /* give packed requests another chance in the new mode */
+                obd2_state.is_packing_enabled = true;
+                pr_info_int_msg(_LOG_PFX "Trying OBDII bit mode ", obd2_state.is_29bit_obd2 ? 29 : 11);
+        }
+}
+
+/**
+ * Adds the other channels that are due and can share a mode 01 request
+ * with the selected one, earliest deadline first.
+ */
+static void pack_due_channels(const OBD2Config *obd2_config,
+                              const uint16_t enabled_obd2_pids_count,
+                              const size_t now)
+{
+        while (obd2_state.request_count < OBD2_MAX_PIDS_PER_REQUEST) {
+                const int index = most_due_channel(obd2_config,
+                                                   enabled_obd2_pids_count,
+                                                   true, now);
+                if (index < 0)
+                        return;
+
+                channel_scheduled(&obd2_state.current_channel_states[index]);
+                obd2_state.request_indexes[obd2_state.request_count++] = index;
+        }
+}
+
+void sequence_next_obd2_query(const OBD2Config *obd2_config, uint16_t enabled_obd2_pids_count)
+{
+        /* no PIDs, no query... */
+        if (enabled_obd2_pids_count == 0)
+                return;
+
+        update_achieved_rates();
+
+        bool is_obd2_timeout = obd2_state.last_obd2_query_timestamp > 0 &&
+                isTimeoutMs(obd2_state.last_obd2_query_timestamp, OBD2_PID_DEFAULT_TIMEOUT_MS);
+
+        if (is_obd2_timeout)
+                request_timed_out();
 
         /* if a query is active and not timed out, exit now */
         if (obd2_state.last_obd2_query_timestamp != 0 && !is_obd2_timeout)
-        		return;
-
-		/**
-		 * Scheduler algorithm.  This updates a sequencer counter
-		 * based on the channel's sample rate.
-		 *
-		 * Whichever PID has the highest count *above* the max configured
-		 * OBDII sample rate wins and is selected for querying. once this happens
-		 * the counter is reset to 0.
-		 *
-		 * The result causes channels to be proportionately queried based on the
-		 * configured sample rate.
-		 *
-		 * Example:
-		 * Channel1 @ 1Hz - gets incremented by 1 on every pass through
-		 * Channel2 @ 25Hz - gets incremented by 25 on every pass
-		 * Channel3 @ 50Hz - gets incremented by 50 on every pass
-		 * Max configured sample rate: 50Hz
-		 *
-		 * Results:
-		 * Channel 1 is selected for PID querying approx. 1/50 the rate of channel 3
-		 * Channel 2 is selected for PID querying approx. 1/2 the rate of channel 3
-		 * Channel 3 is selected for PID querying approx. every time
-		 */
-
-		uint16_t highest_timeout_factor = 0;
-
-		/* tracks which PID should be scheduled next */
-		int most_due_pid_index = -1;
-
-		for (size_t i = 0; i < enabled_obd2_pids_count; i++) {
-                struct OBD2ChannelState *state = &obd2_state.current_channel_states[i];
+                return;
+
+        /**
+         * Scheduler algorithm.  Each channel has a deadline for its next
+         * query, one period of its sample rate after the last one.  A
+         * channel is due once its deadline is less than a measured round
+         * trip away, so the answer arrives about when it is wanted.
+         *
+         * Of the due channels, the one with the earliest deadline is
+         * queried.  Nothing is sent until something is due.  When the ECU
+         * can't keep up every deadline slips at the same pace, so each
+         * channel gets the same share of its configured rate.
+         *
+         * Example, with channels at 1Hz, 10Hz and 50Hz:
+         * An ECU that answers 100 queries/sec - each channel gets its
+         * configured rate, and the ECU is left idle the rest of the time.
+         * An ECU that answers 30 queries/sec - each channel gets about
+         * half of its configured rate: 0.5Hz, 5Hz and 25Hz.
+         *
+         * If the selected PID is a standard mode 01 PID, up to
+         * OBD2_MAX_PIDS_PER_REQUEST - 1 other mode 01 PIDs that are also
+         * due ride along in the same request.  The ECU's response rate is
+         * then shared by that many more PIDs.
+         */
+
+        const size_t now = getCurrentTicks();
+        obd2_state.request_count = 0;
+
+        /* tracks which PID should be scheduled next */
+        const int most_due_pid_index =
+                most_due_channel(obd2_config, enabled_obd2_pids_count,
+                                 false, now);
+
+        if (most_due_pid_index < 0)
+                /* nothing is due yet */
+                return;
+
+        struct OBD2ChannelState *state = &obd2_state.current_channel_states[most_due_pid_index];
+        limit_schedule_lag(channel_lateness(state, now));
+        channel_scheduled(state);
+        obd2_state.request_indexes[0] = most_due_pid_index;
+        obd2_state.request_count = 1;
+        obd2_state.response_expected = 0;
+
+        const PidConfig *pid_cfg = &obd2_config->pids[most_due_pid_index];
+        if (obd2_state.is_packing_enabled &&
+            is_packable(obd2_config, most_due_pid_index))
+                pack_due_channels(obd2_config, enabled_obd2_pids_count, now);
+
+        int pid_request_result;
+        if (obd2_state.request_count > 1) {
+                /* channels that share a PID share its answer */
+                uint8_t pids[OBD2_MAX_PIDS_PER_REQUEST];
+                size_t pid_count = 0;
+                for (size_t i = 0; i < obd2_state.request_count; i++) {
+                        const uint8_t pid = obd2_config->pids[obd2_state.request_indexes[i]].pid;
+                        if (!memchr(pids, pid, pid_count))
+                                pids[pid_count++] = pid;
+                }
+
+                pid_request_result = OBD2_request_PIDs(pids, pid_count,
+                                                       obd2_state.is_29bit_obd2,
+                                                       OBD2_PID_REQUEST_TIMEOUT_MS);
+        } else {
+                pid_request_result = pid_cfg->passive || OBD2_request_PID(pid_cfg->pid, pid_cfg->mode, obd2_state.is_29bit_obd2, OBD2_PID_REQUEST_TIMEOUT_MS);
+        }
+
+        if (pid_request_result) {
+                obd2_state.last_obd2_query_timestamp = getCurrentTicks();
+        }
+        else {
+                pr_debug_int_msg("Timeout sending PID request ", pid_cfg->pid);
+                obd2_state.request_count = 0;
+        }
+        obd2_state.current_obd2_pid_index = most_due_pid_index;
+}
+
+size_t OBD2_next_query_delay_ms(void)
+{
+        const size_t now = getCurrentTicks();
+
+        if (obd2_state.last_obd2_query_timestamp != 0) {
+                /* waiting on an answer, or for it to time out */
+                const size_t waited = ticksToMs(now - obd2_state.last_obd2_query_timestamp);
+                return waited < OBD2_PID_DEFAULT_TIMEOUT_MS ?
+                        OBD2_PID_DEFAULT_TIMEOUT_MS - waited : 1;
+        }
+
+        size_t delay = OBD2_PID_DEFAULT_TIMEOUT_MS;
+        for (size_t i = 0; i < OBD2_get_channel_count(); i++) {
+                const struct OBD2ChannelState *state = &obd2_state.current_channel_states[i];
                 if (state->channel_status == OBD2_CHANNEL_STATUS_SQUELCHED)
-                        /* if channel is squelched then skip */
                         continue;
 
-                uint16_t timeout = state->sequencer_count;
-                uint16_t sample_rate = decodeSampleRate(obd2_config->pids[i].mapping.channel_cfg.sampleRate);
-                timeout += sample_rate;
-
-                /**
-                 * select the channel if:
-                 * 1. the timeout has reached the trigger point
-                 * 2. the timeout has taken the longest amount of time to reach the trigger point */
-                uint16_t timeout_factor = timeout / sample_rate;
-                if (timeout >= obd2_state.max_sample_rate && timeout_factor > highest_timeout_factor) {
-                        highest_timeout_factor = timeout_factor;
-                        most_due_pid_index = i;
+                const int32_t lateness = channel_lateness(state, now);
+                if (lateness >= 0)
+                        return 1;
+
+                delay = MIN(delay, ticksToMs(-lateness));
+        }
+        return MAX(1, delay);
+}
+
+static void request_complete(void)
+{
+        /* Save our latency, smoothed over the last few queries */
+        const uint32_t latency = ticksToMs(getCurrentTicks() - obd2_state.last_obd2_query_timestamp);
+        obd2_state.query_latency = obd2_state.query_latency == 0 ? latency :
+                (3 * obd2_state.query_latency + latency) / 4;
+        obd2_state.is_active = true;
+        /* PID request is complete */
+        obd2_state.last_obd2_query_timestamp = 0;
+        obd2_state.request_count = 0;
+}
+
+/**
+ * Collects the frames of a packed response (ISO 15765-2).
+ * @return true once the whole response is in obd2_state.response
+ */
+static bool receive_packed_response(const CAN_msg *msg)
+{
+        const uint8_t frame_type = msg->data[0] >> 4;
+        size_t length;
+
+        switch (frame_type) {
+        case ISO_TP_SINGLE_FRAME:
+                length = msg->data[0] & 0x0F;
+                if (length == 0 || length > CAN_MSG_SIZE - 1)
+                        return false;
+
+                memcpy(obd2_state.response, msg->data + 1, length);
+                obd2_state.response_length = length;
+                obd2_state.response_expected = 0;
+                return true;
+        case ISO_TP_FIRST_FRAME:
+                length = ((msg->data[0] & 0x0F) << 8) | msg->data[1];
+                if (length <= CAN_MSG_SIZE - 2 || length > sizeof(obd2_state.response))
+                        return false;
+
+                memcpy(obd2_state.response, msg->data + 2, CAN_MSG_SIZE - 2);
+                obd2_state.response_length = CAN_MSG_SIZE - 2;
+                obd2_state.response_expected = length;
+                obd2_state.response_sequence = 1;
+                OBD2_send_flow_control(obd2_state.is_29bit_obd2, OBD2_PID_REQUEST_TIMEOUT_MS);
+                return false;
+        case ISO_TP_CONSECUTIVE_FRAME:
+                if (!obd2_state.response_expected ||
+                    (msg->data[0] & 0x0F) != obd2_state.response_sequence) {
+                        /* lost a frame; let the request time out */
+                        obd2_state.response_expected = 0;
+                        return false;
                 }
-                state->sequencer_count = timeout;
-		}
 
-		if (most_due_pid_index < 0)
-		        /* no PID was selected, give up */
-		        return;
+                length = MIN(CAN_MSG_SIZE - 1,
+                             obd2_state.response_expected - obd2_state.response_length);
+                memcpy(obd2_state.response + obd2_state.response_length,
+                       msg->data + 1, length);
+                obd2_state.response_length += length;
+                obd2_state.response_sequence = (obd2_state.response_sequence + 1) & 0x0F;
+                if (obd2_state.response_length < obd2_state.response_expected)
+                        return false;
+
+                obd2_state.response_expected = 0;
+                return true;
+        default:
+                return false;
+        }
+}
 
-		current_pid_index = most_due_pid_index;
-		obd2_state.current_channel_states[current_pid_index].sequencer_count = 0;
+/**
+ * Hands each PID's value in a packed response to the channels that
+ * asked for it, as the single frame response a CAN mapping expects.
+ */
+static void demux_packed_response(const CAN_msg *msg, const OBD2Config *cfg)
+{
+        const uint8_t *response = obd2_state.response;
+        const size_t length = obd2_state.response_length;
+        bool answered[OBD2_MAX_PIDS_PER_REQUEST] = {false};
+        size_t answered_pids = 0;
+
+        for (size_t offset = 1; offset < length;) {
+                const uint8_t pid = response[offset];
+                const uint8_t pid_length = pid < sizeof(mode1_pid_lengths) ?
+                        mode1_pid_lengths[pid] : 0;
+                if (pid_length == 0 || offset + 1 + pid_length > length)
+                        /* can't tell where the next PID starts */
+                        break;
+
+                CAN_msg frame = *msg;
+                memset(frame.data, ISO_TP_PAD, sizeof(frame.data));
+                frame.data[0] = 2 + pid_length;
+                frame.data[1] = OBD2_MODE_SHOW_CURRENT_DATA + OBD2_MODE_RESPONSE_OFFSET;
+                memcpy(frame.data + 2, response + offset, 1 + pid_length);
+                ++answered_pids;
+
+                for (size_t i = 0; i < obd2_state.request_count; i++) {
+                        const uint16_t index = obd2_state.request_indexes[i];
+                        const PidConfig *pid_config = &cfg->pids[index];
+                        if (pid_config->pid != pid)
+                                continue;
+
+                        float value;
+                        if (canmapping_map_value(&value, &frame, &pid_config->mapping))
+                                channel_updated(index, value);
+                        answered[i] = true;
+                }
 
-		PidConfig * pid_cfg = &obd2_config->pids[current_pid_index];
-		int pid_request_result = pid_cfg->passive || OBD2_request_PID(pid_cfg->pid, pid_cfg->mode, obd2_state.is_29bit_obd2, OBD2_PID_REQUEST_TIMEOUT_MS);
-		if (pid_request_result) {
-				obd2_state.last_obd2_query_timestamp = getCurrentTicks();
-		}
-		else {
-				pr_debug_int_msg("Timeout sending PID request ", pid_cfg->pid);
-		}
-		obd2_state.current_obd2_pid_index = current_pid_index;
+                offset += 1 + pid_length;
+        }
+
+        if (answered_pids > 1)
+                obd2_state.is_packing_confirmed = true;
+
+        /**
+         * Some ECUs only answer the first PID of a packed request.  Ask
+         * for the ones left out on their own before holding it against
+         * them.
+         */
+        for (size_t i = 0; i < obd2_state.request_count; i++) {
+                if (!answered[i])
+                        obd2_state.current_channel_states[obd2_state.request_indexes[i]].is_solo_pending = true;
+        }
 }
 
-void update_obd2_channels(CAN_msg *msg, OBD2Config *cfg)
+static void update_packed_obd2_channels(CAN_msg *msg, const OBD2Config *cfg)
 {
-        uint16_t current_pid_index = obd2_state.current_obd2_pid_index;
-        PidConfig *pid_config = &cfg->pids[current_pid_index];
-        struct OBD2ChannelState *channel_state = &obd2_state.current_channel_states[current_pid_index];
+        if (!receive_packed_response(msg))
+                return;
 
-        /* Did we get an OBDII PID we were waiting for? */
+        if (obd2_state.response[0] != OBD2_MODE_SHOW_CURRENT_DATA + OBD2_MODE_RESPONSE_OFFSET)
+                return;
 
-        uint8_t mode = pid_config->mode;
+        demux_packed_response(msg, cfg);
+        request_complete();
+}
 
+void update_obd2_channels(CAN_msg *msg, const OBD2Config *cfg)
+{
         /* valid OBD2 request timestamp? */
-        if (obd2_state.last_obd2_query_timestamp &&
+        if (!obd2_state.last_obd2_query_timestamp)
+                return;
+
+        /* is this CAN message an OBD2 PID response */
+        if (msg->addressValue != OBD2_11BIT_PID_RESPONSE && msg->addressValue != OBD2_29BIT_PID_RESPONSE)
+                return;
 
-            /* is this CAN message an OBD2 PID response */
-            (msg->addressValue == OBD2_11BIT_PID_RESPONSE || msg->addressValue == OBD2_29BIT_PID_RESPONSE) &&
+        if (obd2_state.request_count > 1) {
+                update_packed_obd2_channels(msg, cfg);
+                return;
+        }
 
-            /* does the returned mode + response offeset match the one expected in the current query? ? */
-            msg->data[1] == mode + OBD2_MODE_RESPONSE_OFFSET &&
+        uint16_t current_pid_index = obd2_state.current_obd2_pid_index;
+        const PidConfig *pid_config = &cfg->pids[current_pid_index];
+
+        /* Did we get an OBDII PID we were waiting for? */
+
+        uint8_t mode = pid_config->mode;
+
+        /* does the returned mode + response offeset match the one expected in the current query? ? */
+        if (msg->data[1] == mode + OBD2_MODE_RESPONSE_OFFSET &&
 
             (
 
@@ -395,18 +909,20 @@ void update_obd2_channels(CAN_msg *msg, OBD2Config *cfg)
 
             )
             ) {
+                    struct OBD2ChannelState *state =
+                            &obd2_state.current_channel_states[current_pid_index];
+                    if (state->is_solo_pending) {
+                            pr_info_int_msg(_LOG_PFX "Only answered on its own, "
+                                            "no longer packing PID ", state->pid);
+                            state->is_solo_pending = false;
+                            state->is_solo_only = true;
+                    }
+
                     float value;
                     bool result = canmapping_map_value(&value, msg, &pid_config->mapping);
-                    if (result) {
-                            OBD2_set_current_channel_value(current_pid_index, value);
-                            channel_state->channel_status = OBD2_CHANNEL_STATUS_DATA_RECEIVED;
-                            channel_state->timeout_count = 0;
-                    }
-                    /* Save our latency */
-                    obd2_state.query_latency = ticksToMs(getCurrentTicks() - obd2_state.last_obd2_query_timestamp);
-                    obd2_state.is_active = true;
-                    /* PID request is complete */
-                    obd2_state.last_obd2_query_timestamp = 0;
+                    if (result)
+                            channel_updated(current_pid_index, value);
+                    request_complete();
         }
 }
 
@@ -478,13 +478,9 @@ static void rx_data_cb(int chan_id, size_t len, const char* data)
 		return;
 	}
 
-        xQueueHandle q = serial_get_rx_queue(ch->serial);
-        bool data_dropped = false;
-        for (size_t i = 0; i < len && !data_dropped; ++i)
-                if (!xQueueSend(q, data + i, RX_DATA_TIMEOUT_TICKS))
-                        data_dropped = true;
-
-        if (data_dropped)
+        const size_t put =
+                serial_rx_put(ch->serial, data, len, RX_DATA_TIMEOUT_TICKS);
+        if (put < len)
                 pr_warning(LOG_PFX "Rx Buffer Overflow Detected\r\n");
 
         cmd_set_check(CHECK_DATA);
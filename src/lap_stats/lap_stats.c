@@ -27,6 +27,7 @@
 #include "geopoint.h"
 #include "gps.h"
 #include "lap_stats.h"
+#include "lap_summary.h"
 #include "launch_control.h"
 #include "loggerConfig.h"
 #include "loggerHardware.h"
@@ -111,6 +112,7 @@ void lapstats_reset()
         resetLapCount();
         reset_elapsed_time();
         lc_reset();
+        lap_summary_reset();
 }
 
 /**
@@ -447,6 +449,7 @@ static void lap_finished_event(const GpsSnapshot *gpsSnapshot)
 
         end_lap_timing(gpsSnapshot);
         finishLap(gpsSnapshot);
+        lap_summary_end_lap(g_lapCount, g_lastLapTime);
         g_at_sf = true;
         lc_reset();
 
@@ -472,6 +475,7 @@ static void lap_started_event(const tiny_millis_t time, const GeoPoint *sp,
         // Timing and predictive timing
         start_lap_timing(time);
         startLap(sp, time);
+        lap_summary_start_lap();
         reset_elapsed_time();
 
         // Reset the sector logic
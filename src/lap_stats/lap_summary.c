@@ -0,0 +1,310 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "FreeRTOS.h"
+#include "api.h"
+#include "channel_registry.h"
+#include "lap_summary.h"
+#include "loggerSampleData.h"
+#include "mem_mang.h"
+#include "printk.h"
+#include "sampleRecord.h"
+#include "semphr.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[lap_summary] "
+
+static struct {
+        xSemaphoreHandle mutex;
+
+        /* Only used by the logger task */
+        struct lap_summary_channel *current;
+        unsigned int version;
+
+        /* Guarded by the mutex */
+        struct lap_summary_channel *last;
+        size_t channel_count;
+        int lap;
+        tiny_millis_t lap_time;
+        uint32_t laps;
+
+        /* Lap boundaries waiting for the next sample */
+        bool start_pending;
+        bool end_pending;
+        bool reset_pending;
+        int end_lap;
+        tiny_millis_t end_lap_time;
+} state;
+
+static void lock(void)
+{
+        xSemaphoreTake(state.mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+        xSemaphoreGive(state.mutex);
+}
+
+static void clear_channels(struct lap_summary_channel *chans,
+                           const size_t count)
+{
+        memset(chans, 0, count * sizeof(*chans));
+}
+
+void lap_summary_init(void)
+{
+        portFree(state.current);
+        portFree(state.last);
+        memset(&state, 0, sizeof(state));
+        state.mutex = xSemaphoreCreateMutex();
+}
+
+void lap_summary_reset(void)
+{
+        lock();
+        state.reset_pending = true;
+        state.start_pending = false;
+        state.end_pending = false;
+        unlock();
+}
+
+void lap_summary_start_lap(void)
+{
+        lock();
+        state.start_pending = true;
+        unlock();
+}
+
+void lap_summary_end_lap(const int lap, const tiny_millis_t lap_time)
+{
+        lock();
+        state.end_pending = true;
+        state.end_lap = lap;
+        state.end_lap_time = lap_time;
+        unlock();
+}
+
+/* Lays the statistics out for the current channels.  Called with the lock held */
+static bool prepare_layout(const struct sample *s)
+{
+        const unsigned int version = channel_registry_version();
+        if (state.current && version == state.version &&
+            s->channel_count == state.channel_count)
+                return true;
+
+        portFree(state.current);
+        portFree(state.last);
+        state.channel_count = 0;
+        state.laps = 0;
+        state.version = version;
+
+        const size_t size = s->channel_count * sizeof(struct lap_summary_channel);
+        state.current = portMalloc(size);
+        state.last = portMalloc(size);
+        if (!state.current || !state.last) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", size * 2);
+                portFree(state.current);
+                portFree(state.last);
+                state.current = state.last = NULL;
+                return false;
+        }
+
+        state.channel_count = s->channel_count;
+        clear_channels(state.current, state.channel_count);
+        clear_channels(state.last, state.channel_count);
+        return true;
+}
+
+/* Applies the lap boundaries noted since the last sample */
+static bool apply_events(const struct sample *s)
+{
+        lock();
+        if (!prepare_layout(s)) {
+                unlock();
+                return false;
+        }
+
+        if (state.reset_pending) {
+                clear_channels(state.current, state.channel_count);
+                clear_channels(state.last, state.channel_count);
+                state.laps = 0;
+                state.reset_pending = false;
+        }
+
+        if (state.end_pending) {
+                struct lap_summary_channel *tmp = state.last;
+                state.last = state.current;
+                state.current = tmp;
+                state.lap = state.end_lap;
+                state.lap_time = state.end_lap_time;
+                ++state.laps;
+                state.end_pending = false;
+                clear_channels(state.current, state.channel_count);
+        }
+
+        if (state.start_pending) {
+                clear_channels(state.current, state.channel_count);
+                state.start_pending = false;
+        }
+        unlock();
+
+        return true;
+}
+
+void lap_summary_add_sample(const struct sample *s)
+{
+        if (!s || !s->channel_count)
+                return;
+
+        /* Skip the lock unless something changed */
+        if (!state.current || state.reset_pending || state.end_pending ||
+            state.start_pending || state.version != channel_registry_version())
+                if (!apply_events(s))
+                        return;
+
+        struct lap_summary_channel *chan = state.current;
+        for (size_t i = 0; i < state.channel_count; ++i, ++chan) {
+                const ChannelSample *cs = s->channel_samples + i;
+                double value;
+
+                /* Like UTC, too big to summarize */
+                if (SampleData_LongLong == cs->sampleData ||
+                    SampleData_LongLong_Noarg == cs->sampleData)
+                        continue;
+
+                if (!get_sample_value_by_index(s, i, &value))
+                        continue;
+
+                const float v = (float) value;
+                if (0 == chan->count) {
+                        chan->cfg = cs->cfg;
+                        chan->min = v;
+                        chan->max = v;
+                } else {
+                        if (v < chan->min)
+                                chan->min = v;
+                        if (v > chan->max)
+                                chan->max = v;
+                }
+
+                chan->sum += value;
+                ++chan->count;
+        }
+}
+
+uint32_t lap_summary_count(void)
+{
+        return state.laps;
+}
+
+bool lap_summary_get_channel(const size_t idx,
+                             struct lap_summary_channel *chan)
+{
+        lock();
+        const bool valid = state.laps && idx < state.channel_count;
+        if (valid)
+                *chan = state.last[idx];
+        unlock();
+
+        return valid;
+}
+
+/*
+ * Copies the last completed lap so it can be written out without the
+ * lock.  Writing to a slow link can take a long time, and the logger
+ * and GPS tasks must not wait on it at a lap boundary.
+ * @return The number of channels copied.
+ */
+static size_t copy_last_lap(struct lap_summary_channel **chans, int *lap,
+                            tiny_millis_t *lap_time)
+{
+        lock();
+        const size_t count = state.laps ? state.channel_count : 0;
+        unlock();
+
+        *chans = NULL;
+        *lap = 0;
+        *lap_time = 0;
+        if (!count)
+                return 0;
+
+        const size_t size = count * sizeof(struct lap_summary_channel);
+        *chans = portMalloc(size);
+        if (!*chans) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", size);
+                return 0;
+        }
+
+        lock();
+        /*
+         * The layout may have changed while we allocated.  A new channel
+         * registry also means the config the channels point at may be gone.
+         */
+        const bool same = state.laps && count == state.channel_count &&
+                state.version == channel_registry_version();
+        if (same) {
+                memcpy(*chans, state.last, size);
+                *lap = state.lap;
+                *lap_time = state.lap_time;
+        }
+        unlock();
+
+        return same ? count : 0;
+}
+
+void lap_summary_get_json(struct Serial *serial, const bool more)
+{
+        struct lap_summary_channel *chans;
+        int lap;
+        tiny_millis_t lap_time;
+        const size_t count = copy_last_lap(&chans, &lap, &lap_time);
+
+        json_objStartString(serial, "lapSum");
+        json_int(serial, "lap", lap, 1);
+        json_uint(serial, "ms", lap_time, 1);
+        json_objStartString(serial, "chans");
+
+        bool first = true;
+        for (size_t i = 0; i < count; ++i) {
+                const struct lap_summary_channel *chan = chans + i;
+                if (!chan->count)
+                        continue;
+
+                if (!first)
+                        serial_write_c(serial, ',');
+                first = false;
+
+                const int precision = chan->cfg->precision;
+                json_arrayStart(serial, chan->cfg->label);
+                json_arrayElementFloat(serial, chan->min, precision, 1);
+                json_arrayElementFloat(serial, chan->max, precision, 1);
+                json_arrayElementFloat(serial, chan->sum / chan->count,
+                                       precision, 0);
+                json_arrayEnd(serial, 0);
+        }
+
+        json_objEnd(serial, 0);
+        json_objEnd(serial, more);
+        portFree(chans);
+}
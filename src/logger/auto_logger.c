@@ -21,6 +21,7 @@
 
 #include "api.h"
 #include "auto_logger.h"
+#include "channel_registry.h"
 #include "cpp_guard.h"
 #include "dateTime.h"
 #include "loggerTaskEx.h"
@@ -46,6 +47,7 @@
 static struct {
         struct auto_logger_config *cfg;
         struct auto_control_state control_state;
+        struct channel_ref channel;
 } auto_logger_state;
 
 void auto_logger_reset_config(struct auto_logger_config* cfg)
@@ -53,6 +55,7 @@ void auto_logger_reset_config(struct auto_logger_config* cfg)
         cfg->enabled = true;
         strcpy(cfg->channel, DEFAULT_AUTO_LOGGER_CHANNEL);
         auto_control_reset_trigger(&cfg->start, &cfg->stop);
+        cfg->pre_trigger = 0;
 }
 
 void auto_logger_get_config(struct auto_logger_config* cfg,
@@ -62,6 +65,7 @@ void auto_logger_get_config(struct auto_logger_config* cfg,
         json_objStartString(serial, "sdLogCtrlCfg");
         json_bool(serial, "en", cfg->enabled, true);
         json_string(serial, "channel", cfg->channel, true);
+        json_uint(serial, "pre", cfg->pre_trigger, true);
         get_auto_control_trigger(serial, &cfg->start, "start", true);
         get_auto_control_trigger(serial, &cfg->stop, "stop", false);
         json_objEnd(serial, more);
@@ -72,6 +76,8 @@ bool auto_logger_set_config(struct auto_logger_config* cfg,
 {
         jsmn_exists_set_val_bool(json, "en", &cfg->enabled);
         jsmn_exists_set_val_string(json, "channel", cfg->channel, DEFAULT_LABEL_LENGTH, true);
+        jsmn_exists_set_val_uint8(json, "pre", &cfg->pre_trigger, NULL);
+        channel_ref_invalidate(&auto_logger_state.channel);
         set_auto_control_trigger(&cfg->start, "start", json);
         set_auto_control_trigger(&cfg->stop, "stop", json);
         return true;
@@ -83,8 +89,11 @@ static void auto_logger_sample_cb(const struct sample* sample,
         if (!auto_logger_state.cfg || !auto_logger_state.cfg->enabled)
                 return;
 
+        const int index = channel_registry_resolve(&auto_logger_state.channel,
+                                                   sample,
+                                                   auto_logger_state.cfg->channel);
         double value;
-        if (!get_sample_value_by_name(sample, auto_logger_state.cfg->channel, &value))
+        if (!get_sample_value_by_index(sample, index, &value))
                 return;
 
         enum auto_control_trigger_result res = auto_control_check_trigger(value,
@@ -112,6 +121,7 @@ bool auto_logger_init(struct auto_logger_config* cfg)
 
         auto_logger_state.cfg = cfg;
         auto_control_init_state(&auto_logger_state.control_state);
+        channel_ref_invalidate(&auto_logger_state.channel);
 
         logger_sample_create_callback(auto_logger_sample_cb, 10, NULL);
         return true;
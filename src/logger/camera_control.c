@@ -20,6 +20,7 @@
  */
 
 #include "camera_control.h"
+#include "channel_registry.h"
 #include "cpp_guard.h"
 #include "dateTime.h"
 #include "api.h"
@@ -36,6 +37,7 @@
 static struct {
         struct camera_control_config *cfg;
         struct auto_control_state control_state;
+        struct channel_ref channel;
 } camera_control_state;
 
 void camera_control_reset_config(struct camera_control_config* cfg)
@@ -64,6 +66,7 @@ bool camera_control_set_config(struct camera_control_config* cfg,
 {
         jsmn_exists_set_val_bool(json, "en", &cfg->enabled);
         jsmn_exists_set_val_string(json, "channel", cfg->channel, DEFAULT_LABEL_LENGTH, true);
+        channel_ref_invalidate(&camera_control_state.channel);
         jsmn_exists_set_val_uint8(json, "makeModel", &cfg->make_model, NULL);
         set_auto_control_trigger(&cfg->start, "start", json);
         set_auto_control_trigger(&cfg->stop, "stop", json);
@@ -76,8 +79,11 @@ static void camera_control_sample_cb(const struct sample* sample,
         if (!camera_control_state.cfg || !camera_control_state.cfg->enabled)
                 return;
 
+        const int index = channel_registry_resolve(&camera_control_state.channel,
+                                                   sample,
+                                                   camera_control_state.cfg->channel);
         double value;
-        if (!get_sample_value_by_name(sample, camera_control_state.cfg->channel, &value))
+        if (!get_sample_value_by_index(sample, index, &value))
                 return;
 
         enum auto_control_trigger_result res = auto_control_check_trigger(value,
@@ -105,6 +111,7 @@ bool camera_control_init(struct camera_control_config* cfg)
 
         camera_control_state.cfg = cfg;
         auto_control_init_state(&camera_control_state.control_state);
+        channel_ref_invalidate(&camera_control_state.channel);
 
         logger_sample_create_callback(camera_control_sample_cb, 10, NULL);
         return true;
@@ -0,0 +1,172 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "channel_registry.h"
+#include "hash.h"
+#include "macros.h"
+#include "printk.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[chan_reg] "
+#define EMPTY_SLOT	-1
+
+static struct {
+        struct channel_name_index index;
+        int16_t slots[CHANNEL_REGISTRY_SLOTS];
+        size_t channel_count;
+        unsigned int version;
+} registry;
+
+void channel_name_index_init(struct channel_name_index *ni, int16_t *slots,
+                             const size_t slot_count,
+                             channel_name_fn *name_of)
+{
+        ni->slots = slots;
+        ni->slot_count = slot_count;
+        ni->name_of = name_of;
+        channel_name_index_reset(ni);
+}
+
+void channel_name_index_reset(struct channel_name_index *ni)
+{
+        for (size_t i = 0; i < ni->slot_count; ++i)
+                ni->slots[i] = EMPTY_SLOT;
+}
+
+bool channel_name_index_add(struct channel_name_index *ni, const void *ctx,
+                            const char *name, const size_t idx)
+{
+        size_t slot = hash_fnv1a_str(name) % ni->slot_count;
+
+        for (size_t probes = 0; probes < ni->slot_count; ++probes) {
+                const int16_t entry = ni->slots[slot];
+
+                if (EMPTY_SLOT == entry) {
+                        ni->slots[slot] = (int16_t) idx;
+                        return true;
+                }
+
+                if (STR_EQ(name, ni->name_of(ctx, entry)))
+                        return true;
+
+                slot = (slot + 1) % ni->slot_count;
+        }
+
+        return false;
+}
+
+int channel_name_index_find(const struct channel_name_index *ni,
+                            const void *ctx, const char *name)
+{
+        size_t slot = hash_fnv1a_str(name) % ni->slot_count;
+
+        for (size_t probes = 0; probes < ni->slot_count; ++probes) {
+                const int16_t entry = ni->slots[slot];
+
+                if (EMPTY_SLOT == entry)
+                        break;
+
+                if (STR_EQ(name, ni->name_of(ctx, entry)))
+                        return entry;
+
+                slot = (slot + 1) % ni->slot_count;
+        }
+
+        return CHANNEL_REGISTRY_INVALID_INDEX;
+}
+
+static const char* sample_channel_name(const void *ctx, const size_t idx)
+{
+        const struct sample *s = ctx;
+        return s->channel_samples[idx].cfg->label;
+}
+
+static int find_channel_linear(const struct sample *s, const char *name)
+{
+        for (size_t i = 0; i < s->channel_count; ++i) {
+                if (STR_EQ(name, sample_channel_name(s, i)))
+                        return i;
+        }
+
+        return CHANNEL_REGISTRY_INVALID_INDEX;
+}
+
+void channel_registry_build(const struct sample *s)
+{
+        channel_name_index_init(&registry.index, registry.slots,
+                                ARRAY_LEN(registry.slots),
+                                sample_channel_name);
+        registry.channel_count = 0;
+
+        for (size_t i = 0; s && i < s->channel_count; ++i) {
+                if (!channel_name_index_add(&registry.index, s,
+                                            sample_channel_name(s, i), i)) {
+                        pr_error(LOG_PFX "Registry full\r\n");
+                        break;
+                }
+                registry.channel_count = i + 1;
+        }
+
+        /* Skip 0 on wrap since it means "never built" */
+        if (0 == ++registry.version)
+                ++registry.version;
+
+        pr_debug_int_msg(LOG_PFX "Channels indexed: ",
+                         registry.channel_count);
+}
+
+unsigned int channel_registry_version(void)
+{
+        return registry.version;
+}
+
+int channel_registry_find(const struct sample *s, const char *name)
+{
+        if (!s || !name)
+                return CHANNEL_REGISTRY_INVALID_INDEX;
+
+        /*
+         * Only trust the registry if it was built from a sample with
+         * this layout.  Otherwise do it the slow way.
+         */
+        if (0 == registry.version || s->channel_count != registry.channel_count)
+                return find_channel_linear(s, name);
+
+        return channel_name_index_find(&registry.index, s, name);
+}
+
+int channel_registry_resolve(struct channel_ref *ref,
+                             const struct sample *s, const char *name)
+{
+        if (0 != ref->version && ref->version == registry.version)
+                return ref->index;
+
+        ref->index = channel_registry_find(s, name);
+        ref->version = registry.version;
+        return ref->index;
+}
+
+void channel_ref_invalidate(struct channel_ref *ref)
+{
+        ref->index = CHANNEL_REGISTRY_INVALID_INDEX;
+        ref->version = 0;
+}
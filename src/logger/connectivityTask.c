@@ -27,6 +27,7 @@
 #include "capabilities.h"
 #include "connectivityTask.h"
 #include "devices_common.h"
+#include "lap_summary.h"
 #include "loggerApi.h"
 #include "loggerConfig.h"
 #include "loggerHardware.h"
@@ -37,8 +38,14 @@
 #include "printk.h"
 #include "queue.h"
 #include "sampleRecord.h"
+#include "sample_binary.h"
+#include "sample_meta.h"
 #include "serial.h"
+#include "stream_profile.h"
 #include "cellular.h"
+#include "telemetry_backlog.h"
+#include "telemetry_batch.h"
+#include "telemetry_rate.h"
 #include "stdint.h"
 #include "task.h"
 #include "taskUtil.h"
@@ -68,6 +75,10 @@
 #define METADATA_SAMPLE_INTERVAL				100
 
 static xQueueHandle g_sampleQueue[CONNECTIVITY_CHANNELS] = CONNECTIVITY_TASK_INIT;
+static struct telemetry_rate g_telemetry_rate[CONNECTIVITY_CHANNELS];
+static struct stream_profile g_stream_profile[CONNECTIVITY_CHANNELS];
+static struct telemetry_backlog g_backlog[CONNECTIVITY_CHANNELS];
+static struct telemetry_batch g_batch[CONNECTIVITY_CHANNELS];
 
 
 static size_t trimBuffer(char *buffer, size_t count)
@@ -113,14 +124,69 @@ static int processRxBuffer(struct Serial *serial, char *buffer, size_t *rxCount)
 
 void queueTelemetryRecord(const LoggerMessage *msg)
 {
-    for (size_t i = 0; i < CONNECTIVITY_CHANNELS; i++)
-            send_logger_message(g_sampleQueue[i], msg);
+    for (size_t i = 0; i < CONNECTIVITY_CHANNELS; i++) {
+            /* While its link is down a stream keeps its samples here */
+            if (LoggerMessageType_Sample == msg->type &&
+                telemetry_backlog_capturing(g_backlog + i)) {
+                    telemetry_backlog_capture(g_backlog + i, msg->sample);
+                    continue;
+            }
+
+            const portBASE_TYPE res = send_logger_message(g_sampleQueue[i], msg);
+
+            /* Let the stream know its link isn't keeping up */
+            if (pdTRUE != res && LoggerMessageType_Sample == msg->type)
+                    telemetry_rate_dropped(g_telemetry_rate + i);
+    }
+}
+
+const struct telemetry_rate* connectivity_get_telemetry_rate(const size_t channel)
+{
+        if (channel >= CONNECTIVITY_CHANNELS)
+                return NULL;
+
+        /* Only streams that have a task running have a name */
+        const struct telemetry_rate *tr = g_telemetry_rate + channel;
+        return tr->name ? tr : NULL;
 }
 
+struct telemetry_backlog* connectivity_get_backlog(const size_t channel)
+{
+        if (channel >= CONNECTIVITY_CHANNELS)
+                return NULL;
+
+        struct telemetry_backlog *bl = g_backlog + channel;
+        return telemetry_backlog_enabled(bl) ? bl : NULL;
+}
+
+#if CELLULAR_SUPPORT
+/*
+ * Cellular links drop out in tunnels and dead spots, so keep what they
+ * miss to backfill later.
+ */
+static struct telemetry_backlog* init_cell_backlog(struct telemetry_backlog *bl,
+                                                   const ConnParams *params)
+{
+        const ConnectivityConfig *connConfig =
+                &getWorkingLoggerConfig()->ConnectivityConfigs;
+
+        if (!telemetry_backlog_init(bl, TELEMETRY_BACKLOG_SIZE,
+                                    &connConfig->cellularConfig.profile,
+                                    params->max_sample_rate))
+                return NULL;
+
+        return bl;
+}
+#endif
+
 /*combined telemetry - for when there's only one telemetry / wireless port available on system
 //e.g. "Y-adapter" scenario */
 static void createCombinedTelemetryTask(int16_t priority,
-                                        xQueueHandle sampleQueue)
+                                        xQueueHandle sampleQueue,
+                                        struct telemetry_rate *telemetry_rate,
+                                        struct stream_profile *stream_profile,
+                                        struct telemetry_backlog *backlog,
+                                        struct telemetry_batch *batch)
 {
         ConnectivityConfig *connConfig =
                 &getWorkingLoggerConfig()->ConnectivityConfigs;
@@ -137,25 +203,42 @@ static void createCombinedTelemetryTask(int16_t priority,
                 params->init_connection = &null_device_init_connection;
                 params->serial = SERIAL_TELEMETRY;
                 params->sampleQueue = sampleQueue;
+                params->telemetry_rate = telemetry_rate;
+                params->stream_profile = stream_profile;
+                params->backlog = NULL;
+                params->batch = batch;
                 params->connection_timeout = 0;
                 params->always_streaming = false;
 
                 if (btEnabled) {
+                        params->connectionName = "Wireless";
                         params->check_connection_status = &bt_check_connection_status;
                         params->init_connection = &bt_init_connection;
                         params->disconnect = &bt_disconnect;
                         params->always_streaming = true;
-                        params->max_sample_rate = SAMPLE_50Hz;
+#if BLUETOOTH_SUPPORT
+                        stream_profile_init(stream_profile,
+                                            &connConfig->bluetoothConfig.profile);
+#else
+                        stream_profile_init(stream_profile, NULL);
+#endif
+                        params->max_sample_rate = stream_profile_sample_rate(
+                                stream_profile->cfg, SAMPLE_50Hz);
                 }
 
 #if CELLULAR_SUPPORT
                 /*cell overrides wireless*/
                 if (cellEnabled) {
+                        params->connectionName = "Telemetry";
                         params->check_connection_status = &cellular_check_connection_status;
                         params->init_connection = &cellular_init_connection;
                         params->disconnect = &cellular_disconnect;
                         params->always_streaming = false;
-                        params->max_sample_rate = SAMPLE_10Hz;
+                        stream_profile_init(stream_profile,
+                                            &connConfig->cellularConfig.profile);
+                        params->max_sample_rate = stream_profile_sample_rate(
+                                stream_profile->cfg, SAMPLE_10Hz);
+                        params->backlog = init_cell_backlog(backlog, params);
                 }
 #endif
                 /* Make all task names 16 chars including NULL char */
@@ -167,9 +250,17 @@ static void createCombinedTelemetryTask(int16_t priority,
 
 static void createWirelessConnectionTask(int16_t priority,
                                          xQueueHandle sampleQueue,
+                                         struct telemetry_rate *telemetry_rate,
+                                         struct stream_profile *stream_profile,
+                                         struct telemetry_batch *batch,
                                          enum led activity_led)
 {
 #if BLUETOOTH_SUPPORT
+        const ConnectivityConfig *connConfig =
+                &getWorkingLoggerConfig()->ConnectivityConfigs;
+        stream_profile_init(stream_profile,
+                            &connConfig->bluetoothConfig.profile);
+
         ConnParams *params = portMalloc(sizeof(ConnParams));
         params->connectionName = "Wireless";
         params->periodicMeta = 0;
@@ -179,8 +270,13 @@ static void createWirelessConnectionTask(int16_t priority,
         params->init_connection = &bt_init_connection;
         params->serial = SERIAL_BLUETOOTH;
         params->sampleQueue = sampleQueue;
+        params->telemetry_rate = telemetry_rate;
+        params->stream_profile = stream_profile;
+        params->backlog = NULL;
+        params->batch = batch;
         params->always_streaming = true;
-        params->max_sample_rate = SAMPLE_50Hz;
+        params->max_sample_rate =
+                stream_profile_sample_rate(stream_profile->cfg, SAMPLE_50Hz);
         params->activity_led = activity_led;
 
         /* Make all task names 16 chars including NULL char */
@@ -192,9 +288,18 @@ static void createWirelessConnectionTask(int16_t priority,
 
 static void createTelemetryConnectionTask(int16_t priority,
                                           xQueueHandle sampleQueue,
+                                          struct telemetry_rate *telemetry_rate,
+                                          struct stream_profile *stream_profile,
+                                          struct telemetry_backlog *backlog,
+                                          struct telemetry_batch *batch,
                                           enum led activity_led)
 {
 #if CELLULAR_SUPPORT
+        const ConnectivityConfig *connConfig =
+                &getWorkingLoggerConfig()->ConnectivityConfigs;
+        stream_profile_init(stream_profile,
+                            &connConfig->cellularConfig.profile);
+
         ConnParams * params = (ConnParams *)portMalloc(sizeof(ConnParams));
         params->connectionName = "Telemetry";
         params->periodicMeta = 0;
@@ -204,8 +309,13 @@ static void createTelemetryConnectionTask(int16_t priority,
         params->init_connection = &cellular_init_connection;
         params->serial = SERIAL_TELEMETRY;
         params->sampleQueue = sampleQueue;
+        params->telemetry_rate = telemetry_rate;
+        params->stream_profile = stream_profile;
         params->always_streaming = false;
-        params->max_sample_rate = SAMPLE_10Hz;
+        params->max_sample_rate =
+                stream_profile_sample_rate(stream_profile->cfg, SAMPLE_10Hz);
+        params->backlog = init_cell_backlog(backlog, params);
+        params->batch = batch;
         params->activity_led = activity_led;
 
         /* Make all task names 16 chars including NULL char */
@@ -229,7 +339,11 @@ void startConnectivityTask(int16_t priority)
 
         switch (CONNECTIVITY_CHANNELS) {
         case 1:
-                createCombinedTelemetryTask(priority, g_sampleQueue[0]);
+                createCombinedTelemetryTask(priority, g_sampleQueue[0],
+                                            g_telemetry_rate + 0,
+                                            g_stream_profile + 0,
+                                            g_backlog + 0,
+                                            g_batch + 0);
                 break;
         case 2: {
                 ConnectivityConfig *connConfig =
@@ -244,7 +358,12 @@ void startConnectivityTask(int16_t priority)
 
                 if (cellEnabled)
                         createTelemetryConnectionTask(priority,
-                                                      g_sampleQueue[1], LED_TELEMETRY);
+                                                      g_sampleQueue[1],
+                                                      g_telemetry_rate + 1,
+                                                      g_stream_profile + 1,
+                                                      g_backlog + 1,
+                                                      g_batch + 1,
+                                                      LED_TELEMETRY);
 
                 if (connConfig->bluetoothConfig.btEnabled) {
                         /* Pick the bluetooth LED if available */
@@ -253,6 +372,9 @@ void startConnectivityTask(int16_t priority)
 
                     createWirelessConnectionTask(priority,
                                                  g_sampleQueue[0],
+                                                 g_telemetry_rate + 0,
+                                                 g_stream_profile + 0,
+                                                 g_batch + 0,
                                                  activity_led);
 
                 }
@@ -287,7 +409,12 @@ void connectivityTask(void *params)
 
     xQueueHandle sampleQueue = connParams->sampleQueue;
     uint32_t connection_timeout = connParams->connection_timeout;
-    const size_t max_telem_rate = connParams->max_sample_rate;
+    struct telemetry_rate *telem_rate = connParams->telemetry_rate;
+    struct telemetry_backlog *backlog = connParams->backlog;
+    struct telemetry_batch *batch = connParams->batch;
+    telemetry_rate_init(telem_rate, connParams->connectionName,
+                        connParams->max_sample_rate);
+    telemetry_batch_init(batch, connParams->stream_profile->cfg);
 
     DeviceConfig deviceConfig;
     deviceConfig.serial = serial;
@@ -304,19 +431,30 @@ void connectivityTask(void *params)
                              logger_config->ConnectivityConfigs.telemetryConfig.backgroundStreaming ||
                              connParams->always_streaming;
 
+        /* Keep what the server misses until we are connected again */
+        telemetry_backlog_set_capturing(backlog, should_stream);
         while (should_stream && connParams->init_connection(&deviceConfig, &connected_at) != DEVICE_INIT_SUCCESS) {
             pr_info("conn: not connected. retrying\r\n");
             vTaskDelay(INIT_DELAY);
         }
+        telemetry_backlog_set_capturing(backlog, false);
         if (connected_at > 0)
                 GPS_set_UTC_time(connected_at);
 
         serial_flush(serial);
+        sample_meta_reset_client(serial);
+        sample_binary_reset_client(serial);
+        telemetry_batch_reset(batch);
+        telemetry_rate_reset(telem_rate, getUptime());
         rxCount = 0;
         size_t badMsgCount = 0;
         size_t tick = 0;
         size_t last_message_time = getUptimeAsInt();
         bool should_reconnect = false;
+        /* Only laps completed while connected are sent */
+        uint32_t laps_sent = lap_summary_count();
+        const unsigned char lap_summary =
+                connParams->stream_profile->cfg->lap_summary;
 
         while (1) {
             if ( should_reconnect )
@@ -334,6 +472,10 @@ void connectivityTask(void *params)
             // Process a pending message from logger task, if exists
             ////////////////////////////////////////////////////////////*/
             if (pdFALSE != res) {
+                /* Batched samples go out before anything that follows them */
+                if (LoggerMessageType_Sample != msg.type)
+                        telemetry_batch_flush(batch, serial);
+
                 switch(msg.type) {
                 case LoggerMessageType_Start: {
                     api_sendLogStart(serial);
@@ -356,7 +498,8 @@ void connectivityTask(void *params)
                 }
                 case LoggerMessageType_Sample: {
                         if (!should_stream ||
-                            !should_sample(msg.ticks, max_telem_rate))
+                            STREAM_LAP_SUMMARY_ONLY == lap_summary ||
+                            !telemetry_rate_should_send(telem_rate, msg.ticks))
                                 break;
 
                         toggle_connectivity_indicator(connParams->activity_led);
@@ -364,10 +507,41 @@ void connectivityTask(void *params)
                         const int send_meta = tick == 0 ||
                                 (connParams->periodicMeta &&
                                  (tick % METADATA_SAMPLE_INTERVAL == 0));
-                        api_send_sample_record(serial, msg.sample, tick, send_meta);
-
-                        put_crlf(serial);
+                        const struct channel_mask *mask =
+                                stream_profile_mask(connParams->stream_profile,
+                                                    msg.sample);
+                        const tiny_millis_t start = getUptime();
+                        uint32_t seq = 0;
+                        const bool sequenced = telemetry_backlog_enabled(backlog);
+                        if (sequenced)
+                                seq = telemetry_backlog_next_seq(backlog);
+
+                        if (telemetry_batch_enabled(batch) &&
+                            !sample_binary_client_enabled(serial))
+                                telemetry_batch_add(batch, serial, msg.sample,
+                                                    mask, tick,
+                                                    sequenced ? &seq : NULL,
+                                                    send_meta, start);
+                        else if (sequenced)
+                                api_send_sequenced_sample_record(
+                                        serial, msg.sample, tick, seq,
+                                        send_meta, mask);
+                        else
+                                api_send_sample_record(serial, msg.sample, tick,
+                                                       send_meta, mask);
+                        const tiny_millis_t now = getUptime();
+                        telemetry_rate_sent(telem_rate, serial_tx_pending(serial),
+                                            serial_tx_capacity(serial),
+                                            now - start, now);
                         tick++;
+
+                        /* Fill in what the server missed, if there is room */
+                        if (telemetry_backlog_should_drain(backlog,
+                                                           serial_tx_pending(serial),
+                                                           serial_tx_capacity(serial)) &&
+                            telemetry_backlog_send(backlog, serial, msg.sample,
+                                                   mask, tick))
+                                tick++;
                         break;
                 }
                 default:
@@ -375,6 +549,22 @@ void connectivityTask(void *params)
                 }
             }
 
+            if (telemetry_batch_due(batch, getUptime()))
+                    telemetry_batch_flush(batch, serial);
+
+            /* A reset drops the count; only a new lap is worth sending */
+            const uint32_t laps = lap_summary_count();
+            if (laps < laps_sent)
+                    laps_sent = laps;
+
+            if (should_stream && STREAM_LAP_SUMMARY_OFF != lap_summary &&
+                laps > laps_sent) {
+                    laps_sent = laps;
+                    telemetry_batch_flush(batch, serial);
+                    api_send_lap_summary(serial);
+                    put_crlf(serial);
+            }
+
             /*//////////////////////////////////////////////////////////
             // Process incoming message, if available
             ////////////////////////////////////////////////////////////
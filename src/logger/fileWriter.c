@@ -20,8 +20,10 @@
  */
 
 
+#include "can_capture.h"
 #include "fileWriter.h"
 #include "led.h"
+#include "log_spool.h"
 #include "loggerHardware.h"
 #include "macros.h"
 #include "mem_mang.h"
@@ -32,20 +34,31 @@
 #include "sdcard.h"
 #include "task.h"
 #include "taskUtil.h"
+#include "task_stats.h"
 #include "test.h"
 #include "logger.h"
+#include <ctype.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <string.h>
 
+#define CAPTURE_DRAIN_MS	10
+#define CAPTURE_STOP_WAIT_MS	500
+#define CARD_LOCK_WAIT_MS	500
 #define ERROR_SLEEP_DELAY_MS	500
 #define FILE_BUFFER_SIZE	1024
 #define FILE_WRITER_STACK_SIZE	512
+#define LOG_INDEX_FILE	"rc_next.idx"
+#define LOG_INDEX_LEN	8
 #define LOG_PFX	"[fileWriter] "
 #define MAX_LOG_FILE_INDEX	99999
 #define WRITE_FAIL	EOF
 
 static FIL *g_logfile;
+static FIL *g_capfile;
+static bool g_capturing;
+static bool g_card_locked;
 static xQueueHandle g_LoggerMessage_queue;
 static struct ring_buff *file_buff;
 
@@ -54,6 +67,12 @@ static void error_led(const bool on)
         led_set(LED_ERROR, on);
 }
 
+/* Card writes that block for a while are what the log spool rides out */
+static void note_stall(const portTickType start)
+{
+        log_spool_note_stall((xTaskGetTickCount() - start) * portTICK_RATE_MS);
+}
+
 static FRESULT flush_file_buffer(void)
 {
         while(true) {
@@ -66,8 +85,10 @@ static FRESULT flush_file_buffer(void)
 			return FR_OK;
 
 		unsigned int written = 0;
+		const portTickType start = xTaskGetTickCount();
 		const FRESULT res =
 			f_write(g_logfile, buff, available, &written);
+		note_stall(start);
 
 		ring_buffer_dma_read_fini(file_buff, written);
 		if (FR_OK != res) {
@@ -79,13 +100,9 @@ static FRESULT flush_file_buffer(void)
         }
 }
 
-static FRESULT append_file_buffer(const char *str)
+static FRESULT append_file_buffer_len(const char *str, size_t len)
 {
-        if (!str)
-                return FR_OK;
-
         FRESULT res = FR_OK;
-        size_t len = strlen(str);
         while(len) {
                 const size_t write_len =
                         MIN(ring_buffer_bytes_free(file_buff), len);
@@ -101,6 +118,14 @@ static FRESULT append_file_buffer(const char *str)
         return res;
 }
 
+static FRESULT append_file_buffer(const char *str)
+{
+        if (!str)
+                return FR_OK;
+
+        return append_file_buffer_len(str, strlen(str));
+}
+
 portBASE_TYPE queue_logfile_record(const LoggerMessage * const msg)
 {
         return send_logger_message(g_LoggerMessage_queue, msg);
@@ -139,10 +164,10 @@ static void appendDouble(double num, int precision)
 
 static void appendFloat(float num, int precision)
 {
-        char buf[16];
-        modp_ftoa(num, buf, precision);
-        buf[15] = '\0';
-        append_file_buffer(buf);
+        /* Worst case is "-2147483648.123456789" */
+        char buf[24];
+        const size_t len = modp_ftoa_fixed(num, buf, precision);
+        append_file_buffer_len(buf, len);
 }
 
 static int write_samples_header(const LoggerMessage *msg)
@@ -232,19 +257,121 @@ static enum writing_status open_existing_log_file(struct logging_status *ls)
         return rc == FR_OK ? WRITING_ACTIVE : WRITING_INACTIVE;
 }
 
-static enum writing_status open_new_log_file(struct logging_status *ls)
+static void set_log_file_name(char *name, const int index)
 {
-        pr_debug(_RCP_BASE_FILE_ "Opening new log file\r\n");
+        char buf[12];
+        modp_itoa10(index, buf);
 
-        int i;
+        strcpy(name, "rc_");
+        strcat(name, buf);
+        strcat(name, ".log");
+}
 
-        for (i = 0; i < MAX_LOG_FILE_INDEX; i++) {
-                char buf[12];
-                modp_itoa10(i, buf);
+/**
+ * @return The N of an rc_N.log file name, or -1 if it isn't one.  FatFs
+ * hands back short names in upper case, so the match ignores case.
+ */
+TESTABLE_STATIC int log_file_name_index(const char *name)
+{
+        static const char ext[] = ".LOG";
+
+        if ('R' != toupper((int) name[0]) || 'C' != toupper((int) name[1]) ||
+            '_' != name[2] || !isdigit((int) name[3]))
+                return -1;
+
+        int index = 0;
+        for (name += 3; isdigit((int) *name); ++name) {
+                index = index * 10 + *name - '0';
+                if (index > MAX_LOG_FILE_INDEX)
+                        return -1;
+        }
+
+        for (size_t i = 0; i < ARRAY_LEN(ext); ++i)
+                if (ext[i] != toupper((int) name[i]))
+                        return -1;
+
+        return index;
+}
+
+/**
+ * One pass over the root directory.
+ * @return The index after the highest numbered log file on the card.
+ */
+static int scan_log_files(void)
+{
+        DIR dir;
+        FILINFO fno;
+        int next = 0;
+
+        /* No LFN buffer.  The short name is all we need */
+        memset(&fno, 0, sizeof(fno));
+
+        if (FR_OK != f_opendir(&dir, "/"))
+                return 0;
+
+        while (FR_OK == f_readdir(&dir, &fno) && fno.fname[0]) {
+                const int index = log_file_name_index(fno.fname);
+                if (index >= next)
+                        next = index + 1;
+        }
 
-                strcpy(ls->name, "rc_");
-                strcat(ls->name, buf);
-                strcat(ls->name, ".log");
+        f_closedir(&dir);
+        pr_debug_int_msg(_RCP_BASE_FILE_ "Scanned log index: ", next);
+        return next;
+}
+
+/**
+ * Works out the index of the next log file and records the one after it
+ * in the index file so the following session need not search for it.
+ * The index file is read unless a rescan is requested; the directory is
+ * scanned if it is missing or garbled.  The index is kept in a fixed
+ * width field so that it is rewritten in place.
+ */
+static int claim_log_index(const bool rescan)
+{
+        const bool have_file = FR_OK ==
+                f_open(g_logfile, LOG_INDEX_FILE,
+                       FA_READ | FA_WRITE | FA_OPEN_ALWAYS);
+
+        int index = -1;
+        char buf[LOG_INDEX_LEN + 1];
+
+        if (have_file && !rescan) {
+                unsigned int read = 0;
+                if (FR_OK == f_read(g_logfile, buf, LOG_INDEX_LEN, &read) &&
+                    read == LOG_INDEX_LEN && isdigit((int) buf[0])) {
+                        buf[read] = '\0';
+                        index = atoi(buf);
+                }
+        }
+
+        if (index < 0 || index > MAX_LOG_FILE_INDEX)
+                index = scan_log_files();
+
+        if (have_file) {
+                char num[12];
+                unsigned int written = 0;
+
+                modp_itoa10(index + 1, num);
+                memset(buf, ' ', LOG_INDEX_LEN);
+                memcpy(buf, num, MIN(strlen(num), LOG_INDEX_LEN));
+
+                f_lseek(g_logfile, 0);
+                f_write(g_logfile, buf, LOG_INDEX_LEN, &written);
+                f_close(g_logfile);
+        }
+
+        return index;
+}
+
+/**
+ * The slow path.  Probes every name from rc_0.log upward and takes the
+ * first free one.  Only used once the index space has run out.
+ */
+static enum writing_status probe_log_files(struct logging_status *ls)
+{
+        for (int i = 0; i < MAX_LOG_FILE_INDEX; i++) {
+                set_log_file_name(ls->name, i);
 
                 const FRESULT res = f_open(g_logfile, ls->name,
                                            FA_WRITE | FA_CREATE_NEW);
@@ -259,11 +386,197 @@ static enum writing_status open_new_log_file(struct logging_status *ls)
         return WRITING_INACTIVE;
 }
 
+TESTABLE_STATIC enum writing_status open_new_log_file(struct logging_status *ls)
+{
+        pr_debug(_RCP_BASE_FILE_ "Opening new log file\r\n");
+
+        int index = claim_log_index(false);
+        bool rescanned = false;
+
+        while (index < MAX_LOG_FILE_INDEX) {
+                set_log_file_name(ls->name, index);
+
+                const FRESULT res = f_open(g_logfile, ls->name,
+                                           FA_WRITE | FA_CREATE_NEW);
+                if (FR_OK == res)
+                        return WRITING_ACTIVE;
+
+                f_close(g_logfile);
+
+                if (FR_EXIST != res) {
+                        ls->name[0] = '\0';
+                        return WRITING_INACTIVE;
+                }
+
+                /*
+                 * The index is stale, likely because the card was used
+                 * elsewhere.  Scan once, then just walk forward.
+                 */
+                if (rescanned) {
+                        ++index;
+                } else {
+                        index = claim_log_index(true);
+                        rescanned = true;
+                }
+        }
+
+        return probe_log_files(ls);
+}
+
+#if LOG_PREALLOC_SIZE
+/**
+ * Keeps at least half of LOG_PREALLOC_SIZE allocated past the write
+ * position by growing the file a whole chunk at a time.  FatFs allocates
+ * clusters when f_lseek goes past the end of a file open for writing, so
+ * the FAT gets updated here in one go instead of on every f_write that
+ * crosses into a new cluster.  Clusters come from the free space scan in
+ * order, so on a card that isn't fragmented the region is contiguous.
+ * Relies on the log only ever being appended to.
+ */
+TESTABLE_STATIC FRESULT log_file_reserve(FIL *f)
+{
+        const DWORD pos = f_tell(f);
+
+        if (f_size(f) - pos >= LOG_PREALLOC_SIZE / 2)
+                return FR_OK;
+
+        const FRESULT res = f_lseek(f, pos + LOG_PREALLOC_SIZE);
+        const FRESULT back = f_lseek(f, pos);
+
+        if (FR_OK != res)
+                pr_debug_int_msg(_RCP_BASE_FILE_ "Prealloc failed: ", res);
+
+        return FR_OK != res ? res : back;
+}
+
+/**
+ * Gives back whatever was reserved past the last byte written.
+ */
+TESTABLE_STATIC FRESULT log_file_trim(FIL *f)
+{
+        return f_size(f) > f_tell(f) ? f_truncate(f) : FR_OK;
+}
+#endif
+
+/**
+ * The capture of rc_N.log goes in rc_N.can.
+ */
+static void set_capture_file_name(char *name, const char *log_name)
+{
+        strcpy(name, log_name);
+        char *ext = strrchr(name, '.');
+        if (ext)
+                strcpy(ext, ".can");
+}
+
+/**
+ * Opens the raw CAN capture file that goes with the log, if one is
+ * wanted, and gets the CAN task capturing.  Appends if the log file was
+ * reopened.
+ */
+static void open_capture_file(const struct logging_status *ls)
+{
+        if (g_capturing || !getWorkingLoggerConfig()->CanConfig.capture)
+                return;
+
+        if (!g_capfile) {
+                g_capfile = (FIL *) portMalloc(sizeof(FIL));
+                if (!g_capfile) {
+                        pr_error(LOG_PFX "capture file alloc err\r\n");
+                        return;
+                }
+                memset(g_capfile, 0, sizeof(FIL));
+        }
+
+        char name[FILENAME_LEN];
+        set_capture_file_name(name, ls->name);
+
+        FRESULT res = f_open(g_capfile, name, FA_WRITE | FA_OPEN_ALWAYS);
+        if (FR_OK != res) {
+                pr_warning_str_msg(LOG_PFX "Failed to open: ", name);
+                return;
+        }
+
+        res = f_lseek(g_capfile, f_size(g_capfile));
+        if (FR_OK == res && 0 == f_size(g_capfile)) {
+                uint8_t header[CAN_CAPTURE_HEADER_LEN];
+                unsigned int written = 0;
+                res = f_write(g_capfile, header, can_capture_header(header),
+                              &written);
+        }
+
+        if (FR_OK != res || !can_capture_start()) {
+                f_close(g_capfile);
+                return;
+        }
+
+        g_capturing = true;
+        pr_info_str_msg(LOG_PFX "Capturing CAN to ", name);
+}
+
+/**
+ * Writes out the buffers of frames the CAN task has filled.  A buffer
+ * that fails to write is dropped rather than holding up the capture.
+ */
+static int drain_can_capture(void)
+{
+        if (!g_capturing)
+                return 0;
+
+        int rc = 0;
+        const uint8_t *buf;
+        size_t len;
+
+        while ((buf = can_capture_peek(&len))) {
+                unsigned int written = 0;
+                const portTickType start = xTaskGetTickCount();
+                const FRESULT res = f_write(g_capfile, buf, len, &written);
+                note_stall(start);
+                can_capture_release();
+
+                if (FR_OK != res) {
+                        pr_debug_int_msg(LOG_PFX "capture write failed "
+                                         "with status: ", (int) res);
+                        rc = res;
+                }
+        }
+
+        return rc;
+}
+
+static void close_capture_file(void)
+{
+        if (!g_capturing)
+                return;
+
+        /* The CAN task hands over its last buffer once it sees the stop */
+        can_capture_stop();
+        for (int i = 0; can_capture_is_running() &&
+                     i < CAPTURE_STOP_WAIT_MS / CAPTURE_DRAIN_MS; ++i)
+                delayMs(CAPTURE_DRAIN_MS);
+
+        drain_can_capture();
+        f_close(g_capfile);
+        g_capturing = false;
+}
+
 static void close_log_file(struct logging_status *ls)
 {
         ls->writing_status = WRITING_INACTIVE;
+
+        /* Without the lock the card belongs to someone else */
+        if (!g_card_locked)
+                return;
+
+        close_capture_file();
+#if LOG_PREALLOC_SIZE
+        log_file_trim(g_logfile);
+#endif
         f_close(g_logfile);
         UnmountFS();
+
+        sdcard_unlock();
+        g_card_locked = false;
 }
 
 static void logging_led_toggle(void)
@@ -287,6 +600,15 @@ static void open_log_file(struct logging_status *ls)
                 return;
         }
 
+        /* A log download lets go of the card once logging is active */
+        if (!g_card_locked)
+                g_card_locked = sdcard_lock(CARD_LOCK_WAIT_MS);
+
+        if (!g_card_locked) {
+                pr_warning(_RCP_BASE_FILE_ "SD card busy\r\n");
+                return;
+        }
+
         const int rc = InitFS();
         if (0 != rc) {
                 pr_error_int_msg(_RCP_BASE_FILE_ "FS init error: ", rc);
@@ -304,6 +626,10 @@ static void open_log_file(struct logging_status *ls)
         }
 
         pr_info_str_msg(_RCP_BASE_FILE_ "Opened " , ls->name);
+#if LOG_PREALLOC_SIZE
+        log_file_reserve(g_logfile);
+#endif
+        open_capture_file(ls);
         ls->flush_tick = xTaskGetTickCount();
 	ls->last_sample_tick = 0;
 }
@@ -390,7 +716,9 @@ TESTABLE_STATIC int logging_sample(struct logging_status *ls,
                 if (WRITING_ACTIVE != ls->writing_status)
                         open_log_file(ls);
 
-                if (SD_CARD_NOT_PRESENT == ls->writing_status)
+                /* A busy card is not a write error; skip this sample */
+                if (SD_CARD_NOT_PRESENT == ls->writing_status ||
+                    !g_card_locked)
                         break;
 
                 /* Don't try to write if file isn't open */
@@ -427,7 +755,15 @@ TESTABLE_STATIC int flush_logfile(struct logging_status *ls)
                 return -2;
 
         pr_debug(_RCP_BASE_FILE_ "flush\r\n");
-        const int res = f_sync(g_logfile);
+        const portTickType start = xTaskGetTickCount();
+#if LOG_PREALLOC_SIZE
+        /* The sync is a FAT update anyway.  Top up the reserve here */
+        log_file_reserve(g_logfile);
+#endif
+        int res = f_sync(g_logfile);
+        if (g_capturing && FR_OK == res)
+                res = f_sync(g_capfile);
+        note_stall(start);
         if (0 != res)
                 pr_debug_int_msg(_RCP_BASE_FILE_ "flush err ", res);
 
@@ -452,6 +788,51 @@ static void update_logger_status(struct logging_status *ls)
     }
 }
 
+/*
+ * How long to wait for the next message.  Spooled samples and captured
+ * CAN frames are written out whenever the queue is quiet.
+ */
+static portTickType receive_timeout(void)
+{
+        if (log_spool_pending())
+                return 0;
+
+        return g_capturing ? msToTicks(CAPTURE_DRAIN_MS) : portMAX_DELAY;
+}
+
+/*
+ * Writes out the samples the logger spooled while our queue was full.
+ * They are all newer than anything that was in the queue.
+ */
+TESTABLE_STATIC int drain_log_spool(struct logging_status *ls)
+{
+        int rc = 0;
+        struct sample *s;
+
+        while ((s = log_spool_take())) {
+                LoggerMessage msg = create_logger_message(
+                        LoggerMessageType_Sample, s->ticks, s);
+                rc = logging_sample(ls, &msg);
+        }
+
+        return rc;
+}
+
+/*
+ * The spool is only needed again at the next log start, unless it holds
+ * the pre-trigger ring in the meantime.
+ */
+static void release_log_spool(void)
+{
+        const struct auto_logger_config *cfg =
+                &getWorkingLoggerConfig()->auto_logger_cfg;
+
+        if (logging_is_active() || (cfg->enabled && cfg->pre_trigger))
+                return;
+
+        log_spool_release();
+}
+
 static void fileWriterTask(void *params)
 {
         LoggerMessage msg;
@@ -461,14 +842,32 @@ static void fileWriterTask(void *params)
         while(1) {
                 int rc = -1;
 
-                /* Get a sample. */
+                /*
+                 * Get a sample.  The logger only spools once our queue
+                 * is full and keeps at it until the spool is empty, so
+                 * drain the spool as soon as the queue runs dry.
+                 */
                 const char status = receive_logger_message(g_LoggerMessage_queue,
-                                                           &msg, portMAX_DELAY);
+                                                           &msg, receive_timeout());
+
+                if (pdPASS != status && (log_spool_pending() || g_capturing)) {
+                        task_stats_begin(TASK_STATS_FILE_WRITER);
+                        const int spool_rc = drain_log_spool(&ls);
+                        error_led(drain_can_capture() || spool_rc);
+                        flush_logfile(&ls);
+                        update_logger_status(&ls);
+                        task_stats_end(TASK_STATS_FILE_WRITER);
+                        continue;
+                }
 
                 /* If we fail to receive for any reason, keep trying */
                 if (pdPASS != status)
                    continue;
 
+                task_stats_queue(TASK_STATS_FILE_WRITER,
+                                 uxQueueMessagesWaiting(g_LoggerMessage_queue) + 1);
+                task_stats_begin(TASK_STATS_FILE_WRITER);
+
                 switch (msg.type) {
                 case LoggerMessageType_Sample:
                         rc = logging_sample(&ls, &msg);
@@ -477,7 +876,10 @@ static void fileWriterTask(void *params)
                         rc = logging_start(&ls);
                         break;
                 case LoggerMessageType_Stop:
+                        /* Spooled samples belong to this session */
+                        drain_log_spool(&ls);
                         rc = logging_stop(&ls);
+                        release_log_spool();
                         break;
                 default:
                         pr_warning(_RCP_BASE_FILE_ "Unsupported message "
@@ -492,8 +894,10 @@ static void fileWriterTask(void *params)
                         pr_debug_int_msg(" failed with code ", rc);
                 }
 
+                drain_can_capture();
                 flush_logfile(&ls);
                 update_logger_status(&ls);
+                task_stats_end(TASK_STATS_FILE_WRITER);
         }
 }
 
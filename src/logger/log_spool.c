@@ -0,0 +1,357 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "channel_registry.h"
+#include "loggerConfig.h"
+#include "log_spool.h"
+#include "mem_mang.h"
+#include "printk.h"
+#include "ring_buffer.h"
+#include "sample_binary.h"
+#include "sample_frame.h"
+#include "semphr.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[log_spool] "
+
+struct record_header {
+        uint32_t ticks;
+        uint16_t len;
+};
+
+static struct {
+        xSemaphoreHandle mutex;
+        struct ring_buff *rb;
+        unsigned int version;
+        size_t records;
+        /* Records are a pre-trigger ring, not waiting for the writer */
+        bool preroll;
+        struct log_spool_stats stats;
+
+        /* Only used by the file writer */
+        struct sample decode;
+        unsigned int decode_version;
+        uint8_t *scratch;
+        size_t scratch_cap;
+} state;
+
+static void lock(void)
+{
+        xSemaphoreTake(state.mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+        xSemaphoreGive(state.mutex);
+}
+
+void log_spool_init(void)
+{
+        if (state.rb)
+                ring_buffer_destroy(state.rb);
+        free_sample_buffer(&state.decode);
+        portFree(state.scratch);
+
+        memset(&state, 0, sizeof(state));
+        state.mutex = xSemaphoreCreateMutex();
+}
+
+size_t log_spool_alloc(const size_t max_size)
+{
+        if (state.rb)
+                return state.stats.size;
+
+        size_t size = portGetFreeHeapSize() / 100 * LOG_SPOOL_HEAP_PCT;
+        if (size > max_size)
+                size = max_size;
+
+        if (size < LOG_SPOOL_MIN_SIZE) {
+                pr_warning_int_msg(LOG_PFX "Not enough RAM.  Free: ",
+                                   portGetFreeHeapSize());
+                return 0;
+        }
+
+        struct ring_buff *rb = ring_buffer_create(size);
+        if (!rb) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", size);
+                return 0;
+        }
+
+        lock();
+        state.rb = rb;
+        state.stats.size = size;
+        unlock();
+
+        pr_info_int_msg(LOG_PFX "Bytes: ", size);
+        return size;
+}
+
+void log_spool_release(void)
+{
+        lock();
+        struct ring_buff *rb = state.records ? NULL : state.rb;
+        if (rb) {
+                state.rb = NULL;
+                state.stats.size = 0;
+        }
+        unlock();
+
+        if (!rb)
+                return;
+
+        ring_buffer_destroy(rb);
+        free_sample_buffer(&state.decode);
+        portFree(state.scratch);
+        state.scratch = NULL;
+        state.scratch_cap = 0;
+
+        pr_info(LOG_PFX "Released\r\n");
+}
+
+void log_spool_reset_stats(void)
+{
+        lock();
+        const size_t size = state.stats.size;
+        memset(&state.stats, 0, sizeof(state.stats));
+        state.stats.size = size;
+        unlock();
+}
+
+/* Records of an old channel layout can't be decoded any more */
+static void check_version(void)
+{
+        const unsigned int version = channel_registry_version();
+        if (version == state.version)
+                return;
+
+        if (state.records && !state.preroll) {
+                pr_info_int_msg(LOG_PFX "Layout changed.  Dropped: ",
+                                state.records);
+                state.stats.dropped += state.records;
+        }
+
+        state.records = 0;
+        state.version = version;
+        ring_buffer_clear(state.rb);
+}
+
+bool log_spool_add(const struct sample *s)
+{
+        if (!state.rb)
+                return false;
+
+        struct sample_frame *f = sample_frame_acquire(s, NULL);
+        if (!f)
+                return false;
+
+        const struct record_header hdr = {
+                (uint32_t) s->ticks, (uint16_t) f->bin_length
+        };
+        const size_t len = sizeof(hdr) + f->bin_length;
+        bool added = false;
+
+        lock();
+        if (state.rb)
+                check_version();
+
+        /*
+         * Drop the new sample, not the oldest, so what reaches the file
+         * has a single gap, the same as a queue overflow.
+         */
+        if (state.rb && len <= ring_buffer_bytes_free(state.rb)) {
+                ring_buffer_write(state.rb, &hdr, sizeof(hdr));
+                ring_buffer_write(state.rb, f->bin, f->bin_length);
+                ++state.records;
+                ++state.stats.spooled;
+                added = true;
+
+                const size_t used = ring_buffer_bytes_used(state.rb);
+                if (used > state.stats.high_water)
+                        state.stats.high_water = used;
+                if (state.records > state.stats.high_water_records)
+                        state.stats.high_water_records = state.records;
+        } else {
+                ++state.stats.dropped;
+        }
+        unlock();
+
+        sample_frame_release(f);
+        return added;
+}
+
+/* Makes room by evicting the oldest records.  Called with the lock held */
+static bool evict_oldest(const size_t len, const uint32_t ticks,
+                         const uint32_t window_ticks)
+{
+        struct record_header hdr;
+
+        while (state.records) {
+                ring_buffer_peek(state.rb, &hdr, sizeof(hdr));
+                if (ticks - hdr.ticks <= window_ticks &&
+                    len <= ring_buffer_bytes_free(state.rb))
+                        return true;
+
+                ring_buffer_get(state.rb, NULL, sizeof(hdr) + hdr.len);
+                --state.records;
+        }
+
+        return len <= ring_buffer_bytes_free(state.rb);
+}
+
+bool log_spool_preroll(const struct sample *s, const uint32_t window_ticks)
+{
+        if (!state.rb)
+                return false;
+
+        /* Released, or the writer has yet to drain the last session */
+        bool live = true;
+        lock();
+        if (state.rb) {
+                check_version();
+                live = state.records && !state.preroll;
+        }
+        unlock();
+
+        if (live)
+                return false;
+
+        struct sample_frame *f = sample_frame_acquire(s, NULL);
+        if (!f)
+                return false;
+
+        const struct record_header hdr = {
+                (uint32_t) s->ticks, (uint16_t) f->bin_length
+        };
+        const size_t len = sizeof(hdr) + f->bin_length;
+        bool added = false;
+
+        lock();
+        state.preroll = true;
+        if (state.rb && evict_oldest(len, hdr.ticks, window_ticks)) {
+                ring_buffer_write(state.rb, &hdr, sizeof(hdr));
+                ring_buffer_write(state.rb, f->bin, f->bin_length);
+                ++state.records;
+                added = true;
+        }
+        unlock();
+
+        sample_frame_release(f);
+        return added;
+}
+
+void log_spool_end_preroll(void)
+{
+        if (!state.rb)
+                return;
+
+        lock();
+        if (state.preroll && state.records)
+                pr_info_int_msg(LOG_PFX "Pre-trigger records: ",
+                                state.records);
+        state.preroll = false;
+        unlock();
+}
+
+size_t log_spool_pending(void)
+{
+        return state.preroll ? 0 : state.records;
+}
+
+static bool reserve_scratch(const size_t len)
+{
+        if (len <= state.scratch_cap)
+                return true;
+
+        portFree(state.scratch);
+        state.scratch = portMalloc(len);
+        state.scratch_cap = state.scratch ? len : 0;
+        if (!state.scratch)
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", len);
+
+        return NULL != state.scratch;
+}
+
+/* Lays out the sample we decode into for the current config */
+static bool prepare_decode(const unsigned int version)
+{
+        if (state.decode.channel_samples && version == state.decode_version)
+                return true;
+
+        const size_t count = get_enabled_channel_count(getWorkingLoggerConfig());
+        if (!init_sample_buffer(&state.decode, count))
+                return false;
+
+        state.decode_version = version;
+        return true;
+}
+
+struct sample* log_spool_take(void)
+{
+        struct record_header hdr;
+
+        if (!state.rb)
+                return NULL;
+
+        while (true) {
+                lock();
+                if (state.rb)
+                        check_version();
+                if (!state.rb || state.preroll || 0 == state.records) {
+                        unlock();
+                        return NULL;
+                }
+
+                ring_buffer_get(state.rb, &hdr, sizeof(hdr));
+                const bool have_room = reserve_scratch(hdr.len) &&
+                        prepare_decode(state.version);
+                ring_buffer_get(state.rb, have_room ? state.scratch : NULL,
+                                hdr.len);
+                --state.records;
+                unlock();
+
+                if (have_room && sample_binary_read_values(&state.decode,
+                                                           state.scratch,
+                                                           hdr.len)) {
+                        state.decode.ticks = hdr.ticks;
+                        return &state.decode;
+                }
+
+                pr_warning(LOG_PFX "Dropping record\r\n");
+                lock();
+                ++state.stats.dropped;
+                unlock();
+        }
+}
+
+void log_spool_note_stall(const uint32_t ms)
+{
+        if (ms > state.stats.worst_stall_ms)
+                state.stats.worst_stall_ms = ms;
+}
+
+void log_spool_get_stats(struct log_spool_stats *stats)
+{
+        lock();
+        *stats = state.stats;
+        unlock();
+}
@@ -28,7 +28,9 @@
 #include "CAN.h"
 #include "cellular_api_status_keys.h"
 #include "channel_config.h"
+#include "connectivityTask.h"
 #include "constants.h"
+#include "can_capture.h"
 #include "can_channels.h"
 #include "OBD2.h"
 #include "cpu.h"
@@ -41,7 +43,9 @@
 #include "imu_device.h"
 #include "jsmn.h"
 #include "lap_stats.h"
+#include "lap_summary.h"
 #include "launch_control.h"
+#include "log_spool.h"
 #include "logger.h"
 #include "loggerApi.h"
 #include "loggerConfig.h"
@@ -56,10 +60,15 @@
 #include "mem_mang.h"
 #include "printk.h"
 #include "sampleRecord.h"
+#include "sample_arena.h"
+#include "sample_binary.h"
+#include "sample_frame.h"
+#include "sample_meta.h"
 #include "serial.h"
 #include "str_util.h"
 #include "task.h"
 #include "taskUtil.h"
+#include "task_stats.h"
 #include "timer.h"
 #include "tracks.h"
 #include "units.h"
@@ -68,6 +77,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if SDCARD_SUPPORT
+#include "log_files.h"
+#endif
+
 /* Max number of channels that can be specified in the setOBD2Cfg message */
 #define MAX_OBD2_MESSAGE_PIDS 4
 
@@ -134,6 +147,61 @@ int api_getVersion(struct Serial *serial, const jsmntok_t *json)
         return API_SUCCESS_NO_RETURN;
 }
 
+static void write_histogram(struct Serial *serial, const char *name,
+                            const struct task_stats_histogram *h,
+                            const bool more)
+{
+        json_arrayStart(serial, name);
+        for (size_t i = 0; i < TASK_STATS_BUCKETS; ++i)
+                json_arrayElementInt(serial, h->counts[i],
+                                     i + 1 < TASK_STATS_BUCKETS);
+        json_arrayEnd(serial, more);
+}
+
+int api_get_task_stats(struct Serial *serial, const jsmntok_t *json)
+{
+        static const uint32_t limits[] = TASK_STATS_BUCKET_LIMITS_US;
+
+        json_objStart(serial);
+        json_objStartString(serial, "taskStats");
+        json_uint(serial, "dur", task_stats_duration_ms(), 1);
+
+        json_arrayStart(serial, "buckets");
+        for (size_t i = 0; i < ARRAY_LEN(limits); ++i)
+                json_arrayElementInt(serial, limits[i],
+                                     i + 1 < ARRAY_LEN(limits));
+        json_arrayEnd(serial, 1);
+
+        json_objStartString(serial, "tasks");
+        for (size_t i = 0; i < TASK_STATS_COUNT; ++i) {
+                const struct task_stats *ts = task_stats_get(i);
+
+                json_objStartString(serial, task_stats_name(i));
+                json_uint(serial, "runs", ts->runs, 1);
+                json_uint(serial, "miss", ts->missed, 1);
+                json_uint(serial, "budget", ts->budget_us, 1);
+                json_uint(serial, "busy", (unsigned int) (ts->busy_us / 1000), 1);
+                json_uint(serial, "max", ts->run_max_us, 1);
+                json_uint(serial, "lateMax", ts->late_max_us, 1);
+                json_uint(serial, "qMax", ts->queue_max, 1);
+                write_histogram(serial, "run", &ts->run, 1);
+                write_histogram(serial, "late", &ts->late, 0);
+                json_objEnd(serial, i + 1 < TASK_STATS_COUNT);
+        }
+        json_objEnd(serial, 0);
+
+        json_objEnd(serial, 0);
+        json_objEnd(serial, 0);
+
+        return API_SUCCESS_NO_RETURN;
+}
+
+int api_reset_task_stats(struct Serial *serial, const jsmntok_t *json)
+{
+        task_stats_reset();
+        return API_SUCCESS;
+}
+
 int api_getCapabilities(struct Serial *serial, const jsmntok_t *json)
 {
         json_objStart(serial);
@@ -266,16 +334,78 @@ static void get_bt_status(struct Serial* serial, const bool more)
 #endif
 }
 
+static void get_telemetry_stream_status(struct Serial* serial, const bool more)
+{
+	size_t channels[CONNECTIVITY_CHANNELS];
+	size_t count = 0;
+
+	for (size_t i = 0; i < CONNECTIVITY_CHANNELS; ++i) {
+		if (connectivity_get_telemetry_rate(i))
+			channels[count++] = i;
+	}
+
+	json_objStartString(serial, "stream");
+	for (size_t i = 0; i < count; ++i) {
+		const struct telemetry_rate *tr =
+			connectivity_get_telemetry_rate(channels[i]);
+		struct telemetry_backlog *bl =
+			connectivity_get_backlog(channels[i]);
+
+		json_objStartString(serial, tr->name);
+		json_int(serial, "rate", telemetry_rate_hz(tr), 1);
+		json_int(serial, "maxRate", decodeSampleRate(tr->max_rate), 1);
+		json_uint(serial, "sent", tr->sent, 1);
+		json_uint(serial, "drops", tr->dropped, 1);
+		json_uint(serial, "lat", tr->latency_ms, 1);
+		json_uint(serial, "latMax", tr->latency_max_ms, !!bl);
+		if (bl) {
+			json_uint(serial, "bklg", telemetry_backlog_pending(bl), 1);
+			json_uint(serial, "bfill", bl->backfilled, 1);
+			json_uint(serial, "bklgDrops", bl->dropped, 0);
+		}
+		json_objEnd(serial, i + 1 < count);
+	}
+	json_objEnd(serial, more);
+}
+
 static void get_logging_status(struct Serial* serial, const bool more)
 {
 #if SDCARD_SUPPORT
+	struct log_spool_stats spool;
+	log_spool_get_stats(&spool);
+	struct can_capture_stats capture;
+	can_capture_get_stats(&capture);
+
 	json_objStartString(serial, "logging");
 	json_int(serial, "status", (int)logging_get_status(), 1);
-	json_int(serial, "dur", logging_active_time(), 0);
+	json_int(serial, "dur", logging_active_time(), 1);
+	json_uint(serial, "spool", spool.size, 1);
+	json_uint(serial, "spoolHw", spool.high_water, 1);
+	json_uint(serial, "spoolHwRec", spool.high_water_records, 1);
+	json_uint(serial, "spooled", spool.spooled, 1);
+	json_uint(serial, "spoolDrops", spool.dropped, 1);
+	json_uint(serial, "stall", spool.worst_stall_ms, 1);
+	json_uint(serial, "canCap", capture.frames, 1);
+	json_uint(serial, "canCapDrops", capture.dropped, 0);
 	json_objEnd(serial, 1);
 #endif
 }
 
+static void get_obd2_status(struct Serial* serial, const bool more)
+{
+	const size_t count = OBD2_get_channel_count();
+
+	json_objStartString(serial, "obd2");
+	json_bool(serial, "active", OBD2_is_active(), 1);
+	json_uint(serial, "rtt", OBD2_get_query_latency(), 1);
+	json_arrayStart(serial, "hz");
+	for (size_t i = 0; i < count; ++i)
+		json_arrayElementFloat(serial, OBD2_get_channel_rate(i), 1,
+				       i + 1 < count);
+	json_arrayEnd(serial, 0);
+	json_objEnd(serial, more);
+}
+
 int api_getStatus(struct Serial *serial, const jsmntok_t *json)
 {
 	json_objStart(serial);
@@ -300,7 +430,9 @@ int api_getStatus(struct Serial *serial, const jsmntok_t *json)
 
 	get_cellular_status(serial, true);
 	get_bt_status(serial, true);
+	get_telemetry_stream_status(serial, true);
 	get_logging_status(serial, true);
+	get_obd2_status(serial, true);
 
 	json_objStartString(serial, "track");
 	json_int(serial, "status", lapstats_get_track_status(), 1);
@@ -321,40 +453,6 @@ int api_getStatus(struct Serial *serial, const jsmntok_t *json)
 	return API_SUCCESS_NO_RETURN;
 }
 
-int api_sampleData(struct Serial *serial, const jsmntok_t *json)
-{
-    int sendMeta = 0;
-    if (json->type == JSMN_OBJECT && json->size == 2) {
-        const jsmntok_t * meta = json + 1;
-        const jsmntok_t * value = json + 2;
-
-        jsmn_trimData(meta);
-        jsmn_trimData(value);
-
-        if (STR_EQ("meta",meta->data)) {
-            sendMeta = atoi(value->data);
-        }
-    }
-
-    LoggerConfig *config = getWorkingLoggerConfig();
-    size_t channelCount = get_enabled_channel_count(config);
-
-    if (0 == channelCount)
-        return API_ERROR_SEVERE;
-
-    struct sample s;
-    memset(&s, 0, sizeof(struct sample));
-    const size_t size = init_sample_buffer(&s, channelCount);
-    if (!size)
-       return API_ERROR_SEVERE;
-
-    populate_sample_buffer(&s, 0);
-    api_send_sample_record(serial, &s, 0, sendMeta);
-
-    free_sample_buffer(&s);
-    return API_SUCCESS_NO_RETURN;
-}
-
 int api_heart_beat(struct Serial *serial, const jsmntok_t *json)
 {
     json_objStart(serial);
@@ -377,6 +475,13 @@ void api_sendLogEnd(struct Serial *serial)
     json_objEnd(serial, 0);
 }
 
+void api_send_lap_summary(struct Serial *serial)
+{
+        json_objStart(serial);
+        lap_summary_get_json(serial, false);
+        json_objEnd(serial, 0);
+}
+
 int api_log(struct Serial *serial, const jsmntok_t *json)
 {
     if (json->type == JSMN_PRIMITIVE && json->size == 0) {
@@ -409,121 +514,279 @@ static void json_channelConfig(struct Serial *serial, const ChannelConfig *cfg,
 }
 
 static void write_sample_meta(struct Serial *serial, const struct sample *sample,
-                              int sampleRateLimit, int more)
+                              const struct channel_mask *mask, int more)
 {
-        json_arrayStart(serial, "meta");
-        ChannelSample *channel_sample = sample->channel_samples;
-
-        for (size_t i = 0; i < sample->channel_count; ++i, ++channel_sample) {
-                if (0 < i)
-                        serial_write_c(serial, ',');
+        struct sample_meta *sm = sample_meta_acquire(sample, mask);
+        if (!sm) {
+                json_arrayStart(serial, "meta");
+                json_arrayEnd(serial, more);
+                return;
+        }
 
-                serial_write_c(serial, '{');
-                json_channelConfig(serial, channel_sample->cfg, 0);
-                serial_write_c(serial, '}');
+        /* No need to re-send what the client already has */
+        if (sample_meta_client_has(serial, sm->hash)) {
+                json_uint(serial, "mh", sm->hash, more);
+        } else {
+                sample_meta_write(serial, sm, more);
         }
 
-        json_arrayEnd(serial, more);
+        sample_meta_release(sm);
 }
 
-int api_getMeta(struct Serial *serial, const jsmntok_t *json)
+/*
+ * One off samples use the scratch buffer of the sample arena so that
+ * requests don't churn the heap.  Only if the arena has no room for the
+ * current config, say right after a change that added channels, do we
+ * fall back to a buffer of our own in tmp.
+ */
+static struct sample* acquire_temp_sample(struct sample *tmp,
+                                          const size_t channel_count)
 {
-    json_objStart(serial);
+        struct sample *s = sample_arena_acquire_scratch(channel_count);
+        if (s)
+                return s;
 
-    LoggerConfig * config = getWorkingLoggerConfig();
-    const size_t channelCount = get_enabled_channel_count(config);
+        memset(tmp, 0, sizeof(struct sample));
+        return init_sample_buffer(tmp, channel_count) ? tmp : NULL;
+}
 
-    if (0 == channelCount)
-        return API_ERROR_SEVERE;
+static void release_temp_sample(struct sample *s, struct sample *tmp)
+{
+        if (s == tmp)
+                free_sample_buffer(tmp);
+        else
+                sample_arena_release_scratch(s);
+}
 
-    struct sample s;
-    memset(&s, 0, sizeof(struct sample));
-    const size_t size = init_sample_buffer(&s, channelCount);
-    if (!size)
-       return API_ERROR_SEVERE;
+/**
+ * Gets the channel metadata for the current config.  Only builds a
+ * sample buffer to render it from if the cached copy is stale.
+ */
+static struct sample_meta* get_sample_meta(void)
+{
+        struct sample_meta *sm = sample_meta_acquire(NULL, NULL);
+        if (sm)
+                return sm;
+
+        LoggerConfig * config = getWorkingLoggerConfig();
+        const size_t channelCount = get_enabled_channel_count(config);
+        if (0 == channelCount)
+                return NULL;
+
+        struct sample tmp;
+        struct sample *s = acquire_temp_sample(&tmp, channelCount);
+        if (!s)
+                return NULL;
+
+        sm = sample_meta_acquire(s, NULL);
+        release_temp_sample(s, &tmp);
+        return sm;
+}
 
-    write_sample_meta(serial, &s, getConnectivitySampleRateLimit(), 0);
+int api_getMeta(struct Serial *serial, const jsmntok_t *json)
+{
+    struct sample_meta *sm = get_sample_meta();
+    if (!sm)
+        return API_ERROR_SEVERE;
 
-    free_sample_buffer(&s);
+    /*
+     * Clients that cache the metadata may send the hash of what they have
+     * as {"getMeta":{"mh":<hash>}}.  If it matches, only the hash is
+     * returned and the client is remembered as having it.
+     */
+    uint32_t client_hash;
+    const bool client_current = JSMN_OBJECT == json->type &&
+            jsmn_exists_set_val_uint32(json, "mh", &client_hash) &&
+            client_hash == sm->hash;
+
+    json_objStart(serial);
+    if (client_current) {
+        sample_meta_set_client_hash(serial, sm->hash);
+        json_uint(serial, "mh", sm->hash, 0);
+    } else {
+        sample_meta_write(serial, sm, 0);
+    }
     json_objEnd(serial, 0);
+
+    sample_meta_release(sm);
     return API_SUCCESS_NO_RETURN;
 }
 
 
-#define MAX_BITMAPS 10
-
-void api_send_sample_record(struct Serial *serial,
-                            const struct sample *sample,
-                            const unsigned int tick, const int sendMeta)
+static void write_sample_record(struct Serial *serial,
+                                const struct sample *sample,
+                                const struct sample_frame *frame,
+                                const struct channel_mask *mask,
+                                const unsigned int tick,
+                                const uint32_t *seq, const int sendMeta)
 {
         json_objStart(serial);
         json_objStartString(serial, "s");
         json_uint(serial,"t", tick, 1);
 
+        if (seq)
+                json_uint(serial, "q", *seq, 1);
+
         if (sendMeta)
-                write_sample_meta(serial, sample,
-                                  getConnectivitySampleRateLimit(), 1);
+                write_sample_meta(serial, sample, mask, 1);
 
-        size_t channelBitmaskIndex = 0;
-        unsigned int channelBitmask[MAX_BITMAPS];
-        memset(channelBitmask, 0, sizeof(channelBitmask));
+        json_arrayStart(serial, "d");
+        if (frame)
+                serial_write_buff(serial, frame->data, frame->length);
+        json_arrayEnd(serial, 0);
+        json_objEnd(serial, 0);
+        json_objEnd(serial, 0);
+}
+
+static void send_sample_record(struct Serial *serial,
+                               const struct sample *sample,
+                               const unsigned int tick, const uint32_t *seq,
+                               const int sendMeta,
+                               const struct channel_mask *mask)
+{
+        /*
+         * Every stream sending this sample with the same channels shares
+         * one rendering of it.
+         */
+        struct sample_frame *frame = sample_frame_acquire(sample, mask);
+
+        /*
+         * Binary clients still get the metadata as JSON since it is
+         * rarely sent and needs to be self describing.
+         */
+        if (frame && !sendMeta && sample_binary_client_enabled(serial)) {
+                sample_binary_write_layout(serial, sample, mask);
+                sample_binary_write_sample(serial, tick, frame->bin,
+                                           frame->bin_length);
+        } else {
+                write_sample_record(serial, sample, frame, mask, tick, seq,
+                                    sendMeta);
+                put_crlf(serial);
+        }
+
+        sample_frame_release(frame);
+}
 
+void api_send_sample_record(struct Serial *serial,
+                            const struct sample *sample,
+                            const unsigned int tick, const int sendMeta,
+                            const struct channel_mask *mask)
+{
+        send_sample_record(serial, sample, tick, NULL, sendMeta, mask);
+}
+
+void api_send_sequenced_sample_record(struct Serial *serial,
+                                      const struct sample *sample,
+                                      const unsigned int tick,
+                                      const uint32_t seq, const int sendMeta,
+                                      const struct channel_mask *mask)
+{
+        send_sample_record(serial, sample, tick, &seq, sendMeta, mask);
+}
+
+bool api_send_backfill_record(struct Serial *serial,
+                              const struct sample *layout,
+                              const struct channel_mask *mask,
+                              const unsigned int tick, const uint32_t seq,
+                              const uint8_t *body, const size_t len)
+{
+        json_objStart(serial);
+        json_objStartString(serial, "s");
+        json_uint(serial, "t", tick, 1);
+        json_uint(serial, "q", seq, 1);
+        json_int(serial, "bf", 1, 1);
         json_arrayStart(serial, "d");
-        ChannelSample *cs = sample->channel_samples;
+        const bool fits = sample_binary_write_json_values(serial, layout, mask,
+                                                          body, len);
+        json_arrayEnd(serial, 0);
+        json_objEnd(serial, 0);
+        json_objEnd(serial, 0);
+        put_crlf(serial);
 
-        size_t channelBitPosition = 0;
-        for (size_t i = 0; i < sample->channel_count;
-             i++, channelBitPosition++, cs++) {
+        return fits;
+}
 
-                if (channelBitPosition > 31) {
-                        channelBitmaskIndex++;
-                        channelBitPosition=0;
-                        if (channelBitmaskIndex > MAX_BITMAPS)
-                                break;
-                }
+bool api_send_sample_batch(struct Serial *serial,
+                           const struct sample *layout,
+                           const struct channel_mask *mask,
+                           const unsigned int tick, const uint32_t *seq,
+                           const int sendMeta, const uint8_t *bodies,
+                           const size_t len)
+{
+        bool fits = true;
 
-                if (cs->populated) {
-                        channelBitmask[channelBitmaskIndex] |=
-                                (1 << channelBitPosition);
-
-                        const int precision = cs->cfg->precision;
-                        switch(cs->sampleData) {
-                        case SampleData_Float:
-                        case SampleData_Float_Noarg:
-                                put_float(serial, cs->valueFloat, precision);
-                                break;
-                        case SampleData_Int:
-                        case SampleData_Int_Noarg:
-                                put_int(serial, cs->valueInt);
-                                break;
-                        case SampleData_LongLong:
-                        case SampleData_LongLong_Noarg:
-                                put_ll(serial, cs->valueLongLong);
-                                break;
-                        case SampleData_Double:
-                        case SampleData_Double_Noarg:
-                                put_double(serial, cs->valueDouble, precision);
-                                break;
-                        default:
-                                pr_warning_int_msg("[loggerApi] Unknown sample"
-                                                   " data type: ",
-                                                   cs->sampleData);
-                                break;
-                        }
-                        serial_write_c(serial, ',');
+        json_objStart(serial);
+        json_objStartString(serial, "sb");
+        json_uint(serial, "t", tick, 1);
+
+        if (seq)
+                json_uint(serial, "q", *seq, 1);
+
+        if (sendMeta)
+                write_sample_meta(serial, layout, mask, 1);
+
+        json_arrayStart(serial, "d");
+        for (size_t pos = 0; pos + 2 <= len;) {
+                const size_t body_len = bodies[pos] | bodies[pos + 1] << 8;
+                const uint8_t *body = bodies + pos + 2;
+                pos += 2 + body_len;
+                if (pos > len) {
+                        fits = false;
+                        break;
                 }
-        }
 
-        size_t channelBitmaskCount = channelBitmaskIndex + 1;
-        for (size_t i = 0; i < channelBitmaskCount; i++) {
-                put_uint(serial, channelBitmask[i]);
-                if (i < channelBitmaskCount - 1)
+                if (body != bodies + 2)
                         serial_write_c(serial, ',');
-        }
 
+                serial_write_c(serial, '[');
+                fits = sample_binary_write_json_values(serial, layout, mask,
+                                                       body, body_len) &&
+                        fits;
+                serial_write_c(serial, ']');
+        }
         json_arrayEnd(serial, 0);
         json_objEnd(serial, 0);
         json_objEnd(serial, 0);
+        put_crlf(serial);
+
+        return fits;
+}
+
+int api_sampleData(struct Serial *serial, const jsmntok_t *json)
+{
+    int sendMeta = 0;
+    if (json->type == JSMN_OBJECT && json->size == 2) {
+        const jsmntok_t * meta = json + 1;
+        const jsmntok_t * value = json + 2;
+
+        jsmn_trimData(meta);
+        jsmn_trimData(value);
+
+        if (STR_EQ("meta",meta->data)) {
+            sendMeta = atoi(value->data);
+        }
+    }
+
+    LoggerConfig *config = getWorkingLoggerConfig();
+    size_t channelCount = get_enabled_channel_count(config);
+
+    if (0 == channelCount)
+        return API_ERROR_SEVERE;
+
+    struct sample tmp;
+    struct sample *s = acquire_temp_sample(&tmp, channelCount);
+    if (!s)
+       return API_ERROR_SEVERE;
+
+    populate_sample_buffer(s, 0);
+
+    /* Not a logger sample buffer, so never share its rendering */
+    struct sample_frame *frame = sample_frame_create(s, NULL);
+    write_sample_record(serial, s, frame, NULL, 0, NULL, sendMeta);
+    sample_frame_release(frame);
+
+    release_temp_sample(s, &tmp);
+    return API_SUCCESS_NO_RETURN;
 }
 
 static const jsmntok_t * setChannelConfig(struct Serial *serial, const jsmntok_t *cfg,
@@ -856,7 +1119,24 @@ int api_setLogfileLevel(struct Serial *serial, const jsmntok_t *json)
     }
 }
 
-static void setCellConfig(const jsmntok_t *root)
+#if BLUETOOTH_SUPPORT || CELLULAR_SUPPORT
+/*
+ * The stream profile of a destination lives in a "prof" object within
+ * its config object.  Make sure we don't pick up the one of the
+ * destination that follows it.
+ */
+static bool set_stream_profile(const jsmntok_t *cfgNode,
+                               struct stream_profile_config *profile)
+{
+    const jsmntok_t *profNode = jsmn_find_node(cfgNode + 1, "prof");
+    if (!profNode || profNode->start > cfgNode->end)
+        return true;
+
+    return stream_profile_set_config(profile, profNode + 1);
+}
+#endif
+
+static bool setCellConfig(const jsmntok_t *root)
 {
     const jsmntok_t *cellCfgNode = jsmn_find_node(root, "cellCfg");
     if (cellCfgNode) {
@@ -869,10 +1149,14 @@ static void setCellConfig(const jsmntok_t *root)
 				   CELL_APN_USER_LENGTH, true);
         jsmn_exists_set_val_string(cellCfgNode, "apnPass", cellCfg->apnPass,
 				   CELL_APN_PASS_LENGTH, false);
+#if CELLULAR_SUPPORT
+        return set_stream_profile(cellCfgNode, &cellCfg->profile);
+#endif
     }
+    return true;
 }
 
-static void setBluetoothConfig(const jsmntok_t *root)
+static bool setBluetoothConfig(const jsmntok_t *root)
 {
     const jsmntok_t *btCfgNode = jsmn_find_node(root, "btCfg");
     if (btCfgNode != NULL) {
@@ -883,7 +1167,11 @@ static void setBluetoothConfig(const jsmntok_t *root)
 				   BT_DEVICE_NAME_LENGTH, true);
         jsmn_exists_set_val_string(btCfgNode, "pass", btCfg->new_pin,
 				   BT_PASSCODE_LENGTH, false);
+#if BLUETOOTH_SUPPORT
+        return set_stream_profile(btCfgNode, &btCfg->profile);
+#endif
     }
+    return true;
 }
 
 static void setTelemetryConfig(const jsmntok_t *root)
@@ -906,11 +1194,11 @@ static void setTelemetryConfig(const jsmntok_t *root)
 
 int api_setConnectivityConfig(struct Serial *serial, const jsmntok_t *json)
 {
-    setBluetoothConfig(json);
-    setCellConfig(json);
+    const bool btOk = setBluetoothConfig(json);
+    const bool cellOk = setCellConfig(json);
     setTelemetryConfig(json);
     configChanged();
-    return API_SUCCESS;
+    return btOk && cellOk ? API_SUCCESS : API_ERROR_PARAMETER;
 }
 
 int api_getConnectivityConfig(struct Serial *serial, const jsmntok_t *json)
@@ -923,14 +1211,24 @@ int api_getConnectivityConfig(struct Serial *serial, const jsmntok_t *json)
     json_int(serial, "btEn", cfg->bluetoothConfig.btEnabled, 1);
     /* Remove Name and Pass in next major API version change.  Issue #720 */
     json_string(serial, "name", "", 1);
+#if BLUETOOTH_SUPPORT
+    json_string(serial, "pass", "", 1);
+    stream_profile_get_config(&cfg->bluetoothConfig.profile, serial, false);
+#else
     json_string(serial, "pass", "", 0);
+#endif
     json_objEnd(serial, 1);
 
     json_objStartString(serial, "cellCfg");
     json_int(serial, "cellEn", cfg->cellularConfig.cellEnabled, 1);
     json_string(serial, "apnHost", cfg->cellularConfig.apnHost, 1);
     json_string(serial, "apnUser", cfg->cellularConfig.apnUser, 1);
+#if CELLULAR_SUPPORT
+    json_string(serial, "apnPass", cfg->cellularConfig.apnPass, 1);
+    stream_profile_get_config(&cfg->cellularConfig.profile, serial, false);
+#else
     json_string(serial, "apnPass", cfg->cellularConfig.apnPass, 0);
+#endif
     json_objEnd(serial, 1);
 
     json_objStartString(serial, "telCfg");
@@ -1284,6 +1582,8 @@ int api_getCanConfig(struct Serial *serial, const jsmntok_t *json)
     json_objStart(serial);
     json_objStartString(serial, "canCfg");
     json_int(serial, "en", canCfg->enabled, 1);
+    json_int(serial, "autoFilt", canCfg->auto_filter, 1);
+    json_int(serial, "cap", canCfg->capture, 1);
     json_arrayStart(serial, "baud");
     for (size_t i = 0; i < CONFIG_CAN_CHANNELS; i++) {
         json_arrayElementInt(serial, canCfg->baud[i], i < CONFIG_CAN_CHANNELS - 1);
@@ -1308,6 +1608,8 @@ int api_setCanConfig(struct Serial *serial, const jsmntok_t *json)
     LoggerConfig *lc = getWorkingLoggerConfig();
     CANConfig *canCfg = &lc->CanConfig;
     jsmn_exists_set_val_uint8( json, "en", &canCfg->enabled, NULL);
+    jsmn_exists_set_val_uint8(json, "autoFilt", &canCfg->auto_filter, NULL);
+    jsmn_exists_set_val_uint8(json, "cap", &canCfg->capture, NULL);
 
     {
             const jsmntok_t *tok = jsmn_find_node(json, "baud");
@@ -1336,6 +1638,8 @@ int api_setCanConfig(struct Serial *serial, const jsmntok_t *json)
     }
 #endif
     CAN_init(lc);
+    /* Re-initializing the ports clears the acceptance filters */
+    CAN_state_stale();
     return API_SUCCESS;
 }
 
@@ -1358,7 +1662,7 @@ static void json_put_can_mapping(struct Serial *serial, const CANMapping * mappi
 
 int api_get_can_channel_config(struct Serial *serial, const jsmntok_t *json)
 {
-    const CANChannelConfig * can_channel_cfg = &(getWorkingLoggerConfig()->can_channel_cfg);
+    const CANChannelConfig * can_channel_cfg = get_can_channel_config();
     json_objStart(serial);
     json_objStartString(serial, "canChanCfg");
     json_int(serial, "en", can_channel_cfg->enabled, 1);
@@ -1409,7 +1713,9 @@ static void set_can_mapping(const jsmntok_t *json_mapping, CANMapping *mapping)
 
 int api_set_can_channel_config(struct Serial *serial, const jsmntok_t *json)
 {
-    CANChannelConfig * can_channel_cfg = &(getWorkingLoggerConfig()->can_channel_cfg);
+    CANChannelConfig * can_channel_cfg = get_can_channel_config_rw();
+    if (!can_channel_cfg)
+            return API_ERROR_SEVERE;
 
     /* flag to indicate if this channel is the last in a series */
     bool last = false;
@@ -1461,14 +1767,14 @@ int api_getObd2Config(struct Serial *serial, const jsmntok_t *json)
     json_objStart(serial);
     json_objStartString(serial, "obd2Cfg");
 
-    OBD2Config *obd2Cfg = &(getWorkingLoggerConfig()->OBD2Configs);
+    const OBD2Config *obd2Cfg = get_obd2_config();
 
     int enabledPids = obd2Cfg->enabledPids;
     json_int(serial,"en", obd2Cfg->enabled, 1);
     json_arrayStart(serial, "pids");
 
     for (int i = 0; i < enabledPids; i++) {
-        PidConfig *pidCfg = &obd2Cfg->pids[i];
+        const PidConfig *pidCfg = &obd2Cfg->pids[i];
         json_objStart(serial);
         json_channelConfig(serial, &(pidCfg->mapping.channel_cfg), 1);
         json_put_can_mapping(serial, &(pidCfg->mapping), 1);
@@ -1486,7 +1792,9 @@ int api_getObd2Config(struct Serial *serial, const jsmntok_t *json)
 
 int api_setObd2Config(struct Serial *serial, const jsmntok_t *json)
 {
-    OBD2Config *obd2Cfg = &(getWorkingLoggerConfig()->OBD2Configs);
+    OBD2Config *obd2Cfg = get_obd2_config_rw();
+    if (!obd2Cfg)
+            return API_ERROR_SEVERE;
 
     /* flag to indicate if this channel is the last in a series */
     bool is_last = false;
@@ -1643,6 +1951,12 @@ int api_getLapConfig(struct Serial *serial, const jsmntok_t *json)
     return API_SUCCESS_NO_RETURN;
 }
 
+int api_get_lap_summary(struct Serial *serial, const jsmntok_t *json)
+{
+        api_send_lap_summary(serial);
+        return API_SUCCESS_NO_RETURN;
+}
+
 static void json_geoPointArray(struct Serial *serial, const char *name, const GeoPoint *point, int more)
 {
     json_arrayStart(serial, name);
@@ -2011,6 +2325,20 @@ int api_get_wifi_cfg(struct Serial *serial, const jsmntok_t *json)
 
 int api_set_telemetry(struct Serial *serial, const jsmntok_t *json)
 {
+        /*
+         * Clients that understand the binary sample format ask for it
+         * with "fmt".  Older firmware ignores the field and keeps
+         * streaming JSON, so clients should send it along with "rate".
+         */
+        int format;
+        if (jsmn_exists_set_val_int(json, "fmt", &format)) {
+                if (!sample_binary_set_client_format(serial, format))
+                        return API_ERROR_PARAMETER;
+
+                if (!jsmn_find_node(json, "rate"))
+                        return API_SUCCESS;
+        }
+
         int sample_rate = 0;
         jsmn_exists_set_val_int(json, "rate", &sample_rate);
 	void* data = (void*) (long) sample_rate;
@@ -2082,6 +2410,33 @@ int api_set_auto_logger_cfg(struct Serial *serial, const jsmntok_t *json)
         return auto_logger_set_config(cfg, json) ?
                 API_SUCCESS : API_ERROR_UNSPECIFIED;
 }
+
+int api_get_log_list(struct Serial *serial, const jsmntok_t *json)
+{
+        uint32_t start = 0;
+        uint32_t count = 0;
+
+        jsmn_exists_set_val_uint32(json, "start", &start);
+        jsmn_exists_set_val_uint32(json, "cnt", &count);
+
+        return log_files_list(serial, start, count);
+}
+
+int api_get_log_data(struct Serial *serial, const jsmntok_t *json)
+{
+        char name[LOG_FILES_NAME_LEN];
+        uint32_t offset = 0;
+        uint32_t len = 0;
+
+        if (!jsmn_exists_set_val_string(json, "nm", name, sizeof(name),
+                                        true))
+                return API_ERROR_PARAMETER;
+
+        jsmn_exists_set_val_uint32(json, "off", &offset);
+        jsmn_exists_set_val_uint32(json, "len", &len);
+
+        return log_files_read(serial, name, offset, len);
+}
 #endif
 
 #if CAMERA_CONTROL
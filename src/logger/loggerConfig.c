@@ -19,14 +19,21 @@
  * this code. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "FreeRTOS.h"
+#include "OBD2.h"
 #include "capabilities.h"
 #include "channel_config.h"
 #include "cpu.h"
+#include "can_channels.h"
 #include "loggerConfig.h"
+#include "loggerTaskEx.h"
+#include "mem_mang.h"
 #include "memory.h"
 #include "modp_numtoa.h"
 #include "printk.h"
 #include "str_util.h"
+#include "task.h"
+#include "taskUtil.h"
 #include "timer_config.h"
 #include "units.h"
 #include "virtual_channel.h"
@@ -38,12 +45,201 @@
 
 #ifndef RCP_TESTING
 static const volatile LoggerConfig g_savedLoggerConfig  __attribute__((section(".config\n\t#")));
+static const volatile LoggerConfigOverlay g_savedOverlay  __attribute__((section(".channels\n\t#")));
 #else
 static LoggerConfig g_savedLoggerConfig;
+static LoggerConfigOverlay g_savedOverlay;
 #endif
 
 static LoggerConfig g_workingLoggerConfig;
 
+/* How long flashing waits for the readers to let go of the image */
+#define OVERLAY_SYNC_POLL_MS	10
+#define OVERLAY_SYNC_TIMEOUT_MS	1000
+
+/*
+ * The overlay is read from flash until it is changed.  The first change
+ * copies it to RAM, which is what the accessors hand out until the copy
+ * is flashed.  The copy is then retired and freed once every reader has
+ * synced back to flash.  Each change of copy bumps the generation; a
+ * reader that has synced holds generation + 1 so that 0 means idle.
+ */
+static struct {
+        LoggerConfigOverlay *ram;
+        LoggerConfigOverlay *retired;
+        uint32_t generation;
+        uint32_t synced[LOGGER_CONFIG_READERS];
+} overlay;
+
+static const LoggerConfigOverlay* overlay_read(void)
+{
+        return overlay.ram ? overlay.ram :
+                (const LoggerConfigOverlay *) &g_savedOverlay;
+}
+
+static LoggerConfigOverlay* overlay_write(void)
+{
+        if (overlay.ram)
+                return overlay.ram;
+
+        /* A retired copy still matches flash */
+        taskENTER_CRITICAL();
+        LoggerConfigOverlay *ram = overlay.retired;
+        overlay.retired = NULL;
+        taskEXIT_CRITICAL();
+
+        if (!ram) {
+                ram = portMalloc(sizeof(LoggerConfigOverlay));
+                if (!ram) {
+                        pr_error_int_msg(_LOG_PFX "Failed to allocate bytes: ",
+                                         sizeof(LoggerConfigOverlay));
+                        return NULL;
+                }
+                memcpy(ram, (const void *) &g_savedOverlay,
+                       sizeof(LoggerConfigOverlay));
+        }
+
+        taskENTER_CRITICAL();
+        overlay.ram = ram;
+        ++overlay.generation;
+        taskEXIT_CRITICAL();
+
+        return ram;
+}
+
+/* Call with interrupts off */
+static bool overlay_readers_synced(void)
+{
+        for (size_t i = 0; i < LOGGER_CONFIG_READERS; ++i) {
+                const uint32_t synced = overlay.synced[i];
+                if (synced && synced != overlay.generation + 1)
+                        return false;
+        }
+
+        return true;
+}
+
+/* Frees the retired copy once no reader can be using it */
+static void overlay_collect(void)
+{
+        LoggerConfigOverlay *unused = NULL;
+
+        taskENTER_CRITICAL();
+        if (overlay_readers_synced()) {
+                unused = overlay.retired;
+                overlay.retired = NULL;
+        }
+        taskEXIT_CRITICAL();
+
+        portFree(unused);
+}
+
+void logger_config_overlay_sync(const enum logger_config_reader reader)
+{
+        taskENTER_CRITICAL();
+        overlay.synced[reader] = overlay.generation + 1;
+        taskEXIT_CRITICAL();
+
+        overlay_collect();
+}
+
+static void overlay_readers_stale(void)
+{
+        configChanged();
+        CAN_state_stale();
+        OBD2_state_stale();
+}
+
+static bool overlay_wait_for_readers(void)
+{
+        for (size_t ms = 0; ms < OVERLAY_SYNC_TIMEOUT_MS;
+             ms += OVERLAY_SYNC_POLL_MS) {
+                taskENTER_CRITICAL();
+                const bool synced = overlay_readers_synced();
+                taskEXIT_CRITICAL();
+                if (synced)
+                        return true;
+
+                overlay_readers_stale();
+                delayMs(OVERLAY_SYNC_POLL_MS);
+        }
+
+        pr_error(_LOG_PFX "Overlay readers did not sync\r\n");
+        return false;
+}
+
+/*
+ * Sends the readers back to the flash image.  The RAM copy goes once
+ * they are all off it.
+ */
+static void overlay_retire(void)
+{
+        taskENTER_CRITICAL();
+        overlay.retired = overlay.ram;
+        overlay.ram = NULL;
+        ++overlay.generation;
+        taskEXIT_CRITICAL();
+
+        overlay_collect();
+        if (overlay.retired)
+                overlay_readers_stale();
+}
+
+/*
+ * Only flashes the overlay if it has changed.  Readers must be off the
+ * flash image before it is erased.  Afterwards the RAM copy is retired
+ * and the readers are sent back to flash so that it can be freed.
+ */
+static int flash_overlay(void)
+{
+        if (!overlay.ram)
+                return MEMORY_FLASH_SUCCESS;
+
+        if (!overlay_wait_for_readers())
+                return MEMORY_FLASH_WRITE_ERROR;
+
+        const int rc = memory_flash_region((void *) &g_savedOverlay,
+                                           overlay.ram,
+                                           sizeof(LoggerConfigOverlay));
+        if (rc)
+                return rc;
+
+        overlay_retire();
+        return rc;
+}
+
+size_t logger_config_overlay_size(void)
+{
+        taskENTER_CRITICAL();
+        const size_t size = (overlay.ram ? sizeof(LoggerConfigOverlay) : 0) +
+                (overlay.retired ? sizeof(LoggerConfigOverlay) : 0);
+        taskEXIT_CRITICAL();
+
+        return size;
+}
+
+const CANChannelConfig* get_can_channel_config(void)
+{
+        return &overlay_read()->can_channel_cfg;
+}
+
+CANChannelConfig* get_can_channel_config_rw(void)
+{
+        LoggerConfigOverlay *lco = overlay_write();
+        return lco ? &lco->can_channel_cfg : NULL;
+}
+
+const OBD2Config* get_obd2_config(void)
+{
+        return &overlay_read()->OBD2Configs;
+}
+
+OBD2Config* get_obd2_config_rw(void)
+{
+        LoggerConfigOverlay *lco = overlay_write();
+        return lco ? &lco->OBD2Configs : NULL;
+}
+
 static void resetVersionInfo(VersionInfo *vi)
 {
     vi->major = MAJOR_REV;
@@ -198,6 +394,8 @@ static void resetCanConfig(CANConfig *cfg)
         cfg->termination[i] = true;
 #endif
     }
+    cfg->auto_filter = false;
+    cfg->capture = false;
 }
 
 uint8_t filter_can_bus_channel(uint8_t value)
@@ -279,6 +477,9 @@ static void resetBluetoothConfig(BluetoothConfig *cfg)
 {
         memset(cfg, 0, sizeof(BluetoothConfig));
         cfg->btEnabled = DEFAULT_BT_ENABLED;
+#if BLUETOOTH_SUPPORT
+        stream_profile_reset_config(&cfg->profile);
+#endif
 }
 
 static void resetCellularConfig(CellularConfig *cfg)
@@ -288,6 +489,9 @@ static void resetCellularConfig(CellularConfig *cfg)
     strcpy(cfg->apnHost, DEFAULT_APN_HOST);
     strcpy(cfg->dns1, DEFAULT_DNS1);
     strcpy(cfg->dns2, DEFAULT_DNS2);
+#if CELLULAR_SUPPORT
+    stream_profile_reset_config(&cfg->profile);
+#endif
 }
 
 static void resetTelemetryConfig(TelemetryConfig *cfg)
@@ -332,9 +536,28 @@ int getHigherSampleRate(const int a, const int b)
 
 int getConnectivitySampleRateLimit()
 {
+    int sampleRateLimit = SAMPLE_DISABLED;
+#if BLUETOOTH_SUPPORT || CELLULAR_SUPPORT
     ConnectivityConfig *connConfig = &getWorkingLoggerConfig()->ConnectivityConfigs;
-    int sampleRateLimit = connConfig->cellularConfig.cellEnabled ? SLOW_LINK_MAX_TELEMETRY_SAMPLE_RATE : FAST_LINK_MAX_TELEMETRY_SAMPLE_RATE;
-    return sampleRateLimit;
+#endif
+
+    /* Feed the fastest destination.  Slower ones skip samples */
+#if BLUETOOTH_SUPPORT
+    if (connConfig->bluetoothConfig.btEnabled)
+        sampleRateLimit = getHigherSampleRate(sampleRateLimit,
+            stream_profile_sample_rate(&connConfig->bluetoothConfig.profile,
+                                       FAST_LINK_MAX_TELEMETRY_SAMPLE_RATE));
+#endif
+
+#if CELLULAR_SUPPORT
+    if (connConfig->cellularConfig.cellEnabled)
+        sampleRateLimit = getHigherSampleRate(sampleRateLimit,
+            stream_profile_sample_rate(&connConfig->cellularConfig.profile,
+                                       SLOW_LINK_MAX_TELEMETRY_SAMPLE_RATE));
+#endif
+
+    return SAMPLE_DISABLED == sampleRateLimit ?
+        FAST_LINK_MAX_TELEMETRY_SAMPLE_RATE : sampleRateLimit;
 }
 
 /* Filter sample rates to only allow rates we support */
@@ -527,20 +750,20 @@ unsigned int getHighestSampleRate(LoggerConfig *config)
 #endif
 
     {
-            OBD2Config *obd2_config = &(config->OBD2Configs);
+            const OBD2Config *obd2_config = get_obd2_config();
             const size_t enabled_channels = obd2_config->enabledPids;
             bool enabled = obd2_config->enabled;
             for (size_t i = 0; i < enabled_channels && enabled; i++) {
-					sr = config->OBD2Configs.pids[i].mapping.channel_cfg.sampleRate;
+					sr = obd2_config->pids[i].mapping.channel_cfg.sampleRate;
 					s = getHigherSampleRate(sr, s);
             }
     }
     {
-            CANChannelConfig *ccc = &(config->can_channel_cfg);
+            const CANChannelConfig *ccc = get_can_channel_config();
             const size_t enabled_can_channels = ccc->enabled_mappings;
             bool enabled = ccc->enabled;
             for (size_t i = 0; i < enabled_can_channels && enabled; i++) {
-					sr = config->can_channel_cfg.can_channels[i].mapping.channel_cfg.sampleRate;
+					sr = ccc->can_channels[i].mapping.channel_cfg.sampleRate;
 					s = getHigherSampleRate(sr, s);
             }
     }
@@ -639,16 +862,16 @@ size_t get_enabled_channel_count(LoggerConfig *loggerConfig)
 #endif
 
     {
-            OBD2Config *obd2_config = &(loggerConfig->OBD2Configs);
+            const OBD2Config *obd2_config = get_obd2_config();
             const size_t enabled_channels = obd2_config->enabledPids;
             bool enabled = obd2_config->enabled;
             for (size_t i=0; i < enabled_channels && enabled; i++) {
-                if (loggerConfig->OBD2Configs.pids[i].mapping.channel_cfg.sampleRate != SAMPLE_DISABLED)
+                if (obd2_config->pids[i].mapping.channel_cfg.sampleRate != SAMPLE_DISABLED)
                     ++channels;
             }
     }
     {
-            CANChannelConfig *ccc = &(loggerConfig->can_channel_cfg);
+            const CANChannelConfig *ccc = get_can_channel_config();
             const size_t enabled_can_channels = ccc->enabled_mappings;
             for (size_t i=0; i < enabled_can_channels && ccc->enabled; i++) {
                 if (ccc->can_channels[i].mapping.channel_cfg.sampleRate != SAMPLE_DISABLED)
@@ -684,9 +907,9 @@ size_t get_enabled_channel_count(LoggerConfig *loggerConfig)
     return channels;
 }
 
-void reset_logger_config(void)
+bool reset_logger_config(void)
 {
-    LoggerConfig *lc = &g_workingLoggerConfig;
+    LoggerConfig *lc = getWorkingLoggerConfig();
 
     lc->config_size = sizeof(LoggerConfig);
 
@@ -718,8 +941,14 @@ void reset_logger_config(void)
 #endif
 
     resetCanConfig(&lc->CanConfig);
-    _reset_can_mapping_config(&lc->can_channel_cfg);
-    resetOBD2Config(&lc->OBD2Configs);
+
+    LoggerConfigOverlay *lco = overlay_write();
+    if (lco) {
+        lco->config_size = sizeof(LoggerConfigOverlay);
+        resetVersionInfo(&lco->RcpVersionInfo);
+        _reset_can_mapping_config(&lco->can_channel_cfg);
+        resetOBD2Config(&lco->OBD2Configs);
+    }
 
     logger_config_reset_gps_config(&lc->GPSConfigs);
 
@@ -735,22 +964,40 @@ void reset_logger_config(void)
 #if CAMERA_CONTROL
     camera_control_reset_config(&lc->camera_control_cfg);
 #endif
-    strcpy(lc->padding_data, "");
+
+    return NULL != lco;
 }
 
 int flash_default_logger_config(void)
 {
-    reset_logger_config();
+    const bool reset = reset_logger_config();
     int result = flashLoggerConfig();
+
+    /* The overlay kept its old content; it is not a default config */
+    if (!reset && MEMORY_FLASH_SUCCESS == result)
+        result = MEMORY_FLASH_WRITE_ERROR;
+
     pr_info_str_msg("flashing default config: ", result == 0 ? "win" : "fail");
     return result;
 }
 
+/**
+ * The core and the overlay have flash sectors of their own.  Each is
+ * only rewritten if it has changed, straight from its working copy.
+ */
 int flashLoggerConfig(void)
 {
-    return memory_flash_region((void *) &g_savedLoggerConfig,
-                               (void *) &g_workingLoggerConfig,
-                               sizeof (LoggerConfig));
+    int rc = MEMORY_FLASH_SUCCESS;
+
+    if (memcmp((void *) &g_workingLoggerConfig, (void *) &g_savedLoggerConfig,
+               sizeof(LoggerConfig)))
+        rc = memory_flash_region((void *) &g_savedLoggerConfig,
+                                 (void *) &g_workingLoggerConfig,
+                                 sizeof (LoggerConfig));
+    if (rc)
+        return rc;
+
+    return flash_overlay();
 }
 
 
@@ -761,13 +1008,19 @@ static bool _config_size_changed(void) {
         changed = true;
         pr_warning(_LOG_PFX "size of LoggerConfig changed\r\n");
     }
+    if (g_savedOverlay.config_size != sizeof(LoggerConfigOverlay)) {
+        changed = true;
+        pr_warning(_LOG_PFX "size of LoggerConfigOverlay changed\r\n");
+    }
     return changed;
 }
 
 static bool checkFlashDefaultConfig(void)
 {
         const VersionInfo sv = g_savedLoggerConfig.RcpVersionInfo;
-        bool changed = version_check_changed(&sv) || _config_size_changed();
+        const VersionInfo ov = g_savedOverlay.RcpVersionInfo;
+        bool changed = version_check_changed(&sv) ||
+                version_check_changed(&ov) || _config_size_changed();
         if (!changed)
                 return false;
 
@@ -780,11 +1033,19 @@ static void loadWorkingLoggerConfig(void)
     memcpy((void *) &g_workingLoggerConfig,
            (void *) &g_savedLoggerConfig, sizeof(LoggerConfig));
 
+    /* Changes to the overlay that were never flashed are dropped too */
+    if (overlay.ram)
+        overlay_retire();
+
     pr_info_int_msg("sizeof LoggerConfig: ", sizeof(LoggerConfig));
+    pr_info_int_msg("sizeof LoggerConfigOverlay: ",
+                    sizeof(LoggerConfigOverlay));
 }
 
 void initialize_logger_config()
 {
+    /* No reader task has started yet; they sync once they do */
+    memset(overlay.synced, 0, sizeof(overlay.synced));
     checkFlashDefaultConfig();
     loadWorkingLoggerConfig();
 }
@@ -794,6 +1055,11 @@ const LoggerConfig * getSavedLoggerConfig()
     return (LoggerConfig *) &g_savedLoggerConfig;
 }
 
+const LoggerConfigOverlay * getSavedLoggerConfigOverlay()
+{
+    return (LoggerConfigOverlay *) &g_savedOverlay;
+}
+
 LoggerConfig * getWorkingLoggerConfig()
 {
     return &g_workingLoggerConfig;
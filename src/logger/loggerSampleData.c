@@ -55,7 +55,7 @@ struct sample_cb_registry {
 } sample_cb_registry[SAMPLE_CB_REGISTRY_SIZE] = {0};
 
 static ChannelSample* processChannelSampleWithFloatGetter(ChannelSample *s,
-        ChannelConfig *cfg,
+        const ChannelConfig *cfg,
         const size_t index,
         float (*getter)(int))
 {
@@ -72,7 +72,7 @@ static ChannelSample* processChannelSampleWithFloatGetter(ChannelSample *s,
 
 #if GPIO_CHANNELS > 1
 static ChannelSample* processChannelSampleWithIntGetter(ChannelSample *s,
-        ChannelConfig *cfg,
+        const ChannelConfig *cfg,
         const size_t index,
         int (*getter)(int))
 {
@@ -89,7 +89,7 @@ static ChannelSample* processChannelSampleWithIntGetter(ChannelSample *s,
 #endif
 
 static ChannelSample* processChannelSampleWithFloatGetterNoarg(ChannelSample *s,
-        ChannelConfig *cfg,
+        const ChannelConfig *cfg,
         float (*getter)())
 {
     if (cfg->sampleRate == SAMPLE_DISABLED )
@@ -103,7 +103,7 @@ static ChannelSample* processChannelSampleWithFloatGetterNoarg(ChannelSample *s,
 }
 
 static ChannelSample* processChannelSampleWithIntGetterNoarg(ChannelSample *s,
-        ChannelConfig *cfg,
+        const ChannelConfig *cfg,
         int (*getter)())
 {
     if (cfg->sampleRate == SAMPLE_DISABLED )
@@ -117,7 +117,7 @@ static ChannelSample* processChannelSampleWithIntGetterNoarg(ChannelSample *s,
 }
 
 static ChannelSample* processChannelSampleWithLongLongGetterNoarg(ChannelSample *s,
-        ChannelConfig *cfg,
+        const ChannelConfig *cfg,
         long long (*getter)())
 {
     if (cfg->sampleRate == SAMPLE_DISABLED )
@@ -245,7 +245,7 @@ void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
 {
         buff->ticks = 0;
         ChannelSample *sample = buff->channel_samples;
-        ChannelConfig *chanCfg;
+        const ChannelConfig *chanCfg;
 
     /*
      * This sets up immutable channels.  These channels are channels that are always
@@ -254,13 +254,13 @@ void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
      * clock.
      */
     struct TimeConfig *tc = &(loggerConfig->TimeConfigs[0]);
+    tc->cfg.flags = ALWAYS_SAMPLED; // Set always sampled flag here so we always take samples
     chanCfg = &(tc->cfg);
-    chanCfg->flags = ALWAYS_SAMPLED; // Set always sampled flag here so we always take samples
     sample = processChannelSampleWithIntGetterNoarg(sample, chanCfg, getUptimeAsInt);
 
     tc = &(loggerConfig->TimeConfigs[1]);
+    tc->cfg.flags = ALWAYS_SAMPLED; // Set always sampled flag here so we always take samples
     chanCfg = &(tc->cfg);
-    chanCfg->flags = ALWAYS_SAMPLED; // Set always sampled flag here so we always take samples
     sample = processChannelSampleWithLongLongGetterNoarg(sample, chanCfg, getMillisSinceEpochAsLongLong);
 
 #if ANALOG_CHANNELS > 0
@@ -303,15 +303,15 @@ void init_channel_sample_buffer(LoggerConfig *loggerConfig, struct sample *buff)
     }
 #endif
 
-    OBD2Config *obd2Config = &(loggerConfig->OBD2Configs);
-    const unsigned char enabled = loggerConfig->OBD2Configs.enabled;
+    const OBD2Config *obd2Config = get_obd2_config();
+    const unsigned char enabled = obd2Config->enabled;
     for (size_t i = 0; i < obd2Config->enabledPids && enabled; i++) {
         chanCfg = &(obd2Config->pids[i].mapping.channel_cfg);
         sample = processChannelSampleWithFloatGetter(sample, chanCfg, i,
                                                    OBD2_get_current_channel_value);
     }
 
-    CANChannelConfig *ccc = &(loggerConfig->can_channel_cfg);
+    const CANChannelConfig *ccc = get_can_channel_config();
     for (size_t i = 0; i < ccc->enabled_mappings && ccc->enabled; i++) {
             chanCfg = &(ccc->can_channels[i].mapping.channel_cfg);
             sample = processChannelSampleWithFloatGetter(sample, chanCfg, i,
@@ -22,11 +22,14 @@
 #include "FreeRTOS.h"
 #include "led.h"
 #include "capabilities.h"
+#include "channel_registry.h"
 #include "connectivityTask.h"
 #include "fileWriter.h"
 #include "gps.h"
 #include "imu.h"
 #include "lap_stats.h"
+#include "lap_summary.h"
+#include "log_spool.h"
 #include "logger.h"
 #include "loggerConfig.h"
 #include "loggerData.h"
@@ -38,10 +41,12 @@
 #include "panic.h"
 #include "printk.h"
 #include "sampleRecord.h"
+#include "sample_arena.h"
 #include "semphr.h"
 #include "serial.h"
 #include "task.h"
 #include "taskUtil.h"
+#include "task_stats.h"
 #include "watchdog.h"
 #include "camera_control.h"
 
@@ -57,9 +62,6 @@ struct sample * current_sample = NULL;
 
 xSemaphoreHandle onTick;
 
-/* This should be 0'd out accroding to C standards */
-static struct sample g_sample_buffer[LOGGER_MESSAGE_BUFFER_SIZE] = {0};
-
 struct sample * get_current_sample(void)
 {
 		return current_sample;
@@ -80,8 +82,10 @@ static LoggerMessage getLogStopMessage()
  */
 void vApplicationTickHook(void)
 {
-    if (onTick)
+    if (onTick) {
+        task_stats_due(TASK_STATS_LOGGER);
         xSemaphoreGiveFromISR(onTick, pdFALSE);
+    }
 }
 
 void configChanged()
@@ -101,6 +105,12 @@ void stopLogging()
 
 static void logging_started()
 {
+    /* Each session gets its own timing stats */
+    task_stats_reset();
+#if SDCARD_SUPPORT
+    log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+    log_spool_reset_stats();
+#endif
     logging_set_logging_start(getUptimeAsInt());
     led_disable(LED_LOGGER);
     pr_info("Logging started\r\n");
@@ -113,6 +123,31 @@ static void logging_stopped()
     pr_info("Logging stopped\r\n");
 }
 
+#if SDCARD_SUPPORT
+static void queue_log_sample(const LoggerMessage *msg)
+{
+        /*
+         * Spooled samples are newer than anything in the queue, so once
+         * we spool we keep at it until the file writer has drained it.
+         */
+        if (0 == log_spool_pending() && pdTRUE == queue_logfile_record(msg))
+                return;
+
+        if (!log_spool_add(msg->sample))
+                logging_set_status(LOGGING_STATUS_OVERFLOW);
+}
+
+/* Keeps the lead up to an auto start so the log doesn't miss it */
+static void preroll_log_sample(const struct auto_logger_config *cfg,
+                               const struct sample *s)
+{
+        if (!cfg->enabled || !cfg->pre_trigger)
+                return;
+
+        log_spool_preroll(s, cfg->pre_trigger * TICK_RATE_HZ);
+}
+#endif
+
 void startLoggerTaskEx(int priority)
 {
         /* Make all task names 16 chars including NULL char */
@@ -127,21 +162,22 @@ void startLoggerTaskEx(int priority)
 static int init_sample_ring_buffer(LoggerConfig *loggerConfig)
 {
         const size_t channel_count = get_enabled_channel_count(loggerConfig);
-        struct sample *s = g_sample_buffer;
-        const struct sample * const end = s + LOGGER_MESSAGE_BUFFER_SIZE;
-        int i;
-
-        for (i = 0; s < end; ++s, ++i) {
-                const size_t bytes = init_sample_buffer(s, channel_count);
-                if (0 == bytes) {
-                        /* If here, then can't alloc memory for buffers */
-                        pr_error("Failed to allocate memory for sample buffers\r\n");
-                        break;
-                }
-        }
 
-        pr_debug_int_msg("Sample buffers allocated: ", i);
-        return i;
+        /*
+         * Anything rendered from the old layout, like a telemetry batch,
+         * must see the change before the ring is cleared under it.
+         */
+        channel_registry_build(NULL);
+        const size_t depth = sample_arena_layout(channel_count,
+                                                 LOGGER_MESSAGE_BUFFER_SIZE);
+
+        pr_debug_int_msg("Sample buffers allocated: ", depth);
+
+        /* All buffers share the same layout.  Index it once for all */
+        if (depth)
+                channel_registry_build(sample_arena_get(0));
+
+        return depth;
 }
 
 static int calcTelemetrySampleRate(LoggerConfig *config, int desiredSampleRate)
@@ -178,6 +214,8 @@ void loggerTaskEx(void *params)
         int telemetrySampleRate = SAMPLE_DISABLED;
 
         g_loggingShouldRun = 0;
+        task_stats_reset();
+        task_stats_set_budget(TASK_STATS_LOGGER, 1000000 / TICK_RATE_HZ);
         vSemaphoreCreateBinary(onTick);
         logging_set_status(LOGGING_STATUS_IDLE);
         logging_set_logging_start(0);
@@ -193,9 +231,12 @@ void loggerTaskEx(void *params)
 
         while (1) {
                 xSemaphoreTake(onTick, portMAX_DELAY);
+                task_stats_begin(TASK_STATS_LOGGER);
                 ++currentTicks;
 
                 if (g_configChanged) {
+                        /* The samples point into the CAN and OBD2 config */
+                        logger_config_overlay_sync(LOGGER_CONFIG_READER_LOGGER);
                         buffer_size = init_sample_ring_buffer(loggerConfig);
                         if (!buffer_size) {
                                 pr_error("Failed to allocate any buffers!\r\n");
@@ -206,6 +247,7 @@ void loggerTaskEx(void *params)
                                  * and we give system time to recover.
                                  */
                                 delayMs(10);
+                                task_stats_end(TASK_STATS_LOGGER);
                                 continue;
                         }
 
@@ -214,9 +256,22 @@ void loggerTaskEx(void *params)
                         updateSampleRates(loggerConfig, &loggingSampleRate,
                                           &telemetrySampleRate,
                                           &sampleRateTimebase);
+
+                        /* The file writer has to keep up with logging */
+                        task_stats_set_budget(TASK_STATS_FILE_WRITER,
+                                              SAMPLE_DISABLED == loggingSampleRate ? 0 :
+                                              loggingSampleRate * (1000000 / TICK_RATE_HZ));
+#if SDCARD_SUPPORT
+                        /* The pre-trigger ring lives in the log spool */
+                        if (loggerConfig->auto_logger_cfg.enabled &&
+                            loggerConfig->auto_logger_cfg.pre_trigger)
+                                log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+#endif
                         resetLapCount();
                         lapstats_reset_distance();
                         currentTicks = 0;
+                        /* The new ring may be shorter than the old one */
+                        bufferIndex = 0;
                         g_configChanged = 0;
                 }
 
@@ -238,6 +293,7 @@ void loggerTaskEx(void *params)
                         const LoggerMessage logStartMsg = getLogStartMessage();
 #if SDCARD_SUPPORT
                         queue_logfile_record(&logStartMsg);
+                        log_spool_end_preroll();
 #endif
                         queueTelemetryRecord(&logStartMsg);
                 }
@@ -253,13 +309,19 @@ void loggerTaskEx(void *params)
                 }
 
                 /* Prepare a Sample */
-                struct sample *sample = g_sample_buffer + bufferIndex;
+                struct sample *sample = sample_arena_get(bufferIndex);
+                if (!sample) {
+                        task_stats_end(TASK_STATS_LOGGER);
+                        continue;
+                }
 
                 /* Check if we need to actually populate the buffer. */
                 const int sampledRate = populate_sample_buffer(sample,
                                                                currentTicks);
-                if (sampledRate == SAMPLE_DISABLED)
+                if (sampledRate == SAMPLE_DISABLED) {
+                        task_stats_end(TASK_STATS_LOGGER);
                         continue;
+                }
 
                 /* If here, create the LoggerMessage to send with the sample */
                 const LoggerMessage msg = create_logger_message(
@@ -270,12 +332,12 @@ void loggerTaskEx(void *params)
                  * logging button.
                  */
 #if SDCARD_SUPPORT
-                if (is_logging && should_sample(currentTicks, loggingSampleRate)) {
-                        /* XXX Move this to file writer? */
-                        const portBASE_TYPE res = queue_logfile_record(&msg);
-                        if (pdTRUE != res) {
-                            logging_set_status(LOGGING_STATUS_OVERFLOW);
-                        }
+                if (should_sample(currentTicks, loggingSampleRate)) {
+                        if (is_logging)
+                                queue_log_sample(&msg);
+                        else
+                                preroll_log_sample(&loggerConfig->auto_logger_cfg,
+                                                   sample);
                 }
 #endif
 
@@ -286,6 +348,8 @@ void loggerTaskEx(void *params)
                 queueTelemetryRecord(&msg);
 
 
+                lap_summary_add_sample(sample);
+
                 /* Process callback handlers for the samples */
                 logger_sample_process_callbacks(currentTicks, sample);
 
@@ -293,6 +357,7 @@ void loggerTaskEx(void *params)
                 bufferIndex %= buffer_size;
 
                 current_sample = sample;
+                task_stats_end(TASK_STATS_LOGGER);
         }
 
         panic(PANIC_CAUSE_UNREACHABLE);
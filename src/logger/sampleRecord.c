@@ -22,6 +22,7 @@
 
 #include "FreeRTOS.h"
 #include "capabilities.h"
+#include "channel_registry.h"
 #include "loggerConfig.h"
 #include "loggerSampleData.h"
 #include "mem_mang.h"
@@ -56,41 +57,50 @@ void free_sample_buffer(struct sample *s)
         s->channel_samples = NULL;
 }
 
+bool get_sample_value_by_index(const struct sample *s, const int index,
+                               double *value)
+{
+    if (!s || !value) return false;
+    if (index < 0 || (size_t) index >= s->channel_count) return false;
+
+    const ChannelSample *sam = s->channel_samples + index;
+    if (!sam->populated) return false;
+
+    switch(sam->sampleData) {
+            case SampleData_Float:
+            case SampleData_Float_Noarg:
+                    *value = (double)sam->valueFloat;
+                    return true;
+            case SampleData_Int:
+            case SampleData_Int_Noarg:
+                    *value = (double)sam->valueInt;
+                    return true;
+            case SampleData_Double:
+            case SampleData_Double_Noarg:
+                    *value = sam->valueDouble;
+                    return true;
+            case SampleData_LongLong:
+            case SampleData_LongLong_Noarg:
+                    /* risk of overflow here - specifically pertains to the UTC milliseconds channel */
+                    pr_warning_str_msg(LOG_PFX "Data type not supported for channel: ", sam->cfg->label);
+                    return false;
+            default:
+                    pr_warning_int_msg(LOG_PFX "Unknown channel sample type", sam->sampleData);
+                    return false;
+    }
+}
+
 bool get_sample_value_by_name(const struct sample *s, const char * name, double *value)
 {
     if (!s || !value || !name) return false;
 
-    for (size_t i = 0; i < s->channel_count; i++){
-            ChannelSample *sam = (s->channel_samples + i);
-            if (!STR_EQ(name, sam->cfg->label)) continue;
-
-            if (!sam->populated) return false;
-
-            switch(sam->sampleData) {
-                    case SampleData_Float:
-                    case SampleData_Float_Noarg:
-                            *value = (double)sam->valueFloat;
-                            return true;
-                    case SampleData_Int:
-                    case SampleData_Int_Noarg:
-                            *value = (double)sam->valueInt;
-                            return true;
-                    case SampleData_Double:
-                    case SampleData_Double_Noarg:
-                            *value = sam->valueDouble;
-                            return true;
-                    case SampleData_LongLong:
-                    case SampleData_LongLong_Noarg:
-                            /* risk of overflow here - specifically pertains to the UTC milliseconds channel */
-                            pr_warning_str_msg(LOG_PFX "Data type not supported for channel: ", name);
-                            return false;
-                    default:
-                            pr_warning_int_msg(LOG_PFX "Unknown channel sample type", sam->sampleData);
-                            return false;
-            }
+    const int index = channel_registry_find(s, name);
+    if (CHANNEL_REGISTRY_INVALID_INDEX == index) {
+            pr_trace_str_msg(LOG_PFX "Unknown channel name: ", name);
+            return false;
     }
-    pr_trace_str_msg(LOG_PFX "Unknown channel name: ", name);
-    return false;
+
+    return get_sample_value_by_index(s, index, value);
 }
 
 /**
@@ -0,0 +1,164 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "loggerConfig.h"
+#include "loggerSampleData.h"
+#include "mem_mang.h"
+#include "printk.h"
+#include "sample_arena.h"
+#include "semphr.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[sample_arena] "
+
+static struct {
+        xSemaphoreHandle mutex;
+        struct sample samples[SAMPLE_ARENA_MAX_DEPTH];
+        struct sample scratch;
+        ChannelSample *arena;
+        /* Capacity of the arena, in channel samples */
+        size_t capacity;
+        size_t depth;
+        size_t stride;
+} state;
+
+static void lock(void)
+{
+        xSemaphoreTake(state.mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+        xSemaphoreGive(state.mutex);
+}
+
+void sample_arena_init(void)
+{
+        portFree(state.arena);
+        memset(&state, 0, sizeof(state));
+        state.mutex = xSemaphoreCreateMutex();
+}
+
+/*
+ * Frees the arena and takes the largest one we can get for the layout,
+ * dropping buffers from the ring until the allocation succeeds.  The
+ * scratch buffer always gets a slot of its own.
+ */
+static size_t alloc_arena(const size_t channel_count, size_t depth)
+{
+        portFree(state.arena);
+        state.arena = NULL;
+        state.capacity = 0;
+
+        for (; depth; --depth) {
+                const size_t capacity = channel_count * (depth + 1);
+                state.arena = (ChannelSample *)
+                        portMalloc(sizeof(ChannelSample[capacity]));
+                if (state.arena) {
+                        state.capacity = capacity;
+                        return depth;
+                }
+        }
+
+        return 0;
+}
+
+size_t sample_arena_layout(const size_t channel_count, size_t depth)
+{
+        if (depth > SAMPLE_ARENA_MAX_DEPTH)
+                depth = SAMPLE_ARENA_MAX_DEPTH;
+
+        lock();
+
+        /* Nothing in the ring is valid until we are done */
+        state.depth = 0;
+        memset(state.samples, 0, sizeof(state.samples));
+
+        if (channel_count && channel_count * (depth + 1) > state.capacity)
+                depth = alloc_arena(channel_count, depth);
+
+        if (!channel_count)
+                depth = 0;
+
+        LoggerConfig *config = getWorkingLoggerConfig();
+        for (size_t i = 0; i < depth; ++i) {
+                struct sample *s = state.samples + i;
+                s->channel_samples = state.arena + i * channel_count;
+                s->channel_count = channel_count;
+                init_channel_sample_buffer(config, s);
+        }
+
+        state.depth = depth;
+        state.stride = channel_count;
+        unlock();
+
+        pr_info_int_msg(LOG_PFX "Sample buffers: ", depth);
+        pr_info_int_msg(LOG_PFX "Arena bytes: ", sample_arena_size());
+        return depth;
+}
+
+size_t sample_arena_depth(void)
+{
+        return state.depth;
+}
+
+size_t sample_arena_size(void)
+{
+        return sizeof(ChannelSample[state.capacity]);
+}
+
+struct sample* sample_arena_get(const size_t index)
+{
+        return index < state.depth ? state.samples + index : NULL;
+}
+
+struct sample* sample_arena_acquire_scratch(const size_t channel_count)
+{
+        if (!channel_count)
+                return NULL;
+
+        lock();
+
+        /* The scratch buffer lives in whatever the ring does not use */
+        const size_t used = state.depth * state.stride;
+        if (!state.arena || channel_count > state.capacity - used) {
+                unlock();
+                return NULL;
+        }
+
+        struct sample *s = &state.scratch;
+        s->channel_samples = state.arena + used;
+        s->channel_count = channel_count;
+        init_channel_sample_buffer(getWorkingLoggerConfig(), s);
+
+        return s;
+}
+
+void sample_arena_release_scratch(struct sample *s)
+{
+        if (s != &state.scratch)
+                return;
+
+        s->channel_samples = NULL;
+        unlock();
+}
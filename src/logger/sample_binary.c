@@ -0,0 +1,423 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "FreeRTOS.h"
+#include "channel_registry.h"
+#include "macros.h"
+#include "printk.h"
+#include "sample_binary.h"
+#include "sample_frame.h"
+#include "semphr.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[sample_binary] "
+
+struct binary_client {
+        const struct Serial *serial;
+        /* Channel registry version of the last layout frame sent */
+        unsigned int layout_version;
+};
+
+static struct {
+        xSemaphoreHandle mutex;
+        struct binary_client clients[SAMPLE_BINARY_MAX_CLIENTS];
+        size_t next_client;
+} state;
+
+static void lock(void)
+{
+        xSemaphoreTake(state.mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+        xSemaphoreGive(state.mutex);
+}
+
+static size_t put_le(uint8_t *buf, uint64_t value, const size_t size)
+{
+        for (size_t i = 0; i < size; ++i, value >>= 8)
+                buf[i] = (uint8_t) value;
+
+        return size;
+}
+
+void sample_binary_init(void)
+{
+        memset(&state, 0, sizeof(state));
+        state.mutex = xSemaphoreCreateMutex();
+}
+
+enum sample_binary_value_type sample_binary_value_type(const ChannelSample *cs)
+{
+        switch(cs->sampleData) {
+        case SampleData_Int:
+        case SampleData_Int_Noarg:
+                return SAMPLE_BINARY_INT32;
+        case SampleData_LongLong:
+        case SampleData_LongLong_Noarg:
+                return SAMPLE_BINARY_INT64;
+        case SampleData_Float:
+        case SampleData_Float_Noarg:
+                return SAMPLE_BINARY_FLOAT32;
+        default:
+                return SAMPLE_BINARY_FLOAT64;
+        }
+}
+
+size_t sample_binary_value_size(const enum sample_binary_value_type type)
+{
+        switch(type) {
+        case SAMPLE_BINARY_INT32:
+        case SAMPLE_BINARY_FLOAT32:
+                return 4;
+        default:
+                return 8;
+        }
+}
+
+size_t sample_binary_put_value(uint8_t *buf, const ChannelSample *cs)
+{
+        const enum sample_binary_value_type type =
+                sample_binary_value_type(cs);
+        const size_t size = sample_binary_value_size(type);
+        uint64_t raw;
+
+        switch(type) {
+        case SAMPLE_BINARY_INT32: {
+                raw = (uint32_t) cs->valueInt;
+                break;
+        }
+        case SAMPLE_BINARY_INT64: {
+                raw = (uint64_t) cs->valueLongLong;
+                break;
+        }
+        case SAMPLE_BINARY_FLOAT32: {
+                uint32_t bits;
+                memcpy(&bits, &cs->valueFloat, sizeof(bits));
+                raw = bits;
+                break;
+        }
+        default:
+                memcpy(&raw, &cs->valueDouble, sizeof(raw));
+                break;
+        }
+
+        return put_le(buf, raw, size);
+}
+
+size_t sample_binary_get_value(ChannelSample *cs, const uint8_t *buf)
+{
+        const enum sample_binary_value_type type =
+                sample_binary_value_type(cs);
+        const size_t size = sample_binary_value_size(type);
+
+        uint64_t raw = 0;
+        for (size_t i = size; i; --i)
+                raw = (raw << 8) | buf[i - 1];
+
+        switch(type) {
+        case SAMPLE_BINARY_INT32:
+                cs->valueInt = (int32_t) raw;
+                break;
+        case SAMPLE_BINARY_INT64:
+                cs->valueLongLong = (int64_t) raw;
+                break;
+        case SAMPLE_BINARY_FLOAT32: {
+                const uint32_t bits = (uint32_t) raw;
+                memcpy(&cs->valueFloat, &bits, sizeof(bits));
+                break;
+        }
+        default:
+                memcpy(&cs->valueDouble, &raw, sizeof(raw));
+                break;
+        }
+
+        return size;
+}
+
+static void write_header(struct Serial *serial,
+                         const enum sample_binary_frame_type type,
+                         const size_t payload_len)
+{
+        uint8_t hdr[SAMPLE_BINARY_HEADER_LEN];
+
+        hdr[0] = SAMPLE_BINARY_SOF;
+        hdr[1] = (uint8_t) type;
+        put_le(hdr + 2, payload_len, 2);
+        serial_write_buff(serial, (const char *) hdr, sizeof(hdr));
+}
+
+void sample_binary_write_sample(struct Serial *serial, const uint32_t tick,
+                                const uint8_t *body, const size_t body_len)
+{
+        uint8_t tick_le[4];
+
+        write_header(serial, SAMPLE_BINARY_SAMPLE, sizeof(tick_le) + body_len);
+        put_le(tick_le, tick, sizeof(tick_le));
+        serial_write_buff(serial, (const char *) tick_le, sizeof(tick_le));
+        serial_write_buff(serial, (const char *) body, body_len);
+}
+
+static bool bitmap_has(const uint8_t *body, const size_t bit)
+{
+        if (bit / 32 >= body[0])
+                return false;
+
+        const uint8_t *bm = body + 1 + bit / 32 * sizeof(uint32_t);
+        return bm[bit % 32 / 8] & (1u << (bit % 8));
+}
+
+static size_t bitmaps_len(const uint8_t *body)
+{
+        return 1 + body[0] * sizeof(uint32_t);
+}
+
+bool sample_binary_write_json_values(struct Serial *serial,
+                                     const struct sample *layout,
+                                     const struct channel_mask *mask,
+                                     const uint8_t *body, const size_t len)
+{
+        if (len < 1)
+                return false;
+
+        const size_t bitmap_count = body[0];
+        const uint8_t *values = body + 1 + bitmap_count * sizeof(uint32_t);
+        const uint8_t *end = body + len;
+        if (0 == bitmap_count || values > end)
+                return false;
+
+        /* Bits are assigned to the channels in the mask only */
+        size_t bit = 0;
+        const ChannelSample *cs = layout->channel_samples;
+        for (size_t i = 0; i < layout->channel_count; ++i, ++cs) {
+                if (!channel_mask_has(mask, i))
+                        continue;
+
+                const size_t channel_bit = bit++;
+                if (channel_bit / 32 >= bitmap_count)
+                        break;
+
+                if (!bitmap_has(body, channel_bit))
+                        continue;
+
+                const size_t size = sample_binary_value_size(
+                        sample_binary_value_type(cs));
+                if (values + size > end)
+                        return false;
+
+                ChannelSample value = *cs;
+                values += sample_binary_get_value(&value, values);
+
+                char buf[SAMPLE_FRAME_VALUE_MAX_LEN];
+                serial_write_buff(serial, buf,
+                                  sample_frame_render_value(buf, &value));
+                serial_write_c(serial, ',');
+        }
+
+        for (size_t i = 0; i < bitmap_count; ++i) {
+                if (0 < i)
+                        serial_write_c(serial, ',');
+
+                const uint8_t *bm = body + 1 + i * sizeof(uint32_t);
+                put_uint(serial, bm[0] | bm[1] << 8 | bm[2] << 16 |
+                         (uint32_t) bm[3] << 24);
+        }
+
+        return true;
+}
+
+bool sample_binary_read_values(struct sample *s, const uint8_t *body,
+                               const size_t len)
+{
+        if (len < 1 || len < bitmaps_len(body) || 0 == body[0])
+                return false;
+
+        const uint8_t *values = body + bitmaps_len(body);
+        const uint8_t *end = body + len;
+
+        ChannelSample *cs = s->channel_samples;
+        for (size_t i = 0; i < s->channel_count; ++i, ++cs) {
+                cs->populated = bitmap_has(body, i);
+                if (!cs->populated)
+                        continue;
+
+                const size_t size = sample_binary_value_size(
+                        sample_binary_value_type(cs));
+                if (values + size > end)
+                        return false;
+
+                values += sample_binary_get_value(cs, values);
+        }
+
+        return true;
+}
+
+size_t sample_binary_delta(uint8_t *out, const struct sample *layout,
+                           const struct channel_mask *mask,
+                           const uint8_t *prev, const size_t prev_len,
+                           const uint8_t *cur, const size_t cur_len)
+{
+        if (cur_len < 1 || cur_len < bitmaps_len(cur) ||
+            (prev && (prev_len < 1 || prev_len < bitmaps_len(prev))))
+                return 0;
+
+        const uint8_t *cur_val = cur + bitmaps_len(cur);
+        const uint8_t *cur_end = cur + cur_len;
+        const uint8_t *prev_val = prev ? prev + bitmaps_len(prev) : NULL;
+        const uint8_t *prev_end = prev ? prev + prev_len : NULL;
+
+        /* Same bitmap count as cur, but only the bits of changed values */
+        memset(out, 0, bitmaps_len(cur));
+        out[0] = cur[0];
+        uint8_t *out_val = out + bitmaps_len(cur);
+
+        size_t bit = 0;
+        const ChannelSample *cs = layout->channel_samples;
+        for (size_t i = 0; i < layout->channel_count; ++i, ++cs) {
+                if (!channel_mask_has(mask, i))
+                        continue;
+
+                const size_t channel_bit = bit++;
+                const size_t size = sample_binary_value_size(
+                        sample_binary_value_type(cs));
+
+                const uint8_t *old = NULL;
+                if (prev && bitmap_has(prev, channel_bit)) {
+                        if (prev_val + size > prev_end)
+                                return 0;
+
+                        old = prev_val;
+                        prev_val += size;
+                }
+
+                if (!bitmap_has(cur, channel_bit))
+                        continue;
+
+                if (cur_val + size > cur_end)
+                        return 0;
+
+                if (!old || 0 != memcmp(old, cur_val, size)) {
+                        uint8_t *bm = out + 1 +
+                                channel_bit / 32 * sizeof(uint32_t);
+                        bm[channel_bit % 32 / 8] |= 1u << (channel_bit % 8);
+                        memcpy(out_val, cur_val, size);
+                        out_val += size;
+                }
+
+                cur_val += size;
+        }
+
+        return out_val - out;
+}
+
+static struct binary_client* find_client(const struct Serial *serial)
+{
+        for (size_t i = 0; i < ARRAY_LEN(state.clients); ++i)
+                if (serial == state.clients[i].serial)
+                        return state.clients + i;
+
+        return NULL;
+}
+
+void sample_binary_write_layout(struct Serial *serial,
+                                const struct sample *s,
+                                const struct channel_mask *mask)
+{
+        const unsigned int version = channel_registry_version();
+
+        /* Version 0 can't be told apart from a change, so always send */
+        lock();
+        struct binary_client *client = find_client(serial);
+        const bool current = !client ||
+                (0 != version && version == client->layout_version);
+        if (client)
+                client->layout_version = version;
+        unlock();
+
+        if (current)
+                return;
+
+        size_t count = 0;
+        for (size_t i = 0; i < s->channel_count; ++i)
+                if (channel_mask_has(mask, i))
+                        ++count;
+
+        uint8_t count_le[2];
+        write_header(serial, SAMPLE_BINARY_LAYOUT, sizeof(count_le) + count);
+        put_le(count_le, count, sizeof(count_le));
+        serial_write_buff(serial, (const char *) count_le, sizeof(count_le));
+
+        for (size_t i = 0; i < s->channel_count; ++i)
+                if (channel_mask_has(mask, i))
+                        serial_write_c(serial, (char) sample_binary_value_type(
+                                               s->channel_samples + i));
+}
+
+bool sample_binary_set_client_format(const struct Serial *serial,
+                                     const int format)
+{
+        switch(format) {
+        case TELEMETRY_FORMAT_JSON:
+                sample_binary_reset_client(serial);
+                return true;
+        case TELEMETRY_FORMAT_BINARY:
+                break;
+        default:
+                pr_warning_int_msg(LOG_PFX "Unknown telemetry format: ",
+                                   format);
+                return false;
+        }
+
+        lock();
+        struct binary_client *client = find_client(serial);
+        if (!client) {
+                client = state.clients + state.next_client;
+                state.next_client = (state.next_client + 1) %
+                        ARRAY_LEN(state.clients);
+        }
+
+        client->serial = serial;
+        client->layout_version = 0;
+        unlock();
+
+        return true;
+}
+
+bool sample_binary_client_enabled(const struct Serial *serial)
+{
+        lock();
+        const bool enabled = NULL != find_client(serial);
+        unlock();
+
+        return enabled;
+}
+
+void sample_binary_reset_client(const struct Serial *serial)
+{
+        lock();
+        struct binary_client *client = find_client(serial);
+        if (client)
+                client->serial = NULL;
+        unlock();
+}
@@ -0,0 +1,336 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "FreeRTOS.h"
+#include "channel_registry.h"
+#include "macros.h"
+#include "mem_mang.h"
+#include "modp_numtoa.h"
+#include "printk.h"
+#include "sample_binary.h"
+#include "sample_frame.h"
+#include "semphr.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_PFX	"[sample_frame] "
+
+#define MAX_BITMAPS	10
+#define BITMAP_BITS	32
+
+/*
+ * Worst case rendered lengths, including the NULL terminator that the
+ * modp functions write.  Same as the buffers the put_* serial functions
+ * use.
+ */
+#define INT_MAX_LEN	12
+#define LL_MAX_LEN	22
+#define FLOAT_MAX_LEN	24
+#define DOUBLE_MAX_LEN	SAMPLE_FRAME_VALUE_MAX_LEN
+#define UINT_MAX_LEN	12
+
+static struct {
+        xSemaphoreHandle mutex;
+        struct sample_frame slots[SAMPLE_FRAME_SLOTS];
+} state;
+
+static void lock(void)
+{
+        xSemaphoreTake(state.mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+        xSemaphoreGive(state.mutex);
+}
+
+static size_t value_max_len(const ChannelSample *cs)
+{
+        switch(cs->sampleData) {
+        case SampleData_Int:
+        case SampleData_Int_Noarg:
+                return INT_MAX_LEN;
+        case SampleData_LongLong:
+        case SampleData_LongLong_Noarg:
+                return LL_MAX_LEN;
+        case SampleData_Float:
+        case SampleData_Float_Noarg:
+                return FLOAT_MAX_LEN;
+        default:
+                return DOUBLE_MAX_LEN;
+        }
+}
+
+static size_t bitmap_count_max(const struct sample *s)
+{
+        return MIN(s->channel_count / BITMAP_BITS + 1, MAX_BITMAPS);
+}
+
+static size_t json_max_len(const struct sample *s, const size_t bitmaps)
+{
+        /* Every value and bitmask may be followed by a ',' */
+        size_t len = 0;
+        for (size_t i = 0; i < s->channel_count; ++i)
+                len += value_max_len(s->channel_samples + i) + 1;
+
+        return len + bitmaps * (UINT_MAX_LEN + 1);
+}
+
+static size_t binary_max_len(const struct sample *s, const size_t bitmaps)
+{
+        size_t len = 1 + bitmaps * sizeof(uint32_t);
+        for (size_t i = 0; i < s->channel_count; ++i)
+                len += sample_binary_value_size(
+                        sample_binary_value_type(s->channel_samples + i));
+
+        return len;
+}
+
+/**
+ * @return The most bytes that rendering the sample could take.
+ */
+static size_t frame_max_len(const struct sample *s)
+{
+        const size_t bitmaps = bitmap_count_max(s);
+        return json_max_len(s, bitmaps) + binary_max_len(s, bitmaps);
+}
+
+/*
+ * Renders a value in place.  The caller has made sure there is room for
+ * the worst case, so we let the modp functions write straight into the
+ * frame.
+ */
+size_t sample_frame_render_value(char *buf, const ChannelSample *cs)
+{
+        const int precision = cs->cfg->precision;
+
+        switch(cs->sampleData) {
+        case SampleData_Float:
+        case SampleData_Float_Noarg:
+                return modp_ftoa_fixed(cs->valueFloat, buf, precision);
+        case SampleData_Int:
+        case SampleData_Int_Noarg:
+                modp_itoa10(cs->valueInt, buf);
+                break;
+        case SampleData_LongLong:
+        case SampleData_LongLong_Noarg:
+                modp_ltoa10(cs->valueLongLong, buf);
+                break;
+        case SampleData_Double:
+        case SampleData_Double_Noarg:
+                modp_dtoa(cs->valueDouble, buf, precision);
+                break;
+        default:
+                pr_warning_int_msg(LOG_PFX "Unknown sample data type: ",
+                                   cs->sampleData);
+                return 0;
+        }
+
+        return strlen(buf);
+}
+
+static void render(struct sample_frame *f, const struct sample *s,
+                   const struct channel_mask *mask)
+{
+        uint32_t bitmaps[MAX_BITMAPS] = {0};
+        size_t bitmap_idx = 0;
+        size_t bit = 0;
+
+        /*
+         * The binary body goes at the back of the buffer.  Its values
+         * start after room for the most bitmaps we could have, and the
+         * bitmaps get put right in front of them once they are known.
+         */
+        const size_t max_bitmaps = bitmap_count_max(s);
+        uint8_t *values = (uint8_t *) f->data + f->capacity -
+                binary_max_len(s, max_bitmaps) + 1 +
+                max_bitmaps * sizeof(uint32_t);
+        uint8_t *bin_ptr = values;
+        char *ptr = f->data;
+
+        /* Bits are assigned to the channels in the mask only */
+        const ChannelSample *cs = s->channel_samples;
+        for (size_t i = 0; i < s->channel_count; ++i, ++cs) {
+                if (!channel_mask_has(mask, i))
+                        continue;
+
+                if (BITMAP_BITS == bit) {
+                        bit = 0;
+                        if (MAX_BITMAPS == ++bitmap_idx) {
+                                --bitmap_idx;
+                                break;
+                        }
+                }
+
+                const size_t channel_bit = bit++;
+                if (!cs->populated)
+                        continue;
+
+                bitmaps[bitmap_idx] |= 1u << channel_bit;
+                ptr += sample_frame_render_value(ptr, cs);
+                *ptr++ = ',';
+                bin_ptr += sample_binary_put_value(bin_ptr, cs);
+        }
+
+        for (size_t i = 0; i <= bitmap_idx; ++i) {
+                if (0 < i)
+                        *ptr++ = ',';
+
+                modp_uitoa10(bitmaps[i], ptr);
+                ptr += strlen(ptr);
+        }
+
+        /* Now put the bitmaps in front of the binary values */
+        const size_t bitmap_count = bitmap_idx + 1;
+        f->bin = values - 1 - bitmap_count * sizeof(uint32_t);
+        f->bin[0] = (uint8_t) bitmap_count;
+        for (size_t i = 0; i < bitmap_count; ++i) {
+                uint32_t bm = bitmaps[i];
+                uint8_t *out = f->bin + 1 + i * sizeof(uint32_t);
+                for (size_t b = 0; b < sizeof(uint32_t); ++b, bm >>= 8)
+                        out[b] = (uint8_t) bm;
+        }
+
+        f->sample = s;
+        f->ticks = s->ticks;
+        f->masked = NULL != mask;
+        if (mask)
+                f->mask = *mask;
+        f->length = ptr - f->data;
+        f->bin_length = bin_ptr - f->bin;
+}
+
+/*
+ * Private frames carry their data right behind them and are freed on
+ * their last release.
+ */
+struct sample_frame* sample_frame_create(const struct sample *s,
+                                         const struct channel_mask *mask)
+{
+        const size_t capacity = frame_max_len(s);
+        struct sample_frame *f = portMalloc(sizeof(struct sample_frame) +
+                                            capacity);
+        if (!f) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ",
+                                 capacity);
+                return NULL;
+        }
+
+        memset(f, 0, sizeof(struct sample_frame));
+        f->refs = 1;
+        f->capacity = capacity;
+        f->data = (char *) (f + 1);
+        render(f, s, mask);
+
+        return f;
+}
+
+static bool is_frame_of(const struct sample_frame *f, const struct sample *s,
+                        const struct channel_mask *mask,
+                        const unsigned int version)
+{
+        return f->data && f->version == version && f->sample == s &&
+                f->ticks == s->ticks &&
+                channel_mask_equal(f->masked ? &f->mask : NULL, mask);
+}
+
+static bool reserve(struct sample_frame *f, const size_t capacity)
+{
+        if (capacity <= f->capacity)
+                return true;
+
+        portFree(f->data);
+        f->data = portMalloc(capacity);
+        f->capacity = f->data ? capacity : 0;
+        if (!f->data)
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ",
+                                 capacity);
+
+        return NULL != f->data;
+}
+
+void sample_frame_init(void)
+{
+        memset(&state, 0, sizeof(state));
+        state.mutex = xSemaphoreCreateMutex();
+}
+
+struct sample_frame* sample_frame_acquire(const struct sample *s,
+                                          const struct channel_mask *mask)
+{
+        /*
+         * Version 0 means the channel layout has never been indexed, so
+         * we can't tell if a cached frame still matches it.
+         */
+        const unsigned int version = channel_registry_version();
+        if (0 == version)
+                return sample_frame_create(s, mask);
+
+        struct sample_frame *unused = NULL;
+
+        lock();
+        for (size_t i = 0; i < ARRAY_LEN(state.slots); ++i) {
+                struct sample_frame *f = state.slots + i;
+
+                if (is_frame_of(f, s, mask, version)) {
+                        ++f->refs;
+                        unlock();
+                        return f;
+                }
+
+                if (0 == f->refs && !unused)
+                        unused = f;
+        }
+
+        /*
+         * Render while holding the lock so that streams that show up
+         * for the same sample wait for this rather than doing it again.
+         */
+        if (unused && reserve(unused, frame_max_len(s))) {
+                unused->refs = 1;
+                unused->shared = true;
+                unused->version = version;
+                render(unused, s, mask);
+                unlock();
+                return unused;
+        }
+        unlock();
+
+        /* Every slot is still being sent.  Don't hold anyone up */
+        return sample_frame_create(s, mask);
+}
+
+void sample_frame_release(struct sample_frame *f)
+{
+        if (!f)
+                return;
+
+        if (!f->shared) {
+                portFree(f);
+                return;
+        }
+
+        lock();
+        --f->refs;
+        unlock();
+}
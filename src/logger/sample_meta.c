@@ -0,0 +1,344 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FreeRTOS.h"
+#include "api.h"
+#include "channel_registry.h"
+#include "hash.h"
+#include "loggerConfig.h"
+#include "macros.h"
+#include "mem_mang.h"
+#include "modp_numtoa.h"
+#include "printk.h"
+#include "sample_meta.h"
+#include "semphr.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[sample_meta] "
+
+struct meta_client {
+        const struct Serial *serial;
+        uint32_t hash;
+};
+
+static struct {
+        xSemaphoreHandle mutex;
+        struct sample_meta *meta[SAMPLE_META_SLOTS];
+        size_t next_meta;
+        struct meta_client clients[SAMPLE_META_MAX_CLIENTS];
+        size_t next_client;
+} state;
+
+/*
+ * Renders JSON into a buffer.  If buf is NULL only the length is
+ * tracked, which lets us size the buffer with the same code that fills
+ * it.
+ */
+struct meta_writer {
+        char *buf;
+        size_t len;
+};
+
+static void lock(void)
+{
+        xSemaphoreTake(state.mutex, portMAX_DELAY);
+}
+
+static void unlock(void)
+{
+        xSemaphoreGive(state.mutex);
+}
+
+static void put_c(struct meta_writer *w, const char c)
+{
+        if (w->buf)
+                w->buf[w->len] = c;
+
+        ++w->len;
+}
+
+static void put_s(struct meta_writer *w, const char *s)
+{
+        for (; *s; ++s)
+                put_c(w, *s);
+}
+
+/* Must escape the same way as jsmn_encode_write_string */
+static void put_quoted(struct meta_writer *w, const char *s)
+{
+        put_c(w, '"');
+        for (; *s; ++s) {
+                switch(*s) {
+                case '\b':
+                        put_s(w, "\\b");
+                        break;
+                case '\f':
+                        put_s(w, "\\f");
+                        break;
+                case '\n':
+                        put_s(w, "\\n");
+                        break;
+                case '\r':
+                        put_s(w, "\\r");
+                        break;
+                case '\t':
+                        put_s(w, "\\t");
+                        break;
+                case '"':
+                        put_s(w, "\\\"");
+                        break;
+                case '\\':
+                        put_s(w, "\\\\");
+                        break;
+                default:
+                        put_c(w, *s);
+                        break;
+                }
+        }
+        put_c(w, '"');
+}
+
+static void put_key(struct meta_writer *w, const char *key)
+{
+        put_quoted(w, key);
+        put_c(w, ':');
+}
+
+static void put_int_field(struct meta_writer *w, const char *key,
+                          const int value)
+{
+        char buf[12];
+
+        modp_itoa10(value, buf);
+        put_key(w, key);
+        put_s(w, buf);
+}
+
+static void put_float_field(struct meta_writer *w, const char *key,
+                            const float value, const int precision)
+{
+        char buf[20];
+
+        modp_ftoa(value, buf, precision);
+        put_key(w, key);
+        put_s(w, buf);
+}
+
+static void render_channel(struct meta_writer *w, const ChannelConfig *cfg)
+{
+        put_c(w, '{');
+        put_key(w, "nm");
+        put_quoted(w, cfg->label);
+        put_c(w, ',');
+        put_key(w, "ut");
+        put_quoted(w, cfg->units);
+        put_c(w, ',');
+        put_float_field(w, "min", cfg->min, cfg->precision);
+        put_c(w, ',');
+        put_float_field(w, "max", cfg->max, cfg->precision);
+        put_c(w, ',');
+        put_int_field(w, "prec", (int) cfg->precision);
+        put_c(w, ',');
+        put_int_field(w, "sr", decodeSampleRate(cfg->sampleRate));
+        put_c(w, '}');
+}
+
+static void render(struct meta_writer *w, const struct sample *s,
+                   const struct channel_mask *mask)
+{
+        put_key(w, "meta");
+        put_c(w, '[');
+
+        bool first = true;
+        for (size_t i = 0; i < s->channel_count; ++i) {
+                if (!channel_mask_has(mask, i))
+                        continue;
+
+                if (!first)
+                        put_c(w, ',');
+
+                render_channel(w, s->channel_samples[i].cfg);
+                first = false;
+        }
+
+        put_c(w, ']');
+}
+
+static struct sample_meta* create_meta(const struct sample *s,
+                                       const struct channel_mask *mask,
+                                       const unsigned int version)
+{
+        struct meta_writer w = {NULL, 0};
+        render(&w, s, mask);
+
+        struct sample_meta *sm = portMalloc(sizeof(struct sample_meta) +
+                                            w.len);
+        if (!sm) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", w.len);
+                return NULL;
+        }
+
+        w.buf = sm->json;
+        w.len = 0;
+        render(&w, s, mask);
+
+        sm->refs = 1;
+        sm->version = version;
+        sm->masked = NULL != mask;
+        if (mask)
+                sm->mask = *mask;
+        sm->length = w.len;
+        sm->hash = hash_fnv1a(sm->json, sm->length);
+
+        return sm;
+}
+
+void sample_meta_init(void)
+{
+        memset(&state, 0, sizeof(state));
+        state.mutex = xSemaphoreCreateMutex();
+}
+
+static bool is_meta_of(const struct sample_meta *sm,
+                       const struct channel_mask *mask,
+                       const unsigned int version)
+{
+        return sm && 0 != version && sm->version == version &&
+                channel_mask_equal(sm->masked ? &sm->mask : NULL, mask);
+}
+
+struct sample_meta* sample_meta_acquire(const struct sample *s,
+                                        const struct channel_mask *mask)
+{
+        const unsigned int version = channel_registry_version();
+
+        lock();
+        for (size_t i = 0; i < ARRAY_LEN(state.meta); ++i) {
+                struct sample_meta *sm = state.meta[i];
+                if (is_meta_of(sm, mask, version)) {
+                        ++sm->refs;
+                        unlock();
+                        return sm;
+                }
+        }
+        unlock();
+
+        if (!s)
+                return NULL;
+
+        struct sample_meta *sm = create_meta(s, mask, version);
+
+        /*
+         * Version 0 means the channel layout has never been indexed, so
+         * we have nothing to detect a change with.  Don't cache it.
+         */
+        if (!sm || 0 == version)
+                return sm;
+
+        /* Prefer a stale slot, else take turns */
+        lock();
+        size_t slot = state.next_meta;
+        for (size_t i = 0; i < ARRAY_LEN(state.meta); ++i) {
+                if (!state.meta[i] || state.meta[i]->version != version) {
+                        slot = i;
+                        break;
+                }
+        }
+        if (slot == state.next_meta)
+                state.next_meta = (state.next_meta + 1) %
+                        ARRAY_LEN(state.meta);
+
+        struct sample_meta *old = state.meta[slot];
+        state.meta[slot] = sm;
+        ++sm->refs;
+        unlock();
+
+        if (old)
+                sample_meta_release(old);
+
+        return sm;
+}
+
+void sample_meta_release(struct sample_meta *sm)
+{
+        if (!sm)
+                return;
+
+        lock();
+        const bool unused = 0 == --sm->refs;
+        unlock();
+
+        if (unused)
+                portFree(sm);
+}
+
+void sample_meta_write(struct Serial *serial, const struct sample_meta *sm,
+                       const int more)
+{
+        serial_write_buff(serial, sm->json, sm->length);
+        serial_write_c(serial, ',');
+        json_uint(serial, "mh", sm->hash, more);
+}
+
+static struct meta_client* find_client(const struct Serial *serial)
+{
+        for (size_t i = 0; i < ARRAY_LEN(state.clients); ++i)
+                if (serial == state.clients[i].serial)
+                        return state.clients + i;
+
+        return NULL;
+}
+
+void sample_meta_set_client_hash(const struct Serial *serial,
+                                 const uint32_t hash)
+{
+        lock();
+        struct meta_client *client = find_client(serial);
+        if (!client) {
+                client = state.clients + state.next_client;
+                state.next_client = (state.next_client + 1) %
+                        ARRAY_LEN(state.clients);
+        }
+
+        client->serial = serial;
+        client->hash = hash;
+        unlock();
+}
+
+bool sample_meta_client_has(const struct Serial *serial, const uint32_t hash)
+{
+        lock();
+        const struct meta_client *client = find_client(serial);
+        const bool has = client && hash == client->hash;
+        unlock();
+
+        return has;
+}
+
+void sample_meta_reset_client(const struct Serial *serial)
+{
+        lock();
+        struct meta_client *client = find_client(serial);
+        if (client)
+                client->serial = NULL;
+        unlock();
+}
@@ -0,0 +1,220 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "api.h"
+#include "channel_registry.h"
+#include "loggerConfig.h"
+#include "printk.h"
+#include "stream_profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_PFX	"[stream_profile] "
+#define MASK_WORD_BITS	32
+
+void stream_profile_reset_config(struct stream_profile_config *cfg)
+{
+        memset(cfg, 0, sizeof(struct stream_profile_config));
+        cfg->sample_rate = SAMPLE_DISABLED;
+}
+
+void stream_profile_get_config(const struct stream_profile_config *cfg,
+                               struct Serial *serial, const bool more)
+{
+        json_objStartString(serial, "prof");
+        json_int(serial, "sr", decodeSampleRate(cfg->sample_rate), 1);
+        json_arrayStart(serial, "chans");
+        for (size_t i = 0; i < cfg->channel_count; ++i)
+                json_arrayElementString(serial, cfg->channels[i],
+                                        i + 1 < cfg->channel_count);
+        json_arrayEnd(serial, 1);
+        json_uint(serial, "batch", cfg->batch_samples, 1);
+        json_uint(serial, "batchMs", cfg->batch_ms, 1);
+        json_uint(serial, "laps", cfg->lap_summary, 0);
+        json_objEnd(serial, more);
+}
+
+/*
+ * jsmn_find_node keeps searching past the end of the object it starts
+ * in, so only accept fields that start inside of it.
+ */
+static const jsmntok_t* find_field_value(const jsmntok_t *obj,
+                                         const char *name)
+{
+        const jsmntok_t *field = jsmn_find_node(obj + 1, name);
+        return field && field->start < obj->end ? field + 1 : NULL;
+}
+
+bool stream_profile_set_config(struct stream_profile_config *cfg,
+                               const jsmntok_t *json)
+{
+        if (JSMN_OBJECT != json->type)
+                return false;
+
+        const jsmntok_t *chans = find_field_value(json, "chans");
+        if (chans) {
+                if (JSMN_ARRAY != chans->type ||
+                    chans->size > STREAM_PROFILE_MAX_CHANNELS)
+                        return false;
+
+                /* Only flat arrays of names, so elements follow in order */
+                const jsmntok_t *name = chans + 1;
+                for (int i = 0; i < chans->size; ++i, ++name)
+                        if (JSMN_STRING != name->type)
+                                return false;
+
+                name = chans + 1;
+                for (int i = 0; i < chans->size; ++i, ++name)
+                        jsmn_decode_string(cfg->channels[i],
+                                           jsmn_trimData(name)->data,
+                                           DEFAULT_LABEL_LENGTH);
+
+                cfg->channel_count = (unsigned char) chans->size;
+        }
+
+        const jsmntok_t *sr = find_field_value(json, "sr");
+        if (sr) {
+                if (JSMN_PRIMITIVE != sr->type)
+                        return false;
+
+                cfg->sample_rate = encodeSampleRate(
+                        atoi(jsmn_trimData(sr)->data));
+        }
+
+        const jsmntok_t *batch = find_field_value(json, "batch");
+        if (batch) {
+                if (JSMN_PRIMITIVE != batch->type)
+                        return false;
+
+                const int samples = atoi(jsmn_trimData(batch)->data);
+                if (samples < 0 || samples > STREAM_PROFILE_MAX_BATCH)
+                        return false;
+
+                cfg->batch_samples = (unsigned char) samples;
+        }
+
+        const jsmntok_t *batch_ms = find_field_value(json, "batchMs");
+        if (batch_ms) {
+                if (JSMN_PRIMITIVE != batch_ms->type)
+                        return false;
+
+                const int ms = atoi(jsmn_trimData(batch_ms)->data);
+                if (ms < 0 || ms > UINT16_MAX)
+                        return false;
+
+                cfg->batch_ms = (unsigned short) ms;
+        }
+
+        const jsmntok_t *laps = find_field_value(json, "laps");
+        if (laps) {
+                if (JSMN_PRIMITIVE != laps->type)
+                        return false;
+
+                const int mode = atoi(jsmn_trimData(laps)->data);
+                if (mode < STREAM_LAP_SUMMARY_OFF ||
+                    mode > STREAM_LAP_SUMMARY_ONLY)
+                        return false;
+
+                cfg->lap_summary = (unsigned char) mode;
+        }
+
+        return true;
+}
+
+int stream_profile_sample_rate(const struct stream_profile_config *cfg,
+                               const int link_max)
+{
+        /* Unset, or faster than the link can go */
+        if (SAMPLE_DISABLED == cfg->sample_rate ||
+            isHigherSampleRate(cfg->sample_rate, link_max))
+                return link_max;
+
+        return cfg->sample_rate;
+}
+
+void stream_profile_init(struct stream_profile *sp,
+                         const struct stream_profile_config *cfg)
+{
+        /* Every channel at the link's rate, one sample per message */
+        static const struct stream_profile_config default_config;
+
+        memset(sp, 0, sizeof(struct stream_profile));
+        sp->cfg = cfg ? cfg : &default_config;
+}
+
+static void build_mask(struct stream_profile *sp, const struct sample *s)
+{
+        const struct stream_profile_config *cfg = sp->cfg;
+
+        memset(&sp->mask, 0, sizeof(sp->mask));
+        for (size_t i = 0; i < cfg->channel_count; ++i) {
+                const int idx = channel_registry_find(s, cfg->channels[i]);
+
+                /* Channels that aren't enabled right now are just left out */
+                if (CHANNEL_REGISTRY_INVALID_INDEX == idx ||
+                    idx >= CHANNEL_MASK_WORDS * MASK_WORD_BITS) {
+                        pr_debug_str_msg(LOG_PFX "Channel not streamed: ",
+                                         cfg->channels[i]);
+                        continue;
+                }
+
+                sp->mask.bits[idx / MASK_WORD_BITS] |=
+                        1u << (idx % MASK_WORD_BITS);
+        }
+}
+
+const struct channel_mask* stream_profile_mask(struct stream_profile *sp,
+                                               const struct sample *s)
+{
+        if (!sp || !sp->cfg || 0 == sp->cfg->channel_count)
+                return NULL;
+
+        /* Version 0 can't be told apart from a change, so always build */
+        const unsigned int version = channel_registry_version();
+        if (0 == version || version != sp->version) {
+                build_mask(sp, s);
+                sp->version = version;
+        }
+
+        return &sp->mask;
+}
+
+bool channel_mask_has(const struct channel_mask *mask, const size_t idx)
+{
+        if (!mask)
+                return true;
+
+        if (idx >= CHANNEL_MASK_WORDS * MASK_WORD_BITS)
+                return false;
+
+        return mask->bits[idx / MASK_WORD_BITS] & (1u << (idx % MASK_WORD_BITS));
+}
+
+bool channel_mask_equal(const struct channel_mask *a,
+                        const struct channel_mask *b)
+{
+        if (!a || !b)
+                return a == b;
+
+        return 0 == memcmp(a->bits, b->bits, sizeof(a->bits));
+}
@@ -0,0 +1,233 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "channel_registry.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "mem_mang.h"
+#include "printk.h"
+#include "sample_frame.h"
+#include "telemetry_backlog.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[backlog] "
+
+struct record_header {
+        uint32_t seq;
+        uint16_t len;
+};
+
+static void lock(struct telemetry_backlog *bl)
+{
+        xSemaphoreTake(bl->mutex, portMAX_DELAY);
+}
+
+static void unlock(struct telemetry_backlog *bl)
+{
+        xSemaphoreGive(bl->mutex);
+}
+
+bool telemetry_backlog_init(struct telemetry_backlog *bl, const size_t size,
+                            const struct stream_profile_config *cfg,
+                            const int rate)
+{
+        memset(bl, 0, sizeof(struct telemetry_backlog));
+
+        bl->rb = ring_buffer_create(size);
+        if (!bl->rb) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", size);
+                return false;
+        }
+
+        bl->mutex = xSemaphoreCreateMutex();
+        bl->rate = rate;
+        stream_profile_init(&bl->profile, cfg);
+
+        return true;
+}
+
+bool telemetry_backlog_enabled(const struct telemetry_backlog *bl)
+{
+        return bl && NULL != bl->rb;
+}
+
+void telemetry_backlog_set_capturing(struct telemetry_backlog *bl,
+                                     const bool capturing)
+{
+        if (telemetry_backlog_enabled(bl))
+                bl->capturing = capturing;
+}
+
+bool telemetry_backlog_capturing(const struct telemetry_backlog *bl)
+{
+        return telemetry_backlog_enabled(bl) && bl->capturing;
+}
+
+/* Records of an old channel layout can't be decoded any more */
+static void check_version(struct telemetry_backlog *bl)
+{
+        const unsigned int version = channel_registry_version();
+        if (version == bl->version)
+                return;
+
+        if (bl->records)
+                pr_info_int_msg(LOG_PFX "Layout changed.  Dropped: ",
+                                bl->records);
+
+        bl->dropped += bl->records;
+        bl->records = 0;
+        bl->version = version;
+        ring_buffer_clear(bl->rb);
+}
+
+static void drop_oldest(struct telemetry_backlog *bl)
+{
+        struct record_header hdr;
+
+        ring_buffer_get(bl->rb, &hdr, sizeof(hdr));
+        ring_buffer_get(bl->rb, NULL, hdr.len);
+        --bl->records;
+        ++bl->dropped;
+}
+
+bool telemetry_backlog_capture(struct telemetry_backlog *bl,
+                               const struct sample *s)
+{
+        if (!telemetry_backlog_capturing(bl) ||
+            !should_sample(s->ticks, bl->rate))
+                return false;
+
+        const struct channel_mask *mask = stream_profile_mask(&bl->profile, s);
+        struct sample_frame *f = sample_frame_acquire(s, mask);
+        if (!f)
+                return false;
+
+        struct record_header hdr = {0, (uint16_t) f->bin_length};
+        const size_t len = sizeof(hdr) + f->bin_length;
+        bool added = false;
+
+        lock(bl);
+        if (len <= ring_buffer_capacity(bl->rb)) {
+                check_version(bl);
+                while (ring_buffer_bytes_free(bl->rb) < len)
+                        drop_oldest(bl);
+
+                hdr.seq = bl->next_seq++;
+                ring_buffer_write(bl->rb, &hdr, sizeof(hdr));
+                ring_buffer_write(bl->rb, f->bin, f->bin_length);
+                ++bl->records;
+                ++bl->captured;
+                added = true;
+        }
+        unlock(bl);
+
+        sample_frame_release(f);
+        return added;
+}
+
+uint32_t telemetry_backlog_next_seq(struct telemetry_backlog *bl)
+{
+        lock(bl);
+        const uint32_t seq = bl->next_seq++;
+        unlock(bl);
+
+        return seq;
+}
+
+size_t telemetry_backlog_pending(struct telemetry_backlog *bl)
+{
+        if (!telemetry_backlog_enabled(bl))
+                return 0;
+
+        lock(bl);
+        const size_t records = bl->records;
+        unlock(bl);
+
+        return records;
+}
+
+bool telemetry_backlog_should_drain(struct telemetry_backlog *bl,
+                                    const size_t tx_pending,
+                                    const size_t tx_capacity)
+{
+        if (!telemetry_backlog_enabled(bl) || bl->capturing)
+                return false;
+
+        /* No capacity means we can't tell, so assume there is room */
+        if (tx_capacity &&
+            tx_pending * 100 >= tx_capacity * TELEMETRY_BACKLOG_DRAIN_TX_PCT)
+                return false;
+
+        return 0 < telemetry_backlog_pending(bl);
+}
+
+static bool reserve_scratch(struct telemetry_backlog *bl, const size_t len)
+{
+        if (len <= bl->scratch_cap)
+                return true;
+
+        portFree(bl->scratch);
+        bl->scratch = portMalloc(len);
+        bl->scratch_cap = bl->scratch ? len : 0;
+        if (!bl->scratch)
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", len);
+
+        return NULL != bl->scratch;
+}
+
+bool telemetry_backlog_send(struct telemetry_backlog *bl,
+                            struct Serial *serial,
+                            const struct sample *layout,
+                            const struct channel_mask *mask,
+                            const unsigned int tick)
+{
+        if (!telemetry_backlog_enabled(bl))
+                return false;
+
+        struct record_header hdr;
+
+        lock(bl);
+        check_version(bl);
+        if (0 == bl->records) {
+                unlock(bl);
+                return false;
+        }
+
+        ring_buffer_get(bl->rb, &hdr, sizeof(hdr));
+        const bool have_room = reserve_scratch(bl, hdr.len);
+        ring_buffer_get(bl->rb, have_room ? bl->scratch : NULL, hdr.len);
+        --bl->records;
+        if (have_room)
+                ++bl->backfilled;
+        else
+                ++bl->dropped;
+        unlock(bl);
+
+        if (!have_room)
+                return false;
+
+        if (!api_send_backfill_record(serial, layout, mask, tick, hdr.seq,
+                                      bl->scratch, hdr.len))
+                pr_warning(LOG_PFX "Record does not fit the layout\r\n");
+
+        return true;
+}
@@ -0,0 +1,214 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "channel_registry.h"
+#include "loggerApi.h"
+#include "mem_mang.h"
+#include "printk.h"
+#include "sample_binary.h"
+#include "sample_frame.h"
+#include "telemetry_batch.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[batch] "
+
+/* Each body in the buffer follows its u16 length */
+#define LEN_BYTES	2
+
+static size_t max_samples(const struct telemetry_batch *tb)
+{
+        const size_t samples = tb->cfg->batch_samples;
+        return samples ? samples : STREAM_PROFILE_MAX_BATCH;
+}
+
+bool telemetry_batch_init(struct telemetry_batch *tb,
+                          const struct stream_profile_config *cfg)
+{
+        memset(tb, 0, sizeof(struct telemetry_batch));
+        tb->cfg = cfg;
+
+        if (cfg->batch_samples <= 1 && 0 == cfg->batch_ms)
+                return true;
+
+        tb->buff = portMalloc(TELEMETRY_BATCH_BUFFER_SIZE);
+        if (!tb->buff) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ",
+                                 TELEMETRY_BATCH_BUFFER_SIZE);
+                return false;
+        }
+
+        return true;
+}
+
+bool telemetry_batch_enabled(const struct telemetry_batch *tb)
+{
+        return tb && NULL != tb->buff;
+}
+
+void telemetry_batch_reset(struct telemetry_batch *tb)
+{
+        if (!tb)
+                return;
+
+        tb->used = 0;
+        tb->count = 0;
+        tb->prev_len = 0;
+}
+
+bool telemetry_batch_due(const struct telemetry_batch *tb,
+                         const tiny_millis_t now)
+{
+        return telemetry_batch_enabled(tb) && tb->count &&
+                tb->cfg->batch_ms && now - tb->started >= tb->cfg->batch_ms;
+}
+
+/*
+ * Bodies of an old channel layout can't be decoded any more; the ring
+ * sample they were rendered from has been cleared or laid out again.
+ * @return true if the batch was dropped.
+ */
+static bool drop_stale(struct telemetry_batch *tb)
+{
+        if (!tb->count || tb->version == channel_registry_version())
+                return false;
+
+        pr_debug_int_msg(LOG_PFX "Layout changed.  Dropped: ", tb->count);
+        telemetry_batch_reset(tb);
+        return true;
+}
+
+void telemetry_batch_flush(struct telemetry_batch *tb, struct Serial *serial)
+{
+        if (!telemetry_batch_enabled(tb) || 0 == tb->count)
+                return;
+
+        if (drop_stale(tb))
+                return;
+
+        if (!api_send_sample_batch(serial, tb->layout, tb->mask, tb->tick,
+                                   tb->sequenced ? &tb->seq : NULL,
+                                   tb->send_meta, tb->buff, tb->used))
+                pr_warning(LOG_PFX "Sample does not fit the layout\r\n");
+
+        telemetry_batch_reset(tb);
+}
+
+static bool keep_prev(struct telemetry_batch *tb, const uint8_t *body,
+                      const size_t len)
+{
+        if (len > tb->prev_cap) {
+                portFree(tb->prev);
+                tb->prev = portMalloc(len);
+                tb->prev_cap = tb->prev ? len : 0;
+        }
+
+        if (!tb->prev) {
+                pr_error_int_msg(LOG_PFX "Failed to allocate bytes: ", len);
+                tb->prev_len = 0;
+                return false;
+        }
+
+        memcpy(tb->prev, body, len);
+        tb->prev_len = len;
+        return true;
+}
+
+static void start_batch(struct telemetry_batch *tb, const struct sample *s,
+                        const struct channel_mask *mask,
+                        const unsigned int tick, const uint32_t *seq,
+                        const bool send_meta, const tiny_millis_t now)
+{
+        tb->started = now;
+        tb->tick = tick;
+        tb->seq = seq ? *seq : 0;
+        tb->sequenced = NULL != seq;
+        tb->send_meta = send_meta;
+        tb->layout = s;
+        tb->mask = mask;
+        tb->version = channel_registry_version();
+}
+
+static bool belongs_in_batch(const struct telemetry_batch *tb,
+                             const struct channel_mask *mask,
+                             const bool send_meta, const size_t len,
+                             const tiny_millis_t now)
+{
+        /* Metadata only goes at the start of a batch */
+        return !send_meta && mask == tb->mask &&
+                tb->used + LEN_BYTES + len <= TELEMETRY_BATCH_BUFFER_SIZE &&
+                !telemetry_batch_due(tb, now);
+}
+
+void telemetry_batch_add(struct telemetry_batch *tb, struct Serial *serial,
+                         const struct sample *s,
+                         const struct channel_mask *mask,
+                         const unsigned int tick, const uint32_t *seq,
+                         const bool send_meta, const tiny_millis_t now)
+{
+        if (!telemetry_batch_enabled(tb))
+                return;
+
+        drop_stale(tb);
+
+        struct sample_frame *f = sample_frame_acquire(s, mask);
+        if (!f)
+                return;
+
+        if (tb->count && !belongs_in_batch(tb, mask, send_meta,
+                                           f->bin_length, now))
+                telemetry_batch_flush(tb, serial);
+
+        if (LEN_BYTES + f->bin_length > TELEMETRY_BATCH_BUFFER_SIZE) {
+                /* Too big to ever batch, so it goes on its own */
+                if (seq)
+                        api_send_sequenced_sample_record(serial, s, tick, *seq,
+                                                         send_meta, mask);
+                else
+                        api_send_sample_record(serial, s, tick, send_meta,
+                                               mask);
+                sample_frame_release(f);
+                return;
+        }
+
+        if (0 == tb->count)
+                start_batch(tb, s, mask, tick, seq, send_meta, now);
+
+        uint8_t *entry = tb->buff + tb->used;
+        const size_t len = sample_binary_delta(entry + LEN_BYTES, s, mask,
+                                               tb->count ? tb->prev : NULL,
+                                               tb->prev_len, f->bin,
+                                               f->bin_length);
+
+        if (len) {
+                entry[0] = (uint8_t) len;
+                entry[1] = (uint8_t) (len >> 8);
+                tb->used += LEN_BYTES + len;
+                ++tb->count;
+        }
+        const bool have_prev = len && keep_prev(tb, f->bin, f->bin_length);
+        sample_frame_release(f);
+
+        /* Without the last sample the next one can't be a delta */
+        if (tb->count >= max_samples(tb) || !have_prev)
+                telemetry_batch_flush(tb, serial);
+}
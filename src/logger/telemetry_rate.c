@@ -0,0 +1,130 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "capabilities.h"
+#include "loggerConfig.h"
+#include "macros.h"
+#include "printk.h"
+#include "telemetry_rate.h"
+
+#include <string.h>
+
+#define LOG_PFX	"[telem_rate] "
+
+/* The rates we step through, slowest first */
+static const int rates[] = {
+        SAMPLE_1Hz,
+        SAMPLE_5Hz,
+        SAMPLE_10Hz,
+        SAMPLE_25Hz,
+        SAMPLE_50Hz,
+};
+
+static int level_rate(const struct telemetry_rate *tr, const size_t level)
+{
+        return level == tr->max_level ? tr->max_rate : rates[level];
+}
+
+static void set_level(struct telemetry_rate *tr, const size_t level,
+                      const tiny_millis_t now)
+{
+        tr->level = level;
+        tr->rate = level_rate(tr, level);
+        tr->changed_at = now;
+        tr->clear_since = now;
+
+        pr_info_str_msg(LOG_PFX "Stream: ", tr->name);
+        pr_info_int_msg(LOG_PFX "Rate (Hz): ", telemetry_rate_hz(tr));
+}
+
+void telemetry_rate_init(struct telemetry_rate *tr, const char *name,
+                         const int max_rate)
+{
+        memset(tr, 0, sizeof(struct telemetry_rate));
+        tr->name = name;
+        tr->max_rate = max_rate;
+
+        /* Fastest step that is no faster than the max we were given */
+        for (size_t i = 0; i < ARRAY_LEN(rates) && rates[i] >= max_rate; ++i)
+                tr->max_level = i;
+
+        tr->level = tr->max_level;
+        tr->rate = max_rate;
+}
+
+void telemetry_rate_reset(struct telemetry_rate *tr, const tiny_millis_t now)
+{
+        tr->level = tr->max_level;
+        tr->rate = tr->max_rate;
+        tr->dropped_seen = tr->dropped;
+        tr->latency_ms = 0;
+        tr->latency_max_ms = 0;
+        tr->changed_at = now;
+        tr->clear_since = now;
+}
+
+bool telemetry_rate_should_send(const struct telemetry_rate *tr,
+                                const size_t ticks)
+{
+        return should_sample(ticks, tr->rate);
+}
+
+void telemetry_rate_dropped(struct telemetry_rate *tr)
+{
+        ++tr->dropped;
+}
+
+void telemetry_rate_sent(struct telemetry_rate *tr, const size_t tx_pending,
+                         const size_t tx_capacity, const uint32_t write_ms,
+                         const tiny_millis_t now)
+{
+        ++tr->sent;
+
+        /* Smooth out the latency a bit so the status is readable */
+        tr->latency_ms = (tr->latency_ms * 7 + write_ms) / 8;
+        tr->latency_max_ms = MAX(tr->latency_max_ms, write_ms);
+
+        const uint32_t dropped = tr->dropped;
+        const uint32_t period_ms = tr->rate * 1000 / TICK_RATE_HZ;
+        const bool backed_up = dropped != tr->dropped_seen ||
+                tx_pending * 100 >= tx_capacity * TELEMETRY_RATE_TX_FULL_PCT ||
+                write_ms * 2 > period_ms;
+        tr->dropped_seen = dropped;
+
+        if (backed_up) {
+                tr->clear_since = now;
+                if (0 < tr->level && now - tr->changed_at >=
+                    TELEMETRY_RATE_STEP_DOWN_HOLDOFF_MS)
+                        set_level(tr, tr->level - 1, now);
+
+                return;
+        }
+
+        if (tr->level < tr->max_level &&
+            now - tr->clear_since >= TELEMETRY_RATE_STEP_UP_MS)
+                set_level(tr, tr->level + 1, now);
+}
+
+int telemetry_rate_hz(const struct telemetry_rate *tr)
+{
+        return decodeSampleRate(tr->rate);
+}
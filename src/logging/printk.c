@@ -19,39 +19,217 @@
  * this code. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "FreeRTOS.h"
 #include "capabilities.h"
 #include "macros.h"
 #include <string.h>
 #include "modp_numtoa.h"
 #include "printk.h"
-#include "ts_ring_buff.h"
 #include "serial.h"
+#include "task.h"
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #define IF_LEVEL_GT_CURR_LEVEL_RET_ZERO(l) if ((l) > curr_level) return 0
 
+/* Longest piece of text that fits in one record */
+#define MAX_TEXT_LEN	UINT8_MAX
+
+/*
+ * The log is a ring of records.  Text is stored as is.  Messages that
+ * take a value are stored as the message pointer plus the raw value and
+ * only get formatted when the log is drained.  This keeps logging in
+ * hot paths down to a short copy inside a critical section.
+ */
+enum record_type {
+        RECORD_TEXT,
+        RECORD_INT_MSG,
+        RECORD_FLOAT_MSG,
+        RECORD_BOOL_MSG,
+};
+
+struct record_header {
+        uint8_t type;
+        /* Length of the text that follows.  Only used by RECORD_TEXT */
+        uint8_t len;
+};
+
+struct value_record {
+        const char *msg;
+        union {
+                int i;
+                float f;
+                bool b;
+        } value;
+};
+
 static enum log_level curr_level = INFO;
-static struct ts_ring_buff *log_buff;
 
+static struct {
+        char data[LOG_BUFFER_SIZE];
+        size_t head;
+        size_t tail;
+        size_t used;
+} log_buff;
+
+static void ring_write(const void *src, size_t len)
+{
+        const char *ptr = src;
+        for (; len; --len) {
+                log_buff.data[log_buff.head] = *ptr++;
+                log_buff.head = (log_buff.head + 1) % LOG_BUFFER_SIZE;
+        }
+}
+
+static void ring_read(void *dst, size_t len)
+{
+        char *ptr = dst;
+        for (; len; --len) {
+                if (ptr)
+                        *ptr++ = log_buff.data[log_buff.tail];
+                log_buff.tail = (log_buff.tail + 1) % LOG_BUFFER_SIZE;
+        }
+}
+
+static size_t record_size(const struct record_header *hdr)
+{
+        return sizeof(*hdr) + (RECORD_TEXT == hdr->type ?
+                               hdr->len : sizeof(struct value_record));
+}
+
+/*
+ * Pops the oldest record.  The data may be NULL to discard it.  Must be
+ * called with the log locked and at least one record present.
+ */
+static void pop_record(struct record_header *hdr, void *data)
+{
+        ring_read(hdr, sizeof(*hdr));
+        const size_t size = record_size(hdr);
+        ring_read(data, size - sizeof(*hdr));
+        log_buff.used -= size;
+}
+
+/*
+ * Appends a record, dropping the oldest whole records if we need room.
+ * Partial records are never left behind since the reader trusts the
+ * message pointers it finds.
+ */
+static void push_record(const struct record_header *hdr, const void *data)
+{
+        const size_t size = record_size(hdr);
+
+        taskENTER_CRITICAL();
+        while (LOG_BUFFER_SIZE - log_buff.used < size) {
+                struct record_header old;
+                pop_record(&old, NULL);
+        }
+
+        ring_write(hdr, sizeof(*hdr));
+        ring_write(data, size - sizeof(*hdr));
+        log_buff.used += size;
+        taskEXIT_CRITICAL();
+}
+
+static int push_text(const char *msg, size_t len)
+{
+        const int total = len;
+
+        while (len) {
+                const struct record_header hdr = {
+                        .type = RECORD_TEXT,
+                        .len = MIN(len, MAX_TEXT_LEN),
+                };
+
+                push_record(&hdr, msg);
+                msg += hdr.len;
+                len -= hdr.len;
+        }
+
+        return total;
+}
+
+static int push_value(const enum record_type type,
+                      const struct value_record *vr)
+{
+        const struct record_header hdr = {
+                .type = type,
+                .len = 0,
+        };
+
+        push_record(&hdr, vr);
+        return 1;
+}
+
+static size_t write_text(struct Serial *s, const char *text,
+                         const size_t len, const int escape)
+{
+        if (escape) {
+                put_escapedString(s, text, len);
+        } else {
+                serial_write_buff(s, text, len);
+        }
+
+        return len;
+}
+
+static size_t write_value_record(struct Serial *s, const enum record_type type,
+                                 const struct value_record *vr,
+                                 const int escape)
+{
+        char buf[24];
+        const char *value = buf;
+
+        switch (type) {
+        case RECORD_INT_MSG:
+                modp_itoa10(vr->value.i, buf);
+                break;
+        case RECORD_FLOAT_MSG:
+                modp_ftoa(vr->value.f, buf, 6);
+                break;
+        case RECORD_BOOL_MSG:
+                value = vr->value.b ? "true" : "false";
+                break;
+        default:
+                return 0;
+        }
+
+        return write_text(s, vr->msg, strlen(vr->msg), escape) +
+                write_text(s, value, strlen(value), escape) +
+                write_text(s, "\r\n", 2, escape);
+}
+
+/**
+ * Drains the log to the given serial port, formatting any deferred
+ * records as it goes.
+ * @return The number of characters of log text written.
+ */
 size_t read_log_to_serial(struct Serial *s, int escape)
 {
-        char buff[16];
         size_t read = 0;
 
         while(true) {
-                size_t bytes = ts_ring_buff_get(log_buff, &buff,
-                                                ARRAY_LEN(buff) - 1);
-                if (0 == bytes)
+                struct record_header hdr;
+                union {
+                        char text[MAX_TEXT_LEN];
+                        struct value_record vr;
+                } data;
+
+                taskENTER_CRITICAL();
+                const bool empty = 0 == log_buff.used;
+                if (!empty)
+                        pop_record(&hdr, &data);
+                taskEXIT_CRITICAL();
+
+                if (empty)
                         break;
 
-                buff[bytes] = 0;
-                read += bytes;
-                if (escape) {
-                        put_escapedString(s, buff, bytes);
+                if (RECORD_TEXT == hdr.type) {
+                        read += write_text(s, data.text, hdr.len, escape);
                 } else {
-                        serial_write_s(s, buff);
+                        read += write_value_record(s, hdr.type, &data.vr,
+                                                   escape);
                 }
         }
 
@@ -60,13 +238,10 @@ size_t read_log_to_serial(struct Serial *s, int escape)
 
 int writek(const char *msg)
 {
-        if (!log_buff)
-                log_buff = ts_ring_buff_create(LOG_BUFFER_SIZE);
-
         if (NULL == msg)
                 return 0;
 
-        return ts_ring_buff_put(log_buff, msg, strlen(msg));
+        return push_text(msg, strlen(msg));
 }
 
 int writek_crlf()
@@ -76,7 +251,7 @@ int writek_crlf()
 
 int writek_char(char c)
 {
-        return ts_ring_buff_put(log_buff, &c, 1);
+        return push_text(&c, 1);
 }
 
 int writek_int(int value)
@@ -88,7 +263,7 @@ int writek_int(int value)
 
 int writek_float(float value)
 {
-        char buf[20];
+        char buf[24];
         modp_ftoa(value, buf, 6);
         return writek(buf);
 }
@@ -120,7 +295,11 @@ int printk_int(enum log_level level, int value)
 int printk_int_msg(enum log_level level, const char *msg, int value)
 {
         IF_LEVEL_GT_CURR_LEVEL_RET_ZERO(level);
-        return writek(msg) + writek_int(value) + writek_crlf();
+        const struct value_record vr = {
+                .msg = msg,
+                .value.i = value,
+        };
+        return push_value(RECORD_INT_MSG, &vr);
 }
 
 int printk_float(enum log_level level, float value)
@@ -132,7 +311,11 @@ int printk_float(enum log_level level, float value)
 int printk_float_msg(enum log_level level, const char *msg, float value)
 {
         IF_LEVEL_GT_CURR_LEVEL_RET_ZERO(level);
-        return writek(msg) + writek_float(value) + writek_crlf();
+        const struct value_record vr = {
+                .msg = msg,
+                .value.f = value,
+        };
+        return push_value(RECORD_FLOAT_MSG, &vr);
 }
 
 int printk_str_msg(enum log_level level, const char *msg, const char *value)
@@ -144,8 +327,11 @@ int printk_str_msg(enum log_level level, const char *msg, const char *value)
 int printk_bool_msg(enum log_level level, const char *msg, const bool value)
 {
         IF_LEVEL_GT_CURR_LEVEL_RET_ZERO(level);
-        const char* bool_value = value ? "true" : "false";
-        return writek(msg) + writek(bool_value) + writek_crlf();
+        const struct value_record vr = {
+                .msg = msg,
+                .value.b = value,
+        };
+        return push_value(RECORD_BOOL_MSG, &vr);
 }
 
 enum log_level get_log_level()
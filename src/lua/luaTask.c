@@ -38,6 +38,7 @@
 #include "semphr.h"
 #include "task.h"
 #include "taskUtil.h"
+#include "task_stats.h"
 #include "virtual_channel.h"
 #include "watchdog.h"
 #include <math.h>
@@ -291,8 +292,16 @@ static void lua_task(void *params)
 			if (xSemaphoreTake(state.lua_signal, wake_tick - curr_tick))
 				continue;
 
-                wake_tick = xTaskGetTickCount() + state.callback_interval;
+                /* How long after it was due onTick gets to run */
+                const portTickType now_tick = xTaskGetTickCount();
+                if (wake_tick)
+                        task_stats_late(TASK_STATS_LUA,
+                                        ticksToMs(now_tick - wake_tick) * 1000);
+
+                wake_tick = now_tick + state.callback_interval;
+                task_stats_begin(TASK_STATS_LUA);
                 const int rc = lua_invocation(&rs);
+                task_stats_end(TASK_STATS_LUA);
 
                 /* If its a known unrecoverable, fail fast */
                 switch (rc) {
@@ -472,7 +481,11 @@ size_t lua_task_set_callback_freq(const size_t freq)
         if (LUA_MAXIMUM_ONTICK_HZ < freq || 0 == freq)
                 return 0;
 
-        return state.callback_interval = msToTicks(TICK_RATE_HZ / freq);
+        state.callback_interval = msToTicks(TICK_RATE_HZ / freq);
+        task_stats_set_budget(TASK_STATS_LUA,
+                              ticksToMs(state.callback_interval) * 1000);
+
+        return state.callback_interval;
 }
 
 size_t lua_task_get_callback_freq()
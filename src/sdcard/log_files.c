@@ -0,0 +1,262 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api.h"
+#include "ff.h"
+#include "log_files.h"
+#include "logger.h"
+#include "macros.h"
+#include "mem_mang.h"
+#include "printk.h"
+#include "sdcard.h"
+#include "serial.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define LOG_PFX			"[log_files] "
+#define LOG_FILES_READ_SIZE	1024
+
+static const char hex[] = "0123456789abcdef";
+
+/* Matches *.log, ignoring case.  Nothing with a path in it */
+static bool is_log_name(const char *name)
+{
+        static const char ext[] = ".LOG";
+        const size_t len = strlen(name);
+        const size_t ext_len = ARRAY_LEN(ext) - 1;
+
+        if (len <= ext_len || strpbrk(name, "/\\:"))
+                return false;
+
+        for (size_t i = 0; i < ext_len; ++i)
+                if (ext[i] != toupper((int) name[len - ext_len + i]))
+                        return false;
+
+        return true;
+}
+
+static bool is_log_file(const FILINFO *fno)
+{
+        if (fno->fattrib & (AM_DIR | AM_HID | AM_SYS | AM_VOL))
+                return false;
+
+        return is_log_name(fno->fname);
+}
+
+/*
+ * Mounts the card for the API.  Refuses while a logging session owns it
+ * rather than make the file writer wait on a transfer.
+ */
+static int mount_card(void)
+{
+        if (logging_is_active())
+                return API_ERROR_UNSUPPORTED;
+
+        if (!sdcard_present() || !sdcard_lock(0))
+                return API_ERROR_UNSUPPORTED;
+
+        const int rc = InitFS();
+        if (0 != rc) {
+                pr_warning_int_msg(LOG_PFX "FS init error: ", rc);
+                sdcard_unlock();
+                return API_ERROR_SEVERE;
+        }
+
+        return API_SUCCESS;
+}
+
+static void unmount_card(void)
+{
+        UnmountFS();
+        sdcard_unlock();
+}
+
+int log_files_list(struct Serial *serial, const size_t start,
+                   const size_t count)
+{
+        const size_t max = count && count < LOG_FILES_LIST_MAX ?
+                count : LOG_FILES_LIST_MAX;
+
+        int rc = mount_card();
+        if (API_SUCCESS != rc)
+                return rc;
+
+        DIR dir;
+        FILINFO fno;
+
+        /* No LFN buffer.  The short name is enough to fetch the file */
+        memset(&fno, 0, sizeof(fno));
+
+        if (FR_OK != f_opendir(&dir, "/")) {
+                unmount_card();
+                return API_ERROR_SEVERE;
+        }
+
+        json_objStart(serial);
+        json_objStartString(serial, "logList");
+        json_arrayStart(serial, "files");
+
+        size_t pos = 0;
+        size_t next = 0;
+        size_t listed = 0;
+        bool more = false;
+
+        while (FR_OK == f_readdir(&dir, &fno) && fno.fname[0]) {
+                if (++pos <= start || !is_log_file(&fno))
+                        continue;
+
+                if (listed == max) {
+                        more = true;
+                        break;
+                }
+
+                if (listed++)
+                        serial_write_c(serial, ',');
+
+                json_objStart(serial);
+                json_string(serial, "nm", fno.fname, 1);
+                json_uint(serial, "sz", fno.fsize, 0);
+                json_objEnd(serial, 0);
+                next = pos;
+        }
+
+        f_closedir(&dir);
+        unmount_card();
+
+        json_arrayEnd(serial, 1);
+        json_int(serial, "next", more ? (int) next : -1, 0);
+        json_objEnd(serial, 0);
+        json_objEnd(serial, 0);
+
+        return API_SUCCESS_NO_RETURN;
+}
+
+/* Writes the bytes out as the body of a JSON string, one char per byte */
+static void write_escaped(struct Serial *serial, const char *buf,
+                          const size_t len)
+{
+        for (size_t i = 0; i < len; ++i) {
+                const unsigned char c = buf[i];
+
+                switch (c) {
+                case '\n':
+                        serial_write_s(serial, "\\n");
+                        break;
+                case '\r':
+                        serial_write_s(serial, "\\r");
+                        break;
+                case '\t':
+                        serial_write_s(serial, "\\t");
+                        break;
+                case '"':
+                        serial_write_s(serial, "\\\"");
+                        break;
+                case '\\':
+                        serial_write_s(serial, "\\\\");
+                        break;
+                default:
+                        if (c >= 0x20 && c < 0x7f) {
+                                serial_write_c(serial, c);
+                                break;
+                        }
+
+                        serial_write_s(serial, "\\u00");
+                        serial_write_c(serial, hex[c >> 4]);
+                        serial_write_c(serial, hex[c & 0xf]);
+                        break;
+                }
+        }
+}
+
+int log_files_read(struct Serial *serial, const char *name,
+                   const size_t offset, const size_t len)
+{
+        const size_t max = len && len < LOG_FILES_CHUNK_SIZE ?
+                len : LOG_FILES_CHUNK_SIZE;
+
+        if (!name || !is_log_name(name))
+                return API_ERROR_PARAMETER;
+
+        struct {
+                FIL file;
+                char buf[LOG_FILES_READ_SIZE];
+        } *rd = portMalloc(sizeof(*rd));
+
+        if (!rd) {
+                pr_error(LOG_PFX "Failed to alloc read buffer\r\n");
+                return API_ERROR_SEVERE;
+        }
+
+        int rc = mount_card();
+        if (API_SUCCESS != rc) {
+                portFree(rd);
+                return rc;
+        }
+
+        if (FR_OK != f_open(&rd->file, name, FA_READ)) {
+                rc = API_ERROR_PARAMETER;
+                goto done;
+        }
+
+        const size_t size = f_size(&rd->file);
+        if (offset > size || FR_OK != f_lseek(&rd->file, offset)) {
+                f_close(&rd->file);
+                rc = API_ERROR_PARAMETER;
+                goto done;
+        }
+
+        json_objStart(serial);
+        json_objStartString(serial, "logData");
+        json_escapedString(serial, "nm", name, 1);
+        json_uint(serial, "off", offset, 1);
+        json_uint(serial, "sz", size, 1);
+        json_valueStart(serial, "data");
+        serial_write_c(serial, '"');
+
+        /* Give the card back as soon as a logging session wants it */
+        size_t sent = 0;
+        while (sent < max && !logging_is_active()) {
+                unsigned int read = 0;
+                const FRESULT res = f_read(&rd->file, rd->buf,
+                                           MIN(max - sent, sizeof(rd->buf)),
+                                           &read);
+                if (FR_OK != res || 0 == read)
+                        break;
+
+                write_escaped(serial, rd->buf, read);
+                sent += read;
+        }
+
+        serial_write_s(serial, "\",");
+        json_uint(serial, "len", sent, 0);
+        json_objEnd(serial, 0);
+        json_objEnd(serial, 0);
+
+        f_close(&rd->file);
+        rc = API_SUCCESS_NO_RETURN;
+
+done:
+        unmount_card();
+        portFree(rd);
+        return rc;
+}
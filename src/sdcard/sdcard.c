@@ -25,6 +25,7 @@
 #include <string.h>
 #include "modp_numtoa.h"
 #include "FreeRTOS.h"
+#include "semphr.h"
 #include "task.h"
 #include "taskUtil.h"
 #include "loggerHardware.h"
@@ -34,6 +35,7 @@
 #include "mem_mang.h"
 
 static FATFS *fat_fs = NULL;
+static xSemaphoreHandle fs_mutex = NULL;
 
 void InitFSHardware(void)
 {
@@ -42,10 +44,26 @@ void InitFSHardware(void)
         if (fat_fs == NULL)
                 fat_fs = pvPortMalloc(sizeof(FATFS));
 
-        if (fat_fs == NULL)
+        if (fs_mutex == NULL)
+                fs_mutex = xSemaphoreCreateMutex();
+
+        if (fat_fs == NULL || fs_mutex == NULL)
                 pr_error("sdcard: FatFS init fail\r\n");
 }
 
+bool sdcard_lock(const size_t timeout_ms)
+{
+        if (!fs_mutex)
+                return false;
+
+        return pdTRUE == xSemaphoreTake(fs_mutex, msToTicks(timeout_ms));
+}
+
+void sdcard_unlock(void)
+{
+        xSemaphoreGive(fs_mutex);
+}
+
 static bool is_initialized()
 {
         if (fat_fs)
@@ -89,6 +107,15 @@ void TestSDWrite(struct Serial *serial, int lines, int doFlush, int quiet)
         if(!is_initialized())
                 return;
 
+        /* Logging or a log download may have the card */
+        if (!sdcard_lock(0)) {
+                if (quiet)
+                        put_int(serial, 0);
+                else
+                        serial_write_s(serial, "SD card busy\r\n");
+                return;
+        }
+
         fatFile = pvPortMalloc(sizeof(FIL));
         if (NULL == fatFile) {
                 if (!quiet) serial_write_s(serial,
@@ -185,4 +212,6 @@ exit:
 
         if (fatFile != NULL)
                 vPortFree(fatFile);
+
+        sdcard_unlock();
 }
@@ -19,6 +19,7 @@
  * this code. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "macros.h"
 #include "mem_mang.h"
 #include "printk.h"
 #include "rx_buff.h"
@@ -37,8 +38,12 @@ struct rx_buff {
         char *buff;
         bool msg_ready;
         bool echo;
+        bool json;
 };
 
+/* Characters that terminate a message */
+static const char msg_terms[] = {'\r', '\0'};
+
 /**
  * Clears the contents of an rx_buff struct.
  * @param rxb The rx_buff struct to adjust.
@@ -48,6 +53,7 @@ void rx_buff_clear(struct rx_buff *rxb)
         rxb->idx = 0;
         rxb->buff[0] = 0;
         rxb->msg_ready = false;
+        rxb->json = false;
 }
 
 /**
@@ -100,21 +106,36 @@ void rx_buff_destroy(struct rx_buff *rxb)
  */
 bool rx_buff_read(struct rx_buff *rxb, struct Serial *s, const bool echo)
 {
-        xQueueHandle h = serial_get_rx_queue(s);
-	if (!h)
-		return false;
-
         char c = INVALID_CHAR;
         while (rxb->idx < rxb->cap && !rxb->msg_ready) {
-                const bool rx_status = xQueueReceive(h, &c, 0);
-                if (!rx_status) {
+                /*
+                 * JSON messages are never echoed or edited, so pull in
+                 * the rest of the message in bulk.
+                 */
+                if (rxb->json) {
+                        const int read = serial_read_until_wait(
+                                s, rxb->buff + rxb->idx, rxb->cap - rxb->idx,
+                                msg_terms, ARRAY_LEN(msg_terms), 0);
+                        if (read < 1)
+                                return false;
+
+                        rxb->idx += read;
+                        c = rxb->buff[rxb->idx - 1];
+                        rxb->msg_ready = NULL != memchr(msg_terms, c,
+                                                        sizeof(msg_terms));
+                        continue;
+                }
+
+                if (serial_read_c_wait(s, &c, 0) < 1) {
                         /* If here, no more data to read for now */
                         return false;
                 }
 
                 /* Set echo based on first character */
-                if (0 == rxb->idx)
-                        rxb->echo = echo && '{' != c;
+                if (0 == rxb->idx) {
+                        rxb->json = '{' == c;
+                        rxb->echo = echo && !rxb->json;
+                }
 
                 switch(c) {
                 case 0x08: /* Backspace */
@@ -170,8 +191,8 @@ bool rx_buff_read(struct rx_buff *rxb, struct Serial *s, const bool echo)
         }
 
         /* If there is a \n after the \r, remove it */
-        if ('\r' == c && xQueuePeek(h, &c, 0) && '\n' == c) {
-                xQueueReceive(h, &c, 0);
+        if ('\r' == c && serial_rx_peek_c(s, &c) && '\n' == c) {
+                serial_read_c_wait(s, &c, 0);
                 if (rxb->echo)
                         serial_write_c(s, c);
         }
@@ -27,9 +27,12 @@
 #include "panic.h"
 #include "printk.h"
 #include "projdefs.h"
+#include "ring_buffer.h"
+#include "semphr.h"
 #include "serial.h"
 #include "str_util.h"
 #include "queue.h"
+#include "task.h"
 #include "usart.h"
 #include "usb_comm.h"
 #include <stdarg.h>
@@ -37,8 +40,6 @@
 #include <stdio.h>
 #include <string.h>
 
-static const char invalid_char = INVALID_CHAR;
-
 enum data_dir {
         DATA_DIR_RX,
         DATA_DIR_TX,
@@ -47,7 +48,10 @@ enum data_dir {
 struct Serial {
 	const char *name;
 	xQueueHandle tx_queue;
-	xQueueHandle rx_queue;
+	size_t tx_cap;
+	struct ring_buff *rx_buff;
+	/* Given whenever rx data arrives or the device gets closed */
+	xSemaphoreHandle rx_signal;
 	bool closed;
 
 	config_func_t *config_cb;
@@ -65,7 +69,11 @@ struct Serial {
 
 void serial_purge_rx_queue(struct Serial* s)
 {
-	xQueueReset(s->rx_queue);
+	/*
+	 * Discard by moving the tail only.  The head belongs to the
+	 * producer, which may be an ISR.
+	 */
+	ring_buffer_get(s->rx_buff, NULL, ring_buffer_bytes_used(s->rx_buff));
 }
 
 void serial_purge_tx_queue(struct Serial* s)
@@ -83,14 +91,12 @@ void serial_clear(struct Serial *s)
 }
 
 /**
- * Unblocks our Seral rx queue by putting an invalid character on the
- * front of the queue. This will unblock any task that is waiting on
- * the queue.  Its up to the rx handler below to ensure that we return
- * the correct status code.
+ * Wakes up any task that is waiting on rx data.  Its up to the rx
+ * handlers below to ensure that we return the correct status code.
  */
 static void unblock_rx_queue(struct Serial *s)
 {
-	xQueueSendToFront(s->rx_queue, &invalid_char, 0);
+	xSemaphoreGive(s->rx_signal);
 }
 
 /**
@@ -119,8 +125,12 @@ void serial_reopen(struct Serial* s)
 
 void serial_destroy(struct Serial *s)
 {
-	vQueueDelete(s->tx_queue);
-	vQueueDelete(s->rx_queue);
+	if (s->tx_queue)
+		vQueueDelete(s->tx_queue);
+	if (s->rx_signal)
+		vQueueDelete(s->rx_signal);
+	if (s->rx_buff)
+		ring_buffer_destroy(s->rx_buff);
         portFree(s);
 }
 
@@ -144,10 +154,14 @@ struct Serial* serial_create(const char *name, const size_t tx_cap,
         const unsigned portBASE_TYPE c_size =
                 (unsigned portBASE_TYPE) sizeof(signed portCHAR);
         s->tx_queue = xQueueCreate(tx_cap, c_size);
-        s->rx_queue = xQueueCreate(rx_cap, c_size);
+        s->tx_cap = tx_cap;
+        s->rx_buff = ring_buffer_create(rx_cap);
+        vSemaphoreCreateBinary(s->rx_signal);
+        if (s->rx_signal)
+                xSemaphoreTake(s->rx_signal, 0);
 
         /* If one of these is NULL, then alloc failure.  Handle */
-        if (!s->tx_queue || !s->rx_queue) {
+        if (!s->tx_queue || !s->rx_buff || !s->rx_signal) {
                 serial_destroy(s);
                 return NULL;
         }
@@ -264,6 +278,15 @@ static void log_rx(struct Serial *s, const char data)
         _log(s, DATA_DIR_RX, data);
 }
 
+static void log_rx_buff(struct Serial *s, const char *data, size_t len)
+{
+        if (SERIAL_LOG_TYPE_NONE == s->log_type)
+                return;
+
+        for (; len; --len)
+                log_rx(s, *data++);
+}
+
 static void log_tx(struct Serial *s, const char data)
 {
         _log(s, DATA_DIR_TX, data);
@@ -313,23 +336,94 @@ void serial_flush(struct Serial *s)
         /* STIEG: TODO Figure out how to flush Tx sanely */
 }
 
-int serial_read_c_wait(struct Serial *s, char *c, const size_t delay)
+/**
+ * Waits for rx data to become available.
+ * @return 1 if there is data to read, 0 if we timed out waiting, -1 if
+ * the device is closed.
+ */
+static int wait_rx(struct Serial *s, const size_t delay)
 {
-	if (s->closed)
-		return -1;
+        while (true) {
+                if (s->closed)
+                        return -1;
 
-        if (pdFALSE == xQueueReceive(s->rx_queue, c, delay))
-                return 0;
+                if (ring_buffer_bytes_used(s->rx_buff))
+                        return 1;
 
-	/* Check & handle closure of serial device here */
-	if (*c == invalid_char && s->closed) {
-		/* Unblock the queue for other waiting tasks */
-		unblock_rx_queue(s);
-		return -1;
-	}
+                if (pdFALSE == xSemaphoreTake(s->rx_signal, delay))
+                        return 0;
 
-        log_rx(s, *c);
-        return 1;
+                /* Pass on a close wakeup to any other waiting tasks */
+                if (s->closed) {
+                        unblock_rx_queue(s);
+                        return -1;
+                }
+        }
+}
+
+static const char* find_delim(const char *span, const size_t len,
+                              const char *delims, const size_t delims_len)
+{
+        if (1 == delims_len)
+                return memchr(span, *delims, len);
+
+        for (size_t i = 0; i < len; ++i)
+                if (memchr(delims, span[i], delims_len))
+                        return span + i;
+
+        return NULL;
+}
+
+/**
+ * Copies contiguous spans of rx data out of the rx buffer until either
+ * len bytes are read, the data runs out, or a delimiter is copied.
+ * Each span is scanned and copied in bulk.
+ * @param delims The delimiter characters.  May include '\0'.
+ * @param delims_len Number of delimiter characters.  0 for none.
+ * @param found Set to true if a delimiter was copied.
+ * @return The number of bytes copied.
+ */
+static size_t read_rx_spans(struct Serial *s, char *buff, const size_t len,
+                            const char *delims, const size_t delims_len,
+                            bool *found)
+{
+        size_t read = 0;
+        *found = false;
+
+        while (read < len && !*found) {
+                size_t avail;
+                const char *span =
+                        ring_buffer_dma_read_init(s->rx_buff, &avail);
+                if (!avail)
+                        break;
+
+                size_t n = MIN(avail, len - read);
+                if (delims_len) {
+                        const char *end =
+                                find_delim(span, n, delims, delims_len);
+                        if (end) {
+                                n = end - span + 1;
+                                *found = true;
+                        }
+                }
+
+                memcpy(buff + read, span, n);
+                ring_buffer_dma_read_fini(s->rx_buff, n);
+                log_rx_buff(s, buff + read, n);
+                read += n;
+        }
+
+        return read;
+}
+
+int serial_read_c_wait(struct Serial *s, char *c, const size_t delay)
+{
+        const int status = wait_rx(s, delay);
+        if (status < 1)
+                return status;
+
+        bool found;
+        return read_rx_spans(s, c, 1, NULL, 0, &found);
 }
 
 int serial_read_c(struct Serial *s, char* c)
@@ -338,36 +432,80 @@ int serial_read_c(struct Serial *s, char* c)
 }
 
 /**
- * Reads in a line from a serial device delimeted by \n.  The data is
- * written to buff BUT MAY NOT BE NULL TERMINATED.  NULL termination is the
- * responsibility of the caller.
+ * Reads whatever data is available from a serial device, up to len
+ * bytes, in one call.  Only waits if no data is available.
  * @param s The Serial device to read from.
  * @param buff The buffer to put the data into.
  * @param len The length of the buffer.
- * @param delay The number of ticks to wait.
- * @return Number of characters read.
+ * @param delay The number of ticks to wait for data.
+ * @return Number of characters read, or -1 if the device is closed.
  */
-int serial_read_line_wait(struct Serial *s, char *buff, const size_t len,
-                         const size_t delay)
+int serial_read_buff_wait(struct Serial *s, char *buff, const size_t len,
+                          const size_t delay)
 {
-        int i = 0;
-        for (; i < len; ++i) {
-                switch(serial_read_c_wait(s, buff + i, delay)) {
+        const int status = wait_rx(s, delay);
+        if (status < 1)
+                return status;
+
+        bool found;
+        return read_rx_spans(s, buff, len, NULL, 0, &found);
+}
+
+/**
+ * Reads from a serial device until one of the delimiter characters is
+ * read, the buffer is full, or no data arrives within delay.  The data
+ * is NOT NULL terminated.
+ * @param s The Serial device to read from.
+ * @param buff The buffer to put the data into.
+ * @param len The length of the buffer.
+ * @param delims The delimiter characters.  May include '\0'.
+ * @param delims_len The number of delimiter characters.
+ * @param delay The number of ticks to wait between characters.
+ * @return Number of characters read, including the delimiter, or -1
+ * if the device is closed and nothing was read.
+ */
+int serial_read_until_wait(struct Serial *s, char *buff, const size_t len,
+                           const char *delims, const size_t delims_len,
+                           const size_t delay)
+{
+        size_t read = 0;
+        bool found = false;
+
+        while (read < len && !found) {
+                switch(wait_rx(s, delay)) {
 		default:
 			panic(PANIC_CAUSE_UNREACHABLE);
 			break;
 		case -1:
 			/* If partially read, return what was read. */
-			return i == 0 ? -1 : i;
+			return read == 0 ? -1 : (int) read;
 		case 0:
-			return i;
+			return read;
 		case 1:
-			if ('\n' == buff[i])
-				return ++i;
+			read += read_rx_spans(s, buff + read, len - read,
+					      delims, delims_len, &found);
+			break;
 		}
 	}
 
-        return i;
+        return read;
+}
+
+/**
+ * Reads in a line from a serial device delimeted by \n.  The data is
+ * written to buff BUT MAY NOT BE NULL TERMINATED.  NULL termination is the
+ * responsibility of the caller.  Data that is already buffered is
+ * scanned and copied in bulk; we only block when we run out.
+ * @param s The Serial device to read from.
+ * @param buff The buffer to put the data into.
+ * @param len The length of the buffer.
+ * @param delay The number of ticks to wait between characters.
+ * @return Number of characters read.
+ */
+int serial_read_line_wait(struct Serial *s, char *buff, const size_t len,
+                         const size_t delay)
+{
+        return serial_read_until_wait(s, buff, len, "\n", 1, delay);
 }
 
 int serial_read_line(struct Serial *s, char *l, const size_t len)
@@ -442,9 +580,63 @@ int serial_read_byte(struct Serial *serial, uint8_t *b, const size_t delay)
         return serial_read_c_wait(serial, (char*) b, delay);
 }
 
-xQueueHandle serial_get_rx_queue(struct Serial *s)
+/**
+ * Hands data received by a device driver to the serial device from task
+ * context.  If the rx buffer is full we wait up to delay ticks for
+ * room to free up.
+ * @return The number of bytes accepted.
+ */
+size_t serial_rx_put(struct Serial *s, const void *data, const size_t len,
+                     const size_t delay)
 {
-        return s->rx_queue;
+        const char *ptr = data;
+        size_t put = 0;
+
+        for (size_t waited = 0; ; ++waited) {
+                put += ring_buffer_write(s->rx_buff, ptr + put, len - put);
+                if (put)
+                        xSemaphoreGive(s->rx_signal);
+
+                if (put == len || waited >= delay)
+                        break;
+
+                vTaskDelay(1);
+        }
+
+        return put;
+}
+
+/**
+ * ISR variant of #serial_rx_put.  Never waits.
+ * @param task_woken Set to pdTRUE if a task waiting on the data was
+ * woken.  The caller should yield at the end of the ISR if so.
+ * @return The number of bytes accepted.
+ */
+size_t serial_rx_put_isr(struct Serial *s, const void *data, const size_t len,
+                         portBASE_TYPE *task_woken)
+{
+        const size_t put = ring_buffer_write(s->rx_buff, data, len);
+        if (put)
+                xSemaphoreGiveFromISR(s->rx_signal, task_woken);
+
+        return put;
+}
+
+/**
+ * Looks at the next rx character without consuming it.  Never waits.
+ * @return true if there was a character to look at.
+ */
+bool serial_rx_peek_c(struct Serial *s, char *c)
+{
+        return 1 == ring_buffer_peek(s->rx_buff, c, 1);
+}
+
+/**
+ * @return The number of rx bytes waiting to be read.
+ */
+size_t serial_rx_available(struct Serial *s)
+{
+        return ring_buffer_bytes_used(s->rx_buff);
 }
 
 xQueueHandle serial_get_tx_queue(struct Serial *s)
@@ -452,6 +644,16 @@ xQueueHandle serial_get_tx_queue(struct Serial *s)
         return s->tx_queue;
 }
 
+size_t serial_tx_pending(struct Serial *s)
+{
+        return uxQueueMessagesWaiting(s->tx_queue);
+}
+
+size_t serial_tx_capacity(const struct Serial *s)
+{
+        return s->tx_cap;
+}
+
 void serial_set_name(struct Serial *s, const char *name)
 {
         s->name = name;
@@ -572,9 +774,9 @@ int put_uint(struct Serial *s, const unsigned int n)
 
 int put_float(struct Serial *s, const float f, const int precision)
 {
-        char buf[20];
-        modp_ftoa(f, buf, precision);
-        return serial_write_s(s, buf);
+        char buf[24];
+        const size_t len = modp_ftoa_fixed(f, buf, precision);
+        return serial_write_buff(s, buf, len);
 }
 
 int put_double(struct Serial *s, const double f, const int precision)
@@ -0,0 +1,144 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "cpu.h"
+#include "dateTime.h"
+#include "macros.h"
+#include "task_stats.h"
+
+#include <string.h>
+
+static const uint32_t bucket_limits_us[TASK_STATS_BUCKETS - 1] =
+        TASK_STATS_BUCKET_LIMITS_US;
+
+static const char* const names[TASK_STATS_COUNT] = {
+        "logger",
+        "fileWriter",
+        "can",
+        "lua",
+};
+
+static struct task_stats stats[TASK_STATS_COUNT];
+static tiny_millis_t reset_at;
+
+void task_stats_reset(void)
+{
+        for (size_t i = 0; i < ARRAY_LEN(stats); ++i) {
+                const uint32_t budget_us = stats[i].budget_us;
+                memset(stats + i, 0, sizeof(struct task_stats));
+                stats[i].budget_us = budget_us;
+        }
+
+        reset_at = getUptime();
+}
+
+void task_stats_set_budget(const enum task_stats_id id,
+                           const uint32_t budget_us)
+{
+        stats[id].budget_us = budget_us;
+}
+
+static uint32_t elapsed_us(const uint32_t since)
+{
+        return (cpu_get_cycle_count() - since) / cpu_get_cycles_per_usec();
+}
+
+static void add_to_histogram(struct task_stats_histogram *h,
+                             const uint32_t us)
+{
+        size_t bucket = 0;
+        while (bucket < ARRAY_LEN(bucket_limits_us) &&
+               us >= bucket_limits_us[bucket])
+                ++bucket;
+
+        ++h->counts[bucket];
+}
+
+void task_stats_due(const enum task_stats_id id)
+{
+        struct task_stats *ts = stats + id;
+
+        /* If the last one never started, it is the later one */
+        if (!ts->is_due) {
+                ts->due = cpu_get_cycle_count();
+                ts->is_due = true;
+        }
+}
+
+void task_stats_late(const enum task_stats_id id, const uint32_t late_us)
+{
+        struct task_stats *ts = stats + id;
+
+        add_to_histogram(&ts->late, late_us);
+        if (late_us > ts->late_max_us)
+                ts->late_max_us = late_us;
+}
+
+void task_stats_begin(const enum task_stats_id id)
+{
+        struct task_stats *ts = stats + id;
+
+        ts->started = cpu_get_cycle_count();
+        if (ts->is_due) {
+                task_stats_late(id, elapsed_us(ts->due));
+                ts->is_due = false;
+        }
+}
+
+void task_stats_end(const enum task_stats_id id)
+{
+        struct task_stats *ts = stats + id;
+        const uint32_t run_us = elapsed_us(ts->started);
+
+        ++ts->runs;
+        ts->busy_us += run_us;
+        add_to_histogram(&ts->run, run_us);
+
+        if (run_us > ts->run_max_us)
+                ts->run_max_us = run_us;
+
+        if (ts->budget_us && run_us > ts->budget_us)
+                ++ts->missed;
+}
+
+void task_stats_queue(const enum task_stats_id id, const size_t depth)
+{
+        struct task_stats *ts = stats + id;
+
+        if (depth > ts->queue_max)
+                ts->queue_max = depth;
+}
+
+const struct task_stats* task_stats_get(const enum task_stats_id id)
+{
+        return stats + id;
+}
+
+const char* task_stats_name(const enum task_stats_id id)
+{
+        return names[id];
+}
+
+uint32_t task_stats_duration_ms(void)
+{
+        return getUptime() - reset_at;
+}
@@ -35,6 +35,8 @@
 #include "panic.h"
 #include "printk.h"
 #include "rx_buff.h"
+#include "sample_binary.h"
+#include "sample_meta.h"
 #include "serial.h"
 #include "serial_device.h"
 #include "semphr.h"
@@ -431,6 +433,8 @@ static void process_new_connection(struct Serial *s)
 				serial_get_name(s));
 		pr_debug_int_msg(LOG_PFX "External conn slot: ", i);
 		serial_set_ioctl_cb(s, wifi_serial_ioctl);
+		sample_meta_reset_client(s);
+		sample_binary_reset_client(s);
 
 		reset_connection(conn);
 		conn->serial = s;
@@ -646,8 +650,7 @@ static void process_sample(struct wifi_sample_data* data)
 
 	/* Only try to send if our Serial device is connected */
 	if (serial_is_connected(serial)) {
-		api_send_sample_record(serial, sample, ticks, meta);
-		put_crlf(serial);
+		api_send_sample_record(serial, sample, ticks, meta, NULL);
 	}
 }
 
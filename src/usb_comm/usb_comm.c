@@ -197,8 +197,7 @@ static void process_sample(struct usb_sample_data* data)
                 return;
         }
 
-        api_send_sample_record(serial, sample, ticks, meta);
-        put_crlf(serial);
+        api_send_sample_record(serial, sample, ticks, meta, NULL);
 }
 
 
@@ -0,0 +1,54 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hash.h"
+#include <stdint.h>
+
+#define FNV1A_PRIME	16777619u
+
+uint32_t hash_fnv1a_update(uint32_t hash, const void *data, const size_t len)
+{
+        const uint8_t *b = data;
+
+        for (size_t i = 0; i < len; ++i) {
+                hash ^= b[i];
+                hash *= FNV1A_PRIME;
+        }
+
+        return hash;
+}
+
+uint32_t hash_fnv1a(const void *data, const size_t len)
+{
+        return hash_fnv1a_update(HASH_FNV1A_INIT, data, len);
+}
+
+uint32_t hash_fnv1a_str(const char *str)
+{
+        uint32_t hash = HASH_FNV1A_INIT;
+
+        for (; *str; ++str) {
+                hash ^= (uint8_t) *str;
+                hash *= FNV1A_PRIME;
+        }
+
+        return hash;
+}
@@ -126,14 +126,51 @@ char* trimLeadingZeros(char *ptr)
     return ptr;
 }
 
-void modp_ftoa(float value, char* str, int prec)
+/**
+ * Integer powers of 10, 10^0 to 10^9.  Used for digit counting.
+ */
+static const uint32_t aPow10u[] = {1, 10, 100, 1000, 10000, 100000,
+                                   1000000, 10000000, 100000000,
+                                   1000000000
+                                  };
+
+static size_t count_digits(const uint32_t value)
+{
+    size_t digits = 1;
+    while (digits < sizeof(aPow10u) / sizeof(*aPow10u) &&
+           value >= aPow10u[digits])
+        ++digits;
+
+    return digits;
+}
+
+/**
+ * "00" to "99".  Lets us emit 2 digits per division.
+ */
+static const char aDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Writes exactly len digits of value, most significant first */
+static void write_digits(char* str, size_t len, uint32_t value)
+{
+    while (len >= 2) {
+        const char* pair = aDigitPairs + 2 * (value % 100);
+        value /= 100;
+        str[--len] = pair[1];
+        str[--len] = pair[0];
+    }
+
+    if (len)
+        str[0] = 48 + (value % 10);
+}
+
+size_t modp_ftoa_fixed(float value, char* str, int prec)
 {
     /* if input is larger than thres_max, revert to exponential */
     const float thres_max = (float)(0x7FFFFFFF);
 
-    float diff = 0.0;
-    char* wstr = str;
-
     if (prec < 0) {
         prec = 0;
     } else if (prec > 9) {
@@ -141,7 +178,6 @@ void modp_ftoa(float value, char* str, int prec)
         prec = 9;
     }
 
-
     /* we'll work in positive values and deal with the
        negative sign issue later */
     int neg = 0;
@@ -150,39 +186,16 @@ void modp_ftoa(float value, char* str, int prec)
         value = -value;
     }
 
-
-    int whole = (int) value;
-    float tmp = (value - whole) * aPow10[prec];
-    uint32_t frac = (uint32_t)(tmp);
-    diff = tmp - frac;
-
-    if (diff > 0.5) {
-        ++frac;
-        /* handle rollover, e.g.  case 0.99 with prec 1 is 1.0  */
-        if (frac >= aPow10[prec]) {
-            frac = 0;
-            ++whole;
-        }
-    } else if (diff == 0.5 && ((frac == 0) || (frac & 1))) {
-        /* if halfway, round up if odd, OR
-           if last digit is 0.  That last part is strange */
-        ++frac;
-    }
-
-    /* for very large numbers switch back to native sprintf for exponentials.
-       anyone want to write code to replace this? */
-    /*
-       normal printf behavior is to print EVERY whole number digit
-       which can be 100s of characters overflowing your buffers == bad
-    */
     if (value > thres_max) {
         strcpy(str,"3735928559"); //overflow - avoid sprintf for now  //oxdeadbeef
-        //sprintf(str, "%e", neg ? -value : value);
-        return;
+        return 10;
     }
 
+    uint32_t whole = (uint32_t) value;
+    uint32_t frac = 0;
+
     if (prec == 0) {
-        diff = value - whole;
+        const float diff = value - whole;
         if (diff > 0.5) {
             /* greater than 0.5, round up, e.g. 1.6 -> 2 */
             ++whole;
@@ -192,30 +205,51 @@ void modp_ftoa(float value, char* str, int prec)
             ++whole;
         }
     } else {
-        int count = prec;
-        // now do fractional part, as an unsigned number
-        do {
-            --count;
-            *wstr++ = 48 + (frac % 10);
-        } while (frac /= 10);
-        // add extra 0s
-        while (count-- > 0) *wstr++ = '0';
-        // add decimal
-        *wstr++ = '.';
+        const float tmp = (value - whole) * aPow10[prec];
+        frac = (uint32_t) tmp;
+        const float diff = tmp - frac;
+
+        if (diff > 0.5) {
+            ++frac;
+        } else if (diff == 0.5 && ((frac == 0) || (frac & 1))) {
+            /* if halfway, round up if odd, OR
+               if last digit is 0.  That last part is strange */
+            ++frac;
+        }
+
+        /* handle rollover, e.g.  case 0.99 with prec 1 is 1.0  */
+        if (frac >= aPow10u[prec]) {
+            frac = 0;
+            ++whole;
+        }
     }
 
-    // do whole part
-    // Take care of sign
-    // Conversion. Number is reversed.
-    do *wstr++ = 48 + (whole % 10);
-    while (whole /= 10);
-    if (neg) {
+    char* wstr = str;
+    if (neg)
         *wstr++ = '-';
+
+    const size_t whole_len = count_digits(whole);
+    write_digits(wstr, whole_len, whole);
+    wstr += whole_len;
+
+    if (prec > 0) {
+        /* Drop trailing zeros but always keep one fractional digit */
+        size_t frac_len = prec;
+        for (; frac_len > 1 && frac % 10 == 0; --frac_len)
+            frac /= 10;
+
+        *wstr++ = '.';
+        write_digits(wstr, frac_len, frac);
+        wstr += frac_len;
     }
-    *wstr='\0';
 
-    if (prec > 0) trimLeadingZeros(str);
-    strreverse(str, wstr-1);
+    *wstr = '\0';
+    return wstr - str;
+}
+
+void modp_ftoa(float value, char* str, int prec)
+{
+    modp_ftoa_fixed(value, str, prec);
 }
 
 void modp_dtoa(double value, char* str, int prec)
@@ -21,6 +21,7 @@
 
 #include "capabilities.h"
 #include "channel_config.h"
+#include "channel_registry.h"
 #include "loggerTaskEx.h"
 #include "macros.h"
 #include "mem_mang.h"
@@ -30,6 +31,24 @@
 
 static size_t g_virtualChannelCount = 0;
 static VirtualChannel g_virtualChannels[MAX_VIRTUAL_CHANNELS];
+static int16_t g_virtualChannelSlots[2 * MAX_VIRTUAL_CHANNELS];
+static struct channel_name_index g_virtualChannelIndex;
+
+static const char* virtual_channel_name(const void *ctx, const size_t idx)
+{
+        return g_virtualChannels[idx].config.label;
+}
+
+static struct channel_name_index* get_virtual_channel_index(void)
+{
+        if (!g_virtualChannelIndex.slots)
+                channel_name_index_init(&g_virtualChannelIndex,
+                                        g_virtualChannelSlots,
+                                        ARRAY_LEN(g_virtualChannelSlots),
+                                        virtual_channel_name);
+
+        return &g_virtualChannelIndex;
+}
 
 VirtualChannel* get_virtual_channel(size_t id)
 {
@@ -41,12 +60,11 @@ VirtualChannel* get_virtual_channel(size_t id)
 
 int find_virtual_channel(const char * channel_name)
 {
-        for (size_t i = 0; i < g_virtualChannelCount; i++) {
-                if (STR_EQ(channel_name, g_virtualChannels[i].config.label))
-                        return i;
-        }
+        const int id = channel_name_index_find(get_virtual_channel_index(),
+                                               NULL, channel_name);
 
-        return INVALID_VIRTUAL_CHANNEL;
+        return CHANNEL_REGISTRY_INVALID_INDEX == id ?
+                INVALID_VIRTUAL_CHANNEL : id;
 }
 
 int create_virtual_channel(const ChannelConfig chCfg)
@@ -69,6 +87,8 @@ int create_virtual_channel(const ChannelConfig chCfg)
         VirtualChannel * channel = g_virtualChannels + g_virtualChannelCount;
         channel->config = chCfg;
         channel->currentValue = 0;
+        channel_name_index_add(get_virtual_channel_index(), NULL,
+                               channel->config.label, g_virtualChannelCount);
         configChanged();
 
         return g_virtualChannelCount++;
@@ -96,6 +116,7 @@ size_t get_virtual_channel_count(void)
 void reset_virtual_channels(void)
 {
         g_virtualChannelCount = 0;
+        channel_name_index_reset(get_virtual_channel_index());
 }
 
 int get_virtual_channel_high_sample_rate(void)
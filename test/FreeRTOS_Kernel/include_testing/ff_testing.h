@@ -0,0 +1,67 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FF_TESTING_H_
+#define _FF_TESTING_H_
+
+#include "cpp_guard.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+CPP_GUARD_BEGIN
+
+size_t ff_get_bytes_written(void);
+
+void ff_reset_bytes_written(void);
+
+/**
+ * @return The number of directory entries read by lookups and
+ * directory listings since the last reset.
+ */
+size_t ff_get_dir_reads(void);
+
+void ff_reset_dir_reads(void);
+
+/**
+ * Empties the mock root directory.
+ */
+void ff_reset_files(void);
+
+size_t ff_get_file_count(void);
+
+bool ff_file_exists(const char *path);
+
+size_t ff_get_file_size(const char *path);
+
+size_t ff_get_file_clusters(const char *path);
+
+/**
+ * @return The number of FAT sectors written, counting each FAT copy,
+ * since the last reset.
+ */
+size_t ff_get_fat_writes(void);
+
+void ff_reset_fat_writes(void);
+
+CPP_GUARD_END
+
+#endif /* _FF_TESTING_H_ */
@@ -21,15 +21,217 @@
 
 
 #include "ff.h"
+#include "ff_testing.h"
 
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define FF_MOCK_MAX_FILES	2048
+#define FF_MOCK_DATA_SIZE	256
+#define FF_MOCK_NO_FILE		((DWORD) -1)
+#define FF_MOCK_CLUSTER_SIZE	32768
+#define FF_MOCK_FAT_ENTRIES	128	/* FAT32 entries per 512 byte sector */
+#define FF_MOCK_FAT_COPIES	2
+#define MIN_DWORD(a, b)		((a) < (b) ? (a) : (b))
+
+/*
+ * A flat root directory.  Only the first few bytes of each file are kept,
+ * which is plenty for the small bookkeeping files the firmware reads back.
+ * Lookups walk the entries in order like FatFs does so that tests can
+ * count the directory entries an operation had to read.
+ *
+ * Cluster allocation is modelled as well.  Every file is one contiguous
+ * run handed out from a bump allocator, and FAT updates go through a one
+ * sector window that is written back (to every FAT copy) when another
+ * FAT sector is needed or the file is synced, like FatFs does.  That is
+ * enough to count FAT sector writes.
+ */
+static struct {
+        char name[13];
+        BYTE data[FF_MOCK_DATA_SIZE];
+        DWORD size;
+        DWORD clusters;
+        DWORD last_cluster;
+} files[FF_MOCK_MAX_FILES];
+
+static size_t file_count;
+static size_t bytes_written;
+static size_t dir_reads;
+
+static struct {
+        DWORD next_free;
+        DWORD window;
+        bool dirty;
+        size_t writes;
+} fat = { 2, 0, false, 0 };
+
+size_t ff_get_bytes_written(void)
+{
+        return bytes_written;
+}
+
+void ff_reset_bytes_written(void)
+{
+        bytes_written = 0;
+}
+
+size_t ff_get_dir_reads(void)
+{
+        return dir_reads;
+}
+
+void ff_reset_dir_reads(void)
+{
+        dir_reads = 0;
+}
+
+void ff_reset_files(void)
+{
+        file_count = 0;
+        dir_reads = 0;
+        fat.next_free = 2;
+        fat.window = 0;
+        fat.dirty = false;
+        fat.writes = 0;
+}
+
+size_t ff_get_fat_writes(void)
+{
+        return fat.writes;
+}
+
+void ff_reset_fat_writes(void)
+{
+        fat.writes = 0;
+}
+
+static void fat_touch(const DWORD cluster)
+{
+        const DWORD sector = cluster / FF_MOCK_FAT_ENTRIES;
+
+        if (fat.dirty && fat.window != sector)
+                fat.writes += FF_MOCK_FAT_COPIES;
+
+        fat.window = sector;
+        fat.dirty = true;
+}
+
+static void fat_sync(void)
+{
+        if (fat.dirty)
+                fat.writes += FF_MOCK_FAT_COPIES;
+
+        fat.dirty = false;
+}
+
+/* Grows the cluster chain of a file to cover size bytes */
+static void fat_allocate(const DWORD idx, const DWORD size)
+{
+        const DWORD needed =
+                (size + FF_MOCK_CLUSTER_SIZE - 1) / FF_MOCK_CLUSTER_SIZE;
+
+        for (; files[idx].clusters < needed; ++files[idx].clusters) {
+                const DWORD cluster = fat.next_free++;
+
+                /* Link the previous cluster to this one, then mark EOC */
+                if (files[idx].clusters)
+                        fat_touch(files[idx].last_cluster);
+
+                fat_touch(cluster);
+                files[idx].last_cluster = cluster;
+        }
+}
+
+/* Frees the clusters of a file past size bytes */
+static void fat_release(const DWORD idx, const DWORD size)
+{
+        const DWORD keep =
+                (size + FF_MOCK_CLUSTER_SIZE - 1) / FF_MOCK_CLUSTER_SIZE;
+
+        for (; files[idx].clusters > keep; --files[idx].clusters)
+                fat_touch(files[idx].last_cluster--);
+
+        if (keep)
+                fat_touch(files[idx].last_cluster);
+}
+
+size_t ff_get_file_count(void)
+{
+        return file_count;
+}
+
+static void to_sfn(char *sfn, const TCHAR *path)
+{
+        size_t i = 0;
+
+        if ('/' == *path)
+                ++path;
+
+        for (; path[i] && i < sizeof(files[0].name) - 1; ++i)
+                sfn[i] = toupper((int) path[i]);
+
+        sfn[i] = '\0';
+}
+
+static DWORD find_file(const TCHAR *path)
+{
+        char sfn[sizeof(files[0].name)];
+        to_sfn(sfn, path);
+
+        for (DWORD i = 0; i < file_count; ++i) {
+                ++dir_reads;
+                if (0 == strcmp(sfn, files[i].name))
+                        return i;
+        }
+
+        return FF_MOCK_NO_FILE;
+}
+
+bool ff_file_exists(const char *path)
+{
+        const size_t reads = dir_reads;
+        const bool exists = FF_MOCK_NO_FILE != find_file(path);
+
+        dir_reads = reads;
+        return exists;
+}
+
+size_t ff_get_file_clusters(const char *path)
+{
+        const size_t reads = dir_reads;
+        const DWORD idx = find_file(path);
+
+        dir_reads = reads;
+        return FF_MOCK_NO_FILE == idx ? 0 : files[idx].clusters;
+}
+
+size_t ff_get_file_size(const char *path)
+{
+        const size_t reads = dir_reads;
+        const DWORD idx = find_file(path);
+
+        dir_reads = reads;
+        return FF_MOCK_NO_FILE == idx ? 0 : files[idx].size;
+}
+
+static bool is_open(const FIL *fp)
+{
+        return FF_MOCK_NO_FILE != fp->dir_sect && fp->dir_sect < file_count;
+}
 
 FRESULT f_sync (FIL* fp)
 {
+        if (is_open(fp))
+                fat_sync();
+
         return FR_OK;
 }
 
 FRESULT f_close (FIL* fp)
 {
+        f_sync(fp);
+        fp->dir_sect = FF_MOCK_NO_FILE;
         return FR_OK;
 }
 
@@ -37,6 +239,34 @@ FRESULT f_open(FIL* fp,
                const TCHAR* path,
                BYTE mode)
 {
+        DWORD idx = find_file(path);
+
+        if (FF_MOCK_NO_FILE != idx && (mode & FA_CREATE_NEW))
+                return FR_EXIST;
+
+        if (FF_MOCK_NO_FILE == idx) {
+                if (!(mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS |
+                              FA_OPEN_ALWAYS)))
+                        return FR_NO_FILE;
+
+                if (file_count >= FF_MOCK_MAX_FILES)
+                        return FR_DENIED;
+
+                idx = file_count++;
+                to_sfn(files[idx].name, path);
+                files[idx].size = 0;
+                files[idx].clusters = 0;
+        }
+
+        if (mode & FA_CREATE_ALWAYS) {
+                files[idx].size = 0;
+                fat_release(idx, 0);
+        }
+
+        fp->dir_sect = idx;
+        fp->flag = mode;
+        fp->fptr = 0;
+        fp->fsize = files[idx].size;
         return FR_OK;
 }
 
@@ -46,6 +276,27 @@ int f_puts(const TCHAR* str,
         return 0;
 }
 
+FRESULT f_read (
+    FIL* fp,			/* Pointer to the file object */
+    void* buff,			/* Pointer to data buffer */
+    UINT btr,			/* Number of bytes to read */
+    UINT* br			/* Pointer to number of bytes read */
+)
+{
+        *br = 0;
+        if (!is_open(fp))
+                return FR_INVALID_OBJECT;
+
+        const DWORD size = files[fp->dir_sect].size;
+        while (*br < btr && fp->fptr < size &&
+               fp->fptr < FF_MOCK_DATA_SIZE) {
+                ((BYTE *) buff)[(*br)++] =
+                        files[fp->dir_sect].data[fp->fptr++];
+        }
+
+        return FR_OK;
+}
+
 FRESULT f_write (
     FIL* fp,			/* Pointer to the file object */
     const void *buff,	/* Pointer to the data to be written */
@@ -53,6 +304,27 @@ FRESULT f_write (
     UINT* bw			/* Pointer to number of bytes written */
 )
 {
+        /* Pretend the card took all of it so callers don't spin */
+        if (bw)
+                *bw = btw;
+
+        bytes_written += btw;
+
+        if (!is_open(fp))
+                return FR_OK;
+
+        fat_allocate(fp->dir_sect, fp->fptr + btw);
+
+        for (UINT i = 0; i < btw; ++i, ++fp->fptr) {
+                if (fp->fptr < FF_MOCK_DATA_SIZE)
+                        files[fp->dir_sect].data[fp->fptr] =
+                                ((const BYTE *) buff)[i];
+        }
+
+        if (fp->fptr > fp->fsize)
+                fp->fsize = fp->fptr;
+
+        files[fp->dir_sect].size = fp->fsize;
         return FR_OK;
 }
 
@@ -61,5 +333,51 @@ FRESULT f_lseek (
     DWORD ofs		/* File pointer from top of file */
 )
 {
+        /* Seeking past the end of a writable file grows it */
+        if (is_open(fp) && ofs > fp->fsize && (fp->flag & FA_WRITE)) {
+                fat_allocate(fp->dir_sect, ofs);
+                fp->fsize = files[fp->dir_sect].size = ofs;
+        }
+
+        fp->fptr = MIN_DWORD(ofs, fp->fsize);
+        return FR_OK;
+}
+
+FRESULT f_truncate (FIL* fp)
+{
+        if (!is_open(fp))
+                return FR_INVALID_OBJECT;
+
+        fat_release(fp->dir_sect, fp->fptr);
+        fp->fsize = files[fp->dir_sect].size = fp->fptr;
+        return FR_OK;
+}
+
+FRESULT f_opendir (DIR* dp, const TCHAR* path)
+{
+        dp->index = 0;
+        return FR_OK;
+}
+
+FRESULT f_closedir (DIR* dp)
+{
+        return FR_OK;
+}
+
+FRESULT f_readdir (DIR* dp, FILINFO* fno)
+{
+        if (dp->index >= file_count) {
+                fno->fname[0] = '\0';
+                return FR_OK;
+        }
+
+        ++dir_reads;
+        strcpy(fno->fname, files[dp->index].name);
+        fno->fsize = files[dp->index].size;
+        fno->fattrib = AM_ARC;
+        if (fno->lfname && fno->lfsize)
+                fno->lfname[0] = '\0';
+
+        ++dp->index;
         return FR_OK;
 }
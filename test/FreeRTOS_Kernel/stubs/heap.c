@@ -21,9 +21,14 @@
 
 
 #include "FreeRTOS.h"
+#include "heap_testing.h"
 
 #include <stdlib.h>
 
+#define DEFAULT_FREE_HEAP_SIZE	(64 * 1024)
+
+static size_t free_heap_size = DEFAULT_FREE_HEAP_SIZE;
+
 void *pvPortMalloc( size_t xSize )
 {
         void *addr = malloc(xSize);
@@ -34,3 +39,18 @@ void vPortFree( void *pv )
 {
         free(pv);
 }
+
+size_t xPortGetFreeHeapSize(void)
+{
+        return free_heap_size;
+}
+
+void set_free_heap_size(size_t size)
+{
+        free_heap_size = size;
+}
+
+void reset_free_heap_size(void)
+{
+        free_heap_size = DEFAULT_FREE_HEAP_SIZE;
+}
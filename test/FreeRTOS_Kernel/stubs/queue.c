@@ -27,27 +27,58 @@
 
 #include <stddef.h>
 
+#define MOCK_MUTEX	((xQueueHandle) 1)
+
 struct mock_queue {
         size_t item_size;
         struct ring_buff *rb;
+        /* Semaphores only */
+        size_t length;
+        size_t count;
 };
 
 /*
  * Note that xQueueGenericSend and xQueueGenericReceive are also used for
- * mutexes.  We know this because the pvBuffer value will be NULL.  In that
- * case just return true for now to indicate that we have acquired the
- * mutex.  We may have to implement actual mutex capabilities in the future,
- * lets do that when its actually needed.
+ * mutexes and semaphores.  We know this because the pvBuffer value will be
+ * NULL.  Mutexes always succeed for now since we are single threaded, as
+ * do handles that were never created.
+ * Semaphores keep a count so that waiting on one that was never given
+ * times out instead of succeeding.
  */
 
+static signed portBASE_TYPE give_semaphore(xQueueHandle pxQueue)
+{
+        if (!pxQueue || MOCK_MUTEX == pxQueue)
+                return true;
+
+        struct mock_queue *mc = pxQueue;
+        if (mc->count >= mc->length)
+                return false;
+
+        ++mc->count;
+        return true;
+}
+
+static signed portBASE_TYPE take_semaphore(xQueueHandle pxQueue)
+{
+        if (!pxQueue || MOCK_MUTEX == pxQueue)
+                return true;
+
+        struct mock_queue *mc = pxQueue;
+        if (!mc->count)
+                return false;
+
+        --mc->count;
+        return true;
+}
+
 signed portBASE_TYPE xQueueGenericSend(xQueueHandle pxQueue,
                                        const void * const pvBuffer,
                                        portTickType xTicksToWait,
                                        portBASE_TYPE xCopyPosition )
 {
         if (!pvBuffer)
-                return true;
-
+                return give_semaphore(pxQueue);
 
         struct mock_queue *mc = pxQueue;
         return !!ring_buffer_write(mc->rb, pvBuffer, mc->item_size);
@@ -59,7 +90,7 @@ signed portBASE_TYPE xQueueGenericReceive(
         portBASE_TYPE xJustPeeking )
 {
         if (!pvBuffer)
-                return true;
+                return take_semaphore(pxQueue);
 
         struct mock_queue *mc = pxQueue;
         return !!ring_buffer_get(mc->rb, pvBuffer, mc->item_size);
@@ -78,13 +109,15 @@ xQueueHandle xQueueCreate(unsigned portBASE_TYPE uxQueueLength,
         struct mock_queue *mc = portMalloc(sizeof(struct mock_queue));
         mc->item_size = (size_t) uxItemSize;
         mc->rb = ring_buffer_create(uxQueueLength * uxItemSize);
+        mc->length = (size_t) uxQueueLength;
+        mc->count = 0;
         return mc;
 }
 
 xQueueHandle xQueueCreateMutex()
 {
         /* Can't return NULL b/c failure checks.  Wing it */
-        return (xQueueHandle) 1;
+        return MOCK_MUTEX;
 }
 
 signed portBASE_TYPE xQueueGenericSendFromISR(xQueueHandle pxQueue,
@@ -92,6 +125,9 @@ signed portBASE_TYPE xQueueGenericSendFromISR(xQueueHandle pxQueue,
                                               signed portBASE_TYPE *pxHigherPriorityTaskWoken,
                                               portBASE_TYPE xCopyPosition)
 {
+        if (!pvItemToQueue)
+                return give_semaphore(pxQueue);
+
         return pdTRUE;
 }
 
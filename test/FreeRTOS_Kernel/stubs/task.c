@@ -59,3 +59,11 @@ signed portBASE_TYPE xTaskGenericCreate(
 {
         return 0;
 }
+
+void vPortEnterCritical(void)
+{
+}
+
+void vPortExitCritical(void)
+{
+}
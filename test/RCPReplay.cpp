@@ -0,0 +1,532 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays a recorded RaceCapture log through the logging pipeline on
+ * the host, as fast as the host allows.  Everything runs in lockstep on
+ * a virtual 1ms tick: the producer side does what loggerTaskEx and the
+ * GPS task do, while the file writer and telemetry consumers drain
+ * their queues whenever their modelled busy time has passed.  Consumer
+ * busy time is the host cost of the stage scaled by -x, plus the time
+ * the telemetry bytes need on a link of -b baud.  Queue overflows are
+ * counted the same way loggerTaskEx counts them, along with queued
+ * samples whose buffer was reused before the consumer got to them.
+ * Exits with 2 if either happened.
+ *
+ * Usage: rcpreplay [-n loops] [-x scale] [-b baud] [logfile]
+ */
+
+#include "FreeRTOS.h"
+#include "ff_testing.h"
+#include "fileWriter.h"
+#include "fileWriter_testing.h"
+#include "gps.h"
+#include "gps.testing.h"
+#include "imu.h"
+#include "imu_device.h"
+#include "imu_mock.h"
+#include "lap_stats.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "loggerData.h"
+#include "loggerSampleData.h"
+#include "macros.h"
+#include "mock_serial.h"
+#include "predictive_timer_2.h"
+#include "printk.h"
+#include "queue.h"
+#include "sampleRecord.h"
+#include "sample_arena.h"
+#include "task_testing.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_LOG_FILE	"predictive_time_test_lap.log"
+#define LINE_BUFFER_SIZE	2048
+#define MAX_COLUMNS		64
+#define DEFAULT_BAUD		115200
+
+/* Start/finish of the track predictive_time_test_lap.log was taken on */
+#define TRACK_SF_LAT		47.806934
+#define TRACK_SF_LON		-122.341150
+#define TRACK_SF_RADIUS		0.0004
+
+enum stage {
+        STAGE_GPS,
+        STAGE_SAMPLE,
+        STAGE_FILE,
+        STAGE_TELEMETRY,
+        STAGE_COUNT,
+};
+
+struct stage_stats {
+        const char *name;
+        uint64_t calls;
+        uint64_t total_ns;
+        uint64_t max_ns;
+};
+
+static struct stage_stats stages[STAGE_COUNT] = {
+        { "gps+lapstats" },
+        { "sample" },
+        { "file writer" },
+        { "telemetry" },
+};
+
+struct consumer {
+        xQueueHandle queue;
+        uint64_t busy_until_us;
+        unsigned int overflows;
+        unsigned int stale;
+        unsigned int processed;
+        unsigned int max_depth;
+        unsigned int depth;
+};
+
+struct columns {
+        int lat;
+        int lon;
+        int speed;
+        int time;
+        int imu[CONFIG_IMU_CHANNELS];
+        int max_rate;
+};
+
+static uint64_t now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t stage_end(const enum stage st, const uint64_t start)
+{
+        const uint64_t ns = now_ns() - start;
+        struct stage_stats *ss = stages + st;
+
+        ++ss->calls;
+        ss->total_ns += ns;
+        if (ns > ss->max_ns)
+                ss->max_ns = ns;
+
+        return ns;
+}
+
+static size_t split_line(char *line, char **cols)
+{
+        size_t count = 0;
+        char *c = line;
+
+        cols[count++] = c;
+        for (; *c && count < MAX_COLUMNS; ++c) {
+                if (',' != *c)
+                        continue;
+
+                *c = '\0';
+                cols[count++] = c + 1;
+        }
+
+        return count;
+}
+
+/*
+ * Header fields look like "Name"|"Units"|rate.  Pull out the columns we
+ * know how to feed back into the system.  IMU columns are matched by the
+ * configured channel names.
+ */
+static void parse_header(char *line, struct columns *c,
+                         LoggerConfig *config)
+{
+        char *cols[MAX_COLUMNS];
+        const size_t count = split_line(line + 1, cols);
+
+        c->lat = c->lon = c->speed = c->time = -1;
+        for (size_t i = 0; i < CONFIG_IMU_CHANNELS; ++i)
+                c->imu[i] = -1;
+        c->max_rate = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+                char name[32] = { 0 };
+                sscanf(cols[i], "\"%31[^\"]\"", name);
+
+                const char *rate = strrchr(cols[i], '|');
+                if (rate && atoi(rate + 1) > c->max_rate)
+                        c->max_rate = atoi(rate + 1);
+
+                if (!strcmp(name, "Latitude"))
+                        c->lat = i;
+                else if (!strcmp(name, "Longitude"))
+                        c->lon = i;
+                else if (!strcmp(name, "Speed"))
+                        c->speed = i;
+                else if (!strcmp(name, "Time"))
+                        c->time = i;
+
+                for (size_t j = 0; j < CONFIG_IMU_CHANNELS; ++j)
+                        if (!strcmp(name, config->ImuConfigs[j].cfg.label))
+                                c->imu[j] = i;
+        }
+}
+
+static bool has_value(char **cols, const size_t count, const int idx)
+{
+        return idx >= 0 && (size_t) idx < count && *cols[idx] &&
+                '\r' != *cols[idx] && '\n' != *cols[idx];
+}
+
+/* Time is logged as HHMMSS.sss UTC */
+static millis_t parse_utc(const char *str)
+{
+        const double t = atof(str);
+        const int hms = (int) t;
+        DateTime dt;
+
+        dt.year = 2014;
+        dt.month = 5;
+        dt.day = 3;
+        dt.hour = (int8_t) (hms / 10000);
+        dt.minute = (int8_t) (hms / 100 % 100);
+        dt.second = (int8_t) (hms % 100);
+        dt.millisecond = (int16_t) ((t - hms) * 1000 + 0.5);
+
+        return getMillisecondsSinceUnixEpoch(dt);
+}
+
+static void replay_gps(char **cols, const size_t count,
+                       const struct columns *c)
+{
+        if (!has_value(cols, count, c->lat) ||
+            !has_value(cols, count, c->lon) ||
+            !has_value(cols, count, c->speed) ||
+            !has_value(cols, count, c->time))
+                return;
+
+        const uint64_t start = now_ns();
+
+        GpsSample sample;
+        sample.quality = GPS_QUALITY_3D;
+        sample.point.latitude = atof(cols[c->lat]);
+        sample.point.longitude = atof(cols[c->lon]);
+        sample.speed = atof(cols[c->speed]);
+        sample.time = parse_utc(cols[c->time]);
+        sample.satellites = 8;
+
+        GPS_sample_update(&sample);
+        const GpsSnapshot snap = getGpsSnapshot();
+        lapstats_processUpdate(&snap);
+
+        stage_end(STAGE_GPS, start);
+}
+
+static void replay_imu(char **cols, const size_t count,
+                       const struct columns *c, LoggerConfig *config)
+{
+        for (size_t i = 0; i < CONFIG_IMU_CHANNELS; ++i) {
+                if (!has_value(cols, count, c->imu[i]))
+                        continue;
+
+                const ImuConfig *ic = config->ImuConfigs + i;
+                const float cpu = imu_device_counts_per_unit(
+                        (enum imu_channel) i);
+                const float counts = atof(cols[c->imu[i]]) * cpu +
+                        ic->zeroValue;
+                imu_mock_set_value(ic->physicalChannel,
+                                   (unsigned int) (int) counts);
+        }
+}
+
+static void enqueue(struct consumer *con, const LoggerMessage *msg)
+{
+        if (pdTRUE != send_logger_message(con->queue, msg)) {
+                ++con->overflows;
+                return;
+        }
+
+        if (++con->depth > con->max_depth)
+                con->max_depth = con->depth;
+}
+
+/*
+ * Queued messages point into the sample ring.  A consumer that falls far
+ * enough behind finds its sample already reused for a later tick; count
+ * those as stale rather than silently skipping them.
+ */
+static bool dequeue(struct consumer *con, const uint64_t now_us,
+                    LoggerMessage *msg)
+{
+        while (now_us >= con->busy_until_us && con->depth) {
+                if (pdTRUE != xQueueReceive(con->queue, msg, 0))
+                        return false;
+
+                --con->depth;
+                if (is_sample_data_valid(msg)) {
+                        ++con->processed;
+                        return true;
+                }
+
+                ++con->stale;
+        }
+
+        return false;
+}
+
+static void drain_file_writer(struct consumer *con, struct logging_status *ls,
+                              const uint64_t now_us, const double scale)
+{
+        LoggerMessage msg;
+
+        while (dequeue(con, now_us, &msg)) {
+                const uint64_t start = now_ns();
+                logging_sample(ls, &msg);
+                flush_logfile(ls);
+                const uint64_t ns = stage_end(STAGE_FILE, start);
+
+                con->busy_until_us = now_us + (uint64_t) (ns * scale / 1000);
+        }
+}
+
+static size_t drain_telemetry(struct consumer *con, const uint64_t now_us,
+                              const double scale, const unsigned int baud)
+{
+        static bool meta_sent;
+        LoggerMessage msg;
+        size_t bytes = 0;
+
+        while (dequeue(con, now_us, &msg)) {
+                mock_resetTxBuffer();
+
+                const uint64_t start = now_ns();
+                api_send_sample_record(getMockSerial(), msg.sample,
+                                       msg.ticks, !meta_sent, NULL);
+                const uint64_t ns = stage_end(STAGE_TELEMETRY, start);
+
+                const size_t len = mock_getTxBufferLength();
+                const uint64_t wire_us = (uint64_t) len * 10 * 1000000 / baud;
+
+                meta_sent = true;
+                bytes += len;
+                con->busy_until_us = now_us + wire_us +
+                        (uint64_t) (ns * scale / 1000);
+        }
+
+        return bytes;
+}
+
+static void usage(const char *name)
+{
+        fprintf(stderr, "Usage: %s [-n loops] [-x scale] [-b baud] "
+                "[logfile]\n", name);
+        fprintf(stderr, "  -n  Times to replay the log (default 1)\n");
+        fprintf(stderr, "  -x  Target cost per unit of host cost "
+                "(default 1)\n");
+        fprintf(stderr, "  -b  Telemetry link baud rate (default %d)\n",
+                DEFAULT_BAUD);
+}
+
+int main(int argc, char* argv[])
+{
+        unsigned int loops = 1;
+        double scale = 1;
+        unsigned int baud = DEFAULT_BAUD;
+        int opt;
+
+        while (-1 != (opt = getopt(argc, argv, "n:x:b:h"))) {
+                switch (opt) {
+                case 'n':
+                        loops = atoi(optarg);
+                        break;
+                case 'x':
+                        scale = atof(optarg);
+                        break;
+                case 'b':
+                        baud = atoi(optarg);
+                        break;
+                default:
+                        usage(argv[0]);
+                        return 1;
+                }
+        }
+
+        const char *path = optind < argc ? argv[optind] : DEFAULT_LOG_FILE;
+        FILE *fp = fopen(path, "r");
+        if (!fp) {
+                perror(path);
+                return 1;
+        }
+
+        LoggerConfig *config = getWorkingLoggerConfig();
+        initApi();
+        initialize_logger_config();
+        setupMockSerial();
+        imu_init(config);
+        GPS_init(10, getMockSerial());
+        resetPredictiveTimer();
+        startFileWriterTask(0);
+
+        TrackConfig *track_cfg = &config->TrackConfigs;
+        track_cfg->track.circuit.startFinish.latitude = TRACK_SF_LAT;
+        track_cfg->track.circuit.startFinish.longitude = TRACK_SF_LON;
+        track_cfg->radius = TRACK_SF_RADIUS;
+
+        sample_arena_init();
+        const size_t channels = get_enabled_channel_count(config);
+        const size_t depth = sample_arena_layout(channels,
+                                                 LOGGER_MESSAGE_BUFFER_SIZE);
+        if (!depth) {
+                fprintf(stderr, "Failed to allocate sample buffers\n");
+                return 1;
+        }
+
+        const int logging_rate = getHighestSampleRate(config);
+        const int telemetry_rate =
+                isHigherSampleRate(logging_rate,
+                                   getConnectivitySampleRateLimit()) ?
+                getConnectivitySampleRateLimit() : logging_rate;
+
+        struct consumer file_con = { create_logger_message_queue() };
+        struct consumer tele_con = { create_logger_message_queue() };
+        struct logging_status ls = { 0 };
+        logging_start(&ls);
+        ff_reset_bytes_written();
+
+        struct columns cols_idx = { 0 };
+        char line[LINE_BUFFER_SIZE];
+        char *cols[MAX_COLUMNS];
+        size_t telemetry_bytes = 0;
+        size_t buffer_index = 0;
+        unsigned int rows = 0;
+        unsigned int ticks = 0;
+        unsigned int sampled = 0;
+
+        const uint64_t wall_start = now_ns();
+
+        for (unsigned int loop = 0; loop < loops; ++loop) {
+                rewind(fp);
+                while (fgets(line, sizeof(line), fp)) {
+                        if ('#' == line[0]) {
+                                parse_header(line, &cols_idx, config);
+                                continue;
+                        }
+
+                        if (cols_idx.max_rate <= 0)
+                                continue;
+
+                        const size_t count = split_line(line, cols);
+                        replay_gps(cols, count, &cols_idx);
+                        replay_imu(cols, count, &cols_idx, config);
+                        ++rows;
+
+                        /* Run every tick until the next row is due */
+                        const unsigned int row_end =
+                                (uint64_t) rows * TICK_RATE_HZ /
+                                cols_idx.max_rate;
+                        for (; ticks < row_end; ++ticks) {
+                                const unsigned int tick = ticks + 1;
+                                const uint64_t now_us = (uint64_t) tick *
+                                        (1000000 / TICK_RATE_HZ);
+                                set_ticks(tick);
+
+                                struct sample *s =
+                                        sample_arena_get(buffer_index);
+                                const uint64_t start = now_ns();
+                                if (should_sample(tick, logging_rate))
+                                        doBackgroundSampling();
+                                const int rate = populate_sample_buffer(s,
+                                                                        tick);
+                                if (SAMPLE_DISABLED != rate) {
+                                        stage_end(STAGE_SAMPLE, start);
+                                        ++sampled;
+
+                                        const LoggerMessage msg =
+                                                create_logger_message(
+                                                        LoggerMessageType_Sample,
+                                                        tick, s);
+                                        if (should_sample(tick, logging_rate))
+                                                enqueue(&file_con, &msg);
+                                        if (should_sample(tick, telemetry_rate))
+                                                enqueue(&tele_con, &msg);
+
+                                        ++buffer_index;
+                                        buffer_index %= depth;
+                                }
+
+                                drain_file_writer(&file_con, &ls, now_us,
+                                                  scale);
+                                telemetry_bytes +=
+                                        drain_telemetry(&tele_con, now_us,
+                                                        scale, baud);
+                        }
+                }
+        }
+
+        const double wall_s = (now_ns() - wall_start) / 1e9;
+        const double virt_s = (double) ticks / TICK_RATE_HZ;
+        fclose(fp);
+
+        printf("Replayed %u rows (%u loops) of %s\n", rows, loops, path);
+        printf("  channels:        %zu\n", channels);
+        printf("  sample buffers:  %zu (%zu bytes)\n", depth,
+               sample_arena_size());
+        printf("  logging rate:    %d Hz\n", decodeSampleRate(logging_rate));
+        printf("  telemetry rate:  %d Hz\n",
+               decodeSampleRate(telemetry_rate));
+        printf("  laps:            %d\n", getLapCount());
+        printf("  log time:        %.1f s\n", virt_s);
+        printf("  wall time:       %.3f s\n", wall_s);
+        printf("  speedup:         %.1fx real time\n",
+               wall_s > 0 ? virt_s / wall_s : 0);
+        printf("  samples:         %u (%.0f/s)\n", sampled,
+               wall_s > 0 ? sampled / wall_s : 0);
+        printf("  file bytes:      %zu\n", ff_get_bytes_written());
+        printf("  telemetry bytes: %zu (%.0f B/s on the link, %u baud)\n",
+               telemetry_bytes, virt_s > 0 ? telemetry_bytes / virt_s : 0,
+               baud);
+
+        printf("\n%-14s %10s %12s %10s %10s\n", "stage", "calls",
+               "total ms", "mean us", "max us");
+        for (size_t i = 0; i < STAGE_COUNT; ++i) {
+                const struct stage_stats *ss = stages + i;
+                printf("%-14s %10llu %12.1f %10.2f %10.1f\n", ss->name,
+                       (unsigned long long) ss->calls, ss->total_ns / 1e6,
+                       ss->calls ? ss->total_ns / 1e3 / ss->calls : 0,
+                       ss->max_ns / 1e3);
+        }
+
+        printf("\n%-14s %10s %10s %10s %10s (x%.1f cost)\n", "queue",
+               "processed", "max depth", "overflows", "stale", scale);
+        const struct consumer *cons[] = { &file_con, &tele_con };
+        const char *con_names[] = { "file writer", "telemetry" };
+        for (size_t i = 0; i < ARRAY_LEN(cons); ++i)
+                printf("%-14s %10u %10u %10u %10u\n", con_names[i],
+                       cons[i]->processed, cons[i]->max_depth,
+                       cons[i]->overflows, cons[i]->stale);
+
+        logging_stop(&ls);
+        vQueueDelete(file_con.queue);
+        vQueueDelete(tele_con.queue);
+        return file_con.overflows || tele_con.overflows ||
+                file_con.stale || tele_con.stale ? 2 : 0;
+}
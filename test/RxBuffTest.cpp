@@ -118,3 +118,79 @@ void RxBuffTest::msgOverflowTest()
 			     rx_buff_get_status(rxbuff));
 	CPPUNIT_ASSERT(!rx_buff_get_msg(rxbuff));
 }
+
+void RxBuffTest::jsonMsgBulkTest()
+{
+	Serial* serial = getMockSerial();
+	mock_appendRxBuffer("{\"a\":1}\r\n{\"b\":2}\r\n");
+
+	CPPUNIT_ASSERT_EQUAL(true, rx_buff_read(rxbuff, serial, true));
+	CPPUNIT_ASSERT_EQUAL(string("{\"a\":1}"),
+			     string(rx_buff_get_msg(rxbuff)));
+	/* JSON is never echoed */
+	CPPUNIT_ASSERT_EQUAL(string(""), string(mock_getTxBuffer()));
+
+	/* The second message must be left alone, minus the \n */
+	rx_buff_clear(rxbuff);
+	CPPUNIT_ASSERT_EQUAL(true, rx_buff_read(rxbuff, serial, true));
+	CPPUNIT_ASSERT_EQUAL(string("{\"b\":2}"),
+			     string(rx_buff_get_msg(rxbuff)));
+	CPPUNIT_ASSERT_EQUAL((size_t) 0, serial_rx_available(serial));
+}
+
+void RxBuffTest::serialReadLineTest()
+{
+	Serial* serial = getMockSerial();
+	char buff[16];
+
+	mock_appendRxBuffer("OK\r\nERROR\r\npart");
+
+	CPPUNIT_ASSERT_EQUAL(4, serial_read_line_wait(serial, buff,
+						      sizeof(buff), 0));
+	CPPUNIT_ASSERT_EQUAL(string("OK\r\n"), string(buff, 4));
+
+	CPPUNIT_ASSERT_EQUAL(7, serial_read_line_wait(serial, buff,
+						      sizeof(buff), 0));
+	CPPUNIT_ASSERT_EQUAL(string("ERROR\r\n"), string(buff, 7));
+
+	/* No \n, so we time out with what we have */
+	CPPUNIT_ASSERT_EQUAL(4, serial_read_line_wait(serial, buff,
+						      sizeof(buff), 0));
+	CPPUNIT_ASSERT_EQUAL(string("part"), string(buff, 4));
+	CPPUNIT_ASSERT_EQUAL(0, serial_read_line_wait(serial, buff,
+						      sizeof(buff), 0));
+
+	/* Line longer than the buffer gets split */
+	mock_appendRxBuffer("0123456789\n");
+	CPPUNIT_ASSERT_EQUAL(4, serial_read_line_wait(serial, buff, 4, 0));
+	CPPUNIT_ASSERT_EQUAL(string("0123"), string(buff, 4));
+	CPPUNIT_ASSERT_EQUAL(7, serial_read_line_wait(serial, buff,
+						      sizeof(buff), 0));
+	CPPUNIT_ASSERT_EQUAL(string("456789\n"), string(buff, 7));
+}
+
+void RxBuffTest::serialReadUntilTest()
+{
+	Serial* serial = getMockSerial();
+	const char terms[] = {'\r', '\0'};
+	char buff[16];
+	char c;
+
+	/* Lines that span the wrap point of the rx buffer */
+	for (int i = 0; i < 2000; ++i) {
+		mock_appendRxBuffer("abc\rdefgh");
+		CPPUNIT_ASSERT_EQUAL(4, serial_read_until_wait(serial, buff,
+							       sizeof(buff),
+							       terms, 2, 0));
+		CPPUNIT_ASSERT_EQUAL(string("abc\r"), string(buff, 4));
+
+		CPPUNIT_ASSERT(serial_rx_peek_c(serial, &c));
+		CPPUNIT_ASSERT_EQUAL('d', c);
+
+		CPPUNIT_ASSERT_EQUAL(5, serial_read_buff_wait(serial, buff,
+							      sizeof(buff),
+							      0));
+		CPPUNIT_ASSERT_EQUAL(string("defgh"), string(buff, 5));
+		CPPUNIT_ASSERT(!serial_rx_peek_c(serial, &c));
+	}
+}
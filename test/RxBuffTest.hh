@@ -32,6 +32,9 @@ class RxBuffTest : public CppUnit::TestFixture
 	CPPUNIT_TEST( msgReadyTest );
 	CPPUNIT_TEST( msgPartialTest );
 	CPPUNIT_TEST( msgOverflowTest );
+	CPPUNIT_TEST( jsonMsgBulkTest );
+	CPPUNIT_TEST( serialReadLineTest );
+	CPPUNIT_TEST( serialReadUntilTest );
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -42,6 +45,9 @@ public:
 	void msgReadyTest();
 	void msgPartialTest();
 	void msgOverflowTest();
+	void jsonMsgBulkTest();
+	void serialReadLineTest();
+	void serialReadUntilTest();
 };
 
 #endif /* _RXBUFFTEST_H_ */
@@ -0,0 +1,327 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#include "can_capture.h"
+#include "can_capture_test.h"
+#include <cppunit/extensions/HelperMacros.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( CANCaptureTest );
+
+/* How often the file writer drains the capture while it is quiet */
+#define DRAIN_MS	10
+
+struct captured_frame {
+        CAN_msg msg;
+        uint32_t ms;
+};
+
+static std::vector<captured_frame> decoded;
+static size_t decoded_bytes;
+static uint32_t decode_ms;
+
+static uint32_t get_u32(const uint8_t *p)
+{
+        return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/* Mirrors bin/rcp_can_capture_to_candump.py */
+static void decode(const uint8_t *buf, const size_t len)
+{
+        const uint8_t *p = buf;
+        const uint8_t *end = buf + len;
+
+        /* Each buffer starts with a timestamp */
+        CPPUNIT_ASSERT(*p & CAN_CAPTURE_FLAG_TIMESTAMP);
+
+        while (p < end) {
+                captured_frame f;
+                memset(&f, 0, sizeof(f));
+
+                const uint8_t flags = *p++;
+                if (flags & CAN_CAPTURE_FLAG_TIMESTAMP) {
+                        decode_ms = get_u32(p);
+                        p += 4;
+                }
+                f.ms = decode_ms;
+                f.msg.can_bus = flags & CAN_CAPTURE_FLAG_BUS ? 1 : 0;
+                f.msg.isExtendedAddress = flags & CAN_CAPTURE_FLAG_EXTENDED;
+                f.msg.dataLength = flags & CAN_CAPTURE_DLC_MASK;
+
+                if (f.msg.isExtendedAddress) {
+                        f.msg.addressValue = get_u32(p);
+                        p += 4;
+                } else {
+                        f.msg.addressValue = p[0] | p[1] << 8;
+                        p += 2;
+                }
+
+                memcpy(f.msg.data, p, f.msg.dataLength);
+                p += f.msg.dataLength;
+                decoded.push_back(f);
+        }
+
+        CPPUNIT_ASSERT(p == end);
+        decoded_bytes += len;
+}
+
+static size_t drain(void)
+{
+        size_t buffers = 0;
+        const uint8_t *buf;
+        size_t len;
+
+        while ((buf = can_capture_peek(&len))) {
+                decode(buf, len);
+                can_capture_release();
+                ++buffers;
+        }
+
+        return buffers;
+}
+
+static CAN_msg make_msg(const uint8_t bus, const uint32_t id,
+                        const bool extended, const uint8_t len,
+                        const uint8_t seed)
+{
+        CAN_msg msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.can_bus = bus;
+        msg.addressValue = id;
+        msg.isExtendedAddress = extended;
+        msg.dataLength = len;
+        for (size_t i = 0; i < len; ++i)
+                msg.data[i] = seed + i;
+
+        return msg;
+}
+
+static void assert_frame(const CAN_msg &expected, const uint32_t ms,
+                         const captured_frame &f)
+{
+        CPPUNIT_ASSERT_EQUAL(ms, f.ms);
+        CPPUNIT_ASSERT_EQUAL(expected.can_bus, f.msg.can_bus);
+        CPPUNIT_ASSERT_EQUAL(expected.addressValue, f.msg.addressValue);
+        CPPUNIT_ASSERT_EQUAL(expected.isExtendedAddress,
+                             f.msg.isExtendedAddress);
+        CPPUNIT_ASSERT_EQUAL(expected.dataLength, f.msg.dataLength);
+        CPPUNIT_ASSERT(!memcmp(expected.data, f.msg.data, expected.dataLength));
+}
+
+static void start(const uint32_t ms)
+{
+        CPPUNIT_ASSERT(can_capture_start());
+        can_capture_poll(ms);
+        CPPUNIT_ASSERT(can_capture_is_running());
+}
+
+static void stop(const uint32_t ms)
+{
+        can_capture_stop();
+        can_capture_poll(ms);
+        CPPUNIT_ASSERT(!can_capture_is_running());
+}
+
+void CANCaptureTest::setUp(void)
+{
+        can_capture_stop();
+        can_capture_poll(0);
+        drain();
+        decoded.clear();
+        decoded_bytes = 0;
+}
+
+void CANCaptureTest::roundtrip_test(void)
+{
+        const CAN_msg msgs[] = {
+                make_msg(0, 0x7E8, false, 8, 0x10),
+                make_msg(1, 0x100, false, 0, 0),
+                make_msg(0, 0x18FEF100, true, 8, 0xF0),
+                make_msg(1, 0x1FFFFFFF, true, 3, 0x40),
+        };
+        const uint32_t times[] = { 1000, 1000, 1001, 70000 };
+
+        uint8_t header[CAN_CAPTURE_HEADER_LEN];
+        CPPUNIT_ASSERT_EQUAL((size_t) CAN_CAPTURE_HEADER_LEN,
+                             can_capture_header(header));
+        CPPUNIT_ASSERT(!memcmp(CAN_CAPTURE_MAGIC, header, 4));
+        CPPUNIT_ASSERT_EQUAL((uint8_t) CAN_CAPTURE_VERSION, header[4]);
+
+        start(1000);
+        for (size_t i = 0; i < 4; ++i)
+                can_capture_frame(&msgs[i], times[i]);
+        stop(70000);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, drain());
+        CPPUNIT_ASSERT_EQUAL((size_t) 4, decoded.size());
+        for (size_t i = 0; i < 4; ++i)
+                assert_frame(msgs[i], times[i], decoded[i]);
+
+        /* The repeated timestamp is left out */
+        CPPUNIT_ASSERT_EQUAL((size_t) (15 + 3 + 17 + 12),
+                             decoded_bytes);
+
+        struct can_capture_stats stats;
+        can_capture_get_stats(&stats);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 4, stats.frames);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, stats.dropped);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) decoded_bytes, stats.bytes);
+}
+
+void CANCaptureTest::start_stop_test(void)
+{
+        const CAN_msg msg = make_msg(0, 0x123, false, 2, 1);
+
+        /* Nothing is kept until the CAN task sees the start */
+        can_capture_frame(&msg, 0);
+        CPPUNIT_ASSERT(can_capture_start());
+        CPPUNIT_ASSERT(!can_capture_is_running());
+        can_capture_frame(&msg, 0);
+        can_capture_poll(0);
+        CPPUNIT_ASSERT(can_capture_is_running());
+
+        can_capture_frame(&msg, 1);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, drain());
+
+        /* The partial buffer is handed over on stop */
+        can_capture_stop();
+        can_capture_frame(&msg, 2);
+        can_capture_poll(2);
+        CPPUNIT_ASSERT(!can_capture_is_running());
+        can_capture_frame(&msg, 3);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, drain());
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, decoded.size());
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, decoded[0].ms);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, decoded[1].ms);
+
+        /* Stats start over with the next session */
+        start(10);
+        struct can_capture_stats stats;
+        can_capture_get_stats(&stats);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, stats.frames);
+        stop(10);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, drain());
+}
+
+void CANCaptureTest::flush_test(void)
+{
+        const CAN_msg msg = make_msg(0, 0x200, false, 8, 0);
+
+        start(5000);
+        can_capture_frame(&msg, 5000);
+        can_capture_poll(5000 + CAN_CAPTURE_FLUSH_MS - 1);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, drain());
+
+        can_capture_poll(5000 + CAN_CAPTURE_FLUSH_MS);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, drain());
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, decoded.size());
+
+        /* Nothing left to hand over */
+        stop(7000);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, drain());
+}
+
+void CANCaptureTest::drop_test(void)
+{
+        const size_t sent = CAN_CAPTURE_SIZE;
+
+        /* A writer that never drains fills every buffer, then drops */
+        start(0);
+        for (size_t i = 0; i < sent; ++i) {
+                const CAN_msg msg = make_msg(i & 1, i & 0x7FF, false, 8, i);
+                can_capture_frame(&msg, i);
+        }
+        stop(sent);
+
+        struct can_capture_stats stats;
+        can_capture_get_stats(&stats);
+        CPPUNIT_ASSERT(stats.dropped > 0);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) sent, stats.frames + stats.dropped);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) CAN_CAPTURE_BUFFERS, drain());
+        CPPUNIT_ASSERT_EQUAL((size_t) stats.frames, decoded.size());
+        CPPUNIT_ASSERT(decoded_bytes <= CAN_CAPTURE_SIZE);
+
+        /* What was kept is the start of the session, intact */
+        for (size_t i = 0; i < decoded.size(); ++i)
+                assert_frame(make_msg(i & 1, i & 0x7FF, false, 8, i), i,
+                             decoded[i]);
+}
+
+/*
+ * A 1 Mbit bus full of standard frames with 8 data bytes carries a bit
+ * under 9 frames every ms.  Feed that on both buses for a while with the
+ * writer draining on its idle timeout, and report what it costs.
+ */
+void CANCaptureTest::full_load_test(void)
+{
+        const uint32_t frames_per_ms = 9;
+        const uint32_t duration_ms = 60000;
+
+        start(0);
+        const clock_t begin = clock();
+        for (uint32_t ms = 0; ms < duration_ms; ++ms) {
+                for (uint32_t i = 0; i < frames_per_ms; ++i) {
+                        for (uint8_t bus = 0; bus < 2; ++bus) {
+                                const CAN_msg msg =
+                                        make_msg(bus, 0x100 + i, false, 8, ms);
+                                can_capture_frame(&msg, ms);
+                        }
+                }
+                can_capture_poll(ms);
+
+                if (0 == ms % DRAIN_MS) {
+                        const uint8_t *buf;
+                        size_t len;
+                        while ((buf = can_capture_peek(&len))) {
+                                decoded_bytes += len;
+                                can_capture_release();
+                        }
+                }
+        }
+        const double secs = (double) (clock() - begin) / CLOCKS_PER_SEC;
+        stop(duration_ms);
+        drain();
+
+        struct can_capture_stats stats;
+        can_capture_get_stats(&stats);
+        const double frames_per_sec = stats.frames * 1000.0 / duration_ms;
+        const double bytes_per_sec = stats.bytes * 1000.0 / duration_ms;
+
+        printf("\ncan capture: %.0f frames/s on 2 buses, %.1f bytes/frame, "
+               "%.0f KB/s to the card, %.0f ms of buffering, "
+               "%.0f ns/frame host\n", frames_per_sec,
+               (double) stats.bytes / stats.frames, bytes_per_sec / 1024,
+               CAN_CAPTURE_SIZE * 1000.0 / bytes_per_sec,
+               secs * 1e9 / stats.frames);
+
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, stats.dropped);
+        CPPUNIT_ASSERT_EQUAL(2 * frames_per_ms * duration_ms, stats.frames);
+        CPPUNIT_ASSERT_EQUAL((size_t) stats.bytes, decoded_bytes);
+        /* 11 bytes a frame, plus a timestamp shared by the frames of a ms */
+        CPPUNIT_ASSERT(stats.bytes < 12 * stats.frames);
+}
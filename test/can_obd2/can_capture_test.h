@@ -0,0 +1,48 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+
+#ifndef TEST_CAN_OBD2_CAN_CAPTURE_TEST_H_
+#define TEST_CAN_OBD2_CAN_CAPTURE_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class CANCaptureTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( CANCaptureTest );
+    CPPUNIT_TEST( roundtrip_test );
+    CPPUNIT_TEST( start_stop_test );
+    CPPUNIT_TEST( flush_test );
+    CPPUNIT_TEST( drop_test );
+    CPPUNIT_TEST( full_load_test );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void roundtrip_test(void);
+    void start_stop_test(void);
+    void flush_test(void);
+    void drop_test(void);
+    void full_load_test(void);
+};
+
+#endif /* TEST_CAN_OBD2_CAN_CAPTURE_TEST_H_ */
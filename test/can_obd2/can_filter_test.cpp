@@ -0,0 +1,184 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "OBD2.h"
+#include "can_filter.h"
+#include "can_filter_test.h"
+#include <cppunit/extensions/HelperMacros.h>
+#include <string.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( CANFilterTest );
+
+static CANChannelConfig can_cfg;
+static OBD2Config obd2_cfg;
+static struct can_filter_set fs;
+
+static void add_mapping(const uint8_t bus, const uint32_t id,
+                        const uint32_t mask)
+{
+        CANMapping *m = &can_cfg.can_channels[can_cfg.enabled_mappings++].mapping;
+        m->can_channel = bus;
+        m->can_id = id;
+        m->can_mask = mask;
+}
+
+void CANFilterTest::setUp(void)
+{
+        memset(&can_cfg, 0, sizeof(can_cfg));
+        memset(&obd2_cfg, 0, sizeof(obd2_cfg));
+        can_cfg.enabled = true;
+}
+
+void CANFilterTest::exact_id_test(void)
+{
+        add_mapping(0, 0x100, 0);
+        add_mapping(0, 0x200, 0);
+        add_mapping(0, 0x100, 0);
+        add_mapping(1, 0x300, 0);
+        add_mapping(0, 0x18FEF100, 0);
+
+        can_filter_build(&fs, 0, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 5, can_filter_reduce(&fs, CAN_FILTER_BANKS));
+        CPPUNIT_ASSERT(!fs.accept_all);
+
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x100, false));
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x200, false));
+
+        /* A mapping matches an extended frame with the same ID too */
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x100, true));
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x18FEF100, true));
+        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x101, false));
+        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x18FEF101, true));
+
+        /* The other bus only gets its own mapping */
+        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x300, false));
+        can_filter_build(&fs, 1, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, fs.count);
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x300, false));
+
+        /* Nothing when the mappings are off */
+        can_cfg.enabled = false;
+        can_filter_build(&fs, 0, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, fs.count);
+        CPPUNIT_ASSERT(!fs.accept_all);
+}
+
+void CANFilterTest::masked_id_test(void)
+{
+        /* A masked ID can show up as either kind of frame */
+        add_mapping(0, 0x100, 0x700);
+        can_filter_build(&fs, 0, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, fs.count);
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x1FF, false));
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x18FEF1FF, true));
+        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x200, false));
+
+        /* IDs the mask already lets through don't need their own */
+        add_mapping(0, 0x123, 0);
+        can_filter_build(&fs, 0, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, fs.count);
+
+        /* And a wider mask replaces the narrower ones */
+        add_mapping(0, 0x000, 0x600);
+        can_filter_build(&fs, 0, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, fs.count);
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x0FF, false));
+}
+
+void CANFilterTest::wildcard_test(void)
+{
+        add_mapping(0, 0x100, 0);
+        add_mapping(0, 0, 0);
+        can_filter_build(&fs, 0, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT(fs.accept_all);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, can_filter_reduce(&fs, CAN_FILTER_BANKS));
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x555, false));
+}
+
+void CANFilterTest::obd2_test(void)
+{
+        obd2_cfg.enabled = true;
+        obd2_cfg.enabledPids = 1;
+        can_filter_build(&fs, OBD2_CAN_BUS, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, fs.count);
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, OBD2_11BIT_PID_RESPONSE, false));
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, OBD2_29BIT_PID_RESPONSE, true));
+        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x7E9, false));
+
+        can_filter_build(&fs, OBD2_CAN_BUS + 1, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, fs.count);
+
+        obd2_cfg.enabledPids = 0;
+        can_filter_build(&fs, OBD2_CAN_BUS, &can_cfg, &obd2_cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, fs.count);
+}
+
+void CANFilterTest::bank_limit_test(void)
+{
+        /* Two clusters of standard IDs and a couple of extended ones */
+        static const uint32_t std_ids[] = {
+                0x100, 0x101, 0x102, 0x108, 0x500, 0x501, 0x503, 0x510,
+        };
+        static const uint32_t ext_ids[] = {
+                0x18FEF100, 0x0CF00400,
+        };
+
+        for (size_t limit = CAN_FILTER_BANKS; limit >= 2; --limit) {
+                can_filter_init(&fs);
+                for (size_t i = 0; i < sizeof(std_ids) / sizeof(std_ids[0]); ++i)
+                        can_filter_add(&fs, std_ids[i], 0);
+                for (size_t i = 0; i < sizeof(ext_ids) / sizeof(ext_ids[0]); ++i)
+                        can_filter_add(&fs, ext_ids[i], 0);
+
+                const size_t banks = can_filter_reduce(&fs, limit);
+                CPPUNIT_ASSERT(banks <= limit);
+                CPPUNIT_ASSERT(!fs.accept_all);
+
+                /* Never loses a frame a mapping wants */
+                for (size_t i = 0; i < sizeof(std_ids) / sizeof(std_ids[0]); ++i)
+                        CPPUNIT_ASSERT(can_filter_accepts(&fs, std_ids[i], false));
+                for (size_t i = 0; i < sizeof(ext_ids) / sizeof(ext_ids[0]); ++i)
+                        CPPUNIT_ASSERT(can_filter_accepts(&fs, ext_ids[i], true));
+
+                /* And merges the nearby IDs first */
+                if (limit >= 4) {
+                        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x300, false));
+                        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x7E8, false));
+                }
+        }
+}
+
+void CANFilterTest::single_bank_test(void)
+{
+        can_filter_init(&fs);
+        can_filter_add(&fs, 0x100, 0);
+        can_filter_add(&fs, 0x101, 0);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, can_filter_reduce(&fs, 2));
+        CPPUNIT_ASSERT(!fs.accept_all);
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x100, false));
+        CPPUNIT_ASSERT(can_filter_accepts(&fs, 0x101, true));
+        CPPUNIT_ASSERT(!can_filter_accepts(&fs, 0x102, false));
+
+        /* Standard and extended IDs can't share one */
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, can_filter_reduce(&fs, 1));
+        CPPUNIT_ASSERT(fs.accept_all);
+}
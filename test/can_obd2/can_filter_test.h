@@ -0,0 +1,49 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TEST_CAN_OBD2_CAN_FILTER_TEST_H_
+#define TEST_CAN_OBD2_CAN_FILTER_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class CANFilterTest : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( CANFilterTest );
+    CPPUNIT_TEST( exact_id_test );
+    CPPUNIT_TEST( masked_id_test );
+    CPPUNIT_TEST( wildcard_test );
+    CPPUNIT_TEST( obd2_test );
+    CPPUNIT_TEST( bank_limit_test );
+    CPPUNIT_TEST( single_bank_test );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp(void);
+    void exact_id_test(void);
+    void masked_id_test(void);
+    void wildcard_test(void);
+    void obd2_test(void);
+    void bank_limit_test(void);
+    void single_bank_test(void);
+};
+
+#endif /* TEST_CAN_OBD2_CAN_FILTER_TEST_H_ */
@@ -0,0 +1,480 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CAN_mock.h"
+#include "OBD2.h"
+#include "loggerConfig.h"
+#include "obd2_test.h"
+#include "task.h"
+#include "task_testing.h"
+#include <cppunit/extensions/HelperMacros.h>
+#include <deque>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( OBD2Test );
+
+#define BROADCAST_REQUEST       0x7DF
+#define ECU_REQUEST             0x7E0
+#define ECU_RESPONSE            0x7E8
+
+/* enough for the OBD2 timeout, and then some */
+#define TIMEOUT_TICKS   (2 * OBD2_PID_DEFAULT_TIMEOUT_MS / portTICK_RATE_MS)
+
+struct timed_frame {
+        portTickType due;
+        CAN_msg msg;
+};
+
+/**
+ * A simulated ECU on an ISO 15765-4 bus.  It answers each mode 01
+ * request latency ticks later, and sends responses longer than a frame
+ * as a first frame followed by consecutive frames once it gets flow
+ * control.  Every data byte it sends is a new count so each answer
+ * changes the value of its channel.  Some ECUs take a packed request but
+ * only answer its first PID.
+ */
+static struct {
+        bool packing;
+        bool first_pid_only;
+        portTickType latency;
+        uint8_t unsupported_pid;
+        uint8_t counter;
+        std::deque<struct timed_frame> frames;
+        std::vector<CAN_msg> held;
+        std::vector<CAN_msg> requests;
+        size_t flow_controls;
+} ecu;
+
+static OBD2Config cfg;
+
+static size_t pid_length(const uint8_t pid)
+{
+        switch (pid) {
+        case 0x0C:
+        case 0x10:
+        case 0x1F:
+        case 0x42:
+                return 2;
+        default:
+                return 1;
+        }
+}
+
+static CAN_msg make_frame(const uint8_t *data, const size_t len)
+{
+        CAN_msg msg;
+        memset(&msg, 0, sizeof(msg));
+        memset(msg.data, 0x55, sizeof(msg.data));
+        memcpy(msg.data, data, len);
+        msg.addressValue = ECU_RESPONSE;
+        msg.dataLength = 8;
+        return msg;
+}
+
+static void ecu_respond(const CAN_msg *req)
+{
+        size_t count = req->data[0] - 1;
+        if (count > 1 && !ecu.packing)
+                return;
+
+        if (ecu.first_pid_only)
+                count = std::min(count, (size_t) 1);
+
+        std::vector<uint8_t> payload(1, 0x41);
+        for (size_t i = 0; i < count; ++i) {
+                const uint8_t pid = req->data[2 + i];
+                if (pid == ecu.unsupported_pid)
+                        continue;
+
+                payload.push_back(pid);
+                for (size_t j = 0; j < pid_length(pid); ++j)
+                        payload.push_back(++ecu.counter);
+        }
+
+        if (payload.size() == 1)
+                return;
+
+        struct timed_frame tf;
+        tf.due = xTaskGetTickCount() + ecu.latency;
+        uint8_t data[8];
+
+        if (payload.size() <= 7) {
+                data[0] = payload.size();
+                memcpy(data + 1, &payload[0], payload.size());
+                tf.msg = make_frame(data, 1 + payload.size());
+                ecu.frames.push_back(tf);
+                return;
+        }
+
+        data[0] = 0x10 | (payload.size() >> 8);
+        data[1] = payload.size() & 0xFF;
+        memcpy(data + 2, &payload[0], 6);
+        tf.msg = make_frame(data, 8);
+        ecu.frames.push_back(tf);
+
+        uint8_t seq = 1;
+        for (size_t i = 6; i < payload.size(); i += 7, seq = (seq + 1) & 0x0F) {
+                const size_t len = std::min((size_t) 7, payload.size() - i);
+                data[0] = 0x20 | seq;
+                memcpy(data + 1, &payload[i], len);
+                ecu.held.push_back(make_frame(data, 1 + len));
+        }
+}
+
+static void ecu_rx(const CAN_msg *msg)
+{
+        if (msg->addressValue == ECU_REQUEST && msg->data[0] == 0x30) {
+                ++ecu.flow_controls;
+                for (size_t i = 0; i < ecu.held.size(); ++i) {
+                        struct timed_frame tf = { xTaskGetTickCount(), ecu.held[i] };
+                        ecu.frames.push_back(tf);
+                }
+                ecu.held.clear();
+                return;
+        }
+
+        if (msg->addressValue != BROADCAST_REQUEST)
+                return;
+
+        ecu.requests.push_back(*msg);
+        if (msg->data[1] == 0x01) {
+                ecu_respond(msg);
+        } else if (msg->data[1] == 0x22) {
+                const uint8_t data[] = {0x04, 0x62, msg->data[2], msg->data[3],
+                                        ++ecu.counter};
+                struct timed_frame tf = { xTaskGetTickCount() + ecu.latency,
+                                          make_frame(data, sizeof(data)) };
+                ecu.frames.push_back(tf);
+        }
+}
+
+/**
+ * Runs the CAN task's OBD2 loop for a while, counting how many times
+ * each channel got a new value.
+ */
+static void run(const portTickType ticks, std::vector<size_t> *updates = NULL)
+{
+        std::vector<float> last(cfg.enabledPids);
+        for (size_t i = 0; i < cfg.enabledPids; ++i)
+                last[i] = OBD2_get_current_channel_value(i);
+
+        const portTickType end = xTaskGetTickCount() + ticks;
+        for (portTickType t = xTaskGetTickCount() + 1; t <= end; ++t) {
+                set_ticks(t);
+                while (!ecu.frames.empty() && ecu.frames.front().due <= t) {
+                        CAN_msg msg = ecu.frames.front().msg;
+                        ecu.frames.pop_front();
+                        update_obd2_channels(&msg, &cfg);
+                }
+                sequence_next_obd2_query(&cfg, cfg.enabledPids);
+
+                for (size_t i = 0; updates && i < cfg.enabledPids; ++i) {
+                        const float value = OBD2_get_current_channel_value(i);
+                        if (value != last[i])
+                                ++(*updates)[i];
+                        last[i] = value;
+                }
+        }
+}
+
+static void add_pid(const uint8_t pid, const int rate)
+{
+        PidConfig *pc = &cfg.pids[cfg.enabledPids++];
+        pc->pid = pid;
+        pc->mode = 0x01;
+        pc->passive = false;
+
+        CANMapping *m = &pc->mapping;
+        m->channel_cfg.sampleRate = encodeSampleRate(rate);
+        m->offset = 3;
+        m->length = pid_length(pid);
+        m->big_endian = true;
+        m->multiplier = 1;
+        m->sub_id = -1;
+        m->type = CANMappingType_unsigned;
+}
+
+static void reset(void)
+{
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.enabled = 1;
+
+        ecu.packing = true;
+        ecu.first_pid_only = false;
+        ecu.latency = 20 / portTICK_RATE_MS;
+        ecu.unsupported_pid = 0;
+        ecu.counter = 0;
+        ecu.frames.clear();
+        ecu.held.clear();
+        ecu.requests.clear();
+        ecu.flow_controls = 0;
+}
+
+void OBD2Test::setUp(void)
+{
+        reset();
+        set_ticks(1);
+        CAN_mock_set_tx_callback(ecu_rx);
+}
+
+void OBD2Test::tearDown(void)
+{
+        CAN_mock_set_tx_callback(NULL);
+        reset();
+        OBD2_init_current_values(&cfg);
+        reset_ticks();
+}
+
+void OBD2Test::packed_request_test(void)
+{
+        static const uint8_t pids[] = {0x0C, 0x0D, 0x05, 0x0B, 0x0F, 0x11, 0x04};
+        for (size_t i = 0; i < sizeof(pids); ++i)
+                add_pid(pids[i], 10);
+        OBD2_init_current_values(&cfg);
+
+        run(1);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, ecu.requests.size());
+
+        /* The first six ride in one request, padded out */
+        const CAN_msg *req = &ecu.requests[0];
+        CPPUNIT_ASSERT_EQUAL(BROADCAST_REQUEST, (int) req->addressValue);
+        CPPUNIT_ASSERT_EQUAL(7, (int) req->data[0]);
+        CPPUNIT_ASSERT_EQUAL(0x01, (int) req->data[1]);
+        for (size_t i = 0; i < OBD2_MAX_PIDS_PER_REQUEST; ++i)
+                CPPUNIT_ASSERT_EQUAL((int) pids[i], (int) req->data[2 + i]);
+
+        /* Both answered from one multi frame response */
+        run(ecu.latency);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, ecu.flow_controls);
+        CPPUNIT_ASSERT_EQUAL(0x0102, (int) OBD2_get_current_channel_value(0));
+        CPPUNIT_ASSERT_EQUAL(0x03, (int) OBD2_get_current_channel_value(1));
+        CPPUNIT_ASSERT_EQUAL(0x07, (int) OBD2_get_current_channel_value(5));
+
+        /* The one left over goes out next */
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, ecu.requests.size());
+        CPPUNIT_ASSERT_EQUAL((int) pids[6], (int) ecu.requests[1].data[2]);
+}
+
+void OBD2Test::unpackable_pid_test(void)
+{
+        /* Enhanced PIDs have to be asked for on their own */
+        add_pid(0x0C, 10);
+        cfg.pids[0].mode = 0x22;
+        cfg.pids[0].pid = 0x1234;
+        cfg.pids[0].mapping.offset = 4;
+        cfg.pids[0].mapping.length = 1;
+        add_pid(0x0D, 10);
+        add_pid(0x05, 10);
+        OBD2_init_current_values(&cfg);
+
+        run(1);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, ecu.requests.size());
+        CPPUNIT_ASSERT_EQUAL(0x22, (int) ecu.requests[0].data[1]);
+        run(ecu.latency);
+        CPPUNIT_ASSERT_EQUAL(1, (int) OBD2_get_current_channel_value(0));
+
+        /* Then the other two together */
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, ecu.requests.size());
+        CPPUNIT_ASSERT_EQUAL(3, (int) ecu.requests[1].data[0]);
+}
+
+void OBD2Test::multi_frame_response_test(void)
+{
+        add_pid(0x0C, 10);
+        add_pid(0x0D, 10);
+        OBD2_init_current_values(&cfg);
+        run(1);
+
+        /* A response that needs three frames, and a stray one */
+        ecu.frames.clear();
+        static const uint8_t ff[] = {0x10, 0x0E, 0x41, 0x0C, 0x1A, 0xF8, 0x0D, 0x32};
+        static const uint8_t stray[] = {0x03, 0x41, 0x05, 0x7B};
+        static const uint8_t cf1[] = {0x21, 0x05, 0x7B, 0x0B, 0x65, 0x0F, 0x44, 0x11};
+        static const uint8_t cf2[] = {0x22, 0x20};
+        CAN_msg msg = make_frame(ff, sizeof(ff));
+        update_obd2_channels(&msg, &cfg);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, ecu.flow_controls);
+
+        msg = make_frame(stray, sizeof(stray));
+        msg.addressValue = 0x123;
+        update_obd2_channels(&msg, &cfg);
+        msg = make_frame(cf1, sizeof(cf1));
+        update_obd2_channels(&msg, &cfg);
+        CPPUNIT_ASSERT_EQUAL(0, (int) OBD2_get_current_channel_value(0));
+
+        msg = make_frame(cf2, sizeof(cf2));
+        update_obd2_channels(&msg, &cfg);
+        CPPUNIT_ASSERT_EQUAL(0x1AF8, (int) OBD2_get_current_channel_value(0));
+        CPPUNIT_ASSERT_EQUAL(0x32, (int) OBD2_get_current_channel_value(1));
+}
+
+void OBD2Test::missing_pid_test(void)
+{
+        add_pid(0x0C, 10);
+        add_pid(0x0D, 10);
+        ecu.unsupported_pid = 0x0D;
+        OBD2_init_current_values(&cfg);
+
+        /* Left out, then asked for on its own until that times out */
+        run(10 * TIMEOUT_TICKS);
+        const size_t requests = ecu.requests.size();
+        CPPUNIT_ASSERT(requests > 20);
+        CPPUNIT_ASSERT_EQUAL(2, (int) ecu.requests.back().data[0]);
+        CPPUNIT_ASSERT_EQUAL(0x0C, (int) ecu.requests.back().data[2]);
+        CPPUNIT_ASSERT_EQUAL(0, (int) OBD2_get_current_channel_value(1));
+}
+
+void OBD2Test::first_pid_only_ecu_test(void)
+{
+        add_pid(0x0C, 10);
+        add_pid(0x0D, 10);
+        add_pid(0x05, 10);
+        ecu.first_pid_only = true;
+        OBD2_init_current_values(&cfg);
+
+        /* The PIDs left out answer on their own, so none are dropped */
+        std::vector<size_t> updates(cfg.enabledPids);
+        run(2000 / portTICK_RATE_MS, &updates);
+        for (size_t i = 0; i < cfg.enabledPids; ++i)
+                CPPUNIT_ASSERT(updates[i] >= 15);
+
+        /* And are asked for that way from then on */
+        CPPUNIT_ASSERT_EQUAL(2, (int) ecu.requests.back().data[0]);
+        CPPUNIT_ASSERT_EQUAL(2, (int) ecu.requests[ecu.requests.size() - 2].data[0]);
+}
+
+void OBD2Test::single_pid_ecu_test(void)
+{
+        add_pid(0x0C, 10);
+        add_pid(0x0D, 10);
+        ecu.packing = false;
+        OBD2_init_current_values(&cfg);
+
+        /* No answer to the packed request, then one at a time */
+        run(TIMEOUT_TICKS);
+        CPPUNIT_ASSERT(ecu.requests.size() > 2);
+        CPPUNIT_ASSERT_EQUAL(3, (int) ecu.requests[0].data[0]);
+        CPPUNIT_ASSERT_EQUAL(2, (int) ecu.requests.back().data[0]);
+        CPPUNIT_ASSERT(OBD2_get_current_channel_value(0) != 0);
+        CPPUNIT_ASSERT(OBD2_get_current_channel_value(1) != 0);
+
+        /* Still the same 11 bit ECU */
+        CPPUNIT_ASSERT_EQUAL(BROADCAST_REQUEST, (int) ecu.requests.back().addressValue);
+}
+
+void OBD2Test::scheduled_rate_test(void)
+{
+        add_pid(0x0C, 10);
+        add_pid(0x0D, 1);
+        OBD2_init_current_values(&cfg);
+
+        /* Each PID at its own rate, and the ECU is otherwise left alone */
+        std::vector<size_t> updates(cfg.enabledPids);
+        run(10000 / portTICK_RATE_MS, &updates);
+        CPPUNIT_ASSERT(updates[0] >= 99 && updates[0] <= 101);
+        CPPUNIT_ASSERT(updates[1] >= 10 && updates[1] <= 11);
+        CPPUNIT_ASSERT(ecu.requests.size() <= 101);
+
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(10, OBD2_get_channel_rate(0), 0.5);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(1, OBD2_get_channel_rate(1), 0.5);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 20, OBD2_get_query_latency());
+        CPPUNIT_ASSERT(OBD2_is_active());
+}
+
+void OBD2Test::next_query_delay_test(void)
+{
+        add_pid(0x0C, 10);
+        OBD2_init_current_values(&cfg);
+
+        /* Due right away, then waiting on the answer */
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, OBD2_next_query_delay_ms());
+        run(1);
+        CPPUNIT_ASSERT_EQUAL((size_t) OBD2_PID_DEFAULT_TIMEOUT_MS,
+                             OBD2_next_query_delay_ms());
+
+        /* Then asked for one round trip ahead of the next deadline */
+        run(ecu.latency);
+        const size_t elapsed = (1 + ecu.latency) * portTICK_RATE_MS;
+        CPPUNIT_ASSERT_EQUAL(100 - elapsed - 20, OBD2_next_query_delay_ms());
+}
+
+void OBD2Test::overloaded_ecu_test(void)
+{
+        add_pid(0x0C, 1);
+        add_pid(0x0D, 10);
+        add_pid(0x05, 50);
+        ecu.packing = false;
+        ecu.latency = 40 / portTICK_RATE_MS;
+        OBD2_init_current_values(&cfg);
+        run(TIMEOUT_TICKS);
+
+        /* 25 answers/sec for 61 wanted; each PID gets the same share */
+        std::vector<size_t> updates(cfg.enabledPids);
+        run(10000 / portTICK_RATE_MS, &updates);
+        const float share = 25.0f / 61;
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(share * 10, updates[0], 1);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(share * 100, updates[1], 2);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(share * 500, updates[2], 5);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(share * 50, OBD2_get_channel_rate(2), 1);
+}
+
+static float update_rate(const bool packing, const portTickType ticks)
+{
+        static const uint8_t pids[] = {
+                0x0C, 0x0D, 0x05, 0x0B, 0x0F, 0x10, 0x11, 0x04, 0x0E, 0x42,
+        };
+
+        reset();
+        for (size_t i = 0; i < sizeof(pids); ++i)
+                add_pid(pids[i], 50);
+        ecu.packing = packing;
+        OBD2_init_current_values(&cfg);
+
+        /* Settle on a way of asking first */
+        run(TIMEOUT_TICKS);
+
+        std::vector<size_t> updates(cfg.enabledPids);
+        run(ticks, &updates);
+
+        size_t least = updates[0];
+        for (size_t i = 0; i < updates.size(); ++i)
+                least = std::min(least, updates[i]);
+
+        return least * 1000.0f / (ticks * portTICK_RATE_MS);
+}
+
+void OBD2Test::update_rate_test(void)
+{
+        const portTickType ticks = 10000 / portTICK_RATE_MS;
+        const float single = update_rate(false, ticks);
+        const float packed = update_rate(true, ticks);
+
+        printf("\r\nOBD2: %d PIDs, ECU answers in %d ms: "
+               "%.1f Hz/PID one at a time, %.1f Hz/PID packed\r\n",
+               (int) cfg.enabledPids, (int) (ecu.latency * portTICK_RATE_MS),
+               single, packed);
+
+        CPPUNIT_ASSERT(single > 0);
+        CPPUNIT_ASSERT(packed > 4 * single);
+}
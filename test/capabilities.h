@@ -61,6 +61,33 @@ CPP_GUARD_BEGIN
  */
 #define PREDICTIVE_TIME_MAX_SAMPLES	96
 #define LOGGER_MESSAGE_BUFFER_SIZE	5
+/*
+ * Bytes of RAM the cellular stream keeps samples in while its link is
+ * down, to backfill once it is back.
+ */
+#define TELEMETRY_BACKLOG_SIZE	4096
+/*
+ * Most bytes of RAM the logger spools samples in while the SD card is
+ * too slow to keep up.  Takes less if the heap is short when logging
+ * starts.
+ */
+#define LOG_SPOOL_MAX_SIZE	8192
+/*
+ * Bytes of SD card space to reserve ahead of the log file while writing,
+ * so cluster allocation happens a chunk at a time instead of in the
+ * middle of a session.  The reserve is trimmed off when the file is
+ * closed; a file not closed cleanly (power cut) keeps it as junk at the
+ * end.  0 disables.
+ */
+#define LOG_PREALLOC_SIZE	1048576
+/*
+ * Bytes of RAM that raw CAN frames queue up in on their way to the SD
+ * card while capturing, split into CAN_CAPTURE_BUFFERS buffers.  Only
+ * allocated once a capture starts.  A frame takes 11 bytes or so, and
+ * a busy 1 Mbit bus carries about 8000 a second.  0 disables.
+ */
+#define CAN_CAPTURE_SIZE	4096
+#define CAN_CAPTURE_BUFFERS	4
 
 /* LUA Configuration */
 
@@ -109,6 +136,7 @@ CPP_GUARD_BEGIN
 #define CAN_CHANNELS			2
 #define CAN_SW_TERMINATION      true
 #define CAN_MAPPINGS            10
+#define CAN_FILTER_BANKS        13
 #define OBD2_CHANNELS           10
 
 //wireless links
@@ -32,6 +32,11 @@ int flush_logfile(struct logging_status *ls);
 int logging_stop(struct logging_status *ls);
 int logging_start(struct logging_status *ls);
 int logging_sample(struct logging_status *ls, LoggerMessage *msg);
+int drain_log_spool(struct logging_status *ls);
+int log_file_name_index(const char *name);
+enum writing_status open_new_log_file(struct logging_status *ls);
+FRESULT log_file_reserve(FIL *f);
+FRESULT log_file_trim(FIL *f);
 
 CPP_GUARD_END
 
@@ -0,0 +1,213 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "LapSummaryTest.hh"
+#include "channel_registry.h"
+#include "lap_summary.h"
+#include "mock_serial.h"
+#include "sampleRecord.h"
+
+#include <string.h>
+#include <string>
+
+using std::string;
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LapSummaryTest );
+
+#define CHANNELS	3
+
+static ChannelConfig cfgs[CHANNELS];
+static ChannelSample channels[CHANNELS];
+static struct sample sample;
+
+static void add(const float speed, const int rpm)
+{
+        channels[0].valueFloat = speed;
+        channels[1].valueInt = rpm;
+        lap_summary_add_sample(&sample);
+}
+
+void LapSummaryTest::setUp()
+{
+        memset(cfgs, 0, sizeof(cfgs));
+        memset(channels, 0, sizeof(channels));
+        strcpy(cfgs[0].label, "Speed");
+        cfgs[0].precision = 1;
+        strcpy(cfgs[1].label, "RPM");
+        strcpy(cfgs[2].label, "Utc");
+
+        channels[0].sampleData = SampleData_Float;
+        channels[1].sampleData = SampleData_Int;
+        channels[2].sampleData = SampleData_LongLong_Noarg;
+        for (size_t i = 0; i < CHANNELS; ++i) {
+                channels[i].cfg = cfgs + i;
+                channels[i].populated = true;
+        }
+
+        sample.channel_count = CHANNELS;
+        sample.channel_samples = channels;
+        channel_registry_build(&sample);
+
+        lap_summary_init();
+        setupMockSerial();
+        mock_resetTxBuffer();
+}
+
+void LapSummaryTest::tearDown()
+{
+        lap_summary_init();
+        channel_registry_build(NULL);
+}
+
+void LapSummaryTest::no_lap_test()
+{
+        struct lap_summary_channel chan;
+
+        add(10, 1000);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, lap_summary_count());
+        CPPUNIT_ASSERT(!lap_summary_get_channel(0, &chan));
+}
+
+void LapSummaryTest::lap_stats_test()
+{
+        struct lap_summary_channel chan;
+
+        lap_summary_start_lap();
+        add(10, 1000);
+        add(30, 3000);
+        add(20, 5000);
+        lap_summary_end_lap(1, 90000);
+
+        /* The lap ends on the next sample, which goes to the next lap */
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, lap_summary_count());
+        add(50, 6000);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, lap_summary_count());
+
+        CPPUNIT_ASSERT(lap_summary_get_channel(0, &chan));
+        CPPUNIT_ASSERT(cfgs == chan.cfg);
+        CPPUNIT_ASSERT_EQUAL(10.0f, chan.min);
+        CPPUNIT_ASSERT_EQUAL(30.0f, chan.max);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 3, chan.count);
+        CPPUNIT_ASSERT_EQUAL(20.0, chan.sum / chan.count);
+
+        CPPUNIT_ASSERT(lap_summary_get_channel(1, &chan));
+        CPPUNIT_ASSERT_EQUAL(1000.0f, chan.min);
+        CPPUNIT_ASSERT_EQUAL(5000.0f, chan.max);
+        CPPUNIT_ASSERT_EQUAL(3000.0, chan.sum / chan.count);
+
+        /* Too big to summarize */
+        CPPUNIT_ASSERT(lap_summary_get_channel(2, &chan));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, chan.count);
+        CPPUNIT_ASSERT(!lap_summary_get_channel(CHANNELS, &chan));
+
+        /* The next lap started with the sample that ended this one */
+        lap_summary_end_lap(2, 80000);
+        add(0, 0);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, lap_summary_count());
+        CPPUNIT_ASSERT(lap_summary_get_channel(0, &chan));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, chan.count);
+        CPPUNIT_ASSERT_EQUAL(50.0f, chan.min);
+}
+
+void LapSummaryTest::out_lap_dropped_test()
+{
+        struct lap_summary_channel chan;
+
+        add(200, 9000);
+        add(300, 9000);
+        lap_summary_start_lap();
+        add(10, 1000);
+        lap_summary_end_lap(1, 90000);
+        add(0, 0);
+
+        CPPUNIT_ASSERT(lap_summary_get_channel(0, &chan));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, chan.count);
+        CPPUNIT_ASSERT_EQUAL(10.0f, chan.max);
+}
+
+void LapSummaryTest::unpopulated_test()
+{
+        struct lap_summary_channel chan;
+
+        add(10, 1000);
+        channels[1].populated = false;
+        add(20, 9000);
+        lap_summary_end_lap(1, 90000);
+        add(0, 0);
+
+        CPPUNIT_ASSERT(lap_summary_get_channel(0, &chan));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, chan.count);
+        CPPUNIT_ASSERT(lap_summary_get_channel(1, &chan));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, chan.count);
+        CPPUNIT_ASSERT_EQUAL(1000.0f, chan.max);
+}
+
+void LapSummaryTest::reset_test()
+{
+        struct lap_summary_channel chan;
+
+        add(10, 1000);
+        lap_summary_end_lap(1, 90000);
+        add(0, 0);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, lap_summary_count());
+
+        lap_summary_reset();
+        add(0, 0);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, lap_summary_count());
+        CPPUNIT_ASSERT(!lap_summary_get_channel(0, &chan));
+}
+
+void LapSummaryTest::layout_change_test()
+{
+        struct lap_summary_channel chan;
+
+        add(10, 1000);
+        lap_summary_end_lap(1, 90000);
+        add(0, 0);
+
+        /* Indexes of the old layout mean nothing now */
+        sample.channel_count = CHANNELS - 1;
+        channel_registry_build(&sample);
+        add(0, 0);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, lap_summary_count());
+        CPPUNIT_ASSERT(!lap_summary_get_channel(0, &chan));
+}
+
+void LapSummaryTest::json_test()
+{
+        lap_summary_get_json(getMockSerial(), false);
+        CPPUNIT_ASSERT_EQUAL(string("\"lapSum\":{\"lap\":0,\"ms\":0,"
+                                    "\"chans\":{}}"),
+                             string(mock_getTxBuffer()));
+
+        add(10, 1000);
+        add(30, 3000);
+        lap_summary_end_lap(3, 90500);
+        add(0, 0);
+
+        mock_resetTxBuffer();
+        lap_summary_get_json(getMockSerial(), false);
+        CPPUNIT_ASSERT_EQUAL(string("\"lapSum\":{\"lap\":3,\"ms\":90500,"
+                                    "\"chans\":{\"Speed\":[10.0,30.0,20.0],"
+                                    "\"RPM\":[1000,3000,2000]}}"),
+                             string(mock_getTxBuffer()));
+}
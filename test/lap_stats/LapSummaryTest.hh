@@ -0,0 +1,52 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _LAPSUMMARYTEST_H_
+#define _LAPSUMMARYTEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class LapSummaryTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( LapSummaryTest );
+        CPPUNIT_TEST( no_lap_test );
+        CPPUNIT_TEST( lap_stats_test );
+        CPPUNIT_TEST( out_lap_dropped_test );
+        CPPUNIT_TEST( unpopulated_test );
+        CPPUNIT_TEST( reset_test );
+        CPPUNIT_TEST( layout_change_test );
+        CPPUNIT_TEST( json_test );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void tearDown();
+        void no_lap_test();
+        void lap_stats_test();
+        void out_lap_dropped_test();
+        void unpopulated_test();
+        void reset_test();
+        void layout_change_test();
+        void json_test();
+};
+
+#endif /* _LAPSUMMARYTEST_H_ */
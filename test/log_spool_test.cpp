@@ -0,0 +1,288 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "channel_registry.h"
+#include "ff_testing.h"
+#include "fileWriter.h"
+#include "fileWriter_testing.h"
+#include "heap_testing.h"
+#include "log_spool.h"
+#include "log_spool_test.hh"
+#include "loggerConfig.h"
+#include "loggerSampleData.h"
+#include "loggerSampleData_testing.h"
+#include "sampleRecord.h"
+
+#include <string.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LogSpoolTest );
+
+static struct sample sample;
+
+void LogSpoolTest::setUp()
+{
+        reset_free_heap_size();
+        log_spool_init();
+
+        memset(&sample, 0, sizeof(sample));
+        init_sample_buffer(&sample,
+                           get_enabled_channel_count(getWorkingLoggerConfig()));
+        fill_sample(&sample, SAMPLE_10Hz);
+        channel_registry_build(&sample);
+}
+
+void LogSpoolTest::tearDown()
+{
+        log_spool_init();
+        reset_free_heap_size();
+        free_sample_buffer(&sample);
+
+        /* Don't let later tests match frames of this sample */
+        channel_registry_build(NULL);
+}
+
+void LogSpoolTest::testSizedFromHeap()
+{
+        set_free_heap_size(16000);
+        CPPUNIT_ASSERT_EQUAL((size_t) 4000, log_spool_alloc(LOG_SPOOL_MAX_SIZE));
+
+        /* Allocated once, whatever the heap does later */
+        set_free_heap_size(1000000);
+        CPPUNIT_ASSERT_EQUAL((size_t) 4000, log_spool_alloc(LOG_SPOOL_MAX_SIZE));
+
+        log_spool_init();
+        CPPUNIT_ASSERT_EQUAL((size_t) LOG_SPOOL_MAX_SIZE,
+                             log_spool_alloc(LOG_SPOOL_MAX_SIZE));
+}
+
+void LogSpoolTest::testReleasedOnceDrained()
+{
+        set_free_heap_size(16000);
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+        CPPUNIT_ASSERT(log_spool_add(&sample));
+
+        /* Records of the session are not thrown away */
+        log_spool_release();
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, log_spool_pending());
+        CPPUNIT_ASSERT(log_spool_take());
+
+        log_spool_release();
+        CPPUNIT_ASSERT(!log_spool_add(&sample));
+        CPPUNIT_ASSERT(!log_spool_preroll(&sample, SAMPLE_10Hz));
+        CPPUNIT_ASSERT(!log_spool_take());
+
+        /* And sized for the heap of the next session */
+        set_free_heap_size(20000);
+        CPPUNIT_ASSERT_EQUAL((size_t) 5000, log_spool_alloc(LOG_SPOOL_MAX_SIZE));
+        CPPUNIT_ASSERT(log_spool_add(&sample));
+}
+
+void LogSpoolTest::testNotEnoughRam()
+{
+        set_free_heap_size(LOG_SPOOL_MIN_SIZE);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, log_spool_alloc(LOG_SPOOL_MAX_SIZE));
+        CPPUNIT_ASSERT(!log_spool_add(&sample));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, log_spool_pending());
+        CPPUNIT_ASSERT(!log_spool_take());
+}
+
+void LogSpoolTest::testRoundTrip()
+{
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+        sample.channel_samples[2].populated = false;
+        CPPUNIT_ASSERT(log_spool_add(&sample));
+
+        /* What we took must not depend on the sample buffer any more */
+        struct sample copy = sample;
+        ChannelSample values[sample.channel_count];
+        memcpy(values, sample.channel_samples, sizeof(values));
+        copy.channel_samples = values;
+        fill_sample(&sample, SAMPLE_10Hz * 2);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, log_spool_pending());
+        const struct sample *s = log_spool_take();
+        CPPUNIT_ASSERT(s);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, log_spool_pending());
+        CPPUNIT_ASSERT_EQUAL((size_t) SAMPLE_10Hz, s->ticks);
+        CPPUNIT_ASSERT_EQUAL(copy.channel_count, s->channel_count);
+
+        for (size_t i = 0; i < s->channel_count; ++i) {
+                double expected, actual;
+                const bool has = get_sample_value_by_index(&copy, i,
+                                                           &expected);
+                CPPUNIT_ASSERT_EQUAL(has,
+                                     get_sample_value_by_index(s, i, &actual));
+                if (has)
+                        CPPUNIT_ASSERT_EQUAL(expected, actual);
+        }
+
+        CPPUNIT_ASSERT(!s->channel_samples[2].populated);
+        CPPUNIT_ASSERT(!log_spool_take());
+}
+
+void LogSpoolTest::testFull()
+{
+        set_free_heap_size(LOG_SPOOL_MAX_SIZE * 4);
+        const size_t size = log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+
+        size_t added = 0;
+        for (size_t t = 1; log_spool_add(&sample); ++t, ++added)
+                fill_sample(&sample, SAMPLE_10Hz * (t + 1));
+
+        CPPUNIT_ASSERT(added > 1);
+        CPPUNIT_ASSERT_EQUAL(added, log_spool_pending());
+
+        struct log_spool_stats st;
+        log_spool_get_stats(&st);
+        CPPUNIT_ASSERT_EQUAL(size, st.size);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) added, st.spooled);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, st.dropped);
+        CPPUNIT_ASSERT_EQUAL(added, st.high_water_records);
+        CPPUNIT_ASSERT(st.high_water <= size);
+        CPPUNIT_ASSERT(st.high_water > size / 2);
+
+        /* The oldest sample was kept, the newest dropped */
+        CPPUNIT_ASSERT_EQUAL((size_t) SAMPLE_10Hz, log_spool_take()->ticks);
+}
+
+void LogSpoolTest::testLayoutChange()
+{
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+        CPPUNIT_ASSERT(log_spool_add(&sample));
+
+        channel_registry_build(&sample);
+        CPPUNIT_ASSERT(!log_spool_take());
+
+        struct log_spool_stats st;
+        log_spool_get_stats(&st);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, st.dropped);
+}
+
+void LogSpoolTest::testStats()
+{
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+        log_spool_note_stall(12);
+        log_spool_note_stall(5);
+        log_spool_add(&sample);
+
+        struct log_spool_stats st;
+        log_spool_get_stats(&st);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 12, st.worst_stall_ms);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, st.spooled);
+
+        /* A new session starts from scratch, but keeps the spool */
+        log_spool_reset_stats();
+        log_spool_get_stats(&st);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, st.worst_stall_ms);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, st.spooled);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, st.high_water);
+        CPPUNIT_ASSERT_EQUAL((size_t) LOG_SPOOL_MAX_SIZE, st.size);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, log_spool_pending());
+}
+
+void LogSpoolTest::testFileWriterDrains()
+{
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+        for (size_t t = 1; t <= 3; ++t) {
+                fill_sample(&sample, SAMPLE_10Hz * t);
+                CPPUNIT_ASSERT(log_spool_add(&sample));
+        }
+
+        startFileWriterTask(0);
+        struct logging_status ls;
+        memset(&ls, 0, sizeof(ls));
+        logging_start(&ls);
+        ff_reset_bytes_written();
+
+        CPPUNIT_ASSERT_EQUAL(0, drain_log_spool(&ls));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, log_spool_pending());
+
+        /* Header plus the three rows */
+        CPPUNIT_ASSERT_EQUAL((unsigned int) 4, ls.rows_written);
+        CPPUNIT_ASSERT(ff_get_bytes_written() > 0);
+        CPPUNIT_ASSERT_EQUAL((portTickType) (SAMPLE_10Hz * 3),
+                             ls.last_sample_tick);
+
+        logging_stop(&ls);
+}
+
+void LogSpoolTest::testPrerollWindow()
+{
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+        for (size_t t = 1; t <= 10; ++t) {
+                fill_sample(&sample, SAMPLE_10Hz * t);
+                CPPUNIT_ASSERT(log_spool_preroll(&sample, SAMPLE_10Hz * 3));
+        }
+
+        /* Nothing for the writer until logging starts */
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, log_spool_pending());
+        CPPUNIT_ASSERT(!log_spool_take());
+
+        log_spool_end_preroll();
+        CPPUNIT_ASSERT_EQUAL((size_t) 4, log_spool_pending());
+
+        /* Only the window is kept, with the original ticks */
+        for (size_t t = 7; t <= 10; ++t)
+                CPPUNIT_ASSERT_EQUAL((size_t) (SAMPLE_10Hz * t),
+                                     log_spool_take()->ticks);
+
+        /* The pre-roll isn't a spool of the session */
+        struct log_spool_stats st;
+        log_spool_get_stats(&st);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, st.spooled);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, st.dropped);
+}
+
+void LogSpoolTest::testPrerollFull()
+{
+        set_free_heap_size(LOG_SPOOL_MAX_SIZE * 4);
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+
+        /* A window too big for RAM keeps as much of it as fits */
+        const size_t count = 1000;
+        for (size_t t = 1; t <= count; ++t) {
+                fill_sample(&sample, SAMPLE_10Hz * t);
+                CPPUNIT_ASSERT(log_spool_preroll(&sample, UINT32_MAX));
+        }
+
+        log_spool_end_preroll();
+        const size_t kept = log_spool_pending();
+        CPPUNIT_ASSERT(kept > 1);
+        CPPUNIT_ASSERT(kept < count);
+        CPPUNIT_ASSERT_EQUAL((size_t) (SAMPLE_10Hz * (count - kept + 1)),
+                             log_spool_take()->ticks);
+}
+
+void LogSpoolTest::testPrerollWaitsForWriter()
+{
+        log_spool_alloc(LOG_SPOOL_MAX_SIZE);
+        CPPUNIT_ASSERT(log_spool_add(&sample));
+
+        /* Samples of the last session must reach its file first */
+        fill_sample(&sample, SAMPLE_10Hz * 2);
+        CPPUNIT_ASSERT(!log_spool_preroll(&sample, SAMPLE_10Hz * 3));
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, log_spool_pending());
+
+        CPPUNIT_ASSERT_EQUAL((size_t) SAMPLE_10Hz, log_spool_take()->ticks);
+        CPPUNIT_ASSERT(log_spool_preroll(&sample, SAMPLE_10Hz * 3));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, log_spool_pending());
+}
@@ -0,0 +1,60 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _LOG_SPOOL_TEST_H_
+#define _LOG_SPOOL_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class LogSpoolTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( LogSpoolTest );
+        CPPUNIT_TEST( testSizedFromHeap );
+        CPPUNIT_TEST( testReleasedOnceDrained );
+        CPPUNIT_TEST( testNotEnoughRam );
+        CPPUNIT_TEST( testRoundTrip );
+        CPPUNIT_TEST( testFull );
+        CPPUNIT_TEST( testLayoutChange );
+        CPPUNIT_TEST( testStats );
+        CPPUNIT_TEST( testFileWriterDrains );
+        CPPUNIT_TEST( testPrerollWindow );
+        CPPUNIT_TEST( testPrerollFull );
+        CPPUNIT_TEST( testPrerollWaitsForWriter );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void tearDown();
+        void testSizedFromHeap();
+        void testReleasedOnceDrained();
+        void testNotEnoughRam();
+        void testRoundTrip();
+        void testFull();
+        void testLayoutChange();
+        void testStats();
+        void testFileWriterDrains();
+        void testPrerollWindow();
+        void testPrerollFull();
+        void testPrerollWaitsForWriter();
+};
+
+#endif /* _LOG_SPOOL_TEST_H_ */
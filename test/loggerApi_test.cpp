@@ -25,8 +25,11 @@
 #include "bluetooth.h"
 #include "cellular.h"
 #include "channel_config.h"
+#include "channel_registry.h"
 #include "constants.h"
 #include "cpu.h"
+#include "ff.h"
+#include "ff_testing.h"
 #include "imu.h"
 #include "jsmn.h"
 #include "lap_stats.h"
@@ -35,12 +38,15 @@
 #include "loggerApi.h"
 #include "loggerApi_test.h"
 #include "loggerConfig.h"
+#include "loggerSampleData.h"
 #include "luaScript.h"
 #include "memory_mock.h"
 #include "mock_serial.h"
 #include "predictive_timer_2.h"
 #include "printk.h"
 #include "rcp_cpp_unit.hh"
+#include "sample_frame.h"
+#include "sample_meta.h"
 #include "sim900.h"
 #include "task.h"
 #include "task_testing.h"
@@ -187,7 +193,7 @@ void LoggerApiTest::populateChannelConfig(ChannelConfig *cfg, const int i, const
    cfg->precision = (unsigned char) i + 1;
 }
 
-void LoggerApiTest::check_channel_config(Object &json_ch_cfg, ChannelConfig *ch_cfg)
+void LoggerApiTest::check_channel_config(Object &json_ch_cfg, const ChannelConfig *ch_cfg)
 {
     CPPUNIT_ASSERT_EQUAL((int)(Number)json_ch_cfg["sr"], (int)decodeSampleRate(ch_cfg->sampleRate));
     CPPUNIT_ASSERT_EQUAL((string)(String)json_ch_cfg["nm"], string(ch_cfg->label));
@@ -674,6 +680,23 @@ void LoggerApiTest::testGetMeta(){
                         getSampleResponse(requestJson));
 }
 
+void LoggerApiTest::testGetMetaHash(){
+	string requestJson = readFile("getMetaHash.json");
+	string expectedResponseJson = readFile("getMetaHash_response.json");
+
+	CPPUNIT_ASSERT_EQUAL(expectedResponseJson,
+                        getSampleResponse(requestJson));
+        CPPUNIT_ASSERT(sample_meta_client_has(getMockSerial(), 515808957));
+
+        /* A stale hash gets the full meta back */
+        const string staleJson = "{\"getMeta\":{\"mh\":1}}";
+        CPPUNIT_ASSERT_EQUAL(readFile("getMeta_response.json"),
+                             getSampleResponse(staleJson));
+
+        sample_meta_reset_client(getMockSerial());
+        CPPUNIT_ASSERT(!sample_meta_client_has(getMockSerial(), 515808957));
+}
+
 void LoggerApiTest::testSampleData1() {
 	string requestJson1 = readFile("sampleData1.json");
 	string expectedResponseJson1 = readFile("sampleData_response1.json");
@@ -692,6 +715,67 @@ void LoggerApiTest::testSampleData2() {
                         getSampleResponse(requestJson2));
 }
 
+void LoggerApiTest::testSampleFrameShared() {
+        LoggerConfig *config = getWorkingLoggerConfig();
+        struct sample s;
+        memset(&s, 0, sizeof(struct sample));
+        CPPUNIT_ASSERT(init_sample_buffer(&s, get_enabled_channel_count(config)));
+        populate_sample_buffer(&s, 10);
+        channel_registry_build(&s);
+
+        /* Streaming the same sample twice gives the same record */
+        mock_resetTxBuffer();
+        api_send_sample_record(getMockSerial(), &s, 1, 0, NULL);
+        const string first(mock_getTxBuffer());
+        mock_resetTxBuffer();
+        api_send_sample_record(getMockSerial(), &s, 1, 0, NULL);
+        CPPUNIT_ASSERT_EQUAL(first, string(mock_getTxBuffer()));
+
+        /* And both streams get the one rendering */
+        struct sample_frame *a = sample_frame_acquire(&s, NULL);
+        struct sample_frame *b = sample_frame_acquire(&s, NULL);
+        CPPUNIT_ASSERT(a == b);
+        CPPUNIT_ASSERT(a->shared);
+
+        struct sample_frame *p = sample_frame_create(&s, NULL);
+        CPPUNIT_ASSERT(p != a);
+        CPPUNIT_ASSERT(!p->shared);
+        CPPUNIT_ASSERT_EQUAL(string(p->data, p->length),
+                             string(a->data, a->length));
+
+        /* A new sample in the same buffer gets rendered again */
+        populate_sample_buffer(&s, 11);
+        struct sample_frame *c = sample_frame_acquire(&s, NULL);
+        CPPUNIT_ASSERT(c != a);
+        CPPUNIT_ASSERT_EQUAL(s.ticks, c->ticks);
+
+        /* Once all slots are busy it falls back to a private frame */
+        struct sample_frame *d = sample_frame_acquire(&s, NULL);
+        CPPUNIT_ASSERT(d == c);
+        struct sample_frame *busy[SAMPLE_FRAME_SLOTS - 2];
+        for (size_t i = 0; i < SAMPLE_FRAME_SLOTS - 2; ++i) {
+                s.ticks++;
+                busy[i] = sample_frame_acquire(&s, NULL);
+                CPPUNIT_ASSERT(busy[i]->shared);
+        }
+        s.ticks++;
+        struct sample_frame *e = sample_frame_acquire(&s, NULL);
+        CPPUNIT_ASSERT(!e->shared);
+
+        sample_frame_release(a);
+        sample_frame_release(b);
+        sample_frame_release(c);
+        sample_frame_release(d);
+        for (size_t i = 0; i < SAMPLE_FRAME_SLOTS - 2; ++i)
+                sample_frame_release(busy[i]);
+        sample_frame_release(e);
+        sample_frame_release(p);
+        free_sample_buffer(&s);
+
+        /* Don't let later tests match frames of this stack sample */
+        channel_registry_build(NULL);
+}
+
 void LoggerApiTest::testHeartBeat(){
 	set_ticks(3);
     string requestJson = readFile("heartBeat_request.json");
@@ -1077,6 +1161,8 @@ void LoggerApiTest::testGetCanCfgFile(string filename){
 	canConfig->enabled = 1;
 	canConfig->baud[0] = 1000000;
 	canConfig->baud[1] = 125000;
+	canConfig->auto_filter = 1;
+	canConfig->capture = 1;
 
 	const char *response = processApiGeneric(filename);
 	Object json;
@@ -1085,6 +1171,8 @@ void LoggerApiTest::testGetCanCfgFile(string filename){
 	CPPUNIT_ASSERT_EQUAL(1, (int)(Number)json["canCfg"]["en"]);
 	CPPUNIT_ASSERT_EQUAL(1000000, (int)(Number)json["canCfg"]["baud"][0]);
 	CPPUNIT_ASSERT_EQUAL(125000, (int)(Number)json["canCfg"]["baud"][1]);
+	CPPUNIT_ASSERT_EQUAL(1, (int)(Number)json["canCfg"]["autoFilt"]);
+	CPPUNIT_ASSERT_EQUAL(1, (int)(Number)json["canCfg"]["cap"]);
 }
 
 void LoggerApiTest::testSetCanCfg(){
@@ -1102,7 +1190,7 @@ void LoggerApiTest::testSetCanCfgFile(string filename){
 	CPPUNIT_ASSERT_EQUAL(1000000, (int)canCfg->baud[1]);
 }
 
-void LoggerApiTest::check_can_mapping_config(Object &jch, CANMapping *mapping)
+void LoggerApiTest::check_can_mapping_config(Object &jch, const CANMapping *mapping)
 {
     CPPUNIT_ASSERT_EQUAL((int)(Number)jch["filtId"], (int)mapping->conversion_filter_id);
     CPPUNIT_ASSERT_EQUAL((bool)(Boolean)jch["bm"], (bool)mapping->bit_mode);
@@ -1134,8 +1222,7 @@ void LoggerApiTest::testSetCanChanCfg()
 
 void LoggerApiTest::testGetCanChanCfgFile(string filename)
 {
-    LoggerConfig *c = getWorkingLoggerConfig();
-    CANChannelConfig *cfg = &c->can_channel_cfg;
+    CANChannelConfig *cfg = get_can_channel_config_rw();
 
     cfg->enabled = true;
     cfg->enabled_mappings = CONFIG_CAN_MAPPINGS;
@@ -1198,8 +1285,7 @@ void LoggerApiTest::testSetCanChanCfgFile(string filename)
 
         bool last = (bool)(Boolean)json["setCanChanCfg"]["last"];
 
-        LoggerConfig *c = getWorkingLoggerConfig();
-        CANChannelConfig *cfg = &c->can_channel_cfg;
+        const CANChannelConfig *cfg = get_can_channel_config();
 
         /* ensure our index is handled correctly */
         char *txBuffer = mock_getTxBuffer();
@@ -1209,9 +1295,9 @@ void LoggerApiTest::testSetCanChanCfgFile(string filename)
         if (expected_response_code == API_ERROR_PARAMETER)
             return; //no further testing needed
 
-        CANChannel *ch = &(cfg->can_channels[index]);
-        ChannelConfig *ch_cfg = &(ch->mapping.channel_cfg);
-        CANMapping *mapping = &(ch->mapping);
+        const CANChannel *ch = &(cfg->can_channels[index]);
+        const ChannelConfig *ch_cfg = &(ch->mapping.channel_cfg);
+        const CANMapping *mapping = &(ch->mapping);
 
         Object jch = (Object)json["setCanChanCfg"]["chans"][index];
         check_channel_config(jch, ch_cfg);
@@ -1231,8 +1317,7 @@ void LoggerApiTest::testGetObd2Cfg(){
 }
 
 void LoggerApiTest::testGetObd2ConfigFile(string filename){
-        LoggerConfig *c = getWorkingLoggerConfig();
-        OBD2Config *obd2Config = &c->OBD2Configs;
+        OBD2Config *obd2Config = get_obd2_config_rw();
 
         obd2Config->enabled = 1;
         obd2Config->enabledPids = 2;
@@ -1280,15 +1365,14 @@ void LoggerApiTest::testSetObd2ConfigFile(string filename){
         char *txBuffer = mock_getTxBuffer();
         assertGenericResponse(txBuffer, "setObd2Cfg", API_SUCCESS);
 
-        LoggerConfig *c = getWorkingLoggerConfig();
-        OBD2Config *obd2Config = &c->OBD2Configs;
+        const OBD2Config *obd2Config = get_obd2_config();
 
         CPPUNIT_ASSERT_EQUAL(1, (int)obd2Config->enabled);
         CPPUNIT_ASSERT_EQUAL(2, (int)obd2Config->enabledPids);
 
         Array json_pids = (Array)json["setObd2Cfg"]["pids"];
         for (size_t i=0; i < json_pids.Size(); i++) {
-                PidConfig *pid_cfg = &obd2Config->pids[i];
+                const PidConfig *pid_cfg = &obd2Config->pids[i];
                 Object json_pid = (Object)json_pids[i];
                 check_channel_config(json_pid, &pid_cfg->mapping.channel_cfg);
                 check_can_mapping_config(json_pid, &pid_cfg->mapping);
@@ -1312,8 +1396,7 @@ void LoggerApiTest::testSetObd2ConfigFile_fromIndex(){
     processApiGeneric(obd2_cfg1);
     processApiGeneric(obd2_cfg2);
 
-	LoggerConfig *c = getWorkingLoggerConfig();
-	OBD2Config *obd2Config = &c->OBD2Configs;
+	const OBD2Config *obd2Config = get_obd2_config();
 
     CPPUNIT_ASSERT_EQUAL(1, (int)obd2Config->enabled);
 
@@ -1465,6 +1548,10 @@ void LoggerApiTest::testGetStatus(){
 	CPPUNIT_ASSERT_EQUAL((int)BT_STATUS_NOT_INIT,
 			     (int)(Number)bt_obj["init"]);
 
+	/* No connectivity tasks run here, so no streams */
+	Object stream_obj = json["status"]["stream"];
+	CPPUNIT_ASSERT(stream_obj.Begin() == stream_obj.End());
+
 
 	Object logging_obj = json["status"]["logging"];
 	CPPUNIT_ASSERT_EQUAL((int)LOGGING_STATUS_IDLE,
@@ -1472,6 +1559,13 @@ void LoggerApiTest::testGetStatus(){
 	CPPUNIT_ASSERT_EQUAL(0, (int)(Number)logging_obj["started"]);
 
 
+	Object obd2_obj = json["status"]["obd2"];
+	CPPUNIT_ASSERT_EQUAL(false, (bool)(Boolean)obd2_obj["active"]);
+	CPPUNIT_ASSERT_EQUAL(0, (int)(Number)obd2_obj["rtt"]);
+	Array obd2_rates = obd2_obj["hz"];
+	CPPUNIT_ASSERT(obd2_rates.Begin() == obd2_rates.End());
+
+
 	Object track_obj = json["status"]["track"];
 	CPPUNIT_ASSERT_EQUAL((int)TRACK_STATUS_WAITING_TO_CONFIG,
 			     (int)(Number)track_obj["status"]);
@@ -1650,6 +1744,7 @@ void LoggerApiTest::testGetAutoLoggerCfgDefault() {
         Object galc = json["sdLogCtrlCfg"];
         CPPUNIT_ASSERT_EQUAL(alc.enabled, (bool)(Boolean)galc["en"]);
         CPPUNIT_ASSERT_EQUAL(string(alc.channel), (string)(String)galc["channel"]);
+        CPPUNIT_ASSERT_EQUAL((int) alc.pre_trigger, (int)(Number)galc["pre"]);
 
         Object start_st = galc["start"];
         CPPUNIT_ASSERT_EQUAL(alc.start.threshold, (float)(Number)start_st["thresh"]);
@@ -1666,6 +1761,7 @@ void LoggerApiTest::testSetAutoLoggerCfg() {
 
         const struct auto_logger_config* cfg = &lc->auto_logger_cfg;
         CPPUNIT_ASSERT_EQUAL(true, cfg->enabled);
+        CPPUNIT_ASSERT_EQUAL((uint8_t) 5, cfg->pre_trigger);
 
         CPPUNIT_ASSERT_EQUAL((float) 45.6, cfg->start.threshold);
 	       CPPUNIT_ASSERT_EQUAL((uint32_t) 3, cfg->start.time);
@@ -1722,3 +1818,81 @@ void LoggerApiTest::testSetCameraControlCfg() {
 
         assertGenericResponse(response, "setCamCtrlCfg", API_SUCCESS);
 }
+
+static void create_file(const char *name, const char *data, const size_t len)
+{
+        FIL f;
+        UINT bw;
+
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, name, FA_WRITE |
+                                           FA_CREATE_NEW));
+        f_write(&f, data, len, &bw);
+        f_close(&f);
+}
+
+void LoggerApiTest::testGetLogList()
+{
+        ff_reset_files();
+        create_file("rc_0.log", "0123456789", 10);
+        create_file("rc_next.idx", "2", 1);
+        create_file("rc_1.log", "01234", 5);
+        create_file("rc_2.log", "", 0);
+
+        Object json;
+        stringToJson(processApiGeneric("getLogList1.json"), json);
+
+        Array files = (Array) json["logList"]["files"];
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, files.Size());
+        CPPUNIT_ASSERT_EQUAL(string("RC_0.LOG"),
+                             (string)(String) files[0]["nm"]);
+        CPPUNIT_ASSERT_EQUAL(10, (int)(Number) files[0]["sz"]);
+        CPPUNIT_ASSERT_EQUAL(string("RC_1.LOG"),
+                             (string)(String) files[1]["nm"]);
+        CPPUNIT_ASSERT_EQUAL(5, (int)(Number) files[1]["sz"]);
+        CPPUNIT_ASSERT_EQUAL(3, (int)(Number) json["logList"]["next"]);
+
+        /* The second page picks up where the first left off */
+        Object json2;
+        stringToJson(processApiGeneric("getLogList2.json"), json2);
+
+        files = (Array) json2["logList"]["files"];
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, files.Size());
+        CPPUNIT_ASSERT_EQUAL(string("RC_2.LOG"),
+                             (string)(String) files[0]["nm"]);
+        CPPUNIT_ASSERT_EQUAL(-1, (int)(Number) json2["logList"]["next"]);
+}
+
+void LoggerApiTest::testGetLogData()
+{
+        const char data[] = "ab1,\"x\"\r\n\\\x01\xff";
+
+        ff_reset_files();
+        create_file("rc_1.log", data, sizeof(data) - 1);
+
+        /* The test JSON reader can't do \u escapes, so match the text */
+        const char *response = processApiGeneric("getLogData1.json");
+        CPPUNIT_ASSERT_EQUAL(string("{\"logData\":{\"nm\":\"rc_1.log\","
+                                    "\"off\":2,\"sz\":12,\"data\":"
+                                    "\"1,\\\"x\\\"\\r\\n\\\\\\u0001\\u00ff\","
+                                    "\"len\":10}}\r\n"),
+                             string(response));
+
+        /* Names that aren't log files are refused */
+        response = processApiGeneric("getLogData2.json");
+        assertGenericResponse((char *) response, "getLogData",
+                              API_ERROR_PARAMETER);
+}
+
+void LoggerApiTest::testGetLogDataBusy()
+{
+        ff_reset_files();
+        create_file("rc_1.log", "abc", 3);
+
+        /* The card belongs to the logging session while it runs */
+        logging_set_logging_start(1);
+        const char *response = processApiGeneric("getLogData1.json");
+        logging_set_logging_start(0);
+
+        assertGenericResponse((char *) response, "getLogData",
+                              API_ERROR_UNSUPPORTED);
+}
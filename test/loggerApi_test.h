@@ -62,8 +62,10 @@ class LoggerApiTest : public CppUnit::TestFixture
     CPPUNIT_TEST( testGetTrackDb );
     CPPUNIT_TEST( testSampleData1 );
     CPPUNIT_TEST( testSampleData2 );
+    CPPUNIT_TEST( testSampleFrameShared );
     CPPUNIT_TEST( testHeartBeat );
     CPPUNIT_TEST( testGetMeta );
+    CPPUNIT_TEST( testGetMetaHash );
     CPPUNIT_TEST( testLogStartStop );
     CPPUNIT_TEST( testCalibrateImu);
     CPPUNIT_TEST( testFlashConfig);
@@ -94,6 +96,9 @@ class LoggerApiTest : public CppUnit::TestFixture
     CPPUNIT_TEST( testSetAutoLoggerCfg );
     CPPUNIT_TEST( testGetCameraControlCfgDefault );
     CPPUNIT_TEST( testSetCameraControlCfg );
+    CPPUNIT_TEST( testGetLogList );
+    CPPUNIT_TEST( testGetLogData );
+    CPPUNIT_TEST( testGetLogDataBusy );
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -115,8 +120,10 @@ public:
     void assertGenericResponse(char *buffer, const char *messageName, int responseCode);
     void testSampleData1();
     void testSampleData2();
+    void testSampleFrameShared();
     void testHeartBeat();
     void testGetMeta();
+    void testGetMetaHash();
     void testLogStartStop();
     void testSetConnectivityCfg();
     void testGetConnectivityCfg();
@@ -165,6 +172,9 @@ public:
     void testSetAutoLoggerCfg();
     void testGetCameraControlCfgDefault();
     void testSetCameraControlCfg();
+    void testGetLogList();
+    void testGetLogData();
+    void testGetLogDataBusy();
 
 private:
     void testSetScriptFile(string filename);
@@ -202,8 +212,8 @@ private:
     void testGetObd2ConfigFile(string filename);
     void testSetObd2ConfigFile(string filename);
     void populateChannelConfig(ChannelConfig *cfg, const int id, const int splRt);
-    void check_can_mapping_config(Object &json, CANMapping *mapping);
-    void check_channel_config(Object &json_cfg, ChannelConfig *cfg);
+    void check_can_mapping_config(Object &json, const CANMapping *mapping);
+    void check_channel_config(Object &json_cfg, const ChannelConfig *cfg);
     void testChannelConfig(ChannelConfig *chCfg, string expNm, string expUt, unsigned short sr);
 };
 
@@ -23,7 +23,9 @@
 #include "cpu.h"
 #include "loggerConfig.h"
 #include "loggerConfig_test.h"
+#include "memory_mock.h"
 #include "units.h"
+#include <stdio.h>
 #include <string.h>
 #include <string>
 
@@ -141,9 +143,7 @@ void LoggerConfigTest::testLoggerInitImuConfig() {
 }
 
 void LoggerConfigTest::testLoggerInitObd2Config() {
-   LoggerConfig *lc = getWorkingLoggerConfig();
-
-   OBD2Config *c = &lc->OBD2Configs;
+   const OBD2Config *c = get_obd2_config();
    CPPUNIT_ASSERT(c->enabled == 0);
 
    for (int i = 0; i < OBD2_CHANNELS; ++i) {
@@ -263,3 +263,56 @@ void LoggerConfigTest::testLoggerInitConnectivityConfig() {
    CPPUNIT_ASSERT_EQUAL(string(DEFAULT_TELEMETRY_SERVER_HOST),
                         string(tc->telemetryServerHost));
 }
+
+void LoggerConfigTest::testWorkingConfigOverlay() {
+   const LoggerConfigOverlay *saved = getSavedLoggerConfigOverlay();
+
+   /* Freshly loaded, the CAN and OBD2 config is read from flash */
+   CPPUNIT_ASSERT_EQUAL((size_t) 0, logger_config_overlay_size());
+   CPPUNIT_ASSERT(get_can_channel_config() == &saved->can_channel_cfg);
+   CPPUNIT_ASSERT(get_obd2_config() == &saved->OBD2Configs);
+
+   /* Nothing changed, nothing to flash */
+   memory_mock_set_is_flashed(0);
+   CPPUNIT_ASSERT_EQUAL(0, flashLoggerConfig());
+   CPPUNIT_ASSERT_EQUAL(0, memory_mock_get_is_flashed());
+
+   /* The first write moves the overlay to RAM */
+   OBD2Config *oc = get_obd2_config_rw();
+   CPPUNIT_ASSERT(oc != NULL);
+   CPPUNIT_ASSERT(oc != &saved->OBD2Configs);
+   CPPUNIT_ASSERT(get_obd2_config() == oc);
+   CPPUNIT_ASSERT(get_obd2_config_rw() == oc);
+   CPPUNIT_ASSERT(get_can_channel_config() != &saved->can_channel_cfg);
+   CPPUNIT_ASSERT_EQUAL(sizeof(LoggerConfigOverlay),
+                        logger_config_overlay_size());
+
+   oc->enabled = 1;
+   CPPUNIT_ASSERT_EQUAL(0, (int) saved->OBD2Configs.enabled);
+
+   /* A reader on the RAM copy keeps it past the flash */
+   logger_config_overlay_sync(LOGGER_CONFIG_READER_CAN);
+   CPPUNIT_ASSERT_EQUAL(0, flashLoggerConfig());
+   CPPUNIT_ASSERT_EQUAL(1, (int) saved->OBD2Configs.enabled);
+   CPPUNIT_ASSERT(get_obd2_config() == &saved->OBD2Configs);
+   CPPUNIT_ASSERT_EQUAL(sizeof(LoggerConfigOverlay),
+                        logger_config_overlay_size());
+
+   /* Until it syncs back to flash */
+   logger_config_overlay_sync(LOGGER_CONFIG_READER_CAN);
+   CPPUNIT_ASSERT_EQUAL((size_t) 0, logger_config_overlay_size());
+
+   /* Unflashed changes are dropped on reload */
+   get_obd2_config_rw()->enabled = 0;
+   initialize_logger_config();
+   CPPUNIT_ASSERT_EQUAL((size_t) 0, logger_config_overlay_size());
+   CPPUNIT_ASSERT(get_obd2_config() == &saved->OBD2Configs);
+   CPPUNIT_ASSERT_EQUAL(1, (int) get_obd2_config()->enabled);
+
+   CPPUNIT_ASSERT_EQUAL(0, flash_default_logger_config());
+   initialize_logger_config();
+   CPPUNIT_ASSERT_EQUAL((size_t) 0, logger_config_overlay_size());
+
+   printf("\nworking config: %zu bytes of RAM, overlay %zu in flash\n",
+          sizeof(LoggerConfig), sizeof(LoggerConfigOverlay));
+}
@@ -39,6 +39,7 @@ class LoggerConfigTest : public CppUnit::TestFixture
     CPPUNIT_TEST( testLoggerInitGpsConfig );
     CPPUNIT_TEST( testLoggerInitLapConfig );
     CPPUNIT_TEST( testLoggerInitConnectivityConfig );
+    CPPUNIT_TEST( testWorkingConfigOverlay );
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -56,6 +57,7 @@ public:
     void testLoggerInitGpsConfig();
     void testLoggerInitLapConfig();
     void testLoggerInitConnectivityConfig();
+    void testWorkingConfigOverlay();
 };
 
 #endif /* LOGGERDATA_TEST_H_ */
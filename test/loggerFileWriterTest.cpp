@@ -22,12 +22,15 @@
 #include "FreeRTOS.h"
 #include "fileWriter.h"
 #include "fileWriter_testing.h"
+#include "ff.h"
+#include "ff_testing.h"
 #include <string.h>
 #include "task.h"
 #include "task_testing.h"
 
 #include <stdio.h>
 #include <string>
+#include <time.h>
 
 // Registers the fixture into the 'registry'
 CPPUNIT_TEST_SUITE_REGISTRATION( LoggerFileWriterTest );
@@ -92,6 +95,227 @@ void LoggerFileWriterTest::testLoggingSampleSkip()
         CPPUNIT_ASSERT_EQUAL(0, rc);
 }
 
+void LoggerFileWriterTest::testLogFileNameIndex()
+{
+        CPPUNIT_ASSERT_EQUAL(0, log_file_name_index("rc_0.log"));
+        CPPUNIT_ASSERT_EQUAL(123, log_file_name_index("RC_123.LOG"));
+        CPPUNIT_ASSERT_EQUAL(99999, log_file_name_index("rc_99999.log"));
+        CPPUNIT_ASSERT_EQUAL(-1, log_file_name_index("rc_.log"));
+        CPPUNIT_ASSERT_EQUAL(-1, log_file_name_index("rc_12.txt"));
+        CPPUNIT_ASSERT_EQUAL(-1, log_file_name_index("rc_12.logx"));
+        CPPUNIT_ASSERT_EQUAL(-1, log_file_name_index("rc_100000.log"));
+        CPPUNIT_ASSERT_EQUAL(-1, log_file_name_index("RC_NEXT.IDX"));
+}
+
+static void create_log_files(const int count)
+{
+        FIL f;
+        char name[16];
+
+        for (int i = 0; i < count; ++i) {
+                sprintf(name, "rc_%d.log", i);
+                CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, name, FA_WRITE |
+                                                   FA_CREATE_NEW));
+        }
+}
+
+void LoggerFileWriterTest::testNewLogFileIndex()
+{
+        startFileWriterTask(0);
+        ff_reset_files();
+
+        /* Gaps are not refilled.  The next file follows the newest */
+        create_log_files(3);
+        FIL f;
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, "RC_7.LOG", FA_WRITE |
+                                           FA_CREATE_NEW));
+
+        CPPUNIT_ASSERT_EQUAL(WRITING_ACTIVE, open_new_log_file(ls));
+        CPPUNIT_ASSERT_EQUAL(std::string("rc_8.log"), std::string(ls->name));
+        CPPUNIT_ASSERT(ff_file_exists("rc_next.idx"));
+
+        /* The second start goes by the index file, not the directory */
+        ff_reset_dir_reads();
+        CPPUNIT_ASSERT_EQUAL(WRITING_ACTIVE, open_new_log_file(ls));
+        CPPUNIT_ASSERT_EQUAL(std::string("rc_9.log"), std::string(ls->name));
+        CPPUNIT_ASSERT(ff_get_dir_reads() <= 2 * ff_get_file_count());
+}
+
+void LoggerFileWriterTest::testNewLogFileStaleIndex()
+{
+        startFileWriterTask(0);
+        ff_reset_files();
+
+        CPPUNIT_ASSERT_EQUAL(WRITING_ACTIVE, open_new_log_file(ls));
+        CPPUNIT_ASSERT_EQUAL(std::string("rc_0.log"), std::string(ls->name));
+
+        /* Logs written while the card was elsewhere */
+        FIL f;
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, "rc_1.log", FA_WRITE |
+                                           FA_CREATE_NEW));
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, "rc_4.log", FA_WRITE |
+                                           FA_CREATE_NEW));
+
+        CPPUNIT_ASSERT_EQUAL(WRITING_ACTIVE, open_new_log_file(ls));
+        CPPUNIT_ASSERT_EQUAL(std::string("rc_5.log"), std::string(ls->name));
+
+        /* And a garbled index falls back to a scan */
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, "rc_next.idx", FA_WRITE));
+        UINT bw;
+        f_write(&f, "junk", 4, &bw);
+
+        CPPUNIT_ASSERT_EQUAL(WRITING_ACTIVE, open_new_log_file(ls));
+        CPPUNIT_ASSERT_EQUAL(std::string("rc_6.log"), std::string(ls->name));
+}
+
 /*
- * TODO: Build in tests for file open and close methods.
+ * What the file writer did before the index file: probe every name from
+ * rc_0.log up until one can be created.  Kept as the benchmark baseline.
  */
+static void probe_new_log_file(void)
+{
+        FIL f;
+        char name[16];
+
+        for (int i = 0; ; ++i) {
+                sprintf(name, "rc_%d.log", i);
+                if (FR_OK == f_open(&f, name, FA_WRITE | FA_CREATE_NEW))
+                        return;
+        }
+}
+
+void LoggerFileWriterTest::testNewLogFileStartTime()
+{
+        const int files = 1000;
+        const int runs = 20;
+        size_t probe_reads = 0, cold_reads = 0, warm_reads = 0;
+        clock_t probe_ticks = 0, cold_ticks = 0, warm_ticks = 0;
+
+        startFileWriterTask(0);
+
+        for (int run = 0; run < runs; ++run) {
+                ff_reset_files();
+                create_log_files(files);
+
+                ff_reset_dir_reads();
+                clock_t start = clock();
+                probe_new_log_file();
+                probe_ticks += clock() - start;
+                probe_reads += ff_get_dir_reads();
+
+                ff_reset_files();
+                create_log_files(files);
+
+                /* First start on this card.  No index file yet */
+                ff_reset_dir_reads();
+                start = clock();
+                CPPUNIT_ASSERT_EQUAL(WRITING_ACTIVE, open_new_log_file(ls));
+                cold_ticks += clock() - start;
+                cold_reads += ff_get_dir_reads();
+
+                ff_reset_dir_reads();
+                start = clock();
+                CPPUNIT_ASSERT_EQUAL(WRITING_ACTIVE, open_new_log_file(ls));
+                warm_ticks += clock() - start;
+                warm_reads += ff_get_dir_reads();
+        }
+
+        CPPUNIT_ASSERT_EQUAL(std::string("rc_1001.log"),
+                             std::string(ls->name));
+
+        printf("\nlog start (%d files): probe %zu dir reads %.1f us, "
+               "scan %zu dir reads %.1f us, index %zu dir reads %.1f us\n",
+               files, probe_reads / runs,
+               probe_ticks * 1e6 / CLOCKS_PER_SEC / runs,
+               cold_reads / runs, cold_ticks * 1e6 / CLOCKS_PER_SEC / runs,
+               warm_reads / runs, warm_ticks * 1e6 / CLOCKS_PER_SEC / runs);
+
+        /* A handful of directory passes instead of one per existing log */
+        CPPUNIT_ASSERT(cold_reads / runs < 5 * (files + 2));
+        CPPUNIT_ASSERT(warm_reads / runs < 5 * (files + 2));
+        CPPUNIT_ASSERT(warm_reads * 50 < probe_reads);
+}
+
+void LoggerFileWriterTest::testLogFileReserve()
+{
+        FIL f;
+        UINT bw;
+        char block[1000] = { 0 };
+
+        ff_reset_files();
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, "rc_0.log", FA_WRITE |
+                                           FA_CREATE_NEW));
+        CPPUNIT_ASSERT_EQUAL(FR_OK, log_file_reserve(&f));
+        CPPUNIT_ASSERT_EQUAL((DWORD) 0, f_tell(&f));
+        CPPUNIT_ASSERT_EQUAL((DWORD) LOG_PREALLOC_SIZE, f_size(&f));
+
+        /* Nothing more is reserved until half of it is used */
+        f_write(&f, block, sizeof(block), &bw);
+        CPPUNIT_ASSERT_EQUAL(FR_OK, log_file_reserve(&f));
+        CPPUNIT_ASSERT_EQUAL((DWORD) LOG_PREALLOC_SIZE, f_size(&f));
+
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_lseek(&f, LOG_PREALLOC_SIZE / 2 + 1));
+        CPPUNIT_ASSERT_EQUAL(FR_OK, log_file_reserve(&f));
+        CPPUNIT_ASSERT_EQUAL((DWORD) (LOG_PREALLOC_SIZE / 2 + 1), f_tell(&f));
+        CPPUNIT_ASSERT_EQUAL((DWORD) (LOG_PREALLOC_SIZE * 3 / 2 + 1),
+                             f_size(&f));
+
+        f_lseek(&f, sizeof(block));
+        CPPUNIT_ASSERT_EQUAL(FR_OK, log_file_trim(&f));
+        f_close(&f);
+
+        CPPUNIT_ASSERT_EQUAL(sizeof(block), ff_get_file_size("rc_0.log"));
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, ff_get_file_clusters("rc_0.log"));
+}
+
+/*
+ * Writes mb megabytes the way the file writer does, with a sync every
+ * FLUSH_INTERVAL_MS worth of data at 20KB/s.
+ * @return The FAT sectors written along the way.
+ */
+static size_t log_megabytes(const size_t mb, const bool prealloc)
+{
+        const size_t size = mb * 1024 * 1024;
+        const size_t sync_bytes = 20 * 1024;
+        char block[512] = { 0 };
+        FIL f;
+        UINT bw;
+
+        ff_reset_files();
+        CPPUNIT_ASSERT_EQUAL(FR_OK, f_open(&f, "rc_0.log", FA_WRITE |
+                                           FA_CREATE_NEW));
+        if (prealloc)
+                log_file_reserve(&f);
+
+        for (size_t written = sizeof(block); written <= size;
+             written += sizeof(block)) {
+                f_write(&f, block, sizeof(block), &bw);
+                if (written % sync_bytes)
+                        continue;
+
+                if (prealloc)
+                        log_file_reserve(&f);
+                f_sync(&f);
+        }
+
+        if (prealloc)
+                log_file_trim(&f);
+        f_close(&f);
+
+        CPPUNIT_ASSERT_EQUAL(size, ff_get_file_size("rc_0.log"));
+        CPPUNIT_ASSERT_EQUAL(size / 32768, ff_get_file_clusters("rc_0.log"));
+        return ff_get_fat_writes();
+}
+
+void LoggerFileWriterTest::testLogFileFatWrites()
+{
+        const size_t mb = 16;
+        const size_t plain = log_megabytes(mb, false);
+        const size_t reserved = log_megabytes(mb, true);
+
+        printf("\nFAT sector writes per MB logged: %.1f growing on "
+               "write, %.1f with a %u KB reserve\n", (double) plain / mb,
+               (double) reserved / mb, LOG_PREALLOC_SIZE / 1024);
+
+        CPPUNIT_ASSERT(reserved * 8 < plain);
+}
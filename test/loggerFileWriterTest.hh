@@ -30,6 +30,12 @@ class LoggerFileWriterTest : public CppUnit::TestFixture
         CPPUNIT_TEST( testLoggingStart );
         CPPUNIT_TEST( testLoggingStop );
         CPPUNIT_TEST( testLoggingSampleSkip );
+        CPPUNIT_TEST( testLogFileNameIndex );
+        CPPUNIT_TEST( testNewLogFileIndex );
+        CPPUNIT_TEST( testNewLogFileStaleIndex );
+        CPPUNIT_TEST( testNewLogFileStartTime );
+        CPPUNIT_TEST( testLogFileReserve );
+        CPPUNIT_TEST( testLogFileFatWrites );
         CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -41,6 +47,12 @@ public:
         void testLoggingStart();
         void testLoggingStop();
         void testLoggingSampleSkip();
+        void testLogFileNameIndex();
+        void testNewLogFileIndex();
+        void testNewLogFileStaleIndex();
+        void testNewLogFileStartTime();
+        void testLogFileReserve();
+        void testLogFileFatWrites();
 };
 
 #endif /* _LOGGERFILEWRITER_TEST_H_ */
@@ -0,0 +1,32 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "loggerSampleData.h"
+#include "loggerSampleData_testing.h"
+
+void fill_sample(struct sample *s, const size_t ticks)
+{
+        populate_sample_buffer(s, ticks);
+        s->ticks = ticks;
+        for (size_t i = 0; i < s->channel_count; ++i)
+                s->channel_samples[i].populated = true;
+}
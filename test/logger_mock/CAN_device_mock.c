@@ -21,8 +21,16 @@
 
 
 #include "CAN_device.h"
+#include "CAN_mock.h"
 #include <stdbool.h>
 
+static CAN_mock_tx_cb *tx_cb;
+
+void CAN_mock_set_tx_callback(CAN_mock_tx_cb *cb)
+{
+    tx_cb = cb;
+}
+
 int CAN_device_init(const uint8_t channel, const uint32_t baud, const bool termination_enabled)
 {
     return 1;
@@ -30,6 +38,8 @@ int CAN_device_init(const uint8_t channel, const uint32_t baud, const bool termi
 
 int CAN_device_tx_msg(const uint8_t channel, const CAN_msg *msg, unsigned int timeoutMs)
 {
+    if (tx_cb)
+        tx_cb(msg);
     return 1;
 }
 
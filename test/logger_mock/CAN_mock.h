@@ -0,0 +1,41 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CAN_MOCK_H_
+#define CAN_MOCK_H_
+
+#include "CAN.h"
+#include "cpp_guard.h"
+
+CPP_GUARD_BEGIN
+
+typedef void CAN_mock_tx_cb(const CAN_msg *msg);
+
+/**
+ * Sets a callback that sees every message sent on the bus, so tests
+ * can play the part of the devices on it.  NULL to stop.
+ */
+void CAN_mock_set_tx_callback(CAN_mock_tx_cb *cb);
+
+CPP_GUARD_END
+
+#endif /* CAN_MOCK_H_ */
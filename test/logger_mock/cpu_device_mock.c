@@ -21,6 +21,9 @@
 
 
 #include "cpu_device.h"
+#include "cpu_mock.h"
+
+static uint32_t cycle_count;
 
 int cpu_device_init(void)
 {
@@ -38,3 +41,18 @@ const char * cpu_device_get_serialnumber(void)
 }
 
 void cpu_device_spin(uint32_t ms) {}
+
+uint32_t cpu_device_get_cycle_count(void)
+{
+    return cycle_count;
+}
+
+uint32_t cpu_device_get_cycles_per_usec(void)
+{
+    return 1;
+}
+
+void cpu_mock_set_cycle_count(uint32_t cycles)
+{
+    cycle_count = cycles;
+}
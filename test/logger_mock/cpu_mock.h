@@ -0,0 +1,36 @@
+/*
+ * Race Capture Firmware
+ *
+ * Copyright (C) 2016 Autosport Labs
+ *
+ * This file is part of the Race Capture firmware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_MOCK_H_
+#define CPU_MOCK_H_
+
+#include "cpp_guard.h"
+
+#include <stdint.h>
+
+CPP_GUARD_BEGIN
+
+/* One cycle is one microsecond in the mock */
+void cpu_mock_set_cycle_count(uint32_t cycles);
+
+CPP_GUARD_END
+
+#endif /* CPU_MOCK_H_ */
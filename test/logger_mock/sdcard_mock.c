@@ -51,3 +51,13 @@ bool sdcard_present()
 {
     return true;
 }
+
+bool sdcard_lock(const size_t timeout_ms)
+{
+    return true;
+}
+
+void sdcard_unlock(void)
+{
+
+}
@@ -24,12 +24,16 @@
 
 #include "cpp_guard.h"
 
+#include <stddef.h>
 #include <stdlib.h>
 
 CPP_GUARD_BEGIN
 
 #define portMalloc malloc
 #define portFree free
+#define portGetFreeHeapSize xPortGetFreeHeapSize
+
+size_t xPortGetFreeHeapSize(void);
 
 CPP_GUARD_END
 
@@ -24,6 +24,7 @@
 #include "serial.h"
 
 #include <stddef.h>
+#include <string.h>
 
 #define BUFF_SIZE	(1024 * 16)
 
@@ -52,6 +53,11 @@ char* mock_getTxBuffer()
         return buff;
 }
 
+size_t mock_getTxBufferLength()
+{
+        return ptr - buff;
+}
+
 void mock_resetTxBuffer()
 {
         ptr = buff;
@@ -60,8 +66,7 @@ void mock_resetTxBuffer()
 
 void mock_appendRxBuffer(const char *src)
 {
-        xQueueHandle q = serial_get_rx_queue(s);
-        for (; *src && xQueueSend(q, src, 0); ++src);
+        serial_rx_put(s, src, strlen(src), 0);
 }
 
 void mock_setRxBuffer(const char *src)
@@ -36,6 +36,9 @@ void mock_setRxBuffer(const char *src);
 /* STIEG: Should be const */
 char* mock_getTxBuffer();
 
+/* For binary data that may hold NULL bytes */
+size_t mock_getTxBufferLength();
+
 void mock_appendRxBuffer(const char *src);
 
 void mock_resetTxBuffer();
@@ -0,0 +1,134 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "capabilities.h"
+#include "mock_serial.h"
+#include "printk.h"
+#include "printk_test.hh"
+
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( PrintkTest );
+
+static enum log_level saved_level;
+
+static std::string drain(const int escape = 0)
+{
+        mock_resetTxBuffer();
+        read_log_to_serial(getMockSerial(), escape);
+        return std::string(mock_getTxBuffer());
+}
+
+void PrintkTest::setUp()
+{
+        setupMockSerial();
+        saved_level = get_log_level();
+        set_log_level(INFO);
+
+        /* Throw away whatever earlier tests left behind */
+        drain();
+}
+
+void PrintkTest::tearDown()
+{
+        set_log_level(saved_level);
+}
+
+void PrintkTest::testText()
+{
+        printk(INFO, "foo ");
+        printk_int(INFO, -42);
+        printk_char(INFO, ' ');
+        printk_float(INFO, 1.5f);
+        printk_crlf(INFO);
+
+        CPPUNIT_ASSERT_EQUAL(std::string("foo -42 1.5\r\n"), drain());
+        CPPUNIT_ASSERT_EQUAL(std::string(""), drain());
+}
+
+void PrintkTest::testLongText()
+{
+        const std::string msg(600, 'x');
+
+        CPPUNIT_ASSERT_EQUAL((int) msg.size(), printk(INFO, msg.c_str()));
+        CPPUNIT_ASSERT_EQUAL(msg, drain());
+}
+
+void PrintkTest::testDeferredMsgs()
+{
+        int value = 12;
+        float fvalue = 3.25f;
+
+        printk_int_msg(INFO, "int: ", value);
+        printk_float_msg(INFO, "float: ", fvalue);
+        printk_bool_msg(INFO, "bool: ", true);
+        printk_str_msg(INFO, "str: ", "bar");
+
+        /* Values are captured at the call, not when drained */
+        value = 0;
+        fvalue = 0;
+
+        CPPUNIT_ASSERT_EQUAL(std::string("int: 12\r\n"
+                                         "float: 3.25\r\n"
+                                         "bool: true\r\n"
+                                         "str: bar\r\n"), drain());
+}
+
+void PrintkTest::testEscaped()
+{
+        printk_int_msg(INFO, "\"a\" ", 1);
+
+        CPPUNIT_ASSERT_EQUAL(std::string("\\\"a\\\" 1\\r\\n"), drain(1));
+}
+
+void PrintkTest::testLevelFilter()
+{
+        CPPUNIT_ASSERT_EQUAL(0, printk_int_msg(DEBUG, "debug: ", 1));
+        CPPUNIT_ASSERT_EQUAL(0, printk(TRACE, "trace"));
+        printk_int_msg(ERR, "err: ", 2);
+
+        CPPUNIT_ASSERT_EQUAL(std::string("err: 2\r\n"), drain());
+}
+
+void PrintkTest::testOverflowDropsWholeRecords()
+{
+        /* Overfill the log many times over */
+        for (int i = 0; i < LOG_BUFFER_SIZE; ++i)
+                printk_int_msg(INFO, "val: ", i);
+
+        const std::string out = drain();
+        CPPUNIT_ASSERT(!out.empty());
+
+        /* Oldest entries go first and what is left is intact */
+        const std::string last = "val: " +
+                std::to_string(LOG_BUFFER_SIZE - 1) + "\r\n";
+        CPPUNIT_ASSERT_EQUAL(last, out.substr(out.size() - last.size()));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, out.find("val: "));
+        CPPUNIT_ASSERT(std::string::npos == out.find("val: 0\r\n"));
+
+        /* Every line that survived is a complete record */
+        size_t start = 0;
+        for (size_t end; (end = out.find("\r\n", start)) !=
+                     std::string::npos; start = end + 2)
+                CPPUNIT_ASSERT(0 == out.compare(start, 5, "val: "));
+        CPPUNIT_ASSERT_EQUAL(out.size(), start);
+}
@@ -0,0 +1,50 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _PRINTK_TEST_H_
+#define _PRINTK_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class PrintkTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( PrintkTest );
+        CPPUNIT_TEST( testText );
+        CPPUNIT_TEST( testLongText );
+        CPPUNIT_TEST( testDeferredMsgs );
+        CPPUNIT_TEST( testEscaped );
+        CPPUNIT_TEST( testLevelFilter );
+        CPPUNIT_TEST( testOverflowDropsWholeRecords );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void tearDown();
+        void testText();
+        void testLongText();
+        void testDeferredMsgs();
+        void testEscaped();
+        void testLevelFilter();
+        void testOverflowDropsWholeRecords();
+};
+
+#endif /* _PRINTK_TEST_H_ */
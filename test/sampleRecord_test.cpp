@@ -26,6 +26,7 @@
 #include "FreeRTOS.h"
 #include "GPIO.h"
 #include "capabilities.h"
+#include "channel_registry.h"
 #include "gps.h"
 #include "imu.h"
 #include "lap_stats.h"
@@ -466,3 +467,57 @@ void SampleRecordTest::test_get_sample_value_by_name()
 		result = get_sample_value_by_name(&s, "FooBar", &value);
 		CPPUNIT_ASSERT_EQUAL(false, result);
 }
+
+void SampleRecordTest::test_channel_registry_find()
+{
+        channel_registry_build(&s);
+
+        /* Every channel must map back to its own index */
+        for (size_t i = 0; i < s.channel_count; ++i) {
+                const char *label = s.channel_samples[i].cfg->label;
+                const int idx = channel_registry_find(&s, label);
+                CPPUNIT_ASSERT(idx >= 0);
+                CPPUNIT_ASSERT_EQUAL(string(label),
+                                     string(s.channel_samples[idx].cfg->label));
+        }
+
+        CPPUNIT_ASSERT_EQUAL(CHANNEL_REGISTRY_INVALID_INDEX,
+                             channel_registry_find(&s, "FooBar"));
+
+        /* Must still match the old behavior through the by-name API */
+        lc->ADCConfigs[7].scalingMode = SCALING_MODE_RAW;
+        ADC_mock_set_value(7, 123);
+        ADC_sample_all();
+        increment_tick();
+        populate_sample_buffer(&s, 0);
+
+        double value;
+        CPPUNIT_ASSERT_EQUAL(true, get_sample_value_by_name(&s, "Battery", &value));
+        CPPUNIT_ASSERT_EQUAL((double)123 * 0.0048828125f, value);
+        CPPUNIT_ASSERT_EQUAL(false, get_sample_value_by_name(&s, "FooBar", &value));
+}
+
+void SampleRecordTest::test_channel_registry_resolve()
+{
+        struct channel_ref ref;
+        channel_ref_invalidate(&ref);
+        channel_registry_build(&s);
+
+        const int idx = channel_registry_resolve(&ref, &s, "Battery");
+        CPPUNIT_ASSERT(idx >= 0);
+        CPPUNIT_ASSERT_EQUAL(string("Battery"),
+                             string(s.channel_samples[idx].cfg->label));
+
+        /* Cached until the registry is rebuilt */
+        CPPUNIT_ASSERT_EQUAL(idx, channel_registry_resolve(&ref, &s, "Speed"));
+
+        channel_registry_build(&s);
+        const int speed_idx = channel_registry_resolve(&ref, &s, "Speed");
+        CPPUNIT_ASSERT(speed_idx >= 0);
+        CPPUNIT_ASSERT(speed_idx != idx);
+
+        /* Invalidation forces a fresh lookup */
+        channel_ref_invalidate(&ref);
+        CPPUNIT_ASSERT_EQUAL(CHANNEL_REGISTRY_INVALID_INDEX,
+                             channel_registry_resolve(&ref, &s, "FooBar"));
+}
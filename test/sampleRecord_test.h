@@ -32,6 +32,8 @@ class SampleRecordTest : public CppUnit::TestFixture
     CPPUNIT_TEST( testIsValidLoggerMessage );
     CPPUNIT_TEST( testLoggerMessageAlwaysHasTime );
     CPPUNIT_TEST( test_get_sample_value_by_name );
+    CPPUNIT_TEST( test_channel_registry_find );
+    CPPUNIT_TEST( test_channel_registry_resolve );
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -43,6 +45,8 @@ public:
     void testIsValidLoggerMessage();
     void testLoggerMessageAlwaysHasTime();
     void test_get_sample_value_by_name();
+    void test_channel_registry_find();
+    void test_channel_registry_resolve();
 
 private:
 
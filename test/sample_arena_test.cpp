@@ -0,0 +1,129 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "loggerConfig.h"
+#include "sampleRecord.h"
+#include "sample_arena.h"
+#include "sample_arena_test.hh"
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleArenaTest );
+
+static size_t channel_count;
+
+void SampleArenaTest::setUp()
+{
+        initialize_logger_config();
+        channel_count = get_enabled_channel_count(getWorkingLoggerConfig());
+        sample_arena_init();
+}
+
+void SampleArenaTest::tearDown()
+{
+        sample_arena_init();
+}
+
+void SampleArenaTest::testLayout()
+{
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, sample_arena_layout(channel_count, 3));
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, sample_arena_depth());
+
+        /* Ring plus the scratch buffer, back to back */
+        CPPUNIT_ASSERT_EQUAL(sizeof(ChannelSample[4 * channel_count]),
+                             sample_arena_size());
+
+        const struct sample *first = sample_arena_get(0);
+        for (size_t i = 0; i < 3; ++i) {
+                const struct sample *s = sample_arena_get(i);
+                CPPUNIT_ASSERT(s);
+                CPPUNIT_ASSERT_EQUAL(channel_count, s->channel_count);
+                CPPUNIT_ASSERT_EQUAL((size_t) 0, s->ticks);
+                CPPUNIT_ASSERT(first->channel_samples + i * channel_count ==
+                               s->channel_samples);
+                CPPUNIT_ASSERT(s->channel_samples[0].cfg);
+        }
+
+        CPPUNIT_ASSERT(!sample_arena_get(3));
+}
+
+void SampleArenaTest::testDepthLimit()
+{
+        CPPUNIT_ASSERT_EQUAL((size_t) SAMPLE_ARENA_MAX_DEPTH,
+                             sample_arena_layout(channel_count,
+                                                 SAMPLE_ARENA_MAX_DEPTH + 5));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, sample_arena_layout(0, 3));
+        CPPUNIT_ASSERT(!sample_arena_get(0));
+}
+
+void SampleArenaTest::testReuse()
+{
+        sample_arena_layout(channel_count, 3);
+        const ChannelSample *arena = sample_arena_get(0)->channel_samples;
+        const size_t size = sample_arena_size();
+
+        /* Same or smaller layouts never touch the heap */
+        sample_arena_layout(channel_count, 3);
+        CPPUNIT_ASSERT(arena == sample_arena_get(0)->channel_samples);
+        sample_arena_layout(channel_count, 2);
+        CPPUNIT_ASSERT(arena == sample_arena_get(0)->channel_samples);
+        CPPUNIT_ASSERT_EQUAL(size, sample_arena_size());
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, sample_arena_depth());
+}
+
+void SampleArenaTest::testGrow()
+{
+        sample_arena_layout(channel_count, 2);
+        const size_t size = sample_arena_size();
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 4, sample_arena_layout(channel_count, 4));
+        CPPUNIT_ASSERT(size < sample_arena_size());
+        CPPUNIT_ASSERT_EQUAL(sizeof(ChannelSample[5 * channel_count]),
+                             sample_arena_size());
+}
+
+void SampleArenaTest::testScratch()
+{
+        /* Nothing to lend until the ring is laid out */
+        CPPUNIT_ASSERT(!sample_arena_acquire_scratch(channel_count));
+
+        sample_arena_layout(channel_count, 3);
+        struct sample *s = sample_arena_acquire_scratch(channel_count);
+        CPPUNIT_ASSERT(s);
+        CPPUNIT_ASSERT_EQUAL(channel_count, s->channel_count);
+
+        /* Must not overlap the ring */
+        const struct sample *last = sample_arena_get(2);
+        CPPUNIT_ASSERT(last->channel_samples + channel_count ==
+                       s->channel_samples);
+
+        sample_arena_release_scratch(s);
+        CPPUNIT_ASSERT(!s->channel_samples);
+}
+
+void SampleArenaTest::testScratchTooSmall()
+{
+        sample_arena_layout(channel_count, 3);
+        CPPUNIT_ASSERT(!sample_arena_acquire_scratch(channel_count + 1));
+
+        struct sample *s = sample_arena_acquire_scratch(channel_count);
+        CPPUNIT_ASSERT(s);
+        sample_arena_release_scratch(s);
+}
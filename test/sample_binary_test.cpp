@@ -0,0 +1,357 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "api.h"
+#include "channel_registry.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "loggerSampleData.h"
+#include "mock_serial.h"
+#include "sample_binary.h"
+#include "sample_binary_test.hh"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleBinaryTest );
+
+using std::string;
+using std::vector;
+
+/* Effective throughput of a Bluetooth link at 115200 baud, 8N1 */
+#define BT_BYTES_PER_SEC	11520
+
+/*
+ * Host side decoder for the binary sample stream.  Mirrors what a client
+ * app has to do; see sample_binary.h for the format.
+ */
+struct decoded_value {
+        enum sample_binary_value_type type;
+        union {
+                int32_t i32;
+                int64_t i64;
+                float f32;
+                double f64;
+        };
+};
+
+struct decoder {
+        vector<uint8_t> types;
+        bool have_layout;
+        uint32_t tick;
+        vector<uint32_t> bitmaps;
+        vector<decoded_value> values;
+        size_t samples;
+        size_t json_msgs;
+};
+
+static uint64_t get_le(const uint8_t *buf, const size_t size)
+{
+        uint64_t val = 0;
+        for (size_t i = size; i; --i)
+                val = (val << 8) | buf[i - 1];
+
+        return val;
+}
+
+static void decode_sample(struct decoder *d, const uint8_t *p,
+                          const size_t len)
+{
+        const uint8_t *end = p + len;
+
+        CPPUNIT_ASSERT(d->have_layout);
+        d->tick = get_le(p, 4);
+        p += 4;
+
+        const size_t bitmap_count = *p++;
+        d->bitmaps.clear();
+        for (size_t i = 0; i < bitmap_count; ++i, p += 4)
+                d->bitmaps.push_back(get_le(p, 4));
+
+        d->values.clear();
+        for (size_t i = 0; i < d->types.size(); ++i) {
+                if (!(d->bitmaps[i / 32] & (1u << (i % 32))))
+                        continue;
+
+                decoded_value v;
+                v.type = (enum sample_binary_value_type) d->types[i];
+                const size_t size = sample_binary_value_size(v.type);
+                const uint64_t raw = get_le(p, size);
+                p += size;
+
+                switch (v.type) {
+                case SAMPLE_BINARY_INT32:
+                        v.i32 = (int32_t) raw;
+                        break;
+                case SAMPLE_BINARY_INT64:
+                        v.i64 = (int64_t) raw;
+                        break;
+                case SAMPLE_BINARY_FLOAT32: {
+                        const uint32_t bits = raw;
+                        memcpy(&v.f32, &bits, sizeof(bits));
+                        break;
+                }
+                default:
+                        memcpy(&v.f64, &raw, sizeof(raw));
+                        break;
+                }
+                d->values.push_back(v);
+        }
+
+        CPPUNIT_ASSERT(p == end);
+        ++d->samples;
+}
+
+static void decode(struct decoder *d, const uint8_t *p, const size_t len)
+{
+        const uint8_t *end = p + len;
+
+        while (p < end) {
+                if ('{' == *p) {
+                        /* JSON message.  Runs to the end of the line */
+                        const uint8_t *eol = (const uint8_t *)
+                                memchr(p, '\n', end - p);
+                        CPPUNIT_ASSERT(eol);
+                        p = eol + 1;
+                        ++d->json_msgs;
+                        continue;
+                }
+
+                CPPUNIT_ASSERT(end - p >= SAMPLE_BINARY_HEADER_LEN);
+                CPPUNIT_ASSERT_EQUAL(SAMPLE_BINARY_SOF, (int) p[0]);
+                const int type = p[1];
+                const size_t payload_len = get_le(p + 2, 2);
+                p += SAMPLE_BINARY_HEADER_LEN;
+                CPPUNIT_ASSERT((size_t) (end - p) >= payload_len);
+
+                switch (type) {
+                case SAMPLE_BINARY_LAYOUT: {
+                        const size_t count = get_le(p, 2);
+                        CPPUNIT_ASSERT_EQUAL(count + 2, payload_len);
+                        d->types.assign(p + 2, p + 2 + count);
+                        d->have_layout = true;
+                        break;
+                }
+                case SAMPLE_BINARY_SAMPLE:
+                        decode_sample(d, p, payload_len);
+                        break;
+                default:
+                        CPPUNIT_FAIL("Unknown frame type");
+                }
+
+                p += payload_len;
+        }
+}
+
+static struct sample sample;
+
+static void send(const unsigned int tick, const int meta)
+{
+        api_send_sample_record(getMockSerial(), &sample, tick, meta, NULL);
+}
+
+static vector<uint8_t> tx_bytes()
+{
+        const uint8_t *buf = (const uint8_t *) mock_getTxBuffer();
+        return vector<uint8_t>(buf, buf + mock_getTxBufferLength());
+}
+
+static int set_format(const char *json)
+{
+        string msg(json);
+        mock_resetTxBuffer();
+        return process_api(getMockSerial(), (char *) msg.c_str(), msg.size());
+}
+
+/* Give every channel a value so nothing is left out of the record */
+static void fill_sample(struct sample *s)
+{
+        for (size_t i = 0; i < s->channel_count; ++i) {
+                ChannelSample *cs = s->channel_samples + i;
+
+                cs->populated = true;
+                switch (sample_binary_value_type(cs)) {
+                case SAMPLE_BINARY_INT32:
+                        cs->valueInt = -1000 * (int) i;
+                        break;
+                case SAMPLE_BINARY_INT64:
+                        cs->valueLongLong = 1480000000000LL + i;
+                        break;
+                case SAMPLE_BINARY_FLOAT32:
+                        cs->valueFloat = 123.456f * i;
+                        break;
+                default:
+                        cs->valueDouble = 45.123456789 + i;
+                        break;
+                }
+        }
+}
+
+void SampleBinaryTest::setUp()
+{
+        setupMockSerial();
+        sample_binary_reset_client(getMockSerial());
+
+        LoggerConfig *config = getWorkingLoggerConfig();
+        memset(&sample, 0, sizeof(sample));
+        init_sample_buffer(&sample, get_enabled_channel_count(config));
+        populate_sample_buffer(&sample, 10);
+        fill_sample(&sample);
+        channel_registry_build(&sample);
+        mock_resetTxBuffer();
+}
+
+void SampleBinaryTest::tearDown()
+{
+        sample_binary_reset_client(getMockSerial());
+        free_sample_buffer(&sample);
+
+        /* Don't let later tests match frames of this sample */
+        channel_registry_build(NULL);
+}
+
+void SampleBinaryTest::testNegotiate()
+{
+        CPPUNIT_ASSERT(!sample_binary_client_enabled(getMockSerial()));
+
+        set_format("{\"setTelemetry\":{\"fmt\":1}}");
+        CPPUNIT_ASSERT(strstr(mock_getTxBuffer(), "\"rc\":1"));
+        CPPUNIT_ASSERT(sample_binary_client_enabled(getMockSerial()));
+
+        set_format("{\"setTelemetry\":{\"fmt\":0}}");
+        CPPUNIT_ASSERT(strstr(mock_getTxBuffer(), "\"rc\":1"));
+        CPPUNIT_ASSERT(!sample_binary_client_enabled(getMockSerial()));
+
+        set_format("{\"setTelemetry\":{\"fmt\":7}}");
+        CPPUNIT_ASSERT(strstr(mock_getTxBuffer(), "\"rc\":-1"));
+        CPPUNIT_ASSERT(!sample_binary_client_enabled(getMockSerial()));
+}
+
+void SampleBinaryTest::testJsonByDefault()
+{
+        send(1, 0);
+
+        const string out(mock_getTxBuffer());
+        CPPUNIT_ASSERT_EQUAL(string("{\"s\":{\"t\":1,\"d\":["),
+                             out.substr(0, 17));
+        CPPUNIT_ASSERT_EQUAL(string("]}}\r\n"), out.substr(out.size() - 5));
+}
+
+void SampleBinaryTest::testMetaStaysJson()
+{
+        sample_binary_set_client_format(getMockSerial(),
+                                        TELEMETRY_FORMAT_BINARY);
+        send(0, 1);
+
+        const string out(mock_getTxBuffer());
+        CPPUNIT_ASSERT(out.find("\"meta\":[") != string::npos);
+        CPPUNIT_ASSERT_EQUAL(out.size(), mock_getTxBufferLength());
+}
+
+void SampleBinaryTest::testRoundTrip()
+{
+        sample_binary_set_client_format(getMockSerial(),
+                                        TELEMETRY_FORMAT_BINARY);
+        send(0, 1);
+        send(1, 0);
+        send(2, 0);
+
+        struct decoder d = {};
+        const vector<uint8_t> bytes = tx_bytes();
+        decode(&d, bytes.data(), bytes.size());
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, d.json_msgs);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, d.samples);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, d.tick);
+        CPPUNIT_ASSERT_EQUAL(sample.channel_count, d.types.size());
+
+        size_t value = 0;
+        for (size_t i = 0; i < sample.channel_count; ++i) {
+                const ChannelSample *cs = sample.channel_samples + i;
+                const bool populated = d.bitmaps[i / 32] & (1u << (i % 32));
+                CPPUNIT_ASSERT_EQUAL(cs->populated, populated);
+                if (!populated)
+                        continue;
+
+                const decoded_value &v = d.values[value++];
+                CPPUNIT_ASSERT_EQUAL(sample_binary_value_type(cs), v.type);
+                switch (v.type) {
+                case SAMPLE_BINARY_INT32:
+                        CPPUNIT_ASSERT_EQUAL(cs->valueInt, (int) v.i32);
+                        break;
+                case SAMPLE_BINARY_INT64:
+                        CPPUNIT_ASSERT_EQUAL(cs->valueLongLong,
+                                             (long long) v.i64);
+                        break;
+                case SAMPLE_BINARY_FLOAT32:
+                        CPPUNIT_ASSERT_EQUAL(cs->valueFloat, v.f32);
+                        break;
+                default:
+                        CPPUNIT_ASSERT_EQUAL(cs->valueDouble, v.f64);
+                        break;
+                }
+        }
+        CPPUNIT_ASSERT_EQUAL(d.values.size(), value);
+}
+
+void SampleBinaryTest::testLayoutOnlyOnChange()
+{
+        sample_binary_set_client_format(getMockSerial(),
+                                        TELEMETRY_FORMAT_BINARY);
+        send(1, 0);
+        const size_t first = mock_getTxBufferLength();
+
+        mock_resetTxBuffer();
+        send(2, 0);
+        const size_t second = mock_getTxBufferLength();
+        CPPUNIT_ASSERT_EQUAL(first - SAMPLE_BINARY_HEADER_LEN - 2 -
+                             sample.channel_count, second);
+
+        /* New channel layout means a new layout frame */
+        channel_registry_build(&sample);
+        mock_resetTxBuffer();
+        send(3, 0);
+        CPPUNIT_ASSERT_EQUAL(first, mock_getTxBufferLength());
+}
+
+void SampleBinaryTest::testSizeComparison()
+{
+        send(1, 0);
+        const size_t json_len = mock_getTxBufferLength();
+
+        sample_binary_set_client_format(getMockSerial(),
+                                        TELEMETRY_FORMAT_BINARY);
+        send(1, 0);
+        mock_resetTxBuffer();
+        send(2, 0);
+        const size_t bin_len = mock_getTxBufferLength();
+
+        printf("\nsample record: %zu channels, json %zu bytes "
+               "(%zu Hz @ 115200), binary %zu bytes (%zu Hz @ 115200)\n",
+               sample.channel_count, json_len, BT_BYTES_PER_SEC / json_len,
+               bin_len, BT_BYTES_PER_SEC / bin_len);
+
+        CPPUNIT_ASSERT(bin_len < json_len);
+}
@@ -0,0 +1,283 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "api.h"
+#include "channel_registry.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "loggerSampleData.h"
+#include "mock_serial.h"
+#include "sample_binary.h"
+#include "stream_profile.h"
+#include "stream_profile_test.hh"
+
+#include <string.h>
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( StreamProfileTest );
+
+using std::string;
+
+static struct sample sample;
+
+static int process(const string &json)
+{
+        string msg(json);
+        mock_resetTxBuffer();
+        return process_api(getMockSerial(), (char *) msg.c_str(), msg.size());
+}
+
+static const char* label_of(const size_t idx)
+{
+        return sample.channel_samples[idx].cfg->label;
+}
+
+static size_t count_of(const string &haystack, const string &needle)
+{
+        size_t count = 0;
+        for (size_t pos = haystack.find(needle); pos != string::npos;
+             pos = haystack.find(needle, pos + needle.size()))
+                ++count;
+
+        return count;
+}
+
+/* Number of entries in the "d" array of a sample record */
+static size_t data_entries(const string &record)
+{
+        const size_t start = record.find("\"d\":[") + 5;
+        const size_t end = record.find("]", start);
+        return count_of(record.substr(start, end - start), ",") + 1;
+}
+
+static void set_profile(struct stream_profile_config *cfg,
+                        const size_t *idxs, const size_t count)
+{
+        stream_profile_reset_config(cfg);
+        for (size_t i = 0; i < count; ++i)
+                strcpy(cfg->channels[i], label_of(idxs[i]));
+        cfg->channel_count = count;
+}
+
+void StreamProfileTest::setUp()
+{
+        setupMockSerial();
+        sample_binary_reset_client(getMockSerial());
+
+        LoggerConfig *config = getWorkingLoggerConfig();
+        memset(&sample, 0, sizeof(sample));
+        init_sample_buffer(&sample, get_enabled_channel_count(config));
+        populate_sample_buffer(&sample, 10);
+        for (size_t i = 0; i < sample.channel_count; ++i)
+                sample.channel_samples[i].populated = true;
+        channel_registry_build(&sample);
+        mock_resetTxBuffer();
+}
+
+void StreamProfileTest::tearDown()
+{
+        ConnectivityConfig *cc = &getWorkingLoggerConfig()->ConnectivityConfigs;
+        stream_profile_reset_config(&cc->bluetoothConfig.profile);
+        stream_profile_reset_config(&cc->cellularConfig.profile);
+        cc->bluetoothConfig.btEnabled = DEFAULT_BT_ENABLED;
+        cc->cellularConfig.cellEnabled = DEFAULT_CELL_ENABLED;
+
+        sample_binary_reset_client(getMockSerial());
+        free_sample_buffer(&sample);
+
+        /* Don't let later tests match frames of this sample */
+        channel_registry_build(NULL);
+}
+
+void StreamProfileTest::testSetGetConfig()
+{
+        ConnectivityConfig *cc = &getWorkingLoggerConfig()->ConnectivityConfigs;
+
+        /* Bluetooth leaves out "sr" and must not pick up the cell one */
+        CPPUNIT_ASSERT_EQUAL((int) API_SUCCESS, process(
+                "{\"setConnCfg\":{"
+                "\"btCfg\":{\"prof\":{\"chans\":[\"RPM\",\"Speed\"]}},"
+                "\"cellCfg\":{\"prof\":{\"sr\":10,\"chans\":[\"RPM\"],"
+                "\"laps\":2}}}}"));
+
+        const struct stream_profile_config *bt = &cc->bluetoothConfig.profile;
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_DISABLED, (int) bt->sample_rate);
+        CPPUNIT_ASSERT_EQUAL(2, (int) bt->channel_count);
+        CPPUNIT_ASSERT_EQUAL(string("RPM"), string(bt->channels[0]));
+        CPPUNIT_ASSERT_EQUAL(string("Speed"), string(bt->channels[1]));
+
+        const struct stream_profile_config *cell = &cc->cellularConfig.profile;
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_10Hz, (int) cell->sample_rate);
+        CPPUNIT_ASSERT_EQUAL(1, (int) cell->channel_count);
+        CPPUNIT_ASSERT_EQUAL(string("RPM"), string(cell->channels[0]));
+        CPPUNIT_ASSERT_EQUAL((int) STREAM_LAP_SUMMARY_ONLY,
+                             (int) cell->lap_summary);
+
+        process("{\"getConnCfg\":null}");
+        const string out(mock_getTxBuffer());
+        CPPUNIT_ASSERT(out.find("\"prof\":{\"sr\":0,"
+                                "\"chans\":[\"RPM\",\"Speed\"],"
+                                "\"batch\":0,\"batchMs\":0,\"laps\":0}") !=
+                       string::npos);
+        CPPUNIT_ASSERT(out.find("\"prof\":{\"sr\":10,\"chans\":[\"RPM\"],"
+                                "\"batch\":0,\"batchMs\":0,\"laps\":2}") !=
+                       string::npos);
+
+        /* An empty list goes back to every channel */
+        process("{\"setConnCfg\":{\"btCfg\":{\"prof\":{\"chans\":[]}}}}");
+        CPPUNIT_ASSERT_EQUAL(0, (int) bt->channel_count);
+
+        CPPUNIT_ASSERT_EQUAL((int) API_ERROR_PARAMETER, process(
+                "{\"setConnCfg\":{\"cellCfg\":{\"prof\":{\"laps\":3}}}}"));
+}
+
+void StreamProfileTest::testTooManyChannels()
+{
+        string json("{\"setConnCfg\":{\"cellCfg\":{\"prof\":{\"chans\":[");
+        for (size_t i = 0; i <= STREAM_PROFILE_MAX_CHANNELS; ++i)
+                json += i ? ",\"c\"" : "\"c\"";
+        json += "]}}}}";
+
+        CPPUNIT_ASSERT_EQUAL((int) API_ERROR_PARAMETER, process(json));
+        CPPUNIT_ASSERT_EQUAL(0, (int) getWorkingLoggerConfig()->
+                             ConnectivityConfigs.cellularConfig.profile.channel_count);
+}
+
+void StreamProfileTest::testSampleRate()
+{
+        struct stream_profile_config cfg;
+        stream_profile_reset_config(&cfg);
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_50Hz,
+                             stream_profile_sample_rate(&cfg, SAMPLE_50Hz));
+
+        cfg.sample_rate = SAMPLE_10Hz;
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_10Hz,
+                             stream_profile_sample_rate(&cfg, SAMPLE_50Hz));
+
+        /* Never faster than the link */
+        cfg.sample_rate = SAMPLE_100Hz;
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_50Hz,
+                             stream_profile_sample_rate(&cfg, SAMPLE_50Hz));
+
+        /* The logger feeds the fastest enabled destination */
+        ConnectivityConfig *cc = &getWorkingLoggerConfig()->ConnectivityConfigs;
+        cc->bluetoothConfig.btEnabled = 1;
+        cc->cellularConfig.cellEnabled = 1;
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_50Hz, getConnectivitySampleRateLimit());
+
+        cc->bluetoothConfig.profile.sample_rate = SAMPLE_5Hz;
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_10Hz, getConnectivitySampleRateLimit());
+
+        cc->bluetoothConfig.btEnabled = 0;
+        cc->cellularConfig.profile.sample_rate = SAMPLE_1Hz;
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_1Hz, getConnectivitySampleRateLimit());
+}
+
+void StreamProfileTest::testMask()
+{
+        struct stream_profile_config cfg;
+        struct stream_profile sp;
+
+        /* No channels listed means all of them */
+        stream_profile_reset_config(&cfg);
+        stream_profile_init(&sp, &cfg);
+        CPPUNIT_ASSERT(NULL == stream_profile_mask(&sp, &sample));
+
+        const size_t idxs[] = {3, 1};
+        set_profile(&cfg, idxs, 2);
+        strcpy(cfg.channels[cfg.channel_count++], "NotAChannel");
+        stream_profile_init(&sp, &cfg);
+
+        const struct channel_mask *mask = stream_profile_mask(&sp, &sample);
+        CPPUNIT_ASSERT(mask);
+        for (size_t i = 0; i < sample.channel_count; ++i)
+                CPPUNIT_ASSERT_EQUAL(1 == i || 3 == i,
+                                     channel_mask_has(mask, i));
+
+        /* Only rebuilt when the channel layout changes */
+        strcpy(cfg.channels[0], label_of(2));
+        CPPUNIT_ASSERT(channel_mask_has(stream_profile_mask(&sp, &sample), 3));
+        channel_registry_build(&sample);
+        mask = stream_profile_mask(&sp, &sample);
+        CPPUNIT_ASSERT(channel_mask_has(mask, 2));
+        CPPUNIT_ASSERT(!channel_mask_has(mask, 3));
+}
+
+void StreamProfileTest::testSubsetRecord()
+{
+        struct stream_profile_config cfg;
+        struct stream_profile sp;
+        const size_t idxs[] = {0, 2, 4};
+        set_profile(&cfg, idxs, 3);
+        stream_profile_init(&sp, &cfg);
+        const struct channel_mask *mask = stream_profile_mask(&sp, &sample);
+
+        api_send_sample_record(getMockSerial(), &sample, 0, 1, NULL);
+        const string full(mock_getTxBuffer());
+        mock_resetTxBuffer();
+        api_send_sample_record(getMockSerial(), &sample, 0, 1, mask);
+        const string subset(mock_getTxBuffer());
+
+        /* Metadata only describes the subset, in sample order */
+        CPPUNIT_ASSERT_EQUAL(sample.channel_count, count_of(full, "\"nm\":"));
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, count_of(subset, "\"nm\":"));
+        const size_t first = subset.find(string("\"nm\":\"") + label_of(0));
+        const size_t second = subset.find(string("\"nm\":\"") + label_of(2));
+        const size_t third = subset.find(string("\"nm\":\"") + label_of(4));
+        CPPUNIT_ASSERT(first < second && second < third &&
+                       third != string::npos);
+
+        /* And the subset gets its own meta hash */
+        const size_t hash_pos = full.find("\"mh\":");
+        CPPUNIT_ASSERT(hash_pos != string::npos);
+        CPPUNIT_ASSERT(subset.find(full.substr(hash_pos, 12)) == string::npos);
+
+        /* Three values and a bitmap with the low three bits set */
+        CPPUNIT_ASSERT_EQUAL((size_t) 4, data_entries(subset));
+        CPPUNIT_ASSERT(subset.find(",7]") != string::npos);
+
+        /* Records without metadata share the subset rendering */
+        mock_resetTxBuffer();
+        api_send_sample_record(getMockSerial(), &sample, 1, 0, mask);
+        CPPUNIT_ASSERT_EQUAL((size_t) 4, data_entries(mock_getTxBuffer()));
+}
+
+void StreamProfileTest::testSubsetBinaryLayout()
+{
+        struct stream_profile_config cfg;
+        struct stream_profile sp;
+        const size_t idxs[] = {1, 5};
+        set_profile(&cfg, idxs, 2);
+        stream_profile_init(&sp, &cfg);
+
+        sample_binary_set_client_format(getMockSerial(),
+                                        TELEMETRY_FORMAT_BINARY);
+        api_send_sample_record(getMockSerial(), &sample, 1, 0,
+                               stream_profile_mask(&sp, &sample));
+
+        /* Layout frame comes first and lists only the two channels */
+        const uint8_t *out = (const uint8_t *) mock_getTxBuffer();
+        CPPUNIT_ASSERT_EQUAL(SAMPLE_BINARY_SOF, (int) out[0]);
+        CPPUNIT_ASSERT_EQUAL((int) SAMPLE_BINARY_LAYOUT, (int) out[1]);
+        CPPUNIT_ASSERT_EQUAL(4, out[2] | out[3] << 8);
+        CPPUNIT_ASSERT_EQUAL(2, out[4] | out[5] << 8);
+}
@@ -0,0 +1,174 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "api.h"
+#include "cpu_mock.h"
+#include "mock_serial.h"
+#include "task_stats.h"
+#include "task_stats_test.hh"
+
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TaskStatsTest );
+
+using std::string;
+
+static uint32_t now_us;
+
+/* Runs an iteration of the task that takes run_us */
+static void run(const enum task_stats_id id, const uint32_t run_us)
+{
+        task_stats_begin(id);
+        now_us += run_us;
+        cpu_mock_set_cycle_count(now_us);
+        task_stats_end(id);
+}
+
+void TaskStatsTest::setUp()
+{
+        now_us = 1000;
+        cpu_mock_set_cycle_count(now_us);
+        for (size_t i = 0; i < TASK_STATS_COUNT; ++i)
+                task_stats_set_budget((enum task_stats_id) i, 0);
+        task_stats_reset();
+}
+
+void TaskStatsTest::tearDown()
+{
+        cpu_mock_set_cycle_count(0);
+        task_stats_reset();
+}
+
+void TaskStatsTest::testRunTime()
+{
+        run(TASK_STATS_LOGGER, 50);
+        run(TASK_STATS_LOGGER, 300);
+        run(TASK_STATS_LOGGER, 20000);
+
+        const struct task_stats *ts = task_stats_get(TASK_STATS_LOGGER);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 3, ts->runs);
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 20350, ts->busy_us);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 20000, ts->run_max_us);
+
+        /* <100us, <500us and the last one for everything longer */
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, ts->run.counts[0]);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, ts->run.counts[2]);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1,
+                             ts->run.counts[TASK_STATS_BUCKETS - 1]);
+
+        /* Only the task that ran */
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0,
+                             task_stats_get(TASK_STATS_CAN)->runs);
+}
+
+void TaskStatsTest::testMissedBudget()
+{
+        run(TASK_STATS_FILE_WRITER, 5000);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0,
+                             task_stats_get(TASK_STATS_FILE_WRITER)->missed);
+
+        task_stats_set_budget(TASK_STATS_FILE_WRITER, 1000);
+        run(TASK_STATS_FILE_WRITER, 1000);
+        run(TASK_STATS_FILE_WRITER, 1001);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1,
+                             task_stats_get(TASK_STATS_FILE_WRITER)->missed);
+}
+
+void TaskStatsTest::testLateness()
+{
+        const struct task_stats *ts = task_stats_get(TASK_STATS_LOGGER);
+
+        /* Due, then a second tick before it got to run */
+        task_stats_due(TASK_STATS_LOGGER);
+        now_us += 700;
+        cpu_mock_set_cycle_count(now_us);
+        task_stats_due(TASK_STATS_LOGGER);
+        run(TASK_STATS_LOGGER, 10);
+
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 700, ts->late_max_us);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, ts->late.counts[3]);
+
+        /* Not marked due, so no lateness */
+        run(TASK_STATS_LOGGER, 10);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, ts->late.counts[3]);
+
+        task_stats_late(TASK_STATS_LUA, 3000);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 3000,
+                             task_stats_get(TASK_STATS_LUA)->late_max_us);
+}
+
+void TaskStatsTest::testCycleCounterWraps()
+{
+        now_us = UINT32_MAX - 10;
+        cpu_mock_set_cycle_count(now_us);
+        run(TASK_STATS_CAN, 30);
+
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 30,
+                             task_stats_get(TASK_STATS_CAN)->run_max_us);
+}
+
+void TaskStatsTest::testQueue()
+{
+        task_stats_queue(TASK_STATS_FILE_WRITER, 3);
+        task_stats_queue(TASK_STATS_FILE_WRITER, 1);
+        CPPUNIT_ASSERT_EQUAL((size_t) 3,
+                             task_stats_get(TASK_STATS_FILE_WRITER)->queue_max);
+}
+
+void TaskStatsTest::testReset()
+{
+        task_stats_set_budget(TASK_STATS_LUA, 100);
+        run(TASK_STATS_LUA, 200);
+        task_stats_reset();
+
+        /* The budget is config, not a stat */
+        const struct task_stats *ts = task_stats_get(TASK_STATS_LUA);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, ts->runs);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, ts->missed);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, ts->run.counts[2]);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 100, ts->budget_us);
+}
+
+void TaskStatsTest::testApi()
+{
+        task_stats_set_budget(TASK_STATS_LOGGER, 1000);
+        run(TASK_STATS_LOGGER, 2500);
+
+        string msg("{\"getTaskStats\":null}");
+        mock_resetTxBuffer();
+        process_api(getMockSerial(), (char *) msg.c_str(), msg.size());
+        const string out(mock_getTxBuffer());
+
+        CPPUNIT_ASSERT(out.find("\"buckets\":[100,250,500,1000,2500,5000,"
+                                "10000]") != string::npos);
+        CPPUNIT_ASSERT(out.find("\"logger\":{\"runs\":1,\"miss\":1,"
+                                "\"budget\":1000,\"busy\":2,\"max\":2500,")
+                       != string::npos);
+        CPPUNIT_ASSERT(out.find("\"run\":[0,0,0,0,0,1,0,0]") != string::npos);
+        CPPUNIT_ASSERT(out.find("\"lua\":{") != string::npos);
+
+        msg = "{\"rstTaskStats\":null}";
+        mock_resetTxBuffer();
+        process_api(getMockSerial(), (char *) msg.c_str(), msg.size());
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0,
+                             task_stats_get(TASK_STATS_LOGGER)->runs);
+}
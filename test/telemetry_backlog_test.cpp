@@ -0,0 +1,243 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "channel_registry.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "loggerSampleData.h"
+#include "loggerSampleData_testing.h"
+#include "mem_mang.h"
+#include "mock_serial.h"
+#include "sample_binary.h"
+#include "telemetry_backlog.h"
+#include "telemetry_backlog_test.hh"
+
+#include <string.h>
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TelemetryBacklogTest );
+
+using std::string;
+
+#define BACKLOG_SIZE	4096
+
+static struct telemetry_backlog bl;
+static struct stream_profile_config cfg;
+static struct sample sample;
+
+/* Returns the value of the numeric field name in a record */
+static long field_of(const string &record, const string &name)
+{
+        const string key = "\"" + name + "\":";
+        const size_t pos = record.find(key);
+        if (string::npos == pos)
+                return -1;
+
+        return strtol(record.c_str() + pos + key.size(), NULL, 10);
+}
+
+static string data_of(const string &record)
+{
+        const size_t start = record.find("\"d\":[");
+        const size_t end = record.find("]", start);
+        return record.substr(start, end - start + 1);
+}
+
+static string send_backfill()
+{
+        mock_resetTxBuffer();
+        telemetry_backlog_send(&bl, getMockSerial(), &sample, NULL, 1);
+        return string(mock_getTxBuffer());
+}
+
+void TelemetryBacklogTest::setUp()
+{
+        setupMockSerial();
+        sample_binary_reset_client(getMockSerial());
+
+        memset(&sample, 0, sizeof(sample));
+        init_sample_buffer(&sample,
+                           get_enabled_channel_count(getWorkingLoggerConfig()));
+        fill_sample(&sample, SAMPLE_10Hz);
+        channel_registry_build(&sample);
+
+        stream_profile_reset_config(&cfg);
+        telemetry_backlog_init(&bl, BACKLOG_SIZE, &cfg, SAMPLE_10Hz);
+        mock_resetTxBuffer();
+}
+
+void TelemetryBacklogTest::tearDown()
+{
+        ring_buffer_destroy(bl.rb);
+        portFree(bl.scratch);
+        memset(&bl, 0, sizeof(bl));
+
+        free_sample_buffer(&sample);
+
+        /* Don't let later tests match frames of this sample */
+        channel_registry_build(NULL);
+}
+
+void TelemetryBacklogTest::testDisabled()
+{
+        struct telemetry_backlog off;
+        memset(&off, 0, sizeof(off));
+
+        CPPUNIT_ASSERT(!telemetry_backlog_enabled(&off));
+        CPPUNIT_ASSERT(!telemetry_backlog_enabled(NULL));
+
+        telemetry_backlog_set_capturing(&off, true);
+        CPPUNIT_ASSERT(!telemetry_backlog_capturing(&off));
+        CPPUNIT_ASSERT(!telemetry_backlog_capture(&off, &sample));
+        CPPUNIT_ASSERT(!telemetry_backlog_should_drain(NULL, 0, 100));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, telemetry_backlog_pending(NULL));
+}
+
+void TelemetryBacklogTest::testCaptureWhileDown()
+{
+        /* Nothing is kept while the link is up */
+        CPPUNIT_ASSERT(!telemetry_backlog_capture(&bl, &sample));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, telemetry_backlog_pending(&bl));
+
+        telemetry_backlog_set_capturing(&bl, true);
+        CPPUNIT_ASSERT(telemetry_backlog_capture(&bl, &sample));
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, telemetry_backlog_pending(&bl));
+
+        /* Not drained until the link is back */
+        CPPUNIT_ASSERT(!telemetry_backlog_should_drain(&bl, 0, 100));
+        telemetry_backlog_set_capturing(&bl, false);
+        CPPUNIT_ASSERT(telemetry_backlog_should_drain(&bl, 0, 100));
+
+        const string out = send_backfill();
+        CPPUNIT_ASSERT(out.find("\"bf\":1") != string::npos);
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, telemetry_backlog_pending(&bl));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, bl.backfilled);
+
+        /* Nothing left to send */
+        CPPUNIT_ASSERT(!telemetry_backlog_send(&bl, getMockSerial(), &sample,
+                                               NULL, 2));
+}
+
+void TelemetryBacklogTest::testDecimation()
+{
+        telemetry_backlog_set_capturing(&bl, true);
+
+        /* One second of samples at the logger rate */
+        for (size_t ticks = 1; ticks <= TICK_RATE_HZ; ++ticks) {
+                sample.ticks = ticks;
+                telemetry_backlog_capture(&bl, &sample);
+        }
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 10, telemetry_backlog_pending(&bl));
+}
+
+void TelemetryBacklogTest::testDropOldest()
+{
+        telemetry_backlog_set_capturing(&bl, true);
+
+        size_t added = 0;
+        for (size_t ticks = SAMPLE_10Hz; added < 1000; ticks += SAMPLE_10Hz, ++added) {
+                sample.ticks = ticks;
+                CPPUNIT_ASSERT(telemetry_backlog_capture(&bl, &sample));
+        }
+
+        /* Bounded, and it is the oldest ones that went */
+        const size_t pending = telemetry_backlog_pending(&bl);
+        CPPUNIT_ASSERT(pending < added);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) (added - pending), bl.dropped);
+        CPPUNIT_ASSERT(ring_buffer_bytes_used(bl.rb) <= BACKLOG_SIZE);
+
+        telemetry_backlog_set_capturing(&bl, false);
+        CPPUNIT_ASSERT_EQUAL((long) (added - pending),
+                             field_of(send_backfill(), "q"));
+}
+
+void TelemetryBacklogTest::testSequence()
+{
+        /* A live sample, then the link goes down for three */
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, telemetry_backlog_next_seq(&bl));
+
+        telemetry_backlog_set_capturing(&bl, true);
+        for (size_t i = 1; i <= 3; ++i) {
+                sample.ticks = i * SAMPLE_10Hz;
+                telemetry_backlog_capture(&bl, &sample);
+        }
+        telemetry_backlog_set_capturing(&bl, false);
+
+        /* Live samples carry on after the kept ones */
+        mock_resetTxBuffer();
+        api_send_sequenced_sample_record(getMockSerial(), &sample, 5,
+                                         telemetry_backlog_next_seq(&bl),
+                                         0, NULL);
+        CPPUNIT_ASSERT_EQUAL(4L, field_of(mock_getTxBuffer(), "q"));
+
+        /* And the backfill fills the gap in order */
+        for (long seq = 1; seq <= 3; ++seq)
+                CPPUNIT_ASSERT_EQUAL(seq, field_of(send_backfill(), "q"));
+}
+
+void TelemetryBacklogTest::testBackfillMatchesLive()
+{
+        fill_sample(&sample, SAMPLE_10Hz);
+        mock_resetTxBuffer();
+        api_send_sample_record(getMockSerial(), &sample, 1, 0, NULL);
+        const string live(mock_getTxBuffer());
+
+        telemetry_backlog_set_capturing(&bl, true);
+        telemetry_backlog_capture(&bl, &sample);
+        telemetry_backlog_set_capturing(&bl, false);
+
+        /* The values change, but the backfill has the kept ones */
+        fill_sample(&sample, 2 * SAMPLE_10Hz);
+        sample.channel_samples[0].valueInt += 1234;
+        const string backfill = send_backfill();
+
+        CPPUNIT_ASSERT_EQUAL(data_of(live), data_of(backfill));
+}
+
+void TelemetryBacklogTest::testLayoutChange()
+{
+        telemetry_backlog_set_capturing(&bl, true);
+        telemetry_backlog_capture(&bl, &sample);
+        telemetry_backlog_set_capturing(&bl, false);
+
+        /* Records of the old layout can't be decoded any more */
+        channel_registry_build(&sample);
+        CPPUNIT_ASSERT(!telemetry_backlog_send(&bl, getMockSerial(), &sample,
+                                               NULL, 1));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, telemetry_backlog_pending(&bl));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, bl.dropped);
+}
+
+void TelemetryBacklogTest::testShouldDrain()
+{
+        telemetry_backlog_set_capturing(&bl, true);
+        telemetry_backlog_capture(&bl, &sample);
+        telemetry_backlog_set_capturing(&bl, false);
+
+        /* Only while the live stream leaves the link mostly idle */
+        CPPUNIT_ASSERT(telemetry_backlog_should_drain(&bl, 24, 100));
+        CPPUNIT_ASSERT(!telemetry_backlog_should_drain(&bl, 25, 100));
+
+        /* Links that can't tell us just get it */
+        CPPUNIT_ASSERT(telemetry_backlog_should_drain(&bl, 0, 0));
+}
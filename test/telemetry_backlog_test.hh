@@ -0,0 +1,54 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _TELEMETRY_BACKLOG_TEST_H_
+#define _TELEMETRY_BACKLOG_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TelemetryBacklogTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( TelemetryBacklogTest );
+        CPPUNIT_TEST( testDisabled );
+        CPPUNIT_TEST( testCaptureWhileDown );
+        CPPUNIT_TEST( testDecimation );
+        CPPUNIT_TEST( testDropOldest );
+        CPPUNIT_TEST( testSequence );
+        CPPUNIT_TEST( testBackfillMatchesLive );
+        CPPUNIT_TEST( testLayoutChange );
+        CPPUNIT_TEST( testShouldDrain );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void tearDown();
+        void testDisabled();
+        void testCaptureWhileDown();
+        void testDecimation();
+        void testDropOldest();
+        void testSequence();
+        void testBackfillMatchesLive();
+        void testLayoutChange();
+        void testShouldDrain();
+};
+
+#endif /* _TELEMETRY_BACKLOG_TEST_H_ */
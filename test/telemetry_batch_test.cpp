@@ -0,0 +1,311 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "api.h"
+#include "channel_registry.h"
+#include "loggerApi.h"
+#include "loggerConfig.h"
+#include "loggerSampleData.h"
+#include "loggerSampleData_testing.h"
+#include "mem_mang.h"
+#include "mock_serial.h"
+#include "sample_binary.h"
+#include "telemetry_batch.h"
+#include "telemetry_batch_test.hh"
+
+#include <string.h>
+#include <string>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TelemetryBatchTest );
+
+using std::string;
+
+static struct telemetry_batch tb;
+static struct stream_profile_config cfg;
+static struct sample sample;
+
+static void init_batch(const unsigned char samples,
+                       const unsigned short ms)
+{
+        portFree(tb.buff);
+        portFree(tb.prev);
+
+        stream_profile_reset_config(&cfg);
+        cfg.batch_samples = samples;
+        cfg.batch_ms = ms;
+        telemetry_batch_init(&tb, &cfg);
+}
+
+static void add(const unsigned int tick, const tiny_millis_t now,
+                const bool send_meta = false)
+{
+        /* Frames are rendered once per tick of the sample */
+        sample.ticks = tick + 1;
+
+        const uint32_t seq = tick + 100;
+        telemetry_batch_add(&tb, getMockSerial(), &sample, NULL, tick, &seq,
+                            send_meta, now);
+}
+
+static string tx()
+{
+        return string(mock_getTxBuffer());
+}
+
+static size_t count_of(const string &haystack, const string &needle)
+{
+        size_t count = 0;
+        for (size_t pos = haystack.find(needle); pos != string::npos;
+             pos = haystack.find(needle, pos + needle.size()))
+                ++count;
+
+        return count;
+}
+
+/* The inner "d" arrays of a batch record */
+static size_t batch_samples(const string &record)
+{
+        const size_t start = record.find("\"d\":[");
+        return string::npos == start ? 0 :
+                count_of(record.substr(start + 5), "[");
+}
+
+/* The n-th inner "d" array of a batch record */
+static string batch_sample(const string &record, const size_t n)
+{
+        size_t start = record.find("\"d\":[") + 5;
+        for (size_t i = 0; i < n; ++i)
+                start = record.find("[", start + 1);
+
+        return record.substr(start + 1, record.find("]", start) - start - 1);
+}
+
+static string record_data(const string &record)
+{
+        const size_t start = record.find("\"d\":[") + 5;
+        return record.substr(start, record.find("]", start) - start);
+}
+
+void TelemetryBatchTest::setUp()
+{
+        setupMockSerial();
+        sample_binary_reset_client(getMockSerial());
+
+        memset(&sample, 0, sizeof(sample));
+        init_sample_buffer(&sample,
+                           get_enabled_channel_count(getWorkingLoggerConfig()));
+        fill_sample(&sample, 1);
+        channel_registry_build(&sample);
+
+        memset(&tb, 0, sizeof(tb));
+        mock_resetTxBuffer();
+}
+
+void TelemetryBatchTest::tearDown()
+{
+        portFree(tb.buff);
+        portFree(tb.prev);
+        memset(&tb, 0, sizeof(tb));
+
+        ConnectivityConfig *cc = &getWorkingLoggerConfig()->ConnectivityConfigs;
+        stream_profile_reset_config(&cc->cellularConfig.profile);
+
+        free_sample_buffer(&sample);
+
+        /* Don't let later tests match frames of this sample */
+        channel_registry_build(NULL);
+}
+
+void TelemetryBatchTest::testConfig()
+{
+        const struct stream_profile_config *cell = &getWorkingLoggerConfig()->
+                ConnectivityConfigs.cellularConfig.profile;
+        string json("{\"setConnCfg\":{\"cellCfg\":{\"prof\":"
+                    "{\"batch\":10,\"batchMs\":1000}}}}");
+
+        mock_resetTxBuffer();
+        CPPUNIT_ASSERT_EQUAL((int) API_SUCCESS,
+                             process_api(getMockSerial(), (char *) json.c_str(),
+                                         json.size()));
+        CPPUNIT_ASSERT_EQUAL(10, (int) cell->batch_samples);
+        CPPUNIT_ASSERT_EQUAL(1000, (int) cell->batch_ms);
+
+        json = "{\"setConnCfg\":{\"cellCfg\":{\"prof\":{\"batch\":26}}}}";
+        CPPUNIT_ASSERT_EQUAL((int) API_ERROR_PARAMETER,
+                             process_api(getMockSerial(), (char *) json.c_str(),
+                                         json.size()));
+        CPPUNIT_ASSERT_EQUAL(10, (int) cell->batch_samples);
+}
+
+void TelemetryBatchTest::testDisabled()
+{
+        /* One sample per message needs no batch */
+        init_batch(1, 0);
+        CPPUNIT_ASSERT(!telemetry_batch_enabled(&tb));
+        CPPUNIT_ASSERT(NULL == tb.buff);
+
+        add(0, 0);
+        CPPUNIT_ASSERT_EQUAL(string(""), tx());
+        CPPUNIT_ASSERT(!telemetry_batch_enabled(NULL));
+}
+
+void TelemetryBatchTest::testBatchBySamples()
+{
+        init_batch(3, 0);
+        CPPUNIT_ASSERT(telemetry_batch_enabled(&tb));
+
+        add(5, 0);
+        add(6, 100);
+        CPPUNIT_ASSERT_EQUAL(string(""), tx());
+
+        /* Goes out once it is full, numbered by its first sample */
+        add(7, 200);
+        const string out = tx();
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, count_of(out, "\"sb\":"));
+        CPPUNIT_ASSERT(out.find("\"t\":5,\"q\":105,") != string::npos);
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, batch_samples(out));
+        CPPUNIT_ASSERT_EQUAL(string("\r\n"), out.substr(out.size() - 2));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, tb.count);
+}
+
+void TelemetryBatchTest::testBatchByWindow()
+{
+        init_batch(0, 250);
+
+        add(0, 1000);
+        add(1, 1100);
+        CPPUNIT_ASSERT(!telemetry_batch_due(&tb, 1249));
+        CPPUNIT_ASSERT(telemetry_batch_due(&tb, 1250));
+        CPPUNIT_ASSERT_EQUAL(string(""), tx());
+
+        /* A sample past the window starts the next batch */
+        add(2, 1300);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, batch_samples(tx()));
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, tb.count);
+
+        mock_resetTxBuffer();
+        telemetry_batch_flush(&tb, getMockSerial());
+        CPPUNIT_ASSERT(tx().find("\"t\":2,") != string::npos);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, batch_samples(tx()));
+
+        /* Nothing left */
+        mock_resetTxBuffer();
+        telemetry_batch_flush(&tb, getMockSerial());
+        CPPUNIT_ASSERT_EQUAL(string(""), tx());
+}
+
+void TelemetryBatchTest::testDeltas()
+{
+        api_send_sample_record(getMockSerial(), &sample, 0, 0, NULL);
+        const string live = tx();
+        mock_resetTxBuffer();
+
+        init_batch(3, 0);
+        add(0, 0);
+        add(1, 0);
+        sample.channel_samples[0].valueInt += 1234;
+        add(2, 0);
+        const string out = tx();
+
+        /* The first sample is whole */
+        CPPUNIT_ASSERT_EQUAL(record_data(live), batch_sample(out, 0));
+
+        /* Then nothing changed, so only the empty bitmaps are left */
+        const string second = batch_sample(out, 1);
+        CPPUNIT_ASSERT_EQUAL(string::npos, second.find_first_not_of("0,"));
+        const size_t bitmaps = count_of(second, ",") + 1;
+
+        /* Then only the one channel that did */
+        const string third = batch_sample(out, 2);
+        CPPUNIT_ASSERT_EQUAL(bitmaps, count_of(third, ","));
+        CPPUNIT_ASSERT_EQUAL((size_t) 0,
+                             third.find(",1") - third.find(','));
+}
+
+void TelemetryBatchTest::testMetaStartsBatch()
+{
+        init_batch(5, 0);
+
+        add(0, 0, true);
+        add(1, 0);
+        CPPUNIT_ASSERT_EQUAL(string(""), tx());
+
+        /* Metadata only goes at the start, so the batch before it goes out */
+        add(2, 0, true);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, count_of(tx(), "\"meta\":"));
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, batch_samples(tx()));
+
+        mock_resetTxBuffer();
+        telemetry_batch_flush(&tb, getMockSerial());
+        CPPUNIT_ASSERT(tx().find("\"t\":2,\"q\":102,\"meta\":") != string::npos);
+}
+
+void TelemetryBatchTest::testLayoutChange()
+{
+        init_batch(5, 0);
+        add(0, 0);
+        add(1, 0);
+
+        /* Bodies of the old layout are dropped */
+        channel_registry_build(&sample);
+        add(2, 0);
+        telemetry_batch_flush(&tb, getMockSerial());
+        CPPUNIT_ASSERT(tx().find("\"t\":2,") != string::npos);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, batch_samples(tx()));
+}
+
+void TelemetryBatchTest::testLayoutChangeBeforeFlush()
+{
+        init_batch(5, 0);
+        add(0, 0);
+        add(1, 0);
+
+        /* A timed out batch of the old layout is not decoded */
+        channel_registry_build(NULL);
+        mock_resetTxBuffer();
+        telemetry_batch_flush(&tb, getMockSerial());
+        CPPUNIT_ASSERT_EQUAL(string(""), tx());
+        CPPUNIT_ASSERT_EQUAL((size_t) 0, tb.count);
+}
+
+void TelemetryBatchTest::testSmaller()
+{
+        const size_t samples = 10;
+
+        for (size_t i = 0; i < samples; ++i) {
+                fill_sample(&sample, i + 1);
+                api_send_sample_record(getMockSerial(), &sample, i, 0, NULL);
+        }
+        const size_t single = tx().size();
+        mock_resetTxBuffer();
+
+        init_batch(samples, 0);
+        for (size_t i = 0; i < samples; ++i) {
+                fill_sample(&sample, i + 1);
+                add(i, 0);
+        }
+        const size_t batched = tx().size();
+
+        printf("\nbatch: %u samples, %u bytes one by one, %u batched\n",
+               (unsigned) samples, (unsigned) single, (unsigned) batched);
+        CPPUNIT_ASSERT(batched * 2 < single);
+}
@@ -0,0 +1,56 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _TELEMETRY_BATCH_TEST_H_
+#define _TELEMETRY_BATCH_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TelemetryBatchTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( TelemetryBatchTest );
+        CPPUNIT_TEST( testConfig );
+        CPPUNIT_TEST( testDisabled );
+        CPPUNIT_TEST( testBatchBySamples );
+        CPPUNIT_TEST( testBatchByWindow );
+        CPPUNIT_TEST( testDeltas );
+        CPPUNIT_TEST( testMetaStartsBatch );
+        CPPUNIT_TEST( testLayoutChange );
+        CPPUNIT_TEST( testLayoutChangeBeforeFlush );
+        CPPUNIT_TEST( testSmaller );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void setUp();
+        void tearDown();
+        void testConfig();
+        void testDisabled();
+        void testBatchBySamples();
+        void testBatchByWindow();
+        void testDeltas();
+        void testMetaStartsBatch();
+        void testLayoutChange();
+        void testLayoutChangeBeforeFlush();
+        void testSmaller();
+};
+
+#endif /* _TELEMETRY_BATCH_TEST_H_ */
@@ -0,0 +1,181 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "loggerConfig.h"
+#include "telemetry_rate.h"
+#include "telemetry_rate_test.hh"
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TelemetryRateTest );
+
+#define TX_CAP	100
+
+static struct telemetry_rate tr;
+
+static void clear(const tiny_millis_t now)
+{
+        telemetry_rate_sent(&tr, 0, TX_CAP, 0, now);
+}
+
+static void backed_up(const tiny_millis_t now)
+{
+        telemetry_rate_sent(&tr, TX_CAP, TX_CAP, 0, now);
+}
+
+void TelemetryRateTest::testInit()
+{
+        telemetry_rate_init(&tr, "BT", SAMPLE_50Hz);
+
+        CPPUNIT_ASSERT_EQUAL(50, telemetry_rate_hz(&tr));
+        CPPUNIT_ASSERT(telemetry_rate_should_send(&tr, SAMPLE_50Hz));
+        CPPUNIT_ASSERT(!telemetry_rate_should_send(&tr, SAMPLE_50Hz + 1));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, tr.sent);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, (uint32_t) tr.dropped);
+}
+
+void TelemetryRateTest::testOddMaxRate()
+{
+        /* Rates that aren't steps still get used as the max */
+        telemetry_rate_init(&tr, "BT", SAMPLE_100Hz);
+        CPPUNIT_ASSERT_EQUAL(100, telemetry_rate_hz(&tr));
+
+        backed_up(1000);
+        CPPUNIT_ASSERT_EQUAL(25, telemetry_rate_hz(&tr));
+}
+
+void TelemetryRateTest::testStaysAtMaxWhenClear()
+{
+        telemetry_rate_init(&tr, "Cell", SAMPLE_10Hz);
+
+        for (tiny_millis_t now = 0; now < 60000; now += 100)
+                clear(now);
+
+        CPPUNIT_ASSERT_EQUAL(10, telemetry_rate_hz(&tr));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 600, tr.sent);
+}
+
+void TelemetryRateTest::testStepDownOnTxBackup()
+{
+        telemetry_rate_init(&tr, "BT", SAMPLE_50Hz);
+
+        /* Under half full is fine */
+        telemetry_rate_sent(&tr, TX_CAP / 2 - 1, TX_CAP, 0, 1000);
+        CPPUNIT_ASSERT_EQUAL(50, telemetry_rate_hz(&tr));
+
+        telemetry_rate_sent(&tr, TX_CAP / 2, TX_CAP, 0, 1000);
+        CPPUNIT_ASSERT_EQUAL(25, telemetry_rate_hz(&tr));
+}
+
+void TelemetryRateTest::testStepDownOnDrops()
+{
+        telemetry_rate_init(&tr, "BT", SAMPLE_50Hz);
+
+        telemetry_rate_dropped(&tr);
+        clear(1000);
+        CPPUNIT_ASSERT_EQUAL(25, telemetry_rate_hz(&tr));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, (uint32_t) tr.dropped);
+
+        /* The same drop doesn't count twice */
+        clear(2000);
+        CPPUNIT_ASSERT_EQUAL(25, telemetry_rate_hz(&tr));
+}
+
+void TelemetryRateTest::testStepDownOnSlowWrite()
+{
+        telemetry_rate_init(&tr, "BT", SAMPLE_50Hz);
+
+        /* 50Hz is a 20ms period.  Writes up to half of that are OK */
+        telemetry_rate_sent(&tr, 0, TX_CAP, 10, 1000);
+        CPPUNIT_ASSERT_EQUAL(50, telemetry_rate_hz(&tr));
+
+        telemetry_rate_sent(&tr, 0, TX_CAP, 11, 1000);
+        CPPUNIT_ASSERT_EQUAL(25, telemetry_rate_hz(&tr));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 11, tr.latency_max_ms);
+        CPPUNIT_ASSERT(0 < tr.latency_ms);
+}
+
+void TelemetryRateTest::testStepDownHoldoff()
+{
+        telemetry_rate_init(&tr, "BT", SAMPLE_50Hz);
+
+        backed_up(1000);
+        CPPUNIT_ASSERT_EQUAL(25, telemetry_rate_hz(&tr));
+
+        /* Give the slower rate a chance to drain the link */
+        backed_up(1000 + TELEMETRY_RATE_STEP_DOWN_HOLDOFF_MS - 1);
+        CPPUNIT_ASSERT_EQUAL(25, telemetry_rate_hz(&tr));
+
+        backed_up(1000 + TELEMETRY_RATE_STEP_DOWN_HOLDOFF_MS);
+        CPPUNIT_ASSERT_EQUAL(10, telemetry_rate_hz(&tr));
+}
+
+void TelemetryRateTest::testFloor()
+{
+        telemetry_rate_init(&tr, "Cell", SAMPLE_10Hz);
+
+        for (tiny_millis_t now = 1000; now < 20000; now += 1000)
+                backed_up(now);
+
+        CPPUNIT_ASSERT_EQUAL(1, telemetry_rate_hz(&tr));
+}
+
+void TelemetryRateTest::testStepUpWhenClear()
+{
+        telemetry_rate_init(&tr, "Cell", SAMPLE_10Hz);
+        backed_up(1000);
+        backed_up(2000);
+        CPPUNIT_ASSERT_EQUAL(1, telemetry_rate_hz(&tr));
+
+        clear(2000 + TELEMETRY_RATE_STEP_UP_MS - 1);
+        CPPUNIT_ASSERT_EQUAL(1, telemetry_rate_hz(&tr));
+        clear(2000 + TELEMETRY_RATE_STEP_UP_MS);
+        CPPUNIT_ASSERT_EQUAL(5, telemetry_rate_hz(&tr));
+
+        /* A hiccup restarts the clock */
+        backed_up(2000 + TELEMETRY_RATE_STEP_UP_MS + 100);
+        CPPUNIT_ASSERT_EQUAL(5, telemetry_rate_hz(&tr));
+        clear(2000 + 2 * TELEMETRY_RATE_STEP_UP_MS);
+        CPPUNIT_ASSERT_EQUAL(5, telemetry_rate_hz(&tr));
+        clear(2000 + 2 * TELEMETRY_RATE_STEP_UP_MS + 100);
+        CPPUNIT_ASSERT_EQUAL(10, telemetry_rate_hz(&tr));
+
+        /* Never past the max */
+        clear(2000 + 10 * TELEMETRY_RATE_STEP_UP_MS);
+        CPPUNIT_ASSERT_EQUAL(10, telemetry_rate_hz(&tr));
+}
+
+void TelemetryRateTest::testReset()
+{
+        telemetry_rate_init(&tr, "Cell", SAMPLE_10Hz);
+        telemetry_rate_dropped(&tr);
+        telemetry_rate_sent(&tr, TX_CAP, TX_CAP, 300, 1000);
+        CPPUNIT_ASSERT_EQUAL(5, telemetry_rate_hz(&tr));
+
+        telemetry_rate_reset(&tr, 2000);
+        CPPUNIT_ASSERT_EQUAL(10, telemetry_rate_hz(&tr));
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, tr.latency_max_ms);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, tr.sent);
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 1, (uint32_t) tr.dropped);
+
+        /* Drops from before the reset don't count against the new link */
+        clear(3000);
+        CPPUNIT_ASSERT_EQUAL(10, telemetry_rate_hz(&tr));
+}
@@ -0,0 +1,56 @@
+/*
+ * Race Capture Pro Firmware
+ *
+ * Copyright (C) 2015 Autosport Labs
+ *
+ * This file is part of the Race Capture Pro fimrware suite
+ *
+ * This is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details. You should
+ * have received a copy of the GNU General Public License along with
+ * this code. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _TELEMETRY_RATE_TEST_H_
+#define _TELEMETRY_RATE_TEST_H_
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TelemetryRateTest : public CppUnit::TestFixture
+{
+        CPPUNIT_TEST_SUITE( TelemetryRateTest );
+        CPPUNIT_TEST( testInit );
+        CPPUNIT_TEST( testOddMaxRate );
+        CPPUNIT_TEST( testStaysAtMaxWhenClear );
+        CPPUNIT_TEST( testStepDownOnTxBackup );
+        CPPUNIT_TEST( testStepDownOnDrops );
+        CPPUNIT_TEST( testStepDownOnSlowWrite );
+        CPPUNIT_TEST( testStepDownHoldoff );
+        CPPUNIT_TEST( testFloor );
+        CPPUNIT_TEST( testStepUpWhenClear );
+        CPPUNIT_TEST( testReset );
+        CPPUNIT_TEST_SUITE_END();
+
+public:
+        void testInit();
+        void testOddMaxRate();
+        void testStaysAtMaxWhenClear();
+        void testStepDownOnTxBackup();
+        void testStepDownOnDrops();
+        void testStepDownOnSlowWrite();
+        void testStepDownHoldoff();
+        void testFloor();
+        void testStepUpWhenClear();
+        void testReset();
+};
+
+#endif /* _TELEMETRY_RATE_TEST_H_ */
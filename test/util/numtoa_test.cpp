@@ -21,7 +21,12 @@
 
 #include "numtoa_test.h"
 #include "modp_numtoa.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <string>
 
@@ -99,3 +104,207 @@ void NumtoaTest::testModpFToA() {
   CPPUNIT_ASSERT_EQUAL(string(expStr), string(str));
 
 }
+
+/*
+ * The modp_ftoa implementation from before modp_ftoa_fixed existed.
+ * Kept here so we can prove the output did not change.
+ */
+static const float refPow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+                                 10000000, 100000000, 1000000000};
+
+static void ref_strreverse(char* begin, char* end)
+{
+  char aux;
+  while (end > begin)
+    aux = *end, *end-- = *begin, *begin++ = aux;
+}
+
+static void reference_ftoa(float value, char* str, int prec)
+{
+  const float thres_max = (float)(0x7FFFFFFF);
+  float diff = 0.0;
+  char* wstr = str;
+
+  if (prec < 0)
+    prec = 0;
+  else if (prec > 9)
+    prec = 9;
+
+  int neg = 0;
+  if (value < 0) {
+    neg = 1;
+    value = -value;
+  }
+
+  int whole = (int) value;
+  float tmp = (value - whole) * refPow10[prec];
+  uint32_t frac = (uint32_t)(tmp);
+  diff = tmp - frac;
+
+  if (diff > 0.5) {
+    ++frac;
+    if (frac >= refPow10[prec]) {
+      frac = 0;
+      ++whole;
+    }
+  } else if (diff == 0.5 && ((frac == 0) || (frac & 1))) {
+    ++frac;
+  }
+
+  if (value > thres_max) {
+    strcpy(str,"3735928559");
+    return;
+  }
+
+  if (prec == 0) {
+    diff = value - whole;
+    if (diff > 0.5)
+      ++whole;
+    else if (diff == 0.5 && (whole & 1))
+      ++whole;
+  } else {
+    int count = prec;
+    do {
+      --count;
+      *wstr++ = 48 + (frac % 10);
+    } while (frac /= 10);
+    while (count-- > 0) *wstr++ = '0';
+    *wstr++ = '.';
+  }
+
+  do *wstr++ = 48 + (whole % 10);
+  while (whole /= 10);
+  if (neg)
+    *wstr++ = '-';
+  *wstr='\0';
+
+  if (prec > 0) trimLeadingZeros(str);
+  ref_strreverse(str, wstr-1);
+}
+
+static float bits_to_float(const uint32_t bits)
+{
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+/*
+ * Checks a single value against the reference.  The only allowed
+ * difference is the reference's halfway rollover bug, where something
+ * like 0.95 at precision 1 came out as "0.1".  In that case the new
+ * output must be the closer of the two.
+ */
+static bool matches_reference(const float value, const int prec)
+{
+  char exp[32];
+  char act[32];
+
+  reference_ftoa(value, exp, prec);
+  const size_t len = modp_ftoa_fixed(value, act, prec);
+
+  if (strlen(act) != len)
+    return false;
+
+  if (0 == strcmp(exp, act))
+    return true;
+
+  return fabs(strtod(act, NULL) - value) < fabs(strtod(exp, NULL) - value);
+}
+
+void NumtoaTest::testFToAFixedLength() {
+  char str[32];
+
+  CPPUNIT_ASSERT_EQUAL((size_t) 5, modp_ftoa_fixed(-1.15, str, 5));
+  CPPUNIT_ASSERT_EQUAL(string("-1.15"), string(str));
+
+  CPPUNIT_ASSERT_EQUAL((size_t) 3, modp_ftoa_fixed(0.0, str, 3));
+  CPPUNIT_ASSERT_EQUAL(string("0.0"), string(str));
+
+  CPPUNIT_ASSERT_EQUAL((size_t) 4, modp_ftoa_fixed(3000, str, 0));
+  CPPUNIT_ASSERT_EQUAL(string("3000"), string(str));
+
+  CPPUNIT_ASSERT_EQUAL((size_t) 7, modp_ftoa_fixed(-180.25, str, 6));
+  CPPUNIT_ASSERT_EQUAL(string("-180.25"), string(str));
+
+  CPPUNIT_ASSERT_EQUAL((size_t) 10, modp_ftoa_fixed(1e20, str, 2));
+  CPPUNIT_ASSERT_EQUAL(string("3735928559"), string(str));
+
+  CPPUNIT_ASSERT_EQUAL((size_t) 13,
+                       modp_ftoa_fixed(-2147483000.0, str, 9));
+  CPPUNIT_ASSERT_EQUAL(string("-2147483008.0"), string(str));
+}
+
+void NumtoaTest::testFToAFixedRollover() {
+  char str[32];
+
+  /* 0.95 * 10 rounds to exactly 9.5 in single precision */
+  modp_ftoa_fixed(0.95f, str, 1);
+  CPPUNIT_ASSERT_EQUAL(string("1.0"), string(str));
+
+  modp_ftoa_fixed(-0.99f, str, 1);
+  CPPUNIT_ASSERT_EQUAL(string("-1.0"), string(str));
+
+  modp_ftoa_fixed(2.5f, str, 0);
+  CPPUNIT_ASSERT_EQUAL(string("2"), string(str));
+
+  modp_ftoa_fixed(3.5f, str, 0);
+  CPPUNIT_ASSERT_EQUAL(string("4"), string(str));
+}
+
+void NumtoaTest::testFToAFixedMatchesReference() {
+  /* Walk the bit patterns of every float below 2^31, both signs */
+  for (int prec = 0; prec <= 9; ++prec) {
+    for (uint32_t bits = 0; bits < 0x4F000000; bits += 4099) {
+      const float value = bits_to_float(bits);
+      CPPUNIT_ASSERT_MESSAGE(string("Mismatch at ") + std::to_string(value),
+                             matches_reference(value, prec));
+      CPPUNIT_ASSERT(matches_reference(-value, prec));
+    }
+  }
+
+  /* Every value a channel of that precision can hold near zero */
+  for (int prec = 0; prec <= 6; ++prec) {
+    for (int i = -100000; i <= 100000; ++i) {
+      const float value = i / refPow10[prec];
+      CPPUNIT_ASSERT(matches_reference(value, prec));
+    }
+  }
+}
+
+void NumtoaTest::testFToAFixedRoundTrip() {
+  char str[32];
+
+  for (int prec = 1; prec <= 6; ++prec) {
+    /* Half a unit in the last place, plus float error at 1000 */
+    const double tolerance = 0.5 / refPow10[prec] + 1e-4;
+
+    for (int i = -1000000; i <= 1000000; i += 7) {
+      const float value = i / 1000.0f;
+      modp_ftoa_fixed(value, str, prec);
+      CPPUNIT_ASSERT(fabs(strtod(str, NULL) - value) <= tolerance);
+    }
+  }
+}
+
+void NumtoaTest::testFToAFixedThroughput() {
+  const size_t count = 2000000;
+  char str[32];
+  size_t total = 0;
+
+  clock_t start = clock();
+  for (size_t i = 0; i < count; ++i) {
+    reference_ftoa(i * 0.0173f - 5000.0f, str, i % 7);
+    total += str[0];
+  }
+  const double ref_secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+  start = clock();
+  for (size_t i = 0; i < count; ++i)
+    total += modp_ftoa_fixed(i * 0.0173f - 5000.0f, str, i % 7);
+  const double fixed_secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+  printf("\nftoa: reference %.1f ns/call, fixed %.1f ns/call (%zu)\n",
+         ref_secs * 1e9 / count, fixed_secs * 1e9 / count, total % 10);
+  CPPUNIT_ASSERT(0 < total);
+}
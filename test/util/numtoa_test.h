@@ -29,6 +29,11 @@ class NumtoaTest : public CppUnit::TestFixture
     CPPUNIT_TEST_SUITE( NumtoaTest );
     CPPUNIT_TEST( testDoubleConversion );
     CPPUNIT_TEST( testModpFToA );
+    CPPUNIT_TEST( testFToAFixedLength );
+    CPPUNIT_TEST( testFToAFixedRollover );
+    CPPUNIT_TEST( testFToAFixedMatchesReference );
+    CPPUNIT_TEST( testFToAFixedRoundTrip );
+    CPPUNIT_TEST( testFToAFixedThroughput );
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -36,6 +41,11 @@ public:
     void tearDown();
     void testModpFToA();
     void testDoubleConversion();
+    void testFToAFixedLength();
+    void testFToAFixedRollover();
+    void testFToAFixedMatchesReference();
+    void testFToAFixedRoundTrip();
+    void testFToAFixedThroughput();
 };
 
 #endif  // NUMTOATEST_H